@@ -0,0 +1,95 @@
+/**
+ * @file    arena.cpp
+ * @brief   Implementation of the ObjectArena allocator
+ * @author  Bryan Bartley
+ * @email   bartleyba@sbolstandard.org
+ *
+ * <!--------------------------------------------------------------------------
+ * This file is part of libSBOL.  Please visit http://sbolstandard.org for more
+ * information about SBOL, and the latest version of libSBOL.
+ *
+ *  Copyright 2016 University of Washington, WA, USA
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ------------------------------------------------------------------------->*/
+
+#include "arena.h"
+#include "object.h"
+
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+
+using namespace sbol;
+using namespace std;
+
+ObjectArena::~ObjectArena()
+{
+    release();
+};
+
+void* ObjectArena::allocate(size_t size, size_t alignment)
+{
+    size_t start = (offset + alignment - 1) / alignment * alignment;
+    if (blocks.empty() || start + size > block_size)
+    {
+        // Objects larger than a block get a block of their own
+        blocks.push_back((char*)malloc(max(size, block_size)));
+        if (!blocks.back())
+        {
+            blocks.pop_back();
+            throw bad_alloc();
+        }
+        start = 0;
+    }
+    offset = start + size;
+    return blocks.back() + start;
+};
+
+void ObjectArena::adopt(SBOLObject* sbol_obj)
+{
+    sbol_obj->owning_arena = this;
+    objects.push_back(sbol_obj);
+};
+
+// Removes the children in an arena from the object, and from the heap objects below it, so no destructor reaches a child the arena has already destroyed
+static void detach_arena_children(SBOLObject& sbol_obj)
+{
+    for (auto &i_own : sbol_obj.owned_objects)
+    {
+        vector<SBOLObject*>& object_store = i_own.second;
+        object_store.erase(remove_if(object_store.begin(), object_store.end(), [](SBOLObject* child) { return child->owning_arena != NULL; }), object_store.end());
+        for (auto &child : object_store)
+            detach_arena_children(*child);
+    }
+};
+
+void ObjectArena::release()
+{
+    // Every object is detached from its children in the arena while they are all still alive.  The objects are then destroyed in the reverse order of their construction, and children allocated from the heap are closed by their parents' destructors as usual
+    for (auto &sbol_obj : objects)
+        detach_arena_children(*sbol_obj);
+    for (auto i_obj = objects.rbegin(); i_obj != objects.rend(); ++i_obj)
+        (*i_obj)->~SBOLObject();
+    objects.clear();
+    for (auto &block : blocks)
+        free(block);
+    blocks.clear();
+    offset = 0;
+};
+
+ObjectArena*& ObjectArena::current()
+{
+    static thread_local ObjectArena* arena = NULL;
+    return arena;
+};
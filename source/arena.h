@@ -0,0 +1,97 @@
+/**
+ * @file    arena.h
+ * @brief   ObjectArena class, a region allocator for the objects a Document reads
+ * @author  Bryan Bartley
+ * @email   bartleyba@sbolstandard.org
+ *
+ * <!--------------------------------------------------------------------------
+ * This file is part of libSBOL.  Please visit http://sbolstandard.org for more
+ * information about SBOL, and the latest version of libSBOL.
+ *
+ *  Copyright 2016 University of Washington, WA, USA
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ------------------------------------------------------------------------->*/
+
+#ifndef ARENA_INCLUDED
+#define ARENA_INCLUDED
+
+#include "config.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace sbol
+{
+    class SBOLObject;
+
+    /// @cond
+    /// A region of memory from which a Document allocates the objects it reads. Objects are placed one after another in large blocks and are destroyed and freed together, which spares a heap allocation and a deallocation for every object
+    class SBOL_DECLSPEC ObjectArena
+    {
+    private:
+        std::vector<char*> blocks;
+        std::size_t block_size;
+        std::size_t offset;  ///< The next free byte in the last block
+        std::vector<SBOLObject*> objects;  ///< Objects constructed in the arena, in construction order
+
+    public:
+        ObjectArena(std::size_t block_size = 65536) :
+            block_size(block_size),
+            offset(0)
+        {
+        };
+
+        ~ObjectArena();
+
+        /// @return Uninitialized memory from the arena
+        void* allocate(std::size_t size, std::size_t alignment);
+
+        /// Registers an object constructed in memory from this arena, so that release() destroys it. The object records its arena, so that SBOLObject::close leaves it for the arena to destroy
+        void adopt(SBOLObject* sbol_obj);
+
+        /// Destroys every object in the arena and frees its memory
+        void release();
+
+        /// @return The number of objects in the arena
+        std::size_t size() const
+        {
+            return objects.size();
+        };
+
+        /// @return The arena that the factory functions in SBOL_DATA_MODEL_REGISTER allocate from on this thread, or NULL if they allocate from the heap
+        static ObjectArena*& current();
+
+        /// Makes an arena current on this thread for the lifetime of the Scope, and restores the previous one when the Scope ends, even if an exception is thrown
+        class Scope
+        {
+        private:
+            ObjectArena* previous;
+
+        public:
+            Scope(ObjectArena* arena) :
+                previous(current())
+            {
+                current() = arena;
+            };
+
+            ~Scope()
+            {
+                current() = previous;
+            };
+        };
+    };
+    /// @endcond
+}
+
+#endif /* ARENA_INCLUDED */
@@ -24,13 +24,90 @@
  * ------------------------------------------------------------------------->*/
 
 #include "assembly.h"
+#include "nucleotides.h"
 
 #include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 using namespace sbol;
 
 
+SequenceGraph& ComponentDefinition::getSequenceGraph()
+{
+    SequenceGraph& graph = sequence_graph;
+    if (graph.doc == doc && graph.revision == doc->revision)
+        return graph;
+
+    graph = SequenceGraph();
+    graph.doc = doc;
+    graph.revision = doc->revision;
+    for (auto &i_obj : owned_objects[SBOL_COMPONENTS])
+        graph.components[i_obj->identity.get()] = (Component*)i_obj;
+    for (auto i_sc = sequenceConstraints.begin(); i_sc != sequenceConstraints.end(); i_sc++)
+    {
+        SequenceConstraint& sc = *i_sc;
+        if (sc.restriction.get() != SBOL_RESTRICTION_PRECEDES)
+            continue;
+        const string& subject_id = sc.subject.get();
+        const string& object_id = sc.object.get();
+
+        // A linear arrangement allows each Component one neighbor on either side
+        auto i_downstream = graph.downstream.find(subject_id);
+        if (i_downstream != graph.downstream.end() && i_downstream->second != object_id && graph.branch.empty())
+            graph.branch = "Component " + subject_id + " precedes both " + i_downstream->second + " and " + object_id;
+        auto i_upstream = graph.upstream.find(object_id);
+        if (i_upstream != graph.upstream.end() && i_upstream->second != subject_id && graph.branch.empty())
+            graph.branch = "Component " + object_id + " follows both " + i_upstream->second + " and " + subject_id;
+
+        // As before, the last constraint wins when a Component has more than one neighbor on a side
+        graph.downstream[subject_id] = object_id;
+        graph.upstream[object_id] = subject_id;
+    }
+    return graph;
+}
+
+const vector<Component*>& ComponentDefinition::getSequentialOrder()
+{
+    SequenceGraph& graph = getSequenceGraph();
+    if (graph.is_ordered)
+        return graph.order;
+    if (!graph.branch.empty())
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "The SequenceConstraints of " + identity.get() + " do not arrange its Components in a single line. " + graph.branch);
+
+    // Walk upstream from an arbitrary Component to find the first. A walk that takes more steps than there are constraints has gone around a cycle
+    string first_id = owned_objects[SBOL_COMPONENTS].front()->identity.get();
+    size_t steps = 0;
+    for (auto i_upstream = graph.upstream.find(first_id); i_upstream != graph.upstream.end(); i_upstream = graph.upstream.find(first_id))
+    {
+        if (++steps > graph.upstream.size())
+            throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "The SequenceConstraints of " + identity.get() + " form a cycle through Component " + first_id);
+        first_id = i_upstream->second;
+    }
+
+    // Then walk downstream to the last
+    string next_id = first_id;
+    while (true)
+    {
+        auto i_component = graph.components.find(next_id);
+        if (i_component == graph.components.end())
+            throw SBOLError(SBOL_ERROR_NOT_FOUND, "Component " + next_id + " is referenced by a SequenceConstraint but is not contained in " + identity.get());
+        graph.order.push_back(i_component->second);
+        auto i_downstream = graph.downstream.find(next_id);
+        if (i_downstream == graph.downstream.end())
+            break;
+        next_id = i_downstream->second;
+    }
+    graph.is_ordered = true;
+    return graph.order;
+}
+
 int ComponentDefinition::hasUpstreamComponent(Component& current_component)
 {
     ComponentDefinition& cd_root = *this;
@@ -39,16 +116,7 @@ int ComponentDefinition::hasUpstreamComponent(Component& current_component)
     else if (cd_root.doc == NULL)
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "The ComponentDefinition must belong to a Document in order to use this method");
     else
-    {
-        int hasUpstreamComponent = 0;
-        for (auto i_sc = cd_root.sequenceConstraints.begin(); i_sc != cd_root.sequenceConstraints.end(); i_sc++)
-        {
-            SequenceConstraint& sc = *i_sc;
-            if (sc.object.get() == current_component.identity.get() && sc.restriction.get() == SBOL_RESTRICTION_PRECEDES)
-                hasUpstreamComponent = 1;
-        }
-        return hasUpstreamComponent;
-    }
+        return (int)getSequenceGraph().upstream.count(current_component.identity.get());
 }
 
 int ComponentDefinition::hasDownstreamComponent(Component& current_component)
@@ -59,16 +127,7 @@ int ComponentDefinition::hasDownstreamComponent(Component& current_component)
     else if (cd_root.doc == NULL)
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "The ComponentDefinition must belong to a Document in order to use this method");
     else
-    {
-        int hasDownstreamComponent = 0;
-        for (auto i_sc = cd_root.sequenceConstraints.begin(); i_sc != cd_root.sequenceConstraints.end(); i_sc++)
-        {
-            SequenceConstraint& sc = *i_sc;
-            if (sc.subject.get() == current_component.identity.get() && sc.restriction.get() == SBOL_RESTRICTION_PRECEDES)
-                hasDownstreamComponent = 1;
-        }
-        return hasDownstreamComponent;
-    }
+        return (int)getSequenceGraph().downstream.count(current_component.identity.get());
 }
 
 Component& ComponentDefinition::getUpstreamComponent(Component& current_component)
@@ -82,15 +141,12 @@ Component& ComponentDefinition::getUpstreamComponent(Component& current_componen
         throw SBOLError(SBOL_ERROR_END_OF_LIST, "This component has no upstream component. Use hasUpstreamComponent to catch this error");
     else
     {
-        string upstream_component_id;
-        for (auto i_sc = cd_root.sequenceConstraints.begin(); i_sc != cd_root.sequenceConstraints.end(); i_sc++)
-        {
-            SequenceConstraint& sc = *i_sc;
-            if (sc.object.get() == current_component.identity.get() && sc.restriction.get() == SBOL_RESTRICTION_PRECEDES)
-                 upstream_component_id = sc.subject.get();
-        }
-        Component& upstream_component = components[upstream_component_id];
-        return upstream_component;
+        SequenceGraph& graph = getSequenceGraph();
+        string upstream_component_id = graph.upstream[current_component.identity.get()];
+        auto i_component = graph.components.find(upstream_component_id);
+        if (i_component == graph.components.end())
+            throw SBOLError(SBOL_ERROR_NOT_FOUND, "Component " + upstream_component_id + " is not contained in " + identity.get());
+        return *i_component->second;
     }
 }
 
@@ -105,15 +161,12 @@ Component& ComponentDefinition::getDownstreamComponent(Component& current_compon
         throw SBOLError(SBOL_ERROR_END_OF_LIST, "This component has no downstream component. Use hasDownstreamComponent to catch this error");
     else
     {
-        string downstream_component_id;
-        for (auto i_sc = cd_root.sequenceConstraints.begin(); i_sc != cd_root.sequenceConstraints.end(); i_sc++)
-        {
-            SequenceConstraint& sc = *i_sc;
-            if (sc.subject.get() == current_component.identity.get() && sc.restriction.get() == SBOL_RESTRICTION_PRECEDES)
-                downstream_component_id = sc.object.get();
-        }
-        Component& downstream_component = components[downstream_component_id];
-        return downstream_component;
+        SequenceGraph& graph = getSequenceGraph();
+        string downstream_component_id = graph.downstream[current_component.identity.get()];
+        auto i_component = graph.components.find(downstream_component_id);
+        if (i_component == graph.components.end())
+            throw SBOLError(SBOL_ERROR_NOT_FOUND, "Component " + downstream_component_id + " is not contained in " + identity.get());
+        return *i_component->second;
     }
 }
 
@@ -124,16 +177,10 @@ Component& ComponentDefinition::getFirstComponent()
         throw SBOLError(SBOL_ERROR_NOT_FOUND, "This ComponentDefinition has no components");
     else if (cd_root.doc == NULL)
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "The ComponentDefinition must belong to a Document in order to use this method");
+    else if (cd_root.sequenceConstraints.size() < 1)
+        throw SBOLError(SBOL_ERROR_NOT_FOUND, "This component has no sequenceConstraints");
     else
-    {
-        Component& arbitrary_component = cd_root.components[0];
-        Component* iterator_component = &arbitrary_component;
-        while (cd_root.hasUpstreamComponent(*iterator_component))
-        {
-            iterator_component = &cd_root.getUpstreamComponent(*iterator_component);
-        }
-        return *iterator_component;
-    }
+        return *getSequentialOrder().front();
 }
 
 Component& ComponentDefinition::getLastComponent()
@@ -143,19 +190,10 @@ Component& ComponentDefinition::getLastComponent()
         throw SBOLError(SBOL_ERROR_NOT_FOUND, "This ComponentDefinition has no components");
     else if (cd_root.doc == NULL)
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "The ComponentDefinition must belong to a Document in order to use this method");
+    else if (cd_root.sequenceConstraints.size() < 1)
+        throw SBOLError(SBOL_ERROR_NOT_FOUND, "This component has no sequenceConstraints");
     else
-    {
-
-        Component& arbitrary_component = cd_root.components[0];
-//        Component* iterator_component = &arbitrary_component;
-        Component* iterator_component = &cd_root.components[0];
-        while (cd_root.hasDownstreamComponent(*iterator_component))
-        {
-            iterator_component = &cd_root.getDownstreamComponent(*iterator_component);
-        }
-
-        return *iterator_component;
-    }
+        return *getSequentialOrder().back();
 }
 
 
@@ -164,51 +202,122 @@ vector<Component*> ComponentDefinition::getInSequentialOrder()
     ComponentDefinition& cd_root = *this;
     if (cd_root.sequenceConstraints.size() < 1)
         throw SBOLError(SBOL_ERROR_NOT_FOUND, "This component has no sequenceConstraints");
+    else if (cd_root.components.size() < 1)
+        throw SBOLError(SBOL_ERROR_NOT_FOUND, "This ComponentDefinition has no components");
+    else if (cd_root.doc == NULL)
+        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "The ComponentDefinition must belong to a Document in order to use this method");
     else
-    {
-        Component* first = &getFirstComponent();
-        vector<Component*> sequential_components = { first };
-
-        Component* next = first;
-        while (hasDownstreamComponent(*next))
-        {
-            next = &getDownstreamComponent(*next);
-            sequential_components.push_back(next);
-        }
-        return sequential_components;
-    }
+        return getSequentialOrder();
 }
 
 
 std::string ComponentDefinition::updateSequence(std::string composite_sequence)
 {
-    ComponentDefinition& parent_component = *this;
-    std::string parent_component_id = parent_component.identity.get();
-    if (parent_component.components.size() > 0)
+    if (doc == NULL)
+        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "The ComponentDefinition must belong to a Document in order to use this method");
+    unordered_map<ComponentDefinition*, bool> visits;
+    return composite_sequence + getAssembledSequence(visits, false).str();
+}
+
+const PropertyValue& ComponentDefinition::getAssembledSequence(unordered_map<ComponentDefinition*, bool>& visits, bool update_sequences)
+{
+    auto i_visit = visits.find(this);
+    if (i_visit != visits.end() && !i_visit->second)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Cannot assemble the sequence of " + identity.get() + " because it contains itself");
+
+    // A part is described by its own Sequence. The elements are returned as stored, packed or not, without a copy
+    if (components.size() == 0)
     {
+        Sequence& seq = doc->get < Sequence > (sequences.get());
+        return seq.properties[SBOL_ELEMENTS].front();
+    }
 
+    // Assembled sequences are only reused as long as the Document's structure has not changed
+    if (doc->assembly_revision != doc->revision)
+    {
+        doc->assembled_sequences.clear();
+        doc->assembly_revision = doc->revision;
+    }
+    auto i_assembled = doc->assembled_sequences.find(this);
+    if (i_assembled != doc->assembled_sequences.end() && (!update_sequences || i_visit != visits.end()))
+        return i_assembled->second;
+    visits[this] = false;
+
+    const PropertyValue* assembled;  // Inserting while the parts are assembled may rehash the map, so keep the value rather than an iterator
+    if (i_assembled == doc->assembled_sequences.end())
+    {
+        // Assemble the parts first, so the composite sequence can be allocated once at its full length.  Packed parts are decoded straight into it
         vector<Component*> subcomponents = getInSequentialOrder();
+        vector<const PropertyValue*> parts;
+        parts.reserve(subcomponents.size());
+        size_t length = 0;
         for (auto i_c = subcomponents.begin(); i_c != subcomponents.end(); i_c++)
         {
             Component& c = **i_c;
             ComponentDefinition& cdef = doc->get < ComponentDefinition > (c.definition.get());
-            Sequence& seq = doc->get < Sequence > (cdef.sequences.get());
-            composite_sequence = composite_sequence + cdef.updateSequence(composite_sequence);
+            const PropertyValue& part = cdef.getAssembledSequence(visits, update_sequences);
+            parts.push_back(&part);
+            length += part.packed() ? part.packed()->size() : part.text().size();
         }
-        return composite_sequence;
+        string composite_sequence;
+        composite_sequence.reserve(length);
+        for (auto i_part = parts.begin(); i_part != parts.end(); i_part++)
+        {
+            if ((*i_part)->packed())
+                (*i_part)->packed()->append(composite_sequence);
+            else
+                composite_sequence.append((*i_part)->text());
+        }
+        assembled = &doc->assembled_sequences.emplace(this, PropertyValue(PropertyValue::LITERAL, std::move(composite_sequence))).first->second;
     }
     else
     {
-        std::string parent_component_seq = parent_component.sequences.get();
-        Sequence& seq = doc->get < Sequence >(parent_component.sequences.get());
-        return seq.elements.get();
+        assembled = &i_assembled->second;
+        // The composite parts of a reused assembly still need their Sequences updated
+        for (auto & c : components)
+            doc->get < ComponentDefinition > (c.definition.get()).getAssembledSequence(visits, update_sequences);
+    }
+    if (update_sequences && sequences.get().size())
+        doc->get < Sequence > (sequences.get()).elements.set(assembled->text());
+    visits[this] = true;
+    return *assembled;
+}
+
+void Document::invalidateAssembly(SBOLObject& sequence)
+{
+    if (assembled_sequences.empty())
+        return;
+
+    // Start from the parts this Sequence describes. The Sequences of composite ComponentDefinitions are assembled, so editing them changes nothing
+    vector<SBOLObject*> stale;
+    for (auto & referrer : getReferrers(sequence.identity.get(), SBOL_SEQUENCE_PROPERTY))
+        if (referrer->type == SBOL_COMPONENT_DEFINITION && ((ComponentDefinition*)referrer)->components.size() == 0)
+            stale.push_back(referrer);
+
+    // Then walk up the hierarchy through the Components that instantiate each stale ComponentDefinition
+    unordered_map<SBOLObject*, bool> visited;
+    while (stale.size())
+    {
+        SBOLObject* cdef = stale.back();
+        stale.pop_back();
+        for (auto & c : getReferrers(cdef->identity.get(), SBOL_DEFINITION))
+        {
+            SBOLObject* parent_cdef = c->parent;
+            if (c->type != SBOL_COMPONENT || parent_cdef == NULL || parent_cdef->type != SBOL_COMPONENT_DEFINITION)
+                continue;
+            if (visited[parent_cdef])
+                continue;
+            visited[parent_cdef] = true;
+            assembled_sequences.erase(parent_cdef);
+            stale.push_back(parent_cdef);
+        }
     }
 }
 
 /// @TODO update SequenceAnnotation starts and ends
 void ComponentDefinition::assemble(vector<ComponentDefinition*> list_of_components, Document& doc)
 {
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0)
+    if (!Config::snapshot().compliant_uris)
         throw SBOLError(SBOL_ERROR_COMPLIANCE, "Assemble methods require SBOL-compliance enabled");
 
     ComponentDefinition& parent_component = *this;
@@ -269,6 +378,173 @@ void ComponentDefinition::assemble(vector<ComponentDefinition*> list_of_componen
     assemble(list_of_components, *doc);
 }
 
+// The identity and displayId of a part, read on the calling thread so worker threads never touch the part itself
+struct AssemblyPart
+{
+    string identity;
+    string display_id;
+};
+
+// Builds one construct outside of any Document. Instance numbers are counted as the Components are created, since the construct starts out empty
+static ComponentDefinition* build_construct(const string& uri, const vector<ComponentDefinition*>& design, const unordered_map<ComponentDefinition*, AssemblyPart>& parts)
+{
+    ComponentDefinition* construct = new ComponentDefinition(uri);
+    try
+    {
+        unordered_map<string, int> instance_counts;
+        vector<Component*> list_of_instances;
+        list_of_instances.reserve(design.size());
+        for (auto & cdef : design)
+        {
+            const AssemblyPart& part = parts.at(cdef);
+            int instance_count = instance_counts[part.display_id]++;
+            Component& c = construct->components.create(part.display_id + "/" + to_string(instance_count));
+            c.definition.set(part.identity);
+            list_of_instances.push_back(&c);
+        }
+        for (size_t i_com = 1; i_com < list_of_instances.size(); i_com++)
+        {
+            SequenceConstraint& sc = construct->sequenceConstraints.create("constraint" + to_string(i_com));
+            sc.subject.set(list_of_instances[i_com - 1]->identity.get());
+            sc.object.set(list_of_instances[i_com]->identity.get());
+            sc.restriction.set(SBOL_RESTRICTION_PRECEDES);
+        }
+    }
+    catch (...)
+    {
+        construct->close();
+        throw;
+    }
+    return construct;
+}
+
+// Clears the Document back-pointers of an object and its children
+static void detach_from_document(SBOLObject& sbol_obj)
+{
+    sbol_obj.doc = NULL;
+    for (auto & i_store : sbol_obj.owned_objects)
+    {
+        for (auto & i_obj : i_store.second)
+            detach_from_document(*i_obj);
+    }
+}
+
+// Takes the parts that a failed batch added to a Document out of it again, newest first, so they are left outside of any Document as they were passed in
+static void remove_added_parts(Document& doc, vector<ComponentDefinition*>& added_parts)
+{
+    for (auto i_part = added_parts.rbegin(); i_part != added_parts.rend(); ++i_part)
+    {
+        doc.componentDefinitions.remove((*i_part)->identity.get());
+        detach_from_document(**i_part);
+    }
+    added_parts.clear();
+}
+
+vector<ComponentDefinition*> Document::assemble(vector<string> uris, vector<vector<ComponentDefinition*>> list_of_designs, unsigned int n_threads)
+{
+    if (!Config::snapshot().compliant_uris)
+        throw SBOLError(SBOL_ERROR_COMPLIANCE, "Assemble methods require SBOL-compliance enabled");
+    if (uris.size() != list_of_designs.size())
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Each new ComponentDefinition requires a list of parts");
+    vector<ComponentDefinition*> constructs(uris.size(), NULL);
+    if (uris.empty())
+        return constructs;
+
+    // Read the parts before any threads start. Parts that are not yet in a Document join this one, and leave it again if the batch fails
+    unordered_map<ComponentDefinition*, AssemblyPart> parts;
+    vector<ComponentDefinition*> added_parts;
+    try
+    {
+        for (auto & design : list_of_designs)
+        {
+            for (auto & cdef : design)
+            {
+                if (parts.count(cdef))
+                    continue;
+                if (cdef->doc == NULL)
+                {
+                    add<ComponentDefinition>(*cdef);
+                    added_parts.push_back(cdef);
+                }
+                else if (cdef->doc != this)
+                    throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "ComponentDefinition " + cdef->identity.get() + " cannot be assembled because it belongs to a different Document than the calling object.");
+                parts[cdef] = { cdef->identity.get(), cdef->displayId.get() };
+            }
+        }
+    }
+    catch (...)
+    {
+        remove_added_parts(*this, added_parts);
+        throw;
+    }
+
+    // Lay out every class a construct is built from on this thread, whatever the designs hold, so the workers look up slots that are already declared
+    ComponentDefinition* layout = new ComponentDefinition("layout");
+    layout->components.create("component");
+    layout->sequenceConstraints.create("constraint");
+    layout->close();
+    if (n_threads == 0)
+        n_threads = max(1u, thread::hardware_concurrency());
+    n_threads = (unsigned int)min((size_t)n_threads, uris.size());
+
+    // Workers claim constructs one at a time. The calling thread works alongside them
+    atomic<size_t> next_construct(0);
+    exception_ptr error;
+    mutex error_mutex;
+    auto work = [&]()
+    {
+        for (size_t i_construct = next_construct++; i_construct < uris.size(); i_construct = next_construct++)
+        {
+            try
+            {
+                constructs[i_construct] = build_construct(uris[i_construct], list_of_designs[i_construct], parts);
+            }
+            catch (...)
+            {
+                lock_guard<mutex> guard(error_mutex);
+                if (!error)
+                    error = current_exception();
+            }
+        }
+    };
+    vector<thread> workers;
+    for (unsigned int i_thread = 1; i_thread < n_threads; ++i_thread)
+        workers.push_back(thread(work));
+    work();
+    for (auto & worker : workers)
+        worker.join();
+
+    // Check every identity before adding any construct, so the Document receives either all of them or none
+    if (!error)
+    {
+        unordered_map<string, bool> new_identities;
+        for (auto & construct : constructs)
+        {
+            const string& construct_id = construct->identity.get();
+            if (SBOLObjects.count(construct_id) || new_identities[construct_id])
+            {
+                error = make_exception_ptr(SBOLError(DUPLICATE_URI_ERROR, "Cannot create " + construct_id + ". An object with this identity is already contained in the Document"));
+                break;
+            }
+            new_identities[construct_id] = true;
+        }
+    }
+    if (error)
+    {
+        for (auto & construct : constructs)
+        {
+            if (construct)
+                construct->close();
+        }
+        remove_added_parts(*this, added_parts);
+        rethrow_exception(error);
+    }
+    SBOLObjects.reserve(SBOLObjects.size() + constructs.size());
+    for (auto & construct : constructs)
+        add<ComponentDefinition>(*construct);
+    return constructs;
+}
+
 void Sequence::compile()
 {
     assemble();
@@ -298,19 +574,15 @@ std::string Sequence::assemble(std::string composite_sequence)
     {
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "Sequence cannot be assembled because it does not belong to a Document. Add the Sequence to a Document.");
     }
-    // Search for ComponentDefinition that this Sequence describes
+    // Search for ComponentDefinition that this Sequence describes, preferring one that has Components to assemble
     ComponentDefinition* parent_cdef = NULL;
-    for (auto i_obj = doc->SBOLObjects.begin(); i_obj != doc->SBOLObjects.end(); ++i_obj)
+    for (auto & referrer : doc->getReferrers(identity.get(), SBOL_SEQUENCE_PROPERTY))
     {
-        SBOLObject* obj = i_obj->second;
-        if (obj->getTypeURI() == SBOL_COMPONENT_DEFINITION)
-        {
-            ComponentDefinition* cdef = (ComponentDefinition*)obj;
-            if (cdef->sequences.get() == identity.get())
-            {
-                parent_cdef = cdef;
-            }
-        }
+        if (referrer->type != SBOL_COMPONENT_DEFINITION)
+            continue;
+        ComponentDefinition* cdef = (ComponentDefinition*)referrer;
+        if (parent_cdef == NULL || cdef->components.size() > 0)
+            parent_cdef = cdef;
     }
     // Throw an error if no ComponentDefinitions in the Document refer to this Sequence
     if (parent_cdef == NULL)
@@ -319,26 +591,15 @@ std::string Sequence::assemble(std::string composite_sequence)
     }
 
     ComponentDefinition& parent_component = *parent_cdef;
+    unordered_map<ComponentDefinition*, bool> visits;
     if (parent_component.components.size() > 0)
     {
-            
-        vector<Component*> subcomponents = parent_component.getInSequentialOrder();
-        for (auto i_c = subcomponents.begin(); i_c != subcomponents.end(); i_c++)
-        {
-            Component& c = **i_c;
-            ComponentDefinition& cdef = doc->get < ComponentDefinition > (c.definition.get());
-            Sequence& seq = doc->get < Sequence > (cdef.sequences.get());
-            composite_sequence = composite_sequence + seq.assemble(composite_sequence);
-        }
-        elements.set(composite_sequence);
-        return composite_sequence;
+        // The assembly sets the elements of this Sequence, along with those of the composite parts below it
+        parent_component.getAssembledSequence(visits, true);
+        return composite_sequence + elements.get();
     }
     else
-    {
-        std::string parent_component_seq = parent_component.sequences.get();
-        Sequence& seq = doc->get < Sequence >(parent_component.sequences.get());
-        return seq.elements.get();
-    }
+        return composite_sequence + parent_component.getAssembledSequence(visits, false).str();
 };
 
 void ModuleDefinition::assemble(std::vector < ModuleDefinition* > list_of_modules)
@@ -347,7 +608,7 @@ void ModuleDefinition::assemble(std::vector < ModuleDefinition* > list_of_module
     {
         throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Assemble method expects at least one ModuleDefinition");
     }
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0)
+    if (!Config::snapshot().compliant_uris)
         throw SBOLError(SBOL_ERROR_COMPLIANCE, "This method only works when SBOL-compliance is enabled");
     else
     {
@@ -369,10 +630,12 @@ FunctionalComponent& ModuleDefinition::setOutput(ComponentDefinition& output)
     {
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "These FunctionalComponents cannot be connected because they do not belong to a Document.");
     }
+    // An existing FunctionalComponent is looked up in the Document's identity index, and must belong to this ModuleDefinition
     string output_fc_id = persistentIdentity.get() + "/" + output.displayId.get() + "/" + version.get();
-    if (find(output_fc_id))
+    SBOLObject* existing_fc = doc->find(output_fc_id);
+    if (existing_fc && existing_fc->parent == this && existing_fc->type == SBOL_FUNCTIONAL_COMPONENT)
     {
-        FunctionalComponent& output_fc = functionalComponents[output_fc_id];
+        FunctionalComponent& output_fc = (FunctionalComponent&)*existing_fc;
         output_fc.direction.set(SBOL_DIRECTION_OUT);
         return output_fc;
     }
@@ -391,10 +654,12 @@ FunctionalComponent& ModuleDefinition::setInput(ComponentDefinition& input)
     {
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "These FunctionalComponents cannot be connected because they do not belong to a Document.");
     }
+    // An existing FunctionalComponent is looked up in the Document's identity index, and must belong to this ModuleDefinition
     string input_fc_id = persistentIdentity.get() + "/" + input.displayId.get() + "/" + version.get();
-    if (find(input_fc_id))
+    SBOLObject* existing_fc = doc->find(input_fc_id);
+    if (existing_fc && existing_fc->parent == this && existing_fc->type == SBOL_FUNCTIONAL_COMPONENT)
     {
-        FunctionalComponent& input_fc = functionalComponents[input_fc_id];
+        FunctionalComponent& input_fc = (FunctionalComponent&)*existing_fc;
         input_fc.direction.set(SBOL_DIRECTION_IN);
         return input_fc;
     }
@@ -519,9 +784,44 @@ FunctionalComponent& ModuleDefinition::setInput(ComponentDefinition& input)
 //    connection.refinement.set(SBOL_REFINEMENT_USE_LOCAL);
 //};
 
+// Resolves the ModuleDefinition that contains a FunctionalComponent through its back-pointer
+static ModuleDefinition& get_parent_module_definition(FunctionalComponent& fc)
+{
+    ModuleDefinition* mdef = dynamic_cast<ModuleDefinition*>(fc.parent);
+    if (mdef == NULL)
+        throw SBOLError(NOT_FOUND_ERROR, "FunctionalComponent " + fc.identity.get() + " must belong to a ModuleDefinition");
+    return *mdef;
+}
+
+// Links a component of one submodule to a component of another through a bridge FunctionalComponent contained in their parent ModuleDefinition
+static void connect_through(ModuleDefinition& parent_mdef, Module& subject_module, Module& object_module, FunctionalComponent& subject_fc, FunctionalComponent& interface_component)
+{
+    // Instantiate FunctionalComponent in parent ModuleDefinition
+    FunctionalComponent& bridge_fc = parent_mdef.functionalComponents.create(subject_fc.displayId.get());
+    bridge_fc.definition.set(subject_fc.definition.get());
+    
+    
+    // Link the modules through the bridge FunctionalComponent contained in the parent ModuleDefinition
+    // This FunctionalComponent is assumed to override the object component
+    MapsTo& half_connection1 = subject_module.mapsTos.create(subject_fc.displayId.get());
+    half_connection1.local.set(bridge_fc.identity.get());
+    half_connection1.remote.set(subject_fc.identity.get());
+    if (subject_fc.definition.get() == bridge_fc.definition.get())
+        half_connection1.refinement.set(SBOL_REFINEMENT_VERIFY_IDENTICAL);
+    else
+        half_connection1.refinement.set(SBOL_REFINEMENT_USE_REMOTE);
+    MapsTo& half_connection2 = object_module.mapsTos.create(subject_fc.displayId.get());
+    half_connection2.local.set(bridge_fc.identity.get());
+    half_connection2.remote.set(interface_component.identity.get());
+    if (interface_component.definition.get() == bridge_fc.definition.get())
+        half_connection2.refinement.set(SBOL_REFINEMENT_VERIFY_IDENTICAL);
+    else
+        half_connection2.refinement.set(SBOL_REFINEMENT_USE_LOCAL);
+}
+
 void FunctionalComponent::connect(FunctionalComponent& interface_component)
 {
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0)
+    if (!Config::snapshot().compliant_uris)
         throw SBOLError(SBOL_ERROR_COMPLIANCE, "SBOL-compliant URIs must be enabled to use this method");
    
     // Throw an error if this Sequence is not attached to a Document
@@ -530,104 +830,73 @@ void FunctionalComponent::connect(FunctionalComponent& interface_component)
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "These FunctionalComponents cannot be connected because they do not belong to a Document.");
     }
     
-    // Search for ModuleDefinition that this FunctionalComponent belongs to. Throw an error if the ModuleDefinition can't be found
-    ModuleDefinition* subject_mdef = NULL;
-    for (auto i_obj = doc->SBOLObjects.begin(); i_obj != doc->SBOLObjects.end(); ++i_obj)
+    // Both FunctionalComponents must belong to a ModuleDefinition
+    ModuleDefinition& subject_mdef = get_parent_module_definition(*this);
+    ModuleDefinition& object_mdef = get_parent_module_definition(interface_component);
+    
+    // Search for parent ModuleDefinition that contains the subject and object submodules. The Modules that instantiate each ModuleDefinition are found in the reference index
+    // Throw an error if the parent ModuleDefinition can't be found
+    unordered_map<SBOLObject*, Module*> object_modules;
+    for (auto & referrer : doc->getReferrers(object_mdef.identity.get(), SBOL_DEFINITION))
     {
-        SBOLObject* obj = i_obj->second;
-        if (obj->getTypeURI() == SBOL_MODULE_DEFINITION)
-        {
-            ModuleDefinition* mdef = (ModuleDefinition*)obj;
-            for (auto i_fc = mdef->functionalComponents.begin(); i_fc != mdef->functionalComponents.end(); ++i_fc)
-            {
-                FunctionalComponent& fc = *i_fc;
-                if (fc.identity.get() == identity.get())
-                    subject_mdef = mdef;
-            }
-        }
+        if (referrer->type == SBOL_MODULE && referrer->parent)
+            object_modules[referrer->parent] = (Module*)referrer;
     }
-    if (subject_mdef == NULL)
-        throw SBOLError(NOT_FOUND_ERROR, "FunctionalComponent must belong to a ModuleDefinition");
-
-    // The interface component must also belong to a ModuleDefinition. Throw an error if the ModuleDefinition can't be found
-    ModuleDefinition* object_mdef = NULL;
-    for (auto i_obj = doc->SBOLObjects.begin(); i_obj != doc->SBOLObjects.end(); ++i_obj)
-    {
-        SBOLObject* obj = i_obj->second;
-        if (obj->getTypeURI() == SBOL_MODULE_DEFINITION)
-        {
-            ModuleDefinition* mdef = (ModuleDefinition*)obj;
-            for (auto i_fc = mdef->functionalComponents.begin(); i_fc != mdef->functionalComponents.end(); ++i_fc)
-            {
-                FunctionalComponent& fc = *i_fc;
-                if (fc.identity.get() == interface_component.identity.get())
-                    object_mdef = mdef;
-            }
-        }
-    }
-    if (object_mdef == NULL)
-        throw SBOLError(NOT_FOUND_ERROR, "FunctionalComponent must belong to a ModuleDefinition");
-    
-    // Search for parent ModuleDefinition that contains the subject and object submodules
-    // The interface component MUST also belong to a ModuleDefinition. Throw an error if the parent ModuleDefinition can't be found
     ModuleDefinition* parent_mdef = NULL;
     Module* subject_module = NULL;
     Module* object_module = NULL;
-    for (auto i_obj = doc->SBOLObjects.begin(); i_obj != doc->SBOLObjects.end(); ++i_obj)
+    for (auto & referrer : doc->getReferrers(subject_mdef.identity.get(), SBOL_DEFINITION))
     {
-        SBOLObject* obj = i_obj->second;
-        if (obj->getTypeURI() == SBOL_MODULE_DEFINITION)
-        {
-            ModuleDefinition* mdef = (ModuleDefinition*)obj;
-            for (auto i_m = mdef->modules.begin(); i_m != mdef->modules.end(); ++i_m)
-            {
-                Module& m = *i_m;
-                if (m.definition.get() == subject_mdef->identity.get())
-                {
-                    for (auto i_n = mdef->modules.begin(); i_n != mdef->modules.end(); ++i_n)
-                    {
-                        Module& n = *i_n;
-                        if (n.definition.get() == object_mdef->identity.get())
-                        {
-                            parent_mdef = mdef;
-                            subject_module = &m;
-                            object_module = &n;
-                        }
-                    }
-                }
-            }
-        }
+        if (referrer->type != SBOL_MODULE)
+            continue;
+        auto i_object_module = object_modules.find(referrer->parent);
+        if (i_object_module == object_modules.end() || !dynamic_cast<ModuleDefinition*>(referrer->parent))
+            continue;
+        parent_mdef = (ModuleDefinition*)referrer->parent;
+        subject_module = (Module*)referrer;
+        object_module = i_object_module->second;
     }
     if (parent_mdef == NULL)
         throw SBOLError(NOT_FOUND_ERROR, "Cannot find Modules that these FunctionalComponents belong to");
     
-    // Instantiate FunctionalComponent in parent ModuleDefinition
-    FunctionalComponent& bridge_fc = parent_mdef->functionalComponents.create(displayId.get());
-    bridge_fc.definition.set(definition.get());
-    
-    
-    // Link the modules through the bridge FunctionalComponent contained in the parent ModuleDefinition
-    // This FunctionalComponent is assumed to override the object component
-    MapsTo& half_connection1 = subject_module->mapsTos.create(displayId.get());
-    half_connection1.local.set(bridge_fc.identity.get());
-    half_connection1.remote.set(identity.get());
-    if (definition.get() == bridge_fc.definition.get())
-        half_connection1.refinement.set(SBOL_REFINEMENT_VERIFY_IDENTICAL);
-    else
-        half_connection1.refinement.set(SBOL_REFINEMENT_USE_REMOTE);
-    MapsTo& half_connection2 = object_module->mapsTos.create(displayId.get());
-    half_connection2.local.set(bridge_fc.identity.get());
-    half_connection2.remote.set(interface_component.identity.get());
-    if (interface_component.definition.get() == bridge_fc.definition.get())
-        half_connection2.refinement.set(SBOL_REFINEMENT_VERIFY_IDENTICAL);
-    else
-        half_connection2.refinement.set(SBOL_REFINEMENT_USE_LOCAL);
+    connect_through(*parent_mdef, *subject_module, *object_module, *this, interface_component);
+};
+
+void ModuleDefinition::connect(vector<FunctionalComponent*> components, vector<FunctionalComponent*> interface_components)
+{
+    if (!Config::snapshot().compliant_uris)
+        throw SBOLError(SBOL_ERROR_COMPLIANCE, "SBOL-compliant URIs must be enabled to use this method");
+    if (doc == NULL)
+        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "These FunctionalComponents cannot be connected because they do not belong to a Document.");
+    if (components.size() != interface_components.size())
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Each FunctionalComponent requires an interface component to connect to");
     
+    // Map the submodules of this ModuleDefinition by their definitions once, for all the connections. A definition instantiated by more than one Module maps to NULL, since a connection through it would be ambiguous
+    unordered_map<string, Module*> submodules;
+    for (auto & i_obj : owned_objects[SBOL_MODULES])
+    {
+        Module& m = (Module&)*i_obj;
+        auto i_submodule = submodules.emplace(m.definition.get(), &m);
+        if (!i_submodule.second)
+            i_submodule.first->second = NULL;
+    }
+    for (size_t i_pair = 0; i_pair < components.size(); ++i_pair)
+    {
+        FunctionalComponent& subject_fc = *components[i_pair];
+        FunctionalComponent& object_fc = *interface_components[i_pair];
+        auto i_subject_module = submodules.find(get_parent_module_definition(subject_fc).identity.get());
+        auto i_object_module = submodules.find(get_parent_module_definition(object_fc).identity.get());
+        if (i_subject_module == submodules.end() || i_object_module == submodules.end())
+            throw SBOLError(NOT_FOUND_ERROR, "Cannot connect " + subject_fc.identity.get() + " to " + object_fc.identity.get() + ". " + identity.get() + " does not contain Modules for both of their ModuleDefinitions");
+        if (i_subject_module->second == NULL || i_object_module->second == NULL)
+            throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Cannot connect " + subject_fc.identity.get() + " to " + object_fc.identity.get() + ". " + identity.get() + " contains more than one Module for one of their ModuleDefinitions, so the connection is ambiguous");
+        connect_through(*this, *i_subject_module->second, *i_object_module->second, subject_fc, object_fc);
+    }
 };
 
 void Participation::define(ComponentDefinition& species, string role)
 {
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0)
+    if (!Config::snapshot().compliant_uris)
         throw SBOLError(SBOL_ERROR_COMPLIANCE, "SBOL-compliant URIs must be enabled to use this method");
     if (doc == NULL)
     {
@@ -686,54 +955,16 @@ void ComponentDefinition::participate(Participation& species)
 
 void FunctionalComponent::mask(FunctionalComponent& masked_component)
 {
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0)
+    if (!Config::snapshot().compliant_uris)
         throw SBOLError(SBOL_ERROR_COMPLIANCE, "SBOL-compliant URIs must be enabled to use this method");
     if (doc == NULL)
     {
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "These FunctionalComponents cannot be connected because they do not belong to a Document.");
     }
     
-    // Search for ModuleDefinition that this FunctionalComponent belongs to. Throw an error if the ModuleDefinition can't be found
-    ModuleDefinition* subject_mdef = NULL;
-    for (auto i_obj = doc->SBOLObjects.begin(); i_obj != doc->SBOLObjects.end(); ++i_obj)
-    {
-        SBOLObject* obj = i_obj->second;
-        if (obj->getTypeURI() == SBOL_MODULE_DEFINITION)
-        {
-            ModuleDefinition* mdef = (ModuleDefinition*)obj;
-            for (auto i_fc = mdef->functionalComponents.begin(); i_fc != mdef->functionalComponents.end(); ++i_fc)
-            {
-                FunctionalComponent& fc = *i_fc;
-                if (fc.identity.get() == identity.get())
-                {
-                    subject_mdef = mdef;
-                }
-
-            }
-        }
-    }
-    if (subject_mdef == NULL)
-        throw SBOLError(NOT_FOUND_ERROR, "FunctionalComponent must belong to a ModuleDefinition");
-    // The masked component must also belong to a ModuleDefinition. Throw an error if the ModuleDefinition can't be found
-    ModuleDefinition* object_mdef = NULL;
-    for (auto i_obj = doc->SBOLObjects.begin(); i_obj != doc->SBOLObjects.end(); ++i_obj)
-    {
-        SBOLObject* obj = i_obj->second;
-        if (obj->getTypeURI() == SBOL_MODULE_DEFINITION)
-        {
-            ModuleDefinition* mdef = (ModuleDefinition*)obj;
-            for (auto i_fc = mdef->functionalComponents.begin(); i_fc != mdef->functionalComponents.end(); ++i_fc)
-            {
-                FunctionalComponent& fc = *i_fc;
-                if (fc.identity.get() == masked_component.identity.get())
-                {
-                    object_mdef = mdef;
-                }
-            }
-        }
-    }
-    if (object_mdef == NULL)
-        throw SBOLError(NOT_FOUND_ERROR, "FunctionalComponent must belong to a ModuleDefinition");
+    // Both FunctionalComponents must belong to a ModuleDefinition
+    ModuleDefinition* subject_mdef = &get_parent_module_definition(*this);
+    ModuleDefinition* object_mdef = &get_parent_module_definition(masked_component);
 
     // Determine the relationship of the parent modules.  Are they hierarchically nested? Are they different parts of the tree?
     int IS_LOCAL = -1;
@@ -795,7 +1026,7 @@ void FunctionalComponent::mask(FunctionalComponent& masked_component)
 
 int FunctionalComponent::isMasked()
 {
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0)
+    if (!Config::snapshot().compliant_uris)
         throw SBOLError(SBOL_ERROR_COMPLIANCE, "SBOL-compliant URIs must be enabled to use this method");
     if (doc == NULL)
     {
@@ -829,48 +1060,184 @@ int FunctionalComponent::isMasked()
     return 0;
 };
 
+// The ComponentDefinitions in a Component hierarchy, each listed once in the order a depth-first traversal first reaches it, along with the definitions of their Components
+struct ComponentHierarchy
+{
+    vector<ComponentDefinition*> nodes;
+    vector<vector<size_t>> children;  // Indices into nodes, one for each Component
+};
+
+// Definitions are looked up once, however many Components refer to them, so a hierarchy that reuses parts is walked in time proportional to its number of Components. Throws if a definition is missing or contains itself
+static void get_component_hierarchy(ComponentDefinition& root, ComponentHierarchy& hierarchy)
+{
+    Document* doc = root.doc;
+    unordered_map<ComponentDefinition*, size_t> indices;
+    vector<bool> is_open;  // Definitions on the path from the root to the one being visited
+    vector<pair<size_t, size_t>> path;  // Each definition on the path, and the next of its Components to visit
+
+    indices[&root] = 0;
+    hierarchy.nodes.push_back(&root);
+    hierarchy.children.push_back({});
+    is_open.push_back(true);
+    path.push_back(make_pair(0, 0));
+    while (path.size())
+    {
+        size_t i_node = path.back().first;
+        vector<SBOLObject*>& subcomponents = hierarchy.nodes[i_node]->owned_objects[SBOL_COMPONENTS];
+        if (path.back().second == subcomponents.size())
+        {
+            is_open[i_node] = false;
+            path.pop_back();
+            continue;
+        }
+        Component& subc = *(Component*)subcomponents[path.back().second++];
+        string definition = subc.definition.get();
+        ComponentDefinition* subcdef = dynamic_cast<ComponentDefinition*>(doc->find(definition));
+        if (!subcdef)
+            throw SBOLError(SBOL_ERROR_NOT_FOUND, definition + " not found");
+
+        auto i_sub = indices.find(subcdef);
+        if (i_sub != indices.end())
+        {
+            if (is_open[i_sub->second])
+                throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "The Component hierarchy of " + root.identity.get() + " is cyclical. " + subcdef->identity.get() + " contains itself through Component " + subc.identity.get());
+            hierarchy.children[i_node].push_back(i_sub->second);
+            continue;
+        }
+        size_t i_sub_node = hierarchy.nodes.size();
+        indices[subcdef] = i_sub_node;
+        hierarchy.nodes.push_back(subcdef);
+        hierarchy.children.push_back({});
+        hierarchy.children[i_node].push_back(i_sub_node);
+        is_open.push_back(true);
+        path.push_back(make_pair(i_sub_node, 0));
+    }
+}
+
 vector<ComponentDefinition*> ComponentDefinition::applyToComponentHierarchy(void (*callback_fn)(ComponentDefinition *, void *), void* user_data)
 {
     /* Assumes parent_component is an SBOL data structure of the general form ComponentDefinition(->Component->ComponentDefinition)n where n+1 is an integer describing how many hierarchical levels are in the SBOL structure */
-    /* Look at each of the ComponentDef's SequenceAnnotations, is the target base there? */
     if (!doc)
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "Cannot traverse Component hierarchy without a Document");
 
-    bool GET_ALL = true;
-    vector<ComponentDefinition*> component_nodes;
-    if (components.size() == 0)
+    ComponentHierarchy hierarchy;
+    get_component_hierarchy(*this, hierarchy);
+    if (callback_fn)
     {
-//        cout << "Adding subcomponent : " << identity.get() << endl;
-        component_nodes.push_back(this);  // Add leaf components
-        if (callback_fn)
-            callback_fn(this, user_data);
+        for (auto &i_node : hierarchy.nodes)
+            callback_fn(i_node, user_data);
     }
-    else
+    return hierarchy.nodes;
+};
+
+// The definitions that are ready for a worker's callbacks. A worker takes the definitions it made ready itself from the back of its own queue, and when that runs dry, steals the oldest definition from the front of another worker's queue
+struct HierarchyQueue
+{
+    mutex queue_mutex;
+    deque<size_t> ready;
+};
+
+vector<ComponentDefinition*> ComponentDefinition::applyToComponentHierarchy(void (*callback_fn)(ComponentDefinition *, void *), void* user_data, unsigned int n_threads)
+{
+    if (!doc)
+        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "Cannot traverse Component hierarchy without a Document");
+
+    ComponentHierarchy hierarchy;
+    get_component_hierarchy(*this, hierarchy);
+    vector<ComponentDefinition*>& nodes = hierarchy.nodes;
+    if (!callback_fn)
+        return nodes;
+    if (n_threads == 0)
+        n_threads = max(1u, thread::hardware_concurrency());
+    n_threads = (unsigned int)min((size_t)n_threads, nodes.size());
+
+    // A definition becomes ready once the callbacks of all the definitions beneath it have returned
+    vector<vector<size_t>> parents(nodes.size());
+    unique_ptr<atomic<size_t>[]> n_pending(new atomic<size_t>[nodes.size()]);
+    vector<HierarchyQueue> queues(n_threads);
+    for (size_t i_node = 0; i_node < nodes.size(); ++i_node)
     {
-        if (GET_ALL)
-        {
-//            cout << "Adding subcomponent : " << identity.get() << endl;
-            component_nodes.push_back(this);  // Add components with children
-            if (callback_fn)
-                callback_fn(this, user_data);
-        }
-        for (auto& subc : components)
+        for (auto &i_child : hierarchy.children[i_node])
+            parents[i_child].push_back(i_node);
+        n_pending[i_node] = hierarchy.children[i_node].size();
+    }
+    size_t n_leaves = 0;
+    for (size_t i_node = nodes.size(); i_node-- > 0; )
+    {
+        if (hierarchy.children[i_node].empty())
+            queues[n_leaves++ % n_threads].ready.push_back(i_node);
+    }
+
+    atomic<size_t> n_remaining(nodes.size());
+    atomic<bool> is_failed(false);
+    exception_ptr error;
+    mutex error_mutex;
+    auto work = [&](unsigned int i_worker)
+    {
+        HierarchyQueue& own = queues[i_worker];
+        while (n_remaining > 0 && !is_failed)
         {
-            if (!doc->find(subc.definition.get()))
+            size_t i_node = 0;
+            bool is_found = false;
             {
-//                std::cout << "Not found" << std::endl;
-                throw SBOLError(SBOL_ERROR_NOT_FOUND, subc.definition.get() + "not found");
+                lock_guard<mutex> guard(own.queue_mutex);
+                if (own.ready.size())
+                {
+                    i_node = own.ready.back();
+                    own.ready.pop_back();
+                    is_found = true;
+                }
             }
-            ComponentDefinition& subcdef = doc->get<ComponentDefinition>(subc.definition.get());
-//            std::cout << subcdef.identity.get() << std::endl;
-//            cout << "Descending one level : " << subcdef.identity.get() << endl;
-            vector < sbol::ComponentDefinition* > subcomponents = subcdef.applyToComponentHierarchy(callback_fn, user_data);
-//            cout << "Found " << subcomponents.size() << " components" << std::endl;
-            component_nodes.reserve(component_nodes.size() + distance(subcomponents.begin(), subcomponents.end()));
-            component_nodes.insert(component_nodes.end(), subcomponents.begin(),subcomponents.end());
+            for (unsigned int i_victim = 1; !is_found && i_victim < n_threads; ++i_victim)
+            {
+                HierarchyQueue& victim = queues[(i_worker + i_victim) % n_threads];
+                lock_guard<mutex> guard(victim.queue_mutex);
+                if (victim.ready.size())
+                {
+                    i_node = victim.ready.front();
+                    victim.ready.pop_front();
+                    is_found = true;
+                }
+            }
+            if (!is_found)
+            {
+                this_thread::yield();
+                continue;
+            }
+
+            try
+            {
+                callback_fn(nodes[i_node], user_data);
+            }
+            catch (...)
+            {
+                lock_guard<mutex> guard(error_mutex);
+                if (!error)
+                    error = current_exception();
+                is_failed = true;
+            }
+            for (auto &i_parent : parents[i_node])
+            {
+                if (--n_pending[i_parent] == 0)
+                {
+                    lock_guard<mutex> guard(own.queue_mutex);
+                    own.ready.push_back(i_parent);
+                }
+            }
+            --n_remaining;
         }
-    }
-    return component_nodes;
+    };
+
+    // The calling thread is one of the workers
+    vector<thread> workers;
+    for (unsigned int i_worker = 1; i_worker < n_threads; ++i_worker)
+        workers.push_back(thread(work, i_worker));
+    work(0);
+    for (auto &i_worker : workers)
+        i_worker.join();
+    if (error)
+        rethrow_exception(error);
+    return nodes;
 };
 
 bool SequenceAnnotation::precedes(SequenceAnnotation& comparand)
@@ -933,7 +1300,7 @@ int Range::precedes(Range& comparand)
 int Range::follows(Range& comparand)
 {
     if (start.get() > comparand.end.get())
-        return comparand.end.get() + 1 - start.get();
+        return start.get() + 1 - comparand.end.get();
     else
         return 0;
 }
@@ -968,53 +1335,257 @@ int Range::length()
 vector<SequenceAnnotation*> SequenceAnnotation::precedes(std::vector<SequenceAnnotation*> comparand_list)
 {
     vector<SequenceAnnotation*> filtered_list = {};
+    for (auto &ann_comparand : comparand_list)
+    {
+        if (this->precedes(*ann_comparand))
+            filtered_list.push_back(ann_comparand);
+    }
     return filtered_list;
 };
 
 std::vector<SequenceAnnotation*> SequenceAnnotation::follows(std::vector<SequenceAnnotation*> comparand_list)
 {
     vector<SequenceAnnotation*> filtered_list = {};
+    for (auto &ann_comparand : comparand_list)
+    {
+        if (this->follows(*ann_comparand))
+            filtered_list.push_back(ann_comparand);
+    }
     return filtered_list;
 };
 
 std::vector<SequenceAnnotation*> SequenceAnnotation::contains(std::vector<SequenceAnnotation*> comparand_list)
 {
     vector<SequenceAnnotation*> list_of_contained_annotations;
-    
-    sbol::Range& r_this = (sbol::Range&)locations[0];
-    cout << r_this.start.get() << "\t" << r_this.end.get() << "\t";
     for (auto &ann_comparand : comparand_list)
     {
         if (this->contains(*ann_comparand))
-        {
             list_of_contained_annotations.push_back(ann_comparand);
-            sbol::Range& r_comparand = (sbol::Range&)ann_comparand->locations[0];
-            cout << r_comparand.start.get() << "\t" << r_comparand.end.get() << "\n\t\t";
-        }
     }
-    cout << endl;
     return list_of_contained_annotations;
 };
 
 std::vector<SequenceAnnotation*> SequenceAnnotation::overlaps(std::vector<SequenceAnnotation*> comparand_list)
 {
     vector<SequenceAnnotation*> list_of_overlapping_annotations;
-    
-    sbol::Range& r_this = (sbol::Range&)locations[0];
-    cout << r_this.start.get() << "\t" << r_this.end.get() << "\t";
     for (auto &ann_comparand : comparand_list)
     {
         if (this->overlaps(*ann_comparand))
-        {
             list_of_overlapping_annotations.push_back(ann_comparand);
-            sbol::Range& r_comparand = (sbol::Range&)ann_comparand->locations[0];
-            cout << r_comparand.start.get() << "\t" << r_comparand.end.get() << "\n\t\t";
-        }
     }
-    cout << endl;
     return list_of_overlapping_annotations;
 };
 
+// Records the greatest and least end of the subtree rooted at the middle of a slice of the index
+static void summarize_intervals(AnnotationIndex& index, size_t lo, size_t hi)
+{
+    if (lo >= hi)
+        return;
+    size_t mid = lo + (hi - lo) / 2;
+    summarize_intervals(index, lo, mid);
+    summarize_intervals(index, mid + 1, hi);
+    index.max_end[mid] = index.intervals[mid].end;
+    index.min_end[mid] = index.intervals[mid].end;
+    if (lo < mid)
+    {
+        size_t left = lo + (mid - lo) / 2;
+        index.max_end[mid] = max(index.max_end[mid], index.max_end[left]);
+        index.min_end[mid] = min(index.min_end[mid], index.min_end[left]);
+    }
+    if (mid + 1 < hi)
+    {
+        size_t right = mid + 1 + (hi - mid - 1) / 2;
+        index.max_end[mid] = max(index.max_end[mid], index.max_end[right]);
+        index.min_end[mid] = min(index.min_end[mid], index.min_end[right]);
+    }
+}
+
+// A SequenceAnnotation with several locations is reported once, when the last of the locations a query needs is found
+static void report_interval(const AnnotationIndex::Interval& interval, int n_needed, unordered_map<SequenceAnnotation*, int>& hits, vector<SequenceAnnotation*>& found)
+{
+    if (interval.n_locations == 1)
+        found.push_back(interval.annotation);
+    else if (++hits[interval.annotation] == n_needed)
+        found.push_back(interval.annotation);
+}
+
+static void find_overlapping_intervals(AnnotationIndex& index, size_t lo, size_t hi, int start, int end, unordered_map<SequenceAnnotation*, int>& hits, vector<SequenceAnnotation*>& found)
+{
+    if (lo >= hi)
+        return;
+    size_t mid = lo + (hi - lo) / 2;
+    if (index.max_end[mid] < start)
+        return;
+    find_overlapping_intervals(index, lo, mid, start, end, hits, found);
+    const AnnotationIndex::Interval& interval = index.intervals[mid];
+    if (interval.start > end)
+        return;  // Neither does anything to the right
+    if (interval.end >= start)
+        report_interval(interval, 1, hits, found);
+    find_overlapping_intervals(index, mid + 1, hi, start, end, hits, found);
+}
+
+// A subtree is skipped when all of its intervals start before the region, start after it, or end after it. Apart from the subtrees along the paths to the region's two ends, a subtree that is searched lies entirely within the region by start, so its least end falling inside the region means it holds a contained interval.
+// A query therefore takes O((k + 1) log n) time for k contained intervals, however many intervals merely start in the region
+static void find_contained_intervals(AnnotationIndex& index, size_t lo, size_t hi, int start, int end, unordered_map<SequenceAnnotation*, int>& hits, vector<SequenceAnnotation*>& found)
+{
+    if (lo >= hi)
+        return;
+    size_t mid = lo + (hi - lo) / 2;
+    if (index.min_end[mid] > end)
+        return;
+    const AnnotationIndex::Interval& interval = index.intervals[mid];
+    if (interval.start >= start)
+        find_contained_intervals(index, lo, mid, start, end, hits, found);
+    if (interval.start > end)
+        return;
+    if (interval.start >= start && interval.end <= end)
+        report_interval(interval, interval.n_locations, hits, found);
+    find_contained_intervals(index, mid + 1, hi, start, end, hits, found);
+}
+
+void AnnotationIndex::build(vector<SequenceAnnotation*> annotations)
+{
+    intervals.clear();
+    first_bases.clear();
+    last_bases.clear();
+    for (auto & annotation : annotations)
+    {
+        size_t first_interval = intervals.size();
+        for (auto & location : annotation->owned_objects[SBOL_LOCATIONS])
+        {
+            if (location->type == SBOL_RANGE)
+            {
+                Range& r = *(Range*)location;
+                intervals.push_back({ 2 * r.start.get(), 2 * r.end.get(), annotation, 0 });
+            }
+            else if (location->type == SBOL_CUT)
+            {
+                Cut& c = *(Cut*)location;
+                intervals.push_back({ 2 * c.at.get() + 1, 2 * c.at.get() + 1, annotation, 0 });
+            }
+        }
+        if (intervals.size() == first_interval)
+            continue;  // A GenericLocation has no coordinates to index
+        int first_base = intervals[first_interval].start;
+        int last_base = intervals[first_interval].end;
+        for (size_t i_interval = first_interval; i_interval < intervals.size(); ++i_interval)
+        {
+            intervals[i_interval].n_locations = (int)(intervals.size() - first_interval);
+            first_base = min(first_base, intervals[i_interval].start);
+            last_base = max(last_base, intervals[i_interval].end);
+        }
+        first_bases.push_back(make_pair(first_base, annotation));
+        last_bases.push_back(make_pair(last_base, annotation));
+    }
+    auto by_position = [](const pair<int, SequenceAnnotation*>& a, const pair<int, SequenceAnnotation*>& b) { return a.first < b.first; };
+    stable_sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b) { return a.start < b.start; });
+    stable_sort(first_bases.begin(), first_bases.end(), by_position);
+    stable_sort(last_bases.begin(), last_bases.end(), by_position);
+    max_end.assign(intervals.size(), 0);
+    min_end.assign(intervals.size(), 0);
+    summarize_intervals(*this, 0, intervals.size());
+    is_built = true;
+}
+
+void AnnotationIndex::findOverlapping(int start, int end, vector<SequenceAnnotation*>& found)
+{
+    if (end < start)
+        return;  // An empty region meets nothing
+    unordered_map<SequenceAnnotation*, int> hits;
+    find_overlapping_intervals(*this, 0, intervals.size(), 2 * start, 2 * end, hits, found);
+}
+
+void AnnotationIndex::findContained(int start, int end, vector<SequenceAnnotation*>& found)
+{
+    if (end < start)
+        return;
+    unordered_map<SequenceAnnotation*, int> hits;
+    find_contained_intervals(*this, 0, intervals.size(), 2 * start, 2 * end, hits, found);
+}
+
+AnnotationIndex& ComponentDefinition::getAnnotationIndex()
+{
+    AnnotationIndex& index = annotation_index;
+    if (index.is_built && doc && index.doc == doc && index.revision == doc->revision)
+        return index;
+
+    // Without a Document there is no revision to tell when the annotations change, so the index is rebuilt for every query
+    index.doc = doc;
+    index.revision = doc ? doc->revision : 0;
+    vector<SequenceAnnotation*> annotations;
+    for (auto & i_obj : owned_objects[SBOL_SEQUENCE_ANNOTATIONS])
+        annotations.push_back((SequenceAnnotation*)i_obj);
+    index.build(annotations);
+    return index;
+}
+
+vector<SequenceAnnotation*> ComponentDefinition::findOverlappingAnnotations(int start, int end)
+{
+    vector<SequenceAnnotation*> found;
+    getAnnotationIndex().findOverlapping(start, end, found);
+    return found;
+}
+
+vector<vector<SequenceAnnotation*>> ComponentDefinition::findOverlappingAnnotations(vector<int> starts, vector<int> ends)
+{
+    if (starts.size() != ends.size())
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Each region requires both a start and an end");
+    AnnotationIndex& index = getAnnotationIndex();
+    vector<vector<SequenceAnnotation*>> found(starts.size());
+    for (size_t i_region = 0; i_region < starts.size(); ++i_region)
+        index.findOverlapping(starts[i_region], ends[i_region], found[i_region]);
+    return found;
+}
+
+vector<SequenceAnnotation*> ComponentDefinition::findContainedAnnotations(int start, int end)
+{
+    vector<SequenceAnnotation*> found;
+    getAnnotationIndex().findContained(start, end, found);
+    return found;
+}
+
+vector<vector<SequenceAnnotation*>> ComponentDefinition::findContainedAnnotations(vector<int> starts, vector<int> ends)
+{
+    if (starts.size() != ends.size())
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Each region requires both a start and an end");
+    AnnotationIndex& index = getAnnotationIndex();
+    vector<vector<SequenceAnnotation*>> found(starts.size());
+    for (size_t i_region = 0; i_region < starts.size(); ++i_region)
+        index.findContained(starts[i_region], ends[i_region], found[i_region]);
+    return found;
+}
+
+vector<SequenceAnnotation*> ComponentDefinition::findAnnotationsAt(int position)
+{
+    return findOverlappingAnnotations(position, position);
+}
+
+vector<vector<SequenceAnnotation*>> ComponentDefinition::findAnnotationsAt(vector<int> positions)
+{
+    return findOverlappingAnnotations(positions, positions);
+}
+
+vector<SequenceAnnotation*> ComponentDefinition::findPrecedingAnnotations(int position)
+{
+    AnnotationIndex& index = getAnnotationIndex();
+    vector<SequenceAnnotation*> found;
+    auto i_end = lower_bound(index.last_bases.begin(), index.last_bases.end(), 2 * position, [](const pair<int, SequenceAnnotation*>& last_base, int base) { return last_base.first < base; });
+    for (auto i_base = index.last_bases.begin(); i_base != i_end; ++i_base)
+        found.push_back(i_base->second);
+    return found;
+}
+
+vector<SequenceAnnotation*> ComponentDefinition::findFollowingAnnotations(int position)
+{
+    AnnotationIndex& index = getAnnotationIndex();
+    vector<SequenceAnnotation*> found;
+    auto i_begin = upper_bound(index.first_bases.begin(), index.first_bases.end(), 2 * position, [](int base, const pair<int, SequenceAnnotation*>& first_base) { return base < first_base.first; });
+    for (auto i_base = i_begin; i_base != index.first_bases.end(); ++i_base)
+        found.push_back(i_base->second);
+    return found;
+}
+
 int SequenceAnnotation::length()
 {
     if (locations.size() == 0)
@@ -1027,262 +1598,248 @@ int SequenceAnnotation::length()
 
 void ComponentDefinition::insertDownstream(Component& upstream, ComponentDefinition& insert)
 {
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0)
-        throw SBOLError(SBOL_ERROR_COMPLIANCE, "SBOL-compliant URIs must be enabled to use this method");
-    if (doc == NULL)
-        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "ComponentDefinition " + identity.get() + " does not belong to a Document. Add this ComponentDefinition to a Document before calling insertDownstream");
-    if (doc != insert.doc)
-        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "Invalid Document for ComponentDefinition " + insert.identity.get() + " Add the insert to the same Document as the calling object.");
-    // If the user makes a mistake and tries to insert a ComponentDefinition that doesn't already belong to this Document
-    if (insert.doc == NULL)
-        insert.doc = doc;
-    
-    // Two cases. In first case, insert a Component that already has a downstream Component specified by a SequenceConstraint. Otherwise, append this Component to the end os sequential constraints.
-    // Search for an existing SequenceConstraint between upstream and downstream Component
-    SequenceConstraint* target_constraint = NULL;
-    
-    // Search for target_constraint
-    for (int i_sc = 0; i_sc < sequenceConstraints.size(); ++i_sc)
-    {
-        SequenceConstraint& sc = sequenceConstraints[i_sc];
-        if (sc.subject.get().compare(upstream.identity.get()) == 0 && sc.restriction.get().compare(SBOL_RESTRICTION_PRECEDES) == 0)
-        {
-            // If more than one downstream component has been specified, then it is ambiguous where the insert should be placed, so throw an error
-            if (target_constraint != NULL)
-            {
-                throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "SequenceConstraints are ambiguous. The target component may have more than one downstream component specified");
-            }
-            target_constraint = &sc;
-        }
-    }
+    EditSession session(*this);
+    session.insertDownstream(upstream, insert);
+    session.commit();
+};
 
-    // Generate URI of a Component to be created.  Check if an object with that URI is already instantiated.
-    int instance_count = 0;
-    string component_id;
-    component_id = persistentIdentity.get() + "/" + insert.displayId.get() + "/" + to_string(instance_count) + "/" + version.get();
-    while (find(component_id) != NULL)
-    {
-        // Find the last instance assigned
-        ++instance_count;
-        component_id = persistentIdentity.get() + "/" + insert.displayId.get() + "/" + to_string(instance_count) + "/" + version.get();
-    }
-    // Autoconstruct the new Component
-    Component& c_insert = components.create(insert.displayId.get() + "/" + to_string(instance_count));
-    c_insert.definition.set(insert.identity.get());
-    
-    // Generate URI of new SequenceConstraint.  Check if an object with that URI is already instantiated.
-    instance_count = 0;
-    string sc_id;
-    sc_id = persistentIdentity.get() + "/constraint" + to_string(instance_count) + "/" + version.get();
-    while (find(sc_id) != NULL)
-    {
-        // Find the last instance assigned
-        ++instance_count;
-        sc_id = persistentIdentity.get() + "/constraint" + to_string(instance_count) + "/" + version.get();
+void ComponentDefinition::insertUpstream(Component& downstream, ComponentDefinition& insert)
+{
+    EditSession session(*this);
+    session.insertUpstream(downstream, insert);
+    session.commit();
+};
 
-    }
+void ComponentDefinition::addUpstreamFlank(Component& downstream, std::string elements)
+{
+    EditSession session(*this);
+    session.addUpstreamFlank(downstream, elements);
+    session.commit();
+};
 
-    // Autoconstruct the new SequenceConstraint
-    SequenceConstraint& sc_new = sequenceConstraints.create("constraint" + to_string(instance_count));
-    sc_new.subject.set(upstream.identity.get());
-    sc_new.object.set(component_id);
-    sc_new.restriction.set(SBOL_RESTRICTION_PRECEDES);
-    
-    // In case a downstream component was found...
-    if (target_constraint)
-    {
-        target_constraint->subject.set(c_insert.identity.get());
-    }
+void ComponentDefinition::addDownstreamFlank(Component& upstream, std::string elements)
+{
+    EditSession session(*this);
+    session.addDownstreamFlank(upstream, elements);
+    session.commit();
+};
 
+EditSession::EditSession(ComponentDefinition& design) :
+    design(design)
+{
+    validate();
 };
 
-void ComponentDefinition::insertUpstream(Component& downstream, ComponentDefinition& insert)
+EditSession::~EditSession()
+{
+    rollback();
+};
+
+void EditSession::validate()
 {
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0)
+    if (!Config::snapshot().compliant_uris)
         throw SBOLError(SBOL_ERROR_COMPLIANCE, "SBOL-compliant URIs must be enabled to use this method");
-    if (doc == NULL)
-        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "ComponentDefinition " + identity.get() + " does not belong to a Document. Add this ComponentDefinition to a Document before calling insertUpstream");
-    if (doc != insert.doc)
+    if (design.doc == NULL)
+        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "ComponentDefinition " + design.identity.get() + " does not belong to a Document. Add this ComponentDefinition to a Document before editing it");
+};
+
+void EditSession::insertDownstream(Component& target, ComponentDefinition& insert)
+{
+    if (design.doc != insert.doc)
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "Invalid Document for ComponentDefinition " + insert.identity.get() + " Add the insert to the same Document as the calling object.");
-    // If the user makes a mistake and tries to insert a ComponentDefinition that doesn't already belong to this Document
-    if (insert.doc == NULL)
-        insert.doc = doc;
-    // Two cases. In first case, insert a Component that already has a downstream Component specified by a SequenceConstraint. Otherwise, append this Component to the end os sequential constraints.
-    // Search for an existing SequenceConstraint between upstream and downstream Component
-    SequenceConstraint* target_constraint = NULL;
-    
-    // Search for target_constraint
-    for (int i_sc = 0; i_sc < sequenceConstraints.size(); ++i_sc)
-    {
-        SequenceConstraint& sc = sequenceConstraints[i_sc];
-        if (sc.object.get().compare(downstream.identity.get()) == 0 && sc.restriction.get().compare(SBOL_RESTRICTION_PRECEDES) == 0)
-        {
-            // If more than one downstream component has been specified, then it is ambiguous where the insert should be placed, so throw an error
-            if (target_constraint != NULL)
-            {
-                throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "SequenceConstraints are ambiguous. The target component may have more than one downstream component specified");
-            }
-            target_constraint = &sc;
-        }
-    }
-    
-    // Generate URI of a Component to be created.  Check if an object with that URI is already instantiated.
-    int instance_count = 0;
-    string component_id;
-    component_id = persistentIdentity.get() + "/" + insert.displayId.get() + "/" + to_string(instance_count) + "/" + version.get();
-    while (find(component_id) != NULL)
-    {
-        // Find the last instance assigned
-        ++instance_count;
-        component_id = persistentIdentity.get() + "/" + insert.displayId.get() + "/" + to_string(instance_count) + "/" + version.get();
-    }
-    // Autoconstruct the new Component
-    Component& c_insert = components.create(insert.displayId.get() + "/" + to_string(instance_count));
-    c_insert.definition.set(insert.identity.get());
-    
-    // Generate URI of new SequenceConstraint.  Check if an object with that URI is already instantiated.
-    instance_count = 0;
-    string sc_id;
-    sc_id = persistentIdentity.get() + "/constraint" + to_string(instance_count) + "/" + version.get();
-    while (find(sc_id) != NULL)
-    {
-        // Find the last instance assigned
-        ++instance_count;
-        sc_id = persistentIdentity.get() + "/constraint" + to_string(instance_count) + "/" + version.get();
-    }
-    
-    // Autoconstruct the new SequenceConstraint
-    SequenceConstraint& sc_new = sequenceConstraints.create("constraint" + to_string(instance_count));
-    sc_new.subject.set(component_id);
-    sc_new.object.set(downstream.identity.get());
-    sc_new.restriction.set(SBOL_RESTRICTION_PRECEDES);
-    
-    // In case an upstream component was found...
-    if (target_constraint)
-    {
-        target_constraint->object.set(c_insert.identity.get());
-    }
+    edits.push_back(Edit{ INSERT_DOWNSTREAM, target.identity.get(), insert.identity.get(), "" });
+};
 
+void EditSession::insertUpstream(Component& target, ComponentDefinition& insert)
+{
+    if (design.doc != insert.doc)
+        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "Invalid Document for ComponentDefinition " + insert.identity.get() + " Add the insert to the same Document as the calling object.");
+    edits.push_back(Edit{ INSERT_UPSTREAM, target.identity.get(), insert.identity.get(), "" });
 };
 
-void ComponentDefinition::addUpstreamFlank(Component& downstream, std::string elements)
+void EditSession::addUpstreamFlank(Component& target, std::string elements)
 {
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0)
-        throw SBOLError(SBOL_ERROR_COMPLIANCE, "SBOL-compliant URIs must be enabled to use this method");
-    if (doc == NULL)
-        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "ComponentDefinition " + identity.get() + " does not belong to a Document. Add this ComponentDefinition to a Document before attempting to insert a flanking Component");
+    edits.push_back(Edit{ ADD_UPSTREAM_FLANK, target.identity.get(), "", elements });
+};
+
+void EditSession::addDownstreamFlank(Component& target, std::string elements)
+{
+    edits.push_back(Edit{ ADD_DOWNSTREAM_FLANK, target.identity.get(), "", elements });
+};
 
-    // Generate URI of flanking ComponentDefinition.  Check if an object with that URI is already instantiated.
-    ComponentDefinition* flank = NULL;
-    int instance_count = 0;
-    string flank_display_id = "flank" + to_string(instance_count);
-    while (flank == NULL)
+void EditSession::rollback()
+{
+    edits.clear();
+};
+
+int EditSession::size()
+{
+    return edits.size();
+};
+
+// Removes objects created by a failed commit, newest first, and frees them
+template < class SBOLClass > static void destroy_created(List<OwnedObject<SBOLClass>>& objects, vector<string>& uris)
+{
+    for (auto i_uri = uris.rbegin(); i_uri != uris.rend(); ++i_uri)
     {
-        try
-        {
-            flank = &doc->componentDefinitions.create(flank_display_id);
-        }
-        catch(SBOLError &e)
-        {
-            instance_count++;
-            flank_display_id = "flank" + to_string(instance_count);
-        }
+        SBOLObject& obj = objects.get(*i_uri);
+        objects.remove(*i_uri);
+        obj.close();
     }
-    
-    // Set to Sequence Ontology "flanking_sequence"
-    flank->roles.set(SO "0000239");
+};
 
-    // Generate URI of flanking Sequence.  Check if an object with that URI is already instantiated.
-    Sequence* flank_seq = NULL;
-    instance_count = 0;
-    flank_display_id = "flank_seq" + to_string(instance_count);
-    while (flank_seq == NULL)
-    {
-        try
-        {
-            flank_seq = &doc->sequences.create(flank_display_id);
-        }
-        catch(sbol::SBOLError &e)
+void EditSession::commit()
+{
+    validate();
+    Document& doc = *design.doc;
+    string prefix = design.persistentIdentity.get() + "/";
+    string suffix = "/" + design.version.get();
+
+    // Index the precedes constraints once, by the Component upstream (the subject) and the Component downstream (the object) of each. The indices are kept up to date as edits are applied
+    unordered_map<string, vector<SequenceConstraint*>> downstream_of;
+    unordered_map<string, vector<SequenceConstraint*>> upstream_of;
+    for (int i_sc = 0; i_sc < design.sequenceConstraints.size(); ++i_sc)
+    {
+        SequenceConstraint& sc = design.sequenceConstraints[i_sc];
+        if (sc.restriction.get().compare(SBOL_RESTRICTION_PRECEDES) == 0)
         {
-            instance_count++;
-            flank_display_id = "flank_seq" + to_string(instance_count);
+            downstream_of[sc.subject.get()].push_back(&sc);
+            upstream_of[sc.object.get()].push_back(&sc);
         }
     }
-    
-    // Assign primary sequence elements
-    flank_seq->elements.set(elements);
-    
-    // Now add the Sequence to the ComponentDefinition
-    flank->sequences.set(flank_seq->identity.get());
 
-    // Insert the new flank upstream
-    insertUpstream(downstream, *flank);
-};
+    // Instance numbers already probed, so each number is tried at most once per commit
+    unordered_map<string, int> component_counts;
+    int constraint_count = 0;
+    int flank_count = 0;
+    int flank_seq_count = 0;
 
-void ComponentDefinition::addDownstreamFlank(Component& upstream, std::string elements)
-{
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0)
-        throw SBOLError(SBOL_ERROR_COMPLIANCE, "SBOL-compliant URIs must be enabled to use this method");
-    if (doc == NULL)
-        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "ComponentDefinition " + identity.get() + " does not belong to a Document. Add this ComponentDefinition to a Document before attempting to insert a flanking Component");
-    
-    // Generate URI of flanking ComponentDefinition.  Check if an object with that URI is already instantiated.
-    ComponentDefinition* flank = NULL;
-    int instance_count = 0;
-    string flank_display_id = "flank" + to_string(instance_count);
-    while (flank == NULL)
+    // Undo log
+    struct ChangedConstraint
     {
-        try
-        {
-            flank = &doc->componentDefinitions.create(flank_display_id);
-        }
-        catch(SBOLError &e)
+        SequenceConstraint* sc;
+        bool subject;
+        string previous;
+    };
+    vector<ChangedConstraint> changed_constraints;
+    vector<string> created_components;
+    vector<string> created_constraints;
+    vector<string> created_definitions;
+    vector<string> created_sequences;
+
+    try
+    {
+        for (auto &edit : edits)
         {
-            instance_count++;
-            flank_display_id = "flank" + to_string(instance_count);
+            Component* target = dynamic_cast<Component*>(doc.find(edit.target));
+            if (target == NULL || target->parent != &design)
+                throw SBOLError(NOT_FOUND_ERROR, "Component " + edit.target + " is not a Component of " + design.identity.get());
+
+            // Autoconstruct a ComponentDefinition and Sequence for a flank
+            ComponentDefinition* insert = NULL;
+            if (edit.type == ADD_UPSTREAM_FLANK || edit.type == ADD_DOWNSTREAM_FLANK)
+            {
+                insert = &create_numbered(doc.componentDefinitions, "flank", flank_count);
+                created_definitions.push_back(insert->identity.get());
+
+                // Set to Sequence Ontology "flanking_sequence"
+                insert->roles.set(SO "0000239");
+
+                Sequence& flank_seq = create_numbered(doc.sequences, "flank_seq", flank_seq_count);
+                created_sequences.push_back(flank_seq.identity.get());
+                flank_seq.elements.set(edit.elements);
+                insert->sequences.set(flank_seq.identity.get());
+            }
+            else
+            {
+                insert = dynamic_cast<ComponentDefinition*>(doc.find(edit.insert));
+                if (insert == NULL)
+                    throw SBOLError(NOT_FOUND_ERROR, "ComponentDefinition " + edit.insert + " not found");
+            }
+            bool downstream = (edit.type == INSERT_DOWNSTREAM || edit.type == ADD_DOWNSTREAM_FLANK);
+
+            // Find the SequenceConstraint that currently places a Component next to the target on the side of the insert. If more than one does, it is ambiguous where the insert should be placed
+            vector<SequenceConstraint*>& neighbors = downstream ? downstream_of[edit.target] : upstream_of[edit.target];
+            if (neighbors.size() > 1)
+                throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "SequenceConstraints are ambiguous. The target component may have more than one " + string(downstream ? "downstream" : "upstream") + " component specified");
+            SequenceConstraint* target_constraint = neighbors.size() ? neighbors.front() : NULL;
+
+            // Autoconstruct the new Component with the first free instance number
+            string display_id = insert->displayId.get();
+            int& instance_count = component_counts[display_id];
+            while (doc.find(prefix + display_id + "/" + to_string(instance_count) + suffix) != NULL)
+                ++instance_count;
+            Component& c_insert = design.components.create(display_id + "/" + to_string(instance_count++));
+            created_components.push_back(c_insert.identity.get());
+            c_insert.definition.set(insert->identity.get());
+
+            // Autoconstruct the new SequenceConstraint
+            while (doc.find(prefix + "constraint" + to_string(constraint_count) + suffix) != NULL)
+                ++constraint_count;
+            SequenceConstraint& sc_new = design.sequenceConstraints.create("constraint" + to_string(constraint_count++));
+            created_constraints.push_back(sc_new.identity.get());
+            sc_new.subject.set(downstream ? edit.target : c_insert.identity.get());
+            sc_new.object.set(downstream ? c_insert.identity.get() : edit.target);
+            sc_new.restriction.set(SBOL_RESTRICTION_PRECEDES);
+
+            // Splice the insert in between the target and its neighbor, if it has one
+            if (target_constraint)
+            {
+                if (downstream)
+                {
+                    changed_constraints.push_back(ChangedConstraint{ target_constraint, true, target_constraint->subject.get() });
+                    target_constraint->subject.set(c_insert.identity.get());
+                    downstream_of[c_insert.identity.get()] = { target_constraint };
+                }
+                else
+                {
+                    changed_constraints.push_back(ChangedConstraint{ target_constraint, false, target_constraint->object.get() });
+                    target_constraint->object.set(c_insert.identity.get());
+                    upstream_of[c_insert.identity.get()] = { target_constraint };
+                }
+            }
+            if (downstream)
+            {
+                downstream_of[edit.target] = { &sc_new };
+                upstream_of[c_insert.identity.get()] = { &sc_new };
+            }
+            else
+            {
+                upstream_of[edit.target] = { &sc_new };
+                downstream_of[c_insert.identity.get()] = { &sc_new };
+            }
         }
     }
-    
-    // Set to Sequence Ontology "flanking_sequence"
-    flank->roles.set(SO "0000239");
-    
-    // Generate URI of flanking Sequence.  Check if an object with that URI is already instantiated.
-    Sequence* flank_seq = NULL;
-    instance_count = 0;
-    flank_display_id = "flank_seq" + to_string(instance_count);
-    while (flank_seq == NULL)
+    catch(...)
     {
-        try
-        {
-            flank_seq = &doc->sequences.create(flank_display_id);
-        }
-        catch(sbol::SBOLError &e)
+        // Undo the applied edits in reverse order
+        for (auto i_change = changed_constraints.rbegin(); i_change != changed_constraints.rend(); ++i_change)
         {
-            instance_count++;
-            flank_display_id = "flank_seq" + to_string(instance_count);
+            if (i_change->subject)
+                i_change->sc->subject.set(i_change->previous);
+            else
+                i_change->sc->object.set(i_change->previous);
         }
-    }
-    
-    // Assign primary sequence elements
-    flank_seq->elements.set(elements);
-    
-    // Now add the Sequence to the ComponentDefinition
-    flank->sequences.set(flank_seq->identity.get());
-    
-    // Insert the new flank upstream
-    insertDownstream(upstream, *flank);
+        destroy_created(design.sequenceConstraints, created_constraints);
+        destroy_created(design.components, created_components);
+        destroy_created(doc.componentDefinitions, created_definitions);
+        destroy_created(doc.sequences, created_sequences);
+        edits.clear();
+        throw;
+    }
+    edits.clear();
 };
 
 std::vector<ComponentDefinition*> ComponentDefinition::getPrimaryStructure()
 {
     std::vector<ComponentDefinition*> primary_structure;
-    Component* c = &getFirstComponent();
-    ComponentDefinition* cd = &c->doc->componentDefinitions.get(c->definition.get());
-    primary_structure.push_back(cd);
-    while (hasDownstreamComponent(*c))
+    vector<Component*> subcomponents = getInSequentialOrder();
+    for (auto &c : subcomponents)
     {
-        c = &getDownstreamComponent(*c);
-        ComponentDefinition* cd = &c->doc->componentDefinitions.get(c->definition.get());
+        // Definitions are looked up in the Document's identity index, falling back on the slower search for URIs it does not know
+        ComponentDefinition* cd = dynamic_cast<ComponentDefinition*>(doc->find(c->definition.get()));
+        if (!cd)
+            cd = &doc->componentDefinitions.get(c->definition.get());
         primary_structure.push_back(cd);
     }
     return primary_structure;
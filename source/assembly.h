@@ -28,11 +28,48 @@
 #define SBOL_ASSEMBLY_INCLUDED
 
 #include "document.h"
+#include <algorithm>
+#include <string>
 #include <vector>
 
 namespace sbol
 {
-    
+    /// @cond
+    /// Creates an object with the first free displayId of the form <stem><count>. The count only moves forward, so a caller that keeps it never probes the same displayId twice
+    template < class SBOLClass > SBOLClass& create_numbered(List<OwnedObject<SBOLClass>>& objects, const std::string& stem, int& count)
+    {
+        while (true)
+        {
+            try
+            {
+                return objects.create(stem + std::to_string(count++));
+            }
+            catch(SBOLError &e)
+            {
+                // Only a taken displayId moves on to the next count
+                if (e.error_code() != DUPLICATE_URI_ERROR)
+                    throw;
+            }
+        }
+    };
+
+    /// @return The number after the highest one used by the objects' displayIds of the form <stem><number>, or first if that is higher.  Use it to seed the count of create_numbered
+    template < class SBOLClass > int next_number(List<OwnedObject<SBOLClass>>& objects, const std::string& stem, int first)
+    {
+        int next = first;
+        for (auto & sbol_obj : objects)
+        {
+            std::string display_id = sbol_obj.displayId.get();
+            size_t n_digits = display_id.size() - stem.size();
+            if (display_id.size() <= stem.size() || n_digits > 9 || display_id.compare(0, stem.size(), stem) != 0)
+                continue;
+            if (display_id.find_first_not_of("0123456789", stem.size()) == std::string::npos)
+                next = std::max(next, std::stoi(display_id.substr(stem.size())) + 1);
+        }
+        return next;
+    };
+    /// @endcond
+
 //void sbol::dissemble(ComponentDefinition& );
 //void sbol::attachSubcomponent();
 //void sbol::attachSubcomponents();
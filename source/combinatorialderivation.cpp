@@ -0,0 +1,362 @@
+/**
+ * @file    combinatorialderivation.cpp
+ * @brief   Derivation of the variants described by a CombinatorialDerivation
+ * @author  Bryan Bartley
+ * @email   bartleyba@sbolstandard.org
+ *
+ * <!--------------------------------------------------------------------------
+ * This file is part of libSBOL.  Please visit http://sbolstandard.org for more
+ * information about SBOL, and the latest version of libSBOL.
+ *
+ *  Copyright 2016 University of Washington, WA, USA
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ------------------------------------------------------------------------->*/
+
+#include "document.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+
+using namespace std;
+using namespace sbol;
+
+// The values of a property, leaving out the empty placeholder of a property that was never set
+static vector<string> get_values(SBOLObject& sbol_obj, const sbol_type& property_uri)
+{
+    vector<string> values;
+    auto i_property = sbol_obj.properties.find(property_uri);
+    if (i_property == sbol_obj.properties.end())
+        return values;
+    for (auto &i_val : i_property->second)
+    {
+        if (!i_val.empty())
+            values.push_back(i_val.str());
+    }
+    return values;
+};
+
+static string get_value(SBOLObject& sbol_obj, const sbol_type& property_uri)
+{
+    vector<string> values = get_values(sbol_obj, property_uri);
+    return values.size() ? values.front() : "";
+};
+
+// SplitMix64, which turns the seed into the parameters of the sampling sequence
+static unsigned long long split_mix(unsigned long long& x)
+{
+    unsigned long long z = (x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+};
+
+// Shuffles the bits of a number below mask + 1. Each step can be undone, so no two numbers are shuffled to the same one. This hides the regular low bits of the linear congruential sequence, which would otherwise vary the last VariableComponent in a fixed pattern
+static unsigned long long scramble(unsigned long long x, unsigned long long mask)
+{
+    unsigned int n_bits = 0;
+    while (n_bits < 64 && (mask >> n_bits))
+        ++n_bits;
+    unsigned int shift = max(1u, (n_bits + 1) / 2);
+    x ^= x >> shift;
+    x = (x * 0x9E3779B97F4A7C15ULL) & mask;
+    x ^= x >> shift;
+    x = (x * 0xBF58476D1CE4E5B9ULL) & mask;
+    x ^= x >> shift;
+    return x;
+};
+
+VariantGenerator::VariantGenerator(CombinatorialDerivation& derivation, unsigned long long n_variants, unsigned long long seed) :
+    n_designs(1),
+    n_variants(n_variants),
+    n_derived(0),
+    is_sampled(false),
+    seed(seed),
+    mask(0),
+    multiplier(1),
+    increment(0),
+    state(0)
+{
+    if (!Config::snapshot().compliant_uris)
+        throw SBOLError(SBOL_ERROR_COMPLIANCE, "Deriving variants requires SBOL-compliance enabled");
+    Document* doc = derivation.doc;
+    if (!doc)
+        throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "CombinatorialDerivation " + derivation.identity.get() + " must belong to a Document before its variants can be derived");
+    derivation_id = derivation.identity.get();
+    display_id = derivation.displayId.get();
+    if (display_id.empty())
+        display_id = "variant";
+    is_sampled = get_value(derivation, SBOL_STRATEGY).compare(SBOL_SAMPLE) == 0;
+    namespaces = doc->namespaces;
+
+    ComponentDefinition* template_cd = dynamic_cast<ComponentDefinition*>(doc->find(get_value(derivation, SBOL_TEMPLATE)));
+    if (!template_cd)
+        throw SBOLError(SBOL_ERROR_NOT_FOUND, "The template ComponentDefinition of " + derivation_id + " is not in the Document");
+    types = get_values(*template_cd, SBOL_TYPES);
+    roles = get_values(*template_cd, SBOL_ROLES);
+
+    // Template Components are ordered by identity, so the ordinals of variants do not depend on the order the template was built or read in
+    vector<SBOLObject*> template_components = template_cd->owned_objects[SBOL_COMPONENTS];
+    sort(template_components.begin(), template_components.end(), [](SBOLObject* a, SBOLObject* b)
+    {
+        return a->identity.get() < b->identity.get();
+    });
+    unordered_map<string, size_t> component_indices;
+    for (auto &i_com : template_components)
+    {
+        TemplateComponent c;
+        c.identity = i_com->identity.get();
+        c.display_id = get_value(*i_com, SBOL_DISPLAY_ID);
+        if (c.display_id.empty())
+            c.display_id = "component" + to_string(components.size());
+        c.definition = get_value(*i_com, SBOL_DEFINITION);
+        c.access = get_value(*i_com, SBOL_ACCESS);
+        c.role_integration = get_value(*i_com, SBOL_ROLE_INTEGRATION);
+        c.roles = get_values(*i_com, SBOL_ROLES);
+        c.variable = -1;
+        component_indices[c.identity] = components.size();
+        components.push_back(c);
+    }
+
+    for (auto &i_sc : template_cd->owned_objects[SBOL_SEQUENCE_CONSTRAINTS])
+    {
+        auto i_subject = component_indices.find(get_value(*i_sc, SBOL_SUBJECT));
+        auto i_object = component_indices.find(get_value(*i_sc, SBOL_OBJECT));
+        if (i_subject == component_indices.end() || i_object == component_indices.end())
+            throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "SequenceConstraint " + i_sc->identity.get() + " does not constrain Components of the template " + template_cd->identity.get());
+        string sc_display_id = get_value(*i_sc, SBOL_DISPLAY_ID);
+        if (sc_display_id.empty())
+            sc_display_id = "constraint" + to_string(constraints.size());
+        constraints.push_back({ sc_display_id, get_value(*i_sc, SBOL_RESTRICTION), i_subject->second, i_object->second });
+    }
+
+    // Match each VariableComponent to its template Component
+    vector<SBOLObject*> variables(components.size(), NULL);
+    for (auto &i_vc : derivation.owned_objects[SBOL_VARIABLE_COMPONENTS])
+    {
+        auto i_com = component_indices.find(get_value(*i_vc, SBOL_VARIABLE));
+        if (i_com == component_indices.end())
+            throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "VariableComponent " + i_vc->identity.get() + " does not refer to a Component of the template " + template_cd->identity.get());
+        if (variables[i_com->second])
+            throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Component " + i_com->first + " is the variable of more than one VariableComponent");
+        variables[i_com->second] = i_vc;
+    }
+
+    // Gather the options for each variable Component, in template order
+    for (size_t i_com = 0; i_com < components.size(); ++i_com)
+    {
+        if (!variables[i_com])
+            continue;
+        SBOLObject& vc = *variables[i_com];
+        components[i_com].variable = (int)choices.size();
+        choices.push_back({});
+        vector<string>& options = choices.back();
+        unordered_set<string> is_option;
+        for (auto &i_variant : get_values(vc, SBOL_VARIANTS))
+        {
+            if (is_option.insert(i_variant).second)
+                options.push_back(i_variant);
+        }
+        for (auto &i_collection : get_values(vc, SBOL_VARIANT_COLLECTIONS))
+        {
+            SBOLObject* collection = doc->find(i_collection);
+            if (!collection)
+                throw SBOLError(SBOL_ERROR_NOT_FOUND, "Collection " + i_collection + " is not in the Document");
+            for (auto &i_member : get_values(*collection, SBOL_MEMBERS))
+            {
+                if (is_option.insert(i_member).second)
+                    options.push_back(i_member);
+            }
+        }
+        for (auto &i_derivation : get_values(vc, SBOL_VARIANT_DERIVATIONS))
+        {
+            if (i_derivation.compare(derivation_id) == 0)
+                throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "VariableComponent " + vc.identity.get() + " cannot derive its variants from the CombinatorialDerivation that contains it");
+            vector<string> derived;
+            for (auto &i_referrer : doc->getReferrers(i_derivation, SBOL_WAS_DERIVED_FROM))
+            {
+                if (i_referrer->type.compare(SBOL_COMPONENT_DEFINITION) == 0)
+                    derived.push_back(i_referrer->identity.get());
+            }
+            sort(derived.begin(), derived.end());
+            for (auto &i_derived : derived)
+            {
+                if (is_option.insert(i_derived).second)
+                    options.push_back(i_derived);
+            }
+        }
+        string repeat = get_value(vc, SBOL_OPERATOR);
+        if (repeat.compare(SBOL_REPEAT_ZERO_OR_ONE) == 0 || repeat.compare(SBOL_REPEAT_ZERO_OR_MORE) == 0)
+            options.push_back("");
+
+        if (options.size() && n_designs > ~0ULL / options.size())
+            throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "The design space of " + derivation_id + " has more than 2^64 variants");
+        n_designs *= options.size();
+    }
+
+    if (this->n_variants == 0 || this->n_variants > n_designs)
+        this->n_variants = n_designs;
+    reset();
+};
+
+unsigned long long VariantGenerator::size()
+{
+    return n_designs;
+};
+
+unsigned long long VariantGenerator::remaining()
+{
+    return n_variants - n_derived;
+};
+
+void VariantGenerator::reset()
+{
+    n_derived = 0;
+    if (!is_sampled || n_designs == 0)
+        return;
+    mask = 0;
+    while (mask < n_designs - 1)
+        mask = (mask << 1) | 1;
+    // The sequence has a full period when the increment is odd and the multiplier is one more than a multiple of four
+    unsigned long long x = seed;
+    multiplier = (split_mix(x) & ~3ULL) | 1;
+    increment = split_mix(x) | 1;
+    state = split_mix(x) & mask;
+};
+
+unsigned long long VariantGenerator::nextOrdinal()
+{
+    if (!is_sampled)
+        return n_derived;
+    // Numbers beyond the design space are passed over. Since the design space fills more than half of the sequence, this takes fewer than two steps on average
+    while (true)
+    {
+        state = (state * multiplier + increment) & mask;
+        unsigned long long ordinal = scramble(state, mask);
+        if (ordinal < n_designs)
+            return ordinal;
+    }
+};
+
+ComponentDefinition* VariantGenerator::next()
+{
+    if (remaining() == 0)
+        return NULL;
+    unsigned long long ordinal = nextOrdinal();
+    ++n_derived;
+    return derive(ordinal);
+};
+
+std::vector<ComponentDefinition*> VariantGenerator::next(unsigned int batch_size)
+{
+    vector<ComponentDefinition*> batch;
+    batch.reserve((size_t)min((unsigned long long)batch_size, remaining()));
+    try
+    {
+        while (batch.size() < batch_size && remaining())
+            batch.push_back(next());
+    }
+    catch (...)
+    {
+        for (auto &i_variant : batch)
+            i_variant->close();
+        throw;
+    }
+    return batch;
+};
+
+ComponentDefinition* VariantGenerator::derive(unsigned long long ordinal)
+{
+    if (ordinal >= n_designs)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Variant " + to_string(ordinal) + " is outside the design space of " + derivation_id);
+
+    // The last VariableComponent is the least significant digit of the ordinal
+    vector<size_t> selection(choices.size());
+    unsigned long long remainder = ordinal;
+    for (size_t i_var = choices.size(); i_var-- > 0; )
+    {
+        selection[i_var] = (size_t)(remainder % choices[i_var].size());
+        remainder /= choices[i_var].size();
+    }
+
+    ComponentDefinition* variant = new ComponentDefinition(display_id + "_" + to_string(ordinal), types.size() ? types.front() : "");
+    try
+    {
+        for (size_t i_type = 1; i_type < types.size(); ++i_type)
+            variant->types.add(types[i_type]);
+        for (auto &i_role : roles)
+            variant->roles.add(i_role);
+        variant->wasDerivedFrom.set(derivation_id);
+
+        vector<Component*> instances(components.size(), NULL);
+        for (size_t i_com = 0; i_com < components.size(); ++i_com)
+        {
+            const TemplateComponent& t = components[i_com];
+            const string& definition = t.variable < 0 ? t.definition : choices[t.variable][selection[t.variable]];
+            if (t.variable >= 0 && definition.empty())
+                continue;
+            Component& c = variant->components.create(t.display_id);
+            c.definition.set(definition);
+            if (t.access.size())
+                c.access.set(t.access);
+            if (t.role_integration.size())
+                c.roleIntegration.set(t.role_integration);
+            for (auto &i_role : t.roles)
+                c.roles.add(i_role);
+            c.wasDerivedFrom.set(t.identity);
+            instances[i_com] = &c;
+        }
+
+        // Constraints on a Component that was left out are dropped
+        for (auto &t : constraints)
+        {
+            if (!instances[t.subject] || !instances[t.object])
+                continue;
+            SequenceConstraint& sc = variant->sequenceConstraints.create(t.display_id);
+            sc.subject.set(instances[t.subject]->identity.get());
+            sc.object.set(instances[t.object]->identity.get());
+            sc.restriction.set(t.restriction);
+        }
+    }
+    catch (...)
+    {
+        variant->close();
+        throw;
+    }
+    return variant;
+};
+
+unsigned long long VariantGenerator::write(std::ostream& sbol)
+{
+    RDFXMLWriter writer(sbol, namespaces);
+    writer.begin();
+    unsigned long long n_written = 0;
+    while (ComponentDefinition* variant = next())
+    {
+        try
+        {
+            writer.write(*variant);
+        }
+        catch (...)
+        {
+            variant->close();
+            throw;
+        }
+        variant->close();
+        ++n_written;
+    }
+    writer.end();
+    return n_written;
+};
@@ -1,13 +1,47 @@
+/**
+ * @file    combinatorialderivation.h
+ * @brief   CombinatorialDerivation and VariableComponent classes, and a VariantGenerator that derives their variants
+ * @author  Bryan Bartley
+ * @email   bartleyba@sbolstandard.org
+ *
+ * <!--------------------------------------------------------------------------
+ * This file is part of libSBOL.  Please visit http://sbolstandard.org for more
+ * information about SBOL, and the latest version of libSBOL.
+ *
+ *  Copyright 2016 University of Washington, WA, USA
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ------------------------------------------------------------------------->*/
+
 #ifndef COMBINATORIALDERIVATION_INCLUDED
 #define COMBINATORIALDERIVATION_INCLUDED
 
-#include "partshop.h"
+#include "toplevel.h"
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <unordered_map>
 
 namespace sbol
 {
+    // Forward declaration necessary for the variants derived by a VariantGenerator
+    class ComponentDefinition;
+
     /// The VariableComponent class can be used to specify a choice of ComponentDefinition objects for any new Component derived from a template Component in the template ComponentDefinition. This specification is made using the class properties variable, variants, variantCollections, and variantDerivations. While the variants, variantCollections, and variantDerivations properties are OPTIONAL, at least one of them MUST NOT be empty
     class SBOL_DECLSPEC VariableComponent : public Identified
     {
+    public:
         /// The variable property is REQUIRED and MUST contain a URI that refers to a template `Component` in the template `ComponentDefinition`. If the wasDerivedFrom property of a Component refers to this template Component, then the definition property of the derived Component MUST refer to one of the ComponentDefinition objects referred to by the variants property of the VariableComponent. If not, then this definition property MUST either (1) refer to one of the ComponentDefinition objects from a Collection referred to by the variantCollections property of the VariableComponent, or (2) refer to a ComponentDefinition derived from a CombinatorialDerivation referred to by the variantDerivations property of the VariableComponent.
         ReferencedObject variable;
         
@@ -37,7 +71,7 @@ namespace sbol
         VariableComponent(sbol_type type, std::string uri, std::string repeat, std::string version) :
             Identified(type, uri, version),
             variable(SBOL_VARIABLE, SBOL_COMPONENT, this),
-            repeat(SBOL_OPERATOR, this),
+            repeat(SBOL_OPERATOR, this, repeat),
             variants(SBOL_VARIANTS, SBOL_COMPONENT_DEFINITION, this),
             variantCollections(SBOL_VARIANT_COLLECTIONS, SBOL_COLLECTION, this),
             variantDerivations(SBOL_VARIANT_DERIVATIONS, SBOL_COMBINATORIAL_DERIVATION, this)
@@ -45,7 +79,7 @@ namespace sbol
         };
     };
     
-    /// A ComponentDeriviation specifies the composition of a combinatorial design or variant library for common use cases in synthetic biology, such as tuning the performance of a genetic circuit or biosynthetic pathway through combinatorial DNA assembly and screening
+    /// A ComponentDeriviation specifies the composition of a combinatorial design or variant library for common use cases in synthetic biology, such as tuning the performance of a genetic circuit or biosynthetic pathway through combinatorial DNA assembly and screening. Use a VariantGenerator to derive the ComponentDefinitions it describes
     class SBOL_DECLSPEC CombinatorialDerivation : public TopLevel
     {
     public:
@@ -70,13 +104,97 @@ namespace sbol
         
         CombinatorialDerivation(sbol_type type, std::string uri, std::string strategy, std::string version) :
             TopLevel(type, uri, version),
-            strategy(SBOL_STRATEGY, this),
-            masterTemplate(SBOL_TEMPLATE, SBOL_COMBINATORIAL_DERIVATION, this),
+            strategy(SBOL_STRATEGY, this, strategy),
+            masterTemplate(SBOL_TEMPLATE, SBOL_COMPONENT_DEFINITION, this),
             variableComponents(SBOL_VARIABLE_COMPONENTS, this)
         {
         };
     };
     
+    /// Derives the ComponentDefinitions described by a CombinatorialDerivation one at a time, so libraries far too large to hold in memory can still be enumerated or sampled. Each variant in the design space has an ordinal, read as a mixed-radix number with one digit for each VariableComponent, and a variant is built from its ordinal alone. The generator therefore keeps only the template and the choices for each VariableComponent, however many variants it derives.
+    /// Variants are not added to any Document. The caller owns each variant, and may add it to a Document or close() it once it has been used. Use write() to stream variants to a file without keeping them.
+    /// A VariableComponent with a zeroOrOne or zeroOrMore repeat may also be left out of a variant. Components are not repeated, so zeroOrMore is derived like zeroOrOne, and oneOrMore like one. Derivation requires SBOL-compliant URIs.
+    class SBOL_DECLSPEC VariantGenerator
+    {
+    public:
+        /// Prepare to derive variants from a CombinatorialDerivation, which must belong to a Document that contains its template, variants and variant Collections. The options for a variantDerivation are the ComponentDefinitions in the Document that were derived from it.
+        /// If the derivation's strategy is http://sbols.org/v2#sample, variants are drawn in a pseudorandom order without repetition. Otherwise they are enumerated in order of their ordinals.
+        /// @param derivation The CombinatorialDerivation
+        /// @param n_variants The number of variants to derive. By default, every variant in the design space is derived
+        /// @param seed Sampling with the same seed draws the same variants in the same order
+        VariantGenerator(CombinatorialDerivation& derivation, unsigned long long n_variants = 0, unsigned long long seed = 0);
+
+        /// @return The number of variants in the design space
+        unsigned long long size();
+
+        /// @return The number of variants left to derive
+        unsigned long long remaining();
+
+        /// Derive the next variant
+        /// @return The variant, or NULL once all variants have been derived
+        ComponentDefinition* next();
+
+        /// Derive the next batch of variants
+        /// @param batch_size The number of variants to derive
+        /// @return Up to batch_size variants, or an empty vector once all variants have been derived
+        std::vector<ComponentDefinition*> next(unsigned int batch_size);
+
+        /// Derive the variant with the given ordinal. Its displayId is the derivation's displayId followed by the ordinal, so the same variant always has the same URI
+        /// @param ordinal A number less than size()
+        /// @return The variant
+        ComponentDefinition* derive(unsigned long long ordinal);
+
+        /// Serialize the remaining variants to an RDF/XML stream. Each variant is derived, written and closed before the next, so memory use does not grow with the number of variants
+        /// @param sbol The output stream
+        /// @return The number of variants written
+        unsigned long long write(std::ostream& sbol);
+
+        /// Start again from the first variant. A sampling generator draws the same variants again
+        void reset();
+
+    private:
+        /// @cond
+        struct TemplateComponent
+        {
+            std::string identity;
+            std::string display_id;
+            std::string definition;
+            std::string access;
+            std::string role_integration;
+            std::vector<std::string> roles;
+            int variable;  // The VariableComponent that derives this Component, or -1 if the Component is copied unchanged
+        };
+        struct TemplateConstraint
+        {
+            std::string display_id;
+            std::string restriction;
+            std::size_t subject;  // Indices into the template Components
+            std::size_t object;
+        };
+
+        std::string derivation_id;
+        std::string display_id;
+        std::vector<std::string> types;
+        std::vector<std::string> roles;
+        std::vector<TemplateComponent> components;
+        std::vector<TemplateConstraint> constraints;
+        std::vector<std::vector<std::string>> choices;  // The definitions that each VariableComponent can take. An empty URI leaves the Component out of the variant
+        std::unordered_map<std::string, std::string> namespaces;
+
+        unsigned long long n_designs;     // The size of the design space
+        unsigned long long n_variants;    // The number of variants to derive
+        unsigned long long n_derived;     // The number derived so far
+        bool is_sampled;
+        unsigned long long seed;
+        // Samples are drawn by walking a full-period linear congruential sequence modulo the smallest power of two that covers the design space. The sequence visits every ordinal once, so no record of the variants already drawn is needed
+        unsigned long long mask;
+        unsigned long long multiplier;
+        unsigned long long increment;
+        unsigned long long state;
+
+        unsigned long long nextOrdinal();
+        /// @endcond
+    };
 }
 
-#endif
\ No newline at end of file
+#endif
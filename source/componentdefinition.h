@@ -31,6 +31,8 @@
 #include "sequenceannotation.h"
 #include "sequenceconstraint.h"
 #include <string>
+#include <vector>
+#include <unordered_map>
 
 namespace sbol 
 {
@@ -39,6 +41,48 @@ namespace sbol
     // Forward declaration of Sequence necessary for ComponentDefinition.sequence property
     class Sequence;
     class Participation;
+    class Document;
+
+    /// @cond
+    /// The precedes relations among a ComponentDefinition's Components, derived from its SequenceConstraints. A ComponentDefinition caches its graph until its Document is next modified
+    struct SBOL_DECLSPEC SequenceGraph
+    {
+        Document* doc = NULL;                                      ///< The Document the graph was built in
+        unsigned long revision = 0;                                ///< The Document revision the graph was built at
+        std::unordered_map<std::string, Component*> components;    ///< The ComponentDefinition's Components by identity
+        std::unordered_map<std::string, std::string> upstream;     ///< Maps a Component's identity to the identity of the Component that precedes it
+        std::unordered_map<std::string, std::string> downstream;   ///< Maps a Component's identity to the identity of the Component that follows it
+        std::string branch;                                        ///< Describes a Component with more than one neighbor on the same side, if there is one
+        bool is_ordered = false;
+        std::vector<Component*> order;                             ///< The Components in sequential order, built on first use
+    };
+
+    /// The Range and Cut locations of a ComponentDefinition's SequenceAnnotations, arranged as an interval tree. Positions are doubled, so base b lies at 2b and a Cut after base b lies at 2b + 1, between two bases. A ComponentDefinition caches its index until its Document is next modified
+    struct SBOL_DECLSPEC AnnotationIndex
+    {
+        struct Interval
+        {
+            int start;
+            int end;
+            SequenceAnnotation* annotation;
+            int n_locations;  ///< The number of intervals of the SequenceAnnotation
+        };
+        Document* doc = NULL;                                      ///< The Document the index was built in
+        unsigned long revision = 0;                                ///< The Document revision the index was built at
+        bool is_built = false;
+        std::vector<Interval> intervals;                           ///< Ordered by start. Each slice of the vector is a subtree, rooted at its middle element
+        std::vector<int> max_end;                                  ///< The greatest end in the subtree rooted at each interval
+        std::vector<int> min_end;                                  ///< The least end in the subtree rooted at each interval
+        std::vector<std::pair<int, SequenceAnnotation*>> first_bases;  ///< The first position of each SequenceAnnotation, in ascending order
+        std::vector<std::pair<int, SequenceAnnotation*>> last_bases;   ///< The last position of each SequenceAnnotation, in ascending order
+
+        void build(std::vector<SequenceAnnotation*> annotations);
+        /// Collects the SequenceAnnotations with an interval that meets the region from start to end
+        void findOverlapping(int start, int end, std::vector<SequenceAnnotation*>& found);
+        /// Collects the SequenceAnnotations whose intervals all lie within the region from start to end
+        void findContained(int start, int end, std::vector<SequenceAnnotation*>& found);
+    };
+    /// @endcond
     
     /// The ComponentDefinition class represents the structural entities of a biological design. The primary usage of this class is to represent structural entities with designed sequences, such as DNA, RNA, and proteins, but it can also be used to represent any other entity that is part of a design, such as small molecules, proteins, and complexes
     /// @ingroup sbol_core_data_model
@@ -99,8 +143,8 @@ namespace sbol
         /// @param doc The Document to which the assembled ComponentDefinitions will be added
         void assemble(std::vector<ComponentDefinition*> list_of_components, Document& doc);
         
-        /// Assemble a parent ComponentDefinition's Sequence from its subcomponent Sequences
-        /// @param composite_sequence A recursive parameter, use default value
+        /// Assemble a parent ComponentDefinition's Sequence from its subcomponent Sequences. Each ComponentDefinition in the hierarchy is assembled once, and the result is kept by the Document until a Sequence it was assembled from is edited, so calling this again after changing one part only reassembles the ComponentDefinitions that contain that part
+        /// @param composite_sequence A prefix for the assembled sequence, use default value
         /// @return The assembled parent sequence
         std::string updateSequence(std::string composite_sequence = "");
 
@@ -134,15 +178,64 @@ namespace sbol
         /// @return The last component in sequential order
         Component& getLastComponent();
         
-        /// Perform an operation on every Component in a structurally-linked hierarchy of Components by applying a callback function. If no callback is specified, the default behavior is to return a pointer list of each Component in the hierarchy.
+        /// Perform an operation on every Component in a structurally-linked hierarchy of Components by applying a callback function. If no callback is specified, the default behavior is to return a pointer list of each Component in the hierarchy. A ComponentDefinition that is reused in several places is visited once, before the ComponentDefinitions beneath it. Throws SBOL_ERROR_INVALID_ARGUMENT if a ComponentDefinition contains itself, before the callback is applied to anything.
         /// @param callback_fun A pointer to a callback function with signature void callback_fn(ComponentDefinition *, void *).
         /// @param user_data Arbitrary user data which can be passed in and out of the callback as an argument or return value.
         /// @return Returns a flat list of pointers to all Components in the hierarchy.
         std::vector<ComponentDefinition*> applyToComponentHierarchy(void (*callback_fn)(ComponentDefinition *, void *) = NULL, void * user_data = NULL);
 
+        /// Apply a callback function to every ComponentDefinition in a hierarchy, running the callbacks for independent branches of the hierarchy on several threads. Each ComponentDefinition is visited once, after the callbacks of all the ComponentDefinitions beneath it have returned, so results can be gathered from the leaves up. The callback must be safe to call from several threads at once. If a callback throws, no further callbacks are started and the first exception is rethrown.
+        /// @param callback_fun A pointer to a callback function with signature void callback_fn(ComponentDefinition *, void *).
+        /// @param user_data Arbitrary user data which is passed to every callback.
+        /// @param n_threads The number of threads to run callbacks on, including the calling thread. By default, one for each processor
+        /// @return Returns a flat list of pointers to all Components in the hierarchy, in the same order as the single-threaded method.
+        std::vector<ComponentDefinition*> applyToComponentHierarchy(void (*callback_fn)(ComponentDefinition *, void *), void * user_data, unsigned int n_threads);
+
         /// Get the primary sequence of a design in terms of its sequentially ordered Components
         std::vector<ComponentDefinition*> getPrimaryStructure();
 
+        /// Find the SequenceAnnotations with a Range or Cut that meets a region of the sequence. A Cut meets the region if it falls between two of its bases. Queries are answered from an interval index of the SequenceAnnotations, which is kept until the Document is next modified
+        /// @param start The first base of the region
+        /// @param end The last base of the region
+        /// @return The SequenceAnnotations, ordered by the start of their first matching location
+        std::vector<SequenceAnnotation*> findOverlappingAnnotations(int start, int end);
+
+        /// Find the SequenceAnnotations that meet each of several regions, using one index for all of them
+        /// @param starts The first base of each region
+        /// @param ends The last base of each region
+        /// @return A list of SequenceAnnotations for each region
+        std::vector<std::vector<SequenceAnnotation*>> findOverlappingAnnotations(std::vector<int> starts, std::vector<int> ends);
+
+        /// Find the SequenceAnnotations whose Ranges and Cuts all lie within a region of the sequence. A query takes time proportional to the number of Ranges and Cuts found, times the logarithm of the number indexed
+        /// @param start The first base of the region
+        /// @param end The last base of the region
+        std::vector<SequenceAnnotation*> findContainedAnnotations(int start, int end);
+
+        /// Find the SequenceAnnotations contained by each of several regions, using one index for all of them
+        /// @param starts The first base of each region
+        /// @param ends The last base of each region
+        /// @return A list of SequenceAnnotations for each region
+        std::vector<std::vector<SequenceAnnotation*>> findContainedAnnotations(std::vector<int> starts, std::vector<int> ends);
+
+        /// Find the SequenceAnnotations with a Range that covers a base
+        /// @param position The base
+        std::vector<SequenceAnnotation*> findAnnotationsAt(int position);
+
+        /// Find the SequenceAnnotations that cover each of several bases, using one index for all of them
+        /// @param positions The bases
+        /// @return A list of SequenceAnnotations for each base
+        std::vector<std::vector<SequenceAnnotation*>> findAnnotationsAt(std::vector<int> positions);
+
+        /// Find the SequenceAnnotations whose Ranges and Cuts all lie upstream of a base
+        /// @param position The base
+        /// @return The SequenceAnnotations, ordered by their last base
+        std::vector<SequenceAnnotation*> findPrecedingAnnotations(int position);
+
+        /// Find the SequenceAnnotations whose Ranges and Cuts all lie downstream of a base
+        /// @param position The base
+        /// @return The SequenceAnnotations, ordered by their first base
+        std::vector<SequenceAnnotation*> findFollowingAnnotations(int position);
+
         /// Insert a Component downstream of another in a primary sequence, shifting any adjacent Components dowstream as well
         /// @param target The target Component will be upstream of the insert Component after this operation.
         /// @param insert The insert Component is inserted downstream of the target Component.
@@ -171,6 +264,20 @@ namespace sbol
         void participate(Participation& species);
         
         virtual ~ComponentDefinition() {  };
+
+    private:
+        friend class Sequence;
+        SequenceGraph sequence_graph;
+        SequenceGraph& getSequenceGraph();  ///< Rebuilds the cached graph if the Document changed since it was built
+        const std::vector<Component*>& getSequentialOrder();  ///< The cached order, which throws if the Components do not form a single chain
+        /// Assembles the sequence of this ComponentDefinition from the Sequences of its parts, reusing the sequences the Document has already assembled
+        /// @param visits The ComponentDefinitions visited during this assembly, mapped to true once they are assembled. A ComponentDefinition that is reached again before it is assembled contains itself, which throws
+        /// @param update_sequences Also set the elements of the Sequence of each composite ComponentDefinition in the hierarchy
+        const PropertyValue& getAssembledSequence(std::unordered_map<ComponentDefinition*, bool>& visits, bool update_sequences);
+        AnnotationIndex annotation_index;
+        AnnotationIndex& getAnnotationIndex();  ///< Rebuilds the cached index if the Document changed since it was built
+
+    public:
 //	protected:
 		// This protected constructor is a delegate constructor.  It initializes ComponentDefinitions with the corresponding sbol_type_uri
         ComponentDefinition(sbol_type type, std::string uri, std::string component_type, std::string version) :
@@ -195,6 +302,66 @@ namespace sbol
 //			{
 //			}
 	};
+
+    /// Collects insertions and flanking sequences for a ComponentDefinition and applies them together. The ComponentDefinition's own insertDownstream, insertUpstream, addUpstreamFlank and addDownstreamFlank methods search its SequenceConstraints and probe for a free instance number on every call, so building up a large design one edit at a time takes quadratic time. An EditSession indexes the SequenceConstraints and counts instances once, when the session is committed.
+    /// Edits are applied in the order they were made and give the same result as calling the ComponentDefinition methods of the same names in that order. If any edit fails, the edits already applied are undone, so a commit either succeeds completely or leaves the design as it was.
+    class SBOL_DECLSPEC EditSession
+    {
+    public:
+        /// @param design The ComponentDefinition to edit. It must belong to a Document, and SBOL-compliant URIs must be enabled
+        EditSession(ComponentDefinition& design);
+
+        /// Uncommitted edits are discarded
+        ~EditSession();
+
+        /// Insert a Component downstream of another when the session is committed
+        /// @param target A Component of the design, which will be upstream of the insert
+        /// @param insert The ComponentDefinition to instantiate. It must belong to the same Document as the design
+        void insertDownstream(Component& target, ComponentDefinition& insert);
+
+        /// Insert a Component upstream of another when the session is committed
+        /// @param target A Component of the design, which will be downstream of the insert
+        /// @param insert The ComponentDefinition to instantiate. It must belong to the same Document as the design
+        void insertUpstream(Component& target, ComponentDefinition& insert);
+
+        /// Autoconstruct a flanking ComponentDefinition and Sequence and insert them upstream of a Component when the session is committed
+        /// @param target The new flanking sequence will be placed upstream of the target
+        /// @param elements The primary sequence elements of the flank
+        void addUpstreamFlank(Component& target, std::string elements);
+
+        /// Autoconstruct a flanking ComponentDefinition and Sequence and insert them downstream of a Component when the session is committed
+        /// @param target The new flanking sequence will be placed downstream of the target
+        /// @param elements The primary sequence elements of the flank
+        void addDownstreamFlank(Component& target, std::string elements);
+
+        /// Apply the pending edits to the design.  Afterwards the session is empty and may be used for more edits.  If an edit fails, the design and its Document are restored, the pending edits are discarded, and the error is rethrown
+        void commit();
+
+        /// Discard the pending edits without applying them
+        void rollback();
+
+        /// @return The number of pending edits
+        int size();
+
+    private:
+        /// @cond
+        enum EditType { INSERT_DOWNSTREAM, INSERT_UPSTREAM, ADD_UPSTREAM_FLANK, ADD_DOWNSTREAM_FLANK };
+
+        // Objects are recorded by URI, so an edit does not dangle if its target is removed before the commit
+        struct Edit
+        {
+            EditType type;
+            std::string target;
+            std::string insert;
+            std::string elements;
+        };
+
+        ComponentDefinition& design;
+        std::vector<Edit> edits;
+
+        void validate();
+        /// @endcond
+    };
 }
 
 #endif
\ No newline at end of file
@@ -78,6 +78,18 @@ std::map<std::string, std::vector<std::string>> sbol::Config::valid_options {
     {"return_file", { "True", "False" }}
 };
 
+Config::Snapshot sbol::Config::options_snapshot = Config::takeSnapshot();  // Defined after the option tables, so they are initialized first
+
+Config::Snapshot sbol::Config::takeSnapshot()
+{
+    Snapshot snapshot;
+    snapshot.compliant_uris = options["sbol_compliant_uris"].compare("True") == 0;
+    snapshot.typed_uris = options["sbol_typed_uris"].compare("True") == 0;
+    snapshot.validate = options["validate"].compare("True") == 0;
+    snapshot.output_format = options["output_format"].compare("json") == 0 ? FORMAT_JSON : FORMAT_RDFXML;
+    return snapshot;
+};
+
 void sbol::Config::setOption(std::string option, std::string value)
 {
     if (options.find(option) != options.end())
@@ -87,7 +99,10 @@ void sbol::Config::setOption(std::string option, std::string value)
         {
             // Set the option if a valid argument is provided
             if (std::find(valid_options[option].begin(), valid_options[option].end(), value) != valid_options[option].end())
+            {
                 options[option] = value;
+                options_snapshot = takeSnapshot();
+            }
             else
             {
                 // Format error message
@@ -126,7 +141,10 @@ void sbol::Config::setOption(std::string option, bool value)
         {
             // Set the option if a valid argument is provided
             if (std::find(valid_options[option].begin(), valid_options[option].end(), val_str) != valid_options[option].end())
+            {
                 options[option] = val_str;
+                options_snapshot = takeSnapshot();
+            }
             else
             {
                 // Format error message
@@ -163,7 +181,7 @@ std::string sbol::Config::getOption(std::string option)
 // @TODO move sbol_type TYPEDEF declaration to this file and use sbol_type instead of string for 2nd argument
 std::string sbol::constructCompliantURI(std::string sbol_type, std::string display_id, std::string version)
 {
-    if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+    if (Config::snapshot().compliant_uris)
         return getHomespace() + "/" + parseClassName(sbol_type) + "/" + display_id + "/" + version;
     else
         return "";
@@ -171,7 +189,7 @@ std::string sbol::constructCompliantURI(std::string sbol_type, std::string displ
 
 std::string sbol::constructCompliantURI(std::string parent_type, std::string child_type, std::string display_id, std::string version)
 {
-    if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+    if (Config::snapshot().compliant_uris)
         return getHomespace() + "/" + parseClassName(parent_type) + "/" + parseClassName(child_type) + "/" + display_id + "/" + version;
     else
         return "";
@@ -180,9 +198,9 @@ std::string sbol::constructCompliantURI(std::string parent_type, std::string chi
 // This autoconstruct method constructs non-SBOL-compliant URIs
 std::string sbol::constructNonCompliantURI(std::string uri)
 {
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0 && hasHomespace())
+    if (!Config::snapshot().compliant_uris && hasHomespace())
         return getHomespace() + "/" + uri;
-    else if (Config::getOption("sbol_compliant_uris").compare("False") == 0 && !hasHomespace())
+    else if (!Config::snapshot().compliant_uris && !hasHomespace())
         return uri;
     else
         return "";
@@ -207,9 +225,9 @@ string sbol::randomIdentifier()
 // This autoconstruct method constructs non-SBOL-compliant URIs
 std::string sbol::autoconstructURI()
 {
-    if (Config::getOption("sbol_compliant_uris").compare("False") == 0 && hasHomespace())
+    if (!Config::snapshot().compliant_uris && hasHomespace())
         return getHomespace() + "/" + randomIdentifier();
-    else if (Config::getOption("sbol_compliant_uris").compare("False") == 0 && !hasHomespace())
+    else if (!Config::snapshot().compliant_uris && !hasHomespace())
         throw SBOLError(SBOL_ERROR_COMPLIANCE, "The autoconstructURI method requires a valid namespace authority. Use setHomespace().");
     else
         throw SBOLError(SBOL_ERROR_COMPLIANCE, "The autoconstructURI method only works when SBOLCompliance flag is false. Use setOption to disable SBOL-compliant URIs.");
@@ -353,12 +371,12 @@ void Config::setHomespace(std::string ns)
 
 string Config::getHomespace()
 {
-    return options["homespace"];
+    return options.at("homespace");  // Objects are created on several threads at once by Document::assemble, so the options are only read here
 };
 
 int Config::hasHomespace()
 {
-    if (options["homespace"].compare("") == 0)
+    if (options.at("homespace").compare("") == 0)
         return 0;
     else
         return 1;
@@ -112,7 +112,28 @@ namespace sbol
         /// Get current option value for online validation and conversion
         /// @param option The option key
         static std::string getOption(std::string option);
-        
+
+        /// @cond
+        enum OutputFormat { FORMAT_RDFXML, FORMAT_JSON };
+
+        /// Typed copies of the options that are read on hot paths, such as object creation. Config::setOption keeps them current, so readers test a plain field instead of looking up and comparing strings
+        struct Snapshot
+        {
+            bool compliant_uris;          ///< sbol_compliant_uris
+            bool typed_uris;              ///< sbol_typed_uris
+            bool validate;                ///< validate
+            OutputFormat output_format;   ///< output_format
+        };
+
+        static const Snapshot& snapshot()
+        {
+            return options_snapshot;
+        };
+        /// @endcond
+
+    private:
+        static Snapshot options_snapshot;
+        static Snapshot takeSnapshot();
     };
     
     /// Global methods
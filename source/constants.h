@@ -145,6 +145,12 @@
 #define SBOL_REFINEMENT_MERGE SBOL_URI "#merge"                      ///< Option for MapsTo::refinement property
 #define SBOL_ROLE_INTEGRATION_MERGE SBOL_URI "#mergeRoles"           ///< Option for SequenceAnnotation::roleIntegration or Component::roleIntegration property
 #define SBOL_ROLE_INTEGRATION_OVERRIDE SBOL_URI "#overrideRoles"     ///< Option for SequenceAnnotation::roleIntegration or Component::roleIntegration property
+#define SBOL_ENUMERATE SBOL_URI "#enumerate"  ///< Option for CombinatorialDerivation::strategy property
+#define SBOL_SAMPLE SBOL_URI "#sample"        ///< Option for CombinatorialDerivation::strategy property
+#define SBOL_REPEAT_ZERO_OR_ONE SBOL_URI "#zeroOrOne"    ///< Option for VariableComponent::repeat property
+#define SBOL_REPEAT_ONE SBOL_URI "#one"                  ///< Option for VariableComponent::repeat property
+#define SBOL_REPEAT_ZERO_OR_MORE SBOL_URI "#zeroOrMore"  ///< Option for VariableComponent::repeat property
+#define SBOL_REPEAT_ONE_OR_MORE SBOL_URI "#oneOrMore"    ///< Option for VariableComponent::repeat property
 
 /* PROVO ontology */
 #define PROVO_ACTIVITY PROVO "#Activity"
@@ -25,6 +25,8 @@
 
 
 #include "document.h"
+#include "nucleotides.h"
+#include "partshop.h"
 
 #include <raptor2.h>
 #include <json/json.h>
@@ -32,6 +34,7 @@
 
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <string>
 #include <functional>
 #include <vector>
@@ -59,8 +62,22 @@ Document::~Document()
     for (auto i_obj = SBOLObjects.begin(); i_obj != SBOLObjects.end(); ++i_obj)
     {
         SBOLObject* obj = i_obj->second;
-        delete obj;
+        obj->close();  // Objects in the arena are left for the arena to destroy
     }
+    delete arena;
+};
+
+void Document::toggleArenaAllocation(bool is_toggled)
+{
+    if (is_toggled && !arena)
+        arena = new ObjectArena();
+    arena_enabled = is_toggled;
+};
+
+void Document::checkArena(SBOLObject& sbol_obj)
+{
+    if (sbol_obj.owning_arena && sbol_obj.owning_arena != arena)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Cannot add " + sbol_obj.identity.get() + " to this Document. It was read into the arena of another Document, which destroys it along with that Document. Use copy instead");
 };
 
 unordered_map<string, SBOLObject&(*)()> sbol::SBOL_DATA_MODEL_REGISTER =
@@ -83,6 +100,8 @@ unordered_map<string, SBOLObject&(*)()> sbol::SBOL_DATA_MODEL_REGISTER =
     make_pair(SBOL_MAPS_TO, (SBOLObject&(*)()) &create<MapsTo>),
     make_pair(SBOL_CUT, (SBOLObject&(*)()) &create<Cut>),
     make_pair(SBOL_COLLECTION, (SBOLObject&(*)()) &create<Collection>),
+    make_pair(SBOL_COMBINATORIAL_DERIVATION, (SBOLObject&(*)()) &create<CombinatorialDerivation>),
+    make_pair(SBOL_VARIABLE_COMPONENT, (SBOLObject&(*)()) &create<VariableComponent>),
     make_pair(SBOL_GENERIC_LOCATION, (SBOLObject&(*)()) &create<GenericLocation>)
 };
 
@@ -456,13 +475,323 @@ std::string SBOLObject::nest(std::string& rdfxml_string)
 	return rdfxml_string;
 };
 
+// Characters allowed in XML names, following raptor's check for XML 1.0. Non-ASCII bytes are accepted as part of UTF-8 sequences
+static bool is_xml_name_start_char(unsigned char c)
+{
+    return isalpha(c) || c == '_' || c >= 0x80;
+};
+
+static bool is_xml_name_char(unsigned char c)
+{
+    return is_xml_name_start_char(c) || isdigit(c) || c == '-' || c == '.';
+};
+
+static bool is_xml_name(const std::string& text, std::size_t pos)
+{
+    if (pos >= text.size() || !is_xml_name_start_char(text[pos]))
+        return false;
+    for (std::size_t i_char = pos + 1; i_char < text.size(); ++i_char)
+        if (!is_xml_name_char(text[i_char]))
+            return false;
+    return true;
+};
+
+static std::string escape_xml_attribute(const std::string& text)
+{
+    string escaped;
+    escaped.reserve(text.size());
+    for (auto &c : text)
+    {
+        if (c == '&') escaped += "&amp;";
+        else if (c == '<') escaped += "&lt;";
+        else if (c == '>') escaped += "&gt;";
+        else if (c == '"') escaped += "&quot;";
+        else if (c == '\r') escaped += "&#xD;";
+        else if (c == '\t') escaped += "&#x9;";
+        else if (c == '\n') escaped += "&#xA;";
+        else escaped += c;
+    }
+    return escaped;
+};
+
+RDFXMLWriter::RDFXMLWriter(std::ostream& out, const std::unordered_map<std::string, std::string>& namespaces) :
+    out(out),
+    namespace_count(0)
+{
+    for (auto &i_ns : namespaces)
+        root_namespaces.push_back(make_pair(i_ns.second, i_ns.first));
+    // The rdf namespace is always declared, as raptor does
+    bool has_rdf = false;
+    for (auto &i_ns : root_namespaces)
+        if (i_ns.first.compare(RDF_URI) == 0 && i_ns.second.compare("rdf") == 0)
+            has_rdf = true;
+    if (!has_rdf)
+        root_namespaces.push_back(make_pair(string(RDF_URI), string("rdf")));
+    // Prefer the longest namespace when more than one matches a URI
+    sort(root_namespaces.begin(), root_namespaces.end(), [](const pair<string, string>& a, const pair<string, string>& b)
+    {
+        return a.first.size() > b.first.size();
+    });
+};
+
+std::string RDFXMLWriter::qname(const std::string& uri, int depth, std::string& declaration)
+{
+    declaration.clear();
+    auto i_qname = qnames.find(uri);
+    if (i_qname != qnames.end())
+        return i_qname->second;
+
+    // Namespaces generated for earlier elements that are still in scope
+    for (auto i_ns = scoped_namespaces.rbegin(); i_ns != scoped_namespaces.rend(); ++i_ns)
+    {
+        const string& ns = std::get<0>(*i_ns);
+        if (uri.compare(0, ns.size(), ns) == 0 && is_xml_name(uri, ns.size()))
+            return std::get<1>(*i_ns) + ":" + uri.substr(ns.size());
+    }
+
+    // Namespaces declared on the root element
+    for (auto &i_ns : root_namespaces)
+    {
+        const string& ns = i_ns.first;
+        if (uri.compare(0, ns.size(), ns) == 0 && is_xml_name(uri, ns.size()))
+        {
+            string new_qname = i_ns.second.size() ? i_ns.second + ":" + uri.substr(ns.size()) : uri.substr(ns.size());
+            qnames[uri] = new_qname;
+            return new_qname;
+        }
+    }
+
+    // Split the URI after the last character that can't belong to an XML name, then generate a namespace for the element
+    std::size_t local_start = uri.size();
+    while (local_start > 0 && is_xml_name_char(uri[local_start - 1]))
+        --local_start;
+    while (local_start < uri.size() && !is_xml_name_start_char(uri[local_start]))
+        ++local_start;
+    if (local_start == uri.size())
+        throw SBOLError(SBOL_ERROR_SERIALIZATION, "Cannot form an XML qname for " + uri);
+    string ns = uri.substr(0, local_start);
+    string prefix = "ns" + to_string(++namespace_count);
+    scoped_namespaces.push_back(make_tuple(ns, prefix, depth));
+    declaration = " xmlns:" + prefix + "=\"" + escape_xml_attribute(ns) + "\"";
+    return prefix + ":" + uri.substr(local_start);
+};
+
+void RDFXMLWriter::endScope(int depth)
+{
+    while (scoped_namespaces.size() && std::get<2>(scoped_namespaces.back()) >= depth)
+        scoped_namespaces.pop_back();
+};
+
+void RDFXMLWriter::writeIndent(int depth)
+{
+    for (int i_indent = 0; i_indent < depth; ++i_indent)
+        out.write("  ", 2);
+};
+
+void RDFXMLWriter::writeEscaped(const std::string& text, std::size_t pos, std::size_t len, bool is_attribute)
+{
+    std::size_t run_start = pos;
+    std::size_t end = pos + len;
+    for (std::size_t i_char = pos; i_char < end; ++i_char)
+    {
+        const char* entity = NULL;
+        switch (text[i_char])
+        {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '\r': entity = "&#xD;"; break;
+            case '"': if (is_attribute) entity = "&quot;"; break;
+            case '\t': if (is_attribute) entity = "&#x9;"; break;
+            case '\n': if (is_attribute) entity = "&#xA;"; break;
+        }
+        if (entity)
+        {
+            out.write(text.data() + run_start, i_char - run_start);
+            out << entity;
+            run_start = i_char + 1;
+        }
+    }
+    out.write(text.data() + run_start, end - run_start);
+};
+
+// SBOLObject::nest indented every line of a nested object's text, including the lines of a literal after the first. Each level of nesting indented them by the indentation of the property element that the object replaced
+void RDFXMLWriter::writeLiteral(const std::string& text, int depth)
+{
+    std::size_t line_start = 0;
+    std::size_t line_end;
+    while ((line_end = text.find('\n', line_start)) != std::string::npos)
+    {
+        writeEscaped(text, line_start, line_end + 1 - line_start, false);
+        writeIndent(depth - 1);
+        line_start = line_end + 1;
+    }
+    writeEscaped(text, line_start, text.length() - line_start, false);
+};
+
+void RDFXMLWriter::writeObject(SBOLObject& sbol_obj, int depth)
+{
+    // An RDF statement about this object
+    struct Statement
+    {
+        const string* predicate;
+        const PropertyValue* value;
+        SBOLObject* owned_obj;
+    };
+    vector<Statement> statements;
+    for (auto &i_p : sbol_obj.properties)
+    {
+        // The identity is written as the rdf:about attribute rather than as a property element
+        if (i_p.first.compare(SBOL_IDENTITY) == 0)
+            continue;
+        for (auto &i_val : i_p.second)
+        {
+            if (!i_val.empty())
+                statements.push_back({ &i_p.first, &i_val, NULL });
+        }
+    }
+    for (auto &i_p : sbol_obj.owned_objects)
+    {
+        for (auto &i_obj : i_p.second)
+            statements.push_back({ &i_p.first, &i_obj->properties[SBOL_IDENTITY].front(), i_obj });
+    }
+
+    // Statements are ordered by predicate, then URIs before literals, then by value
+    sort(statements.begin(), statements.end(), [](const Statement& a, const Statement& b)
+    {
+        int cmp = a.predicate->compare(*b.predicate);
+        if (cmp != 0)
+            return cmp < 0;
+        return *a.value < *b.value;
+    });
+
+    string declaration;
+    string type_qname = qname(sbol_obj.type, depth, declaration);
+    const string& identity = sbol_obj.properties[SBOL_IDENTITY].front().text();
+    writeIndent(depth);
+    out << '<' << type_qname << declaration << " rdf:about=\"";
+    writeEscaped(identity, 0, identity.length(), true);
+    if (statements.size() == 0)
+    {
+        out << "\"/>\n";
+        endScope(depth);
+        return;
+    }
+    out << "\">\n";
+
+    const Statement* previous = NULL;
+    for (auto &i_statement : statements)
+    {
+        // Identical statements are only written once
+        if (previous && *previous->predicate == *i_statement.predicate && *previous->value == *i_statement.value)
+            continue;
+        previous = &i_statement;
+
+        // Packed sequences are written straight from their packed form, rather than being decoded.  They have no text
+        const PackedNucleotides* packed_elements = i_statement.value->packed();
+        const string& value = i_statement.value->text();
+        string property_qname = qname(*i_statement.predicate, depth + 1, declaration);
+        writeIndent(depth + 1);
+        out << '<' << property_qname << declaration;
+        if (i_statement.owned_obj)
+        {
+            out << ">\n";
+            writeObject(*i_statement.owned_obj, depth + 2);
+            writeIndent(depth + 1);
+            out << "</" << property_qname << ">\n";
+        }
+        else if (i_statement.value->isURI() && value.compare(0, 2, "_:") == 0)
+        {
+            out << " rdf:nodeID=\"";
+            writeEscaped(value, 2, value.length() - 2, true);
+            out << "\"/>\n";
+        }
+        else if (i_statement.value->isURI())
+        {
+            out << " rdf:resource=\"";
+            writeEscaped(value, 0, value.length(), true);
+            out << "\"/>\n";
+        }
+        else
+        {
+            // Typed and language-tagged literals are written with the tag they were read with
+            const string& datatype = i_statement.value->datatype();
+            const string& language = i_statement.value->language();
+            if (datatype.size())
+            {
+                out << " rdf:datatype=\"";
+                writeEscaped(datatype, 0, datatype.length(), true);
+                out << '"';
+            }
+            if (language.size())
+            {
+                out << " xml:lang=\"";
+                writeEscaped(language, 0, language.length(), true);
+                out << '"';
+            }
+            out << '>';
+            if (packed_elements)
+                packed_elements->write(out);  // Nucleotide codes never need escaping
+            else
+                writeLiteral(value, depth);
+            out << "</" << property_qname << ">\n";
+        }
+        endScope(depth + 1);
+    }
+    writeIndent(depth);
+    out << "</" << type_qname << ">\n";
+    endScope(depth);
+};
+
+void RDFXMLWriter::write(std::vector<SBOLObject*>& sbol_objects)
+{
+    begin();
+    for (auto &i_obj : sbol_objects)
+        writeObject(*i_obj, 1);
+    end();
+};
+
+void RDFXMLWriter::begin()
+{
+    // Namespace declarations are sorted, as raptor does
+    vector<string> declarations;
+    for (auto &i_ns : root_namespaces)
+        declarations.push_back((i_ns.second.size() ? "xmlns:" + i_ns.second : string("xmlns")) + "=\"" + escape_xml_attribute(i_ns.first) + "\"");
+    sort(declarations.begin(), declarations.end());
+
+    out << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<rdf:RDF";
+    for (auto i_decl = declarations.begin(); i_decl != declarations.end(); ++i_decl)
+    {
+        if (i_decl != declarations.begin())
+            out << "\n  ";
+        out << ' ' << *i_decl;
+    }
+    out << ">\n";
+};
+
+void RDFXMLWriter::write(SBOLObject& sbol_obj)
+{
+    writeObject(sbol_obj, 1);
+};
+
+void RDFXMLWriter::end()
+{
+    out << "</rdf:RDF>\n";
+};
+
 void Document::parse_objects(void* user_data, raptor_statement* triple)
 {
 	Document *doc = (Document *)user_data;
 
-	string subject = reinterpret_cast<char*>(raptor_term_to_string(triple->subject));
-	string predicate = reinterpret_cast<char*>(raptor_term_to_string(triple->predicate));
-	string object = reinterpret_cast<char*>(raptor_term_to_string(triple->object));
+	char* subject_str = reinterpret_cast<char*>(raptor_term_to_string(triple->subject));
+	char* predicate_str = reinterpret_cast<char*>(raptor_term_to_string(triple->predicate));
+	char* object_str = reinterpret_cast<char*>(raptor_term_to_string(triple->object));
+	string subject = subject_str;
+	string predicate = predicate_str;
+	string object = object_str;
+	raptor_free_memory(subject_str);
+	raptor_free_memory(predicate_str);
+	raptor_free_memory(object_str);
 	
 	subject = subject.substr(1, subject.length() - 2);  // Removes flanking < and > from uri
 	predicate = predicate.substr(1, predicate.length() - 2);  // Removes flanking < and > from uri
@@ -487,62 +816,87 @@ void Document::parse_objects(void* user_data, raptor_statement* triple)
 //            new_obj->doc = doc;  //  Set's the objects back-pointer to the parent Document
 //        }
 //#endif
-        // Checks if the object has already been created and whether a constructor for this type of object exists
-        if ((doc->SBOLObjects.count(subject) == 0) && (SBOL_DATA_MODEL_REGISTER.count(object) == 1))
-		{
-            SBOLObject& new_obj = SBOL_DATA_MODEL_REGISTER[ object ]();  // Call constructor for the appropriate SBOLObject
+        construct_object(doc, subject, object);
+	}
 
-			// Wipe default property values passed from default constructor. New property values will be added as properties are parsed from the input file
-			for (auto it = new_obj.properties.begin(); it != new_obj.properties.end(); it++)
-			{
-				std::string token = it->second.front();
-				if (token[0] == '<')  // clear defaults and re-initialize this property as a URI
-				{
-					new_obj.properties[it->first].clear();
-					new_obj.properties[it->first].push_back("<>");
-				} 
-				else if (token[0] == '"')  // clear defaults and re-initialize as a literal
-				{
-					new_obj.properties[it->first].clear();
-					new_obj.properties[it->first].push_back("\"\"");
-				}
-			}
-			new_obj.identity.set(subject);
+}
 
-			// All created objects are placed in the document's object store.  However, only toplevel objects will be left permanently.
-			// Owned objects are kept in the object store as a temporary convenience and will be removed later by the parse_properties handler.
-			//doc->add<SBOLObject>(new_obj);
-            doc->SBOLObjects[new_obj.identity.get()] = &new_obj;
-            new_obj.doc = doc;  //  Set's the objects back-pointer to the parent Document
-            
-            // If the new object is TopLevel, add to the Document's property store
-            TopLevel* check_top_level = dynamic_cast<TopLevel*>(&new_obj);
-            if (check_top_level)
-                doc->owned_objects[new_obj.type].push_back(&new_obj);  // Adds objects to the Document's property store, eg, componentDefinitions, moduleDefinitions, etc
-		}
-        // Generic TopLevels
-        else if ((doc->SBOLObjects.count(subject) == 0) && (SBOL_DATA_MODEL_REGISTER.count(object) == 0))
+SBOLObject* Document::construct_object(Document* doc, const std::string& uri, const std::string& type_uri)
+{
+    // Checks if the object has already been created and whether a constructor for this type of object exists
+    if (doc->SBOLObjects.count(uri) == 1)
+        return NULL;
+    if (SBOL_DATA_MODEL_REGISTER.count(type_uri) == 1)
+    {
+        SBOLObject& new_obj = SBOL_DATA_MODEL_REGISTER[ type_uri ]();  // Call constructor for the appropriate SBOLObject
+
+        // Wipe default property values passed from default constructor. New property values will be added as properties are parsed from the input file
+        for (auto it = new_obj.properties.begin(); it != new_obj.properties.end(); it++)
         {
-            SBOLObject& new_obj = *new SBOLObject();  // Call constructor for the appropriate SBOLObject
-            new_obj.identity.set(subject);
-            new_obj.type = object;
-            // All created objects are placed in the document's object store.  However, only toplevel objects will be left permanently.
-            // Owned objects are kept in the object store as a temporary convenience and will be removed later by the parse_properties handler.
-            doc->SBOLObjects[new_obj.identity.get()] = &new_obj;
-//            std::cout << "Adding extension object " << new_obj.identity.get() << " : " << doc->SBOLObjects.count(subject) << std::endl;
-            new_obj.doc = doc;  //  Set's the objects back-pointer to the parent Document
+            if (it->second.size() == 0)
+                continue;
+            PropertyValue::Kind kind = it->second.front().kind();  // clear defaults and re-initialize this property with an empty value of the same kind
+            it->second.clear();
+            it->second.push_back(PropertyValue(kind));
         }
-	}
+        new_obj.identity.set(uri);
+
+        // All created objects are placed in the document's object store.  However, only toplevel objects will be left permanently.
+        // Owned objects are kept in the object store as a temporary convenience and will be removed later by the parse_properties handler.
+        doc->SBOLObjects[new_obj.identity.get()] = &new_obj;
+        new_obj.doc = doc;  //  Set's the objects back-pointer to the parent Document
+
+        // If the new object is TopLevel, add to the Document's property store
+        TopLevel* check_top_level = dynamic_cast<TopLevel*>(&new_obj);
+        if (check_top_level)
+            doc->owned_objects[new_obj.type].push_back(&new_obj);  // Adds objects to the Document's property store, eg, componentDefinitions, moduleDefinitions, etc
+        return &new_obj;
+    }
+    // Generic TopLevels
+    else
+    {
+        SBOLObject& new_obj = *new SBOLObject();  // Call constructor for the appropriate SBOLObject
+        new_obj.identity.set(uri);
+        new_obj.type = type_uri;
+        // All created objects are placed in the document's object store.  However, only toplevel objects will be left permanently.
+        // Owned objects are kept in the object store as a temporary convenience and will be removed later by the parse_properties handler.
+        doc->SBOLObjects[new_obj.identity.get()] = &new_obj;
+        new_obj.doc = doc;  //  Set's the objects back-pointer to the parent Document
+        return &new_obj;
+    }
+};
 
-}
+// Converts an N-Triples term into a property value.  A literal keeps the datatype or language that follows its closing quote
+static PropertyValue decode_ntriples_value(const string& term)
+{
+    if (term.size() >= 2 && term.front() == '<')
+        return PropertyValue(PropertyValue::URI, term.substr(1, term.length() - 2));
+    if (term.size() >= 2 && term.front() == '"')
+    {
+        size_t close = term.rfind('"');
+        PropertyValue value(PropertyValue::LITERAL, term.substr(1, close - 1));
+        if (term.compare(close + 1, 3, "^^<") == 0)
+            value.setTag(term.substr(close + 4, term.length() - close - 5), "");
+        else if (term.compare(close + 1, 1, "@") == 0)
+            value.setTag("", term.substr(close + 2));
+        return value;
+    }
+    return PropertyValue(PropertyValue::URI, term);  // Blank node
+};
 
 void Document::parse_properties(void* user_data, raptor_statement* triple)
 {
 	Document *doc = (Document *)user_data;
 
-	string subject = reinterpret_cast<char*>(raptor_term_to_string(triple->subject));
-	string predicate = reinterpret_cast<char*>(raptor_term_to_string(triple->predicate));
-	string object = reinterpret_cast<char*>(raptor_term_to_string(triple->object));
+	char* subject_str = reinterpret_cast<char*>(raptor_term_to_string(triple->subject));
+	char* predicate_str = reinterpret_cast<char*>(raptor_term_to_string(triple->predicate));
+	char* object_str = reinterpret_cast<char*>(raptor_term_to_string(triple->object));
+	string subject = subject_str;
+	string predicate = predicate_str;
+	string object = object_str;
+	raptor_free_memory(subject_str);
+	raptor_free_memory(predicate_str);
+	raptor_free_memory(object_str);
 
 	string id = subject.substr(1, subject.length() - 2);  // Removes flanking < and > from the uri
 	string property_uri = predicate.substr(1, predicate.length() - 2);  // Removes flanking < and > from uri
@@ -570,9 +924,9 @@ void Document::parse_properties(void* user_data, raptor_statement* triple)
 				{
 					// TODO: double-check this, is there a memory-leak here?`
                     
-                    if (sbol_obj->properties[property_uri][0].compare("<>") == 0 || sbol_obj->properties[property_uri][0].compare("\"\"") == 0 )
+                    if (sbol_obj->properties[property_uri][0].empty())
                         sbol_obj->properties[property_uri].clear();  // Clear an empty property
-					sbol_obj->properties[property_uri].push_back(property_value);
+					sbol_obj->properties[property_uri].push_back(decode_ntriples_value(property_value));
 				}
 				else if (sbol_obj->owned_objects.find(property_uri) != sbol_obj->owned_objects.end())
 				{
@@ -594,13 +948,191 @@ void Document::parse_properties(void* user_data, raptor_statement* triple)
                 else
                 {
 //                    cout << "Setting " << property_uri << " of " << id << " to " << property_value << endl;
-                    sbol_obj->properties[property_uri].push_back(property_value);
+                    sbol_obj->properties[property_uri].push_back(decode_ntriples_value(property_value));
                 }
 			}
 		}
 	}
 };
 
+// @return True if a literal reads differently once it is N-Triples escaped and its quotes and backslashes are unescaped again.  Most literals are plain ASCII text, which is copied as it is
+static bool needs_ntriples_escapes(const unsigned char* literal, size_t len)
+{
+    for (size_t i_char = 0; i_char < len; ++i_char)
+        if (literal[i_char] < 0x20 || literal[i_char] >= 0x7F || literal[i_char] == '\\')
+            return true;
+    return false;
+};
+
+void Document::parse_statement(void* user_data, raptor_statement* triple)
+{
+    Document *doc = (Document *)user_data;
+
+    // Subjects and predicates are interned, so recurring URIs are hashed and stored only once rather than copied out of raptor for every triple
+    symbol_id subject = doc->symbols.intern(triple->subject);
+    symbol_id predicate = doc->symbols.intern(triple->predicate);
+
+    // Triples that have a predicate matching the following uri signal to the parser that a new SBOL object should be constructred
+    // While merging, statements about objects that were in the Document before the read began are dropped
+    if (doc->merged_objects && doc->find(doc->symbols[subject]))
+        return;
+
+    if (predicate == doc->rdf_type_symbol)
+    {
+        symbol_id type = doc->symbols.intern(triple->object);
+        SBOLObject* typed_obj = construct_object(doc, doc->symbols[subject], doc->symbols[type]);
+        if (typed_obj && doc->merged_objects)
+            doc->merged_objects->push_back(typed_obj);
+        if (!typed_obj)
+        {
+            // The subject is already in the Document, so its statements apply to the existing object, as they did in the two-pass parser
+            auto i_obj = doc->SBOLObjects.find(doc->symbols[subject]);
+            if (i_obj == doc->SBOLObjects.end())
+                return;
+            typed_obj = i_obj->second;
+        }
+
+        // Replay any statements about this object that were encountered before its type was known
+        auto i_pending = doc->pending_statements.find(subject);
+        if (i_pending != doc->pending_statements.end())
+        {
+            for (auto &i_statement : i_pending->second)
+                doc->parse_property(typed_obj, i_statement.first, i_statement.second);
+            doc->pending_statements.erase(i_pending);
+        }
+    }
+    else
+    {
+        // Property values are copied straight out of the raptor term, without quoting
+        PropertyValue property_value;
+        raptor_term* object = triple->object;
+        size_t len = 0;
+        if (object->type == RAPTOR_TERM_TYPE_URI)
+        {
+            const char* uri = (const char*)raptor_uri_as_counted_string(object->value.uri, &len);
+            property_value = PropertyValue(PropertyValue::URI, string(uri, len));
+        }
+        else if (object->type == RAPTOR_TERM_TYPE_LITERAL)
+        {
+            const unsigned char* literal = object->value.literal.string;
+            len = object->value.literal.string_len;
+            if (needs_ntriples_escapes(literal, len))
+            {
+                // Control characters and non-ASCII characters are kept N-Triples escaped, as the two-pass reader kept them
+                char* term = reinterpret_cast<char*>(raptor_term_to_string(object));
+                property_value = decode_ntriples_value(convert_ntriples_encoding_to_ascii(term));
+                raptor_free_memory(term);
+            }
+            else
+            {
+                property_value = PropertyValue(PropertyValue::LITERAL, string((const char*)literal, len));
+                // Typed and language-tagged literals keep their tag
+                raptor_uri* datatype = object->value.literal.datatype;
+                const unsigned char* language = object->value.literal.language;
+                if (datatype || language)
+                    property_value.setTag(datatype ? (const char*)raptor_uri_as_string(datatype) : "",
+                                          language ? string((const char*)language, object->value.literal.language_len) : "");
+            }
+        }
+        else
+        {
+            // Blank nodes are kept as references with the N-Triples "_:" prefix
+            len = object->value.blank.string_len;
+            property_value = PropertyValue(PropertyValue::URI, "_:" + string((const char*)object->value.blank.string, len));
+        }
+
+        auto i_obj = doc->SBOLObjects.find(doc->symbols[subject]);
+        if (i_obj != doc->SBOLObjects.end())
+            doc->parse_property(i_obj->second, predicate, property_value);
+        else
+            doc->pending_statements[subject].push_back(make_pair(predicate, std::move(property_value)));  // Buffer until the subject is typed
+    }
+};
+
+void Document::parse_property(SBOLObject* sbol_obj, symbol_id property, PropertyValue& property_value)
+{
+    const string& property_uri = symbols[property];
+
+    // Decide if this triple corresponds to a simple property, a list property, an owned property or a referenced property
+    auto i_property = sbol_obj->properties.find(property_uri);
+    if (i_property != sbol_obj->properties.end())
+    {
+        vector<PropertyValue>& property_store = i_property->second;
+        if (property_store.size() && property_store[0].kind() == PropertyValue::INTEGER && property_value.kind() == PropertyValue::LITERAL)
+        {
+            // Integer properties are parsed once, as they are read
+            PropertyValue int_value(PropertyValue::INTEGER, property_value.str());
+            int_value.setTag(property_value.datatype(), property_value.language());
+            property_value = std::move(int_value);
+        }
+        if (property_store.size() && property_store[0].empty())
+            property_store.clear();  // Clear an empty property
+        property_store.push_back(std::move(property_value));
+    }
+    else if (sbol_obj->owned_objects.find(property_uri) != sbol_obj->owned_objects.end())
+    {
+        // The child object may not have been typed yet, so composite data structures are formed after the whole input has been read
+        symbol_id owned_obj_id = symbols.intern(property_value.text());
+        pending_owned_objects.push_back(make_tuple(sbol_obj, property, owned_obj_id));
+    }
+    // Extension data
+    else
+    {
+        sbol_obj->properties[property_uri].push_back(std::move(property_value));
+    }
+};
+
+void Document::parse(raptor_iostream* ios)
+{
+    raptor_world_set_log_handler(this->rdf_graph, NULL, raptor_error_handler); // Intercept raptor errors
+    ObjectArena::Scope arena_scope(arena_enabled ? arena : NULL);  // Objects constructed while parsing come from the arena, if it is enabled
+
+    pending_statements.clear();
+    pending_owned_objects.clear();
+    rdf_type_symbol = symbols.intern(RDF_URI "type");
+
+    raptor_parser* rdf_parser = raptor_new_parser(this->rdf_graph, getFileFormat().c_str());
+    raptor_parser_set_namespace_handler(rdf_parser, this, this->namespaceHandler);
+    raptor_uri *base_uri = raptor_new_uri(this->rdf_graph, (const unsigned char *)SBOL_URI "#");
+
+    // Read the triple store in a single pass. Objects are constructed when their type is encountered and properties are assigned as they stream in
+    raptor_parser_set_statement_handler(rdf_parser, this, this->parse_statement);
+    raptor_parser_parse_iostream(rdf_parser, ios, base_uri);
+
+    raptor_free_uri(base_uri);
+    raptor_free_parser(rdf_parser);
+
+    // Form composite SBOL data structures.  The owned object is added to its parent object, then removed from its
+    // temporary location in the Document's object store and is now associated only with its parent
+    for (auto &i_link : pending_owned_objects)
+    {
+        SBOLObject* parent_obj = std::get<0>(i_link);
+        const string& property_uri = symbols[std::get<1>(i_link)];
+        auto i_owned = SBOLObjects.find(symbols[std::get<2>(i_link)]);
+        if (i_owned == SBOLObjects.end())
+            continue;
+        SBOLObject* owned_obj = i_owned->second;
+        parent_obj->owned_objects[property_uri].push_back(owned_obj);
+        owned_obj->parent = parent_obj;
+        SBOLObjects.erase(i_owned);
+    }
+    // Statements about subjects that were never typed are discarded, as in the original two-pass parser
+    pending_statements.clear();
+    pending_owned_objects.clear();
+
+    // Index every object that was read, including nested child objects, by identity and by the URIs they refer to.  Objects already in the Document are passed over
+    for (auto &i_obj : SBOLObjects)
+        index(*i_obj.second);
+
+    // On the final pass, nested annotations not in the SBOL namespace are identified
+    parse_annotation_objects();
+
+    // A dummy parser which can be extended by SWIG to attach Python extension code
+    parse_extension_objects();
+    //@TODO fix validation on read
+    //    this->validate();
+};
+
 void Document::parse_annotation_objects()
 {
     // Check if there are any SBOLObjects remaining in the Document's object store which are not recognized as part of the core data model or an explicitly declared extension class
@@ -624,6 +1156,8 @@ void Document::parse_annotation_objects()
                 tl->owned_objects[i_p.first] = i_p.second;
             tl->doc = this;  //  Set's the objects back-pointer to the parent Document
             SBOLObjects[tl->identity.get()] = tl;
+            unindex(*obj);
+            index(*tl);
         }
         // Since this object is not generic TopLevel, it must be a nested annotation. Find the parent object that references it
         else
@@ -635,23 +1169,36 @@ void Document::parse_annotation_objects()
             property_name[0] = tolower(property_name[0]);
             string property_uri = ns + property_name;
                 
-            // Find all parent objects containing a reference to the annotation object
-            vector<SBOLObject*> matches = find_reference(obj->identity.get());
+            // Find all parent objects that refer to the annotation object through this member property
+            vector<SBOLObject*> matches = getReferrers(obj->identity.get(), property_uri);
             for (auto &i_match : matches)
             {
-                // Does this reference belong to the appropriate member property?
-                if (i_match->properties.find(property_uri) != i_match->properties.end())
+                i_match->owned_objects[property_uri].push_back(obj);
+                obj->parent = i_match;
+                unindexReference(*i_match, property_uri, obj->identity.get());
+
+                // Only the reference to this annotation is dropped, since the property may hold references to other annotations of the same kind
+                vector<PropertyValue>& references = i_match->properties[property_uri];
+                for (auto i_val = references.begin(); i_val != references.end(); ++i_val)
                 {
-                    i_match->owned_objects[property_uri].push_back(obj);
-                    obj->parent = i_match;
-                    i_match->properties.erase(property_uri);
+                    if (i_val->isURI() && i_val->text().compare(obj->identity.get()) == 0)
+                    {
+                        references.erase(i_val);
+                        break;
+                    }
                 }
+                if (references.empty())
+                    i_match->properties.erase(property_uri);
             }
         }
     }
     // Remove annotation objects from the top level Document store
     for (auto &obj : annotation_objects)
     {
+        // Annotations that were not nested inside a parent object are dropped from the indices as well
+        auto i_obj = SBOLObjects.find(obj->identity.get());
+        if (i_obj != SBOLObjects.end() && !i_obj->second->parent)
+            unindex(*i_obj->second);
         SBOLObjects.erase(obj->identity.get());
     }
 }
@@ -700,7 +1247,7 @@ std::string Document::validate()
 	std::string sbol_buffer_string = std::string((char*)sbol_buffer);
 
 	std::string response = "";
-	if (Config::getOption("validate").compare("True") == 0)
+	if (Config::snapshot().validate)
 		response = request_validation(sbol_buffer_string);
 
 	raptor_free_iostream(ios);
@@ -735,14 +1282,178 @@ std::vector<std::string> Document::getNamespaces()
 
 SBOLObject* Document::find(std::string uri)
 {
-    for (auto i_obj = SBOLObjects.begin(); i_obj != SBOLObjects.end(); ++i_obj)
+    auto i_obj = identity_index.find(uri);
+    if (i_obj == identity_index.end())
+        return NULL;
+    return i_obj->second;
+};
+
+// Calls visit(property_uri, uri) for each uri that an object refers to through its properties. An object's own identity and persistentIdentity do not count as references
+template < class Visitor > static void visit_references(SBOLObject& sbol_obj, Visitor visit)
+{
+    for (auto &i_property : sbol_obj.properties)
     {
-        SBOLObject& obj = *i_obj->second;
-        SBOLObject* match = obj.find(uri);
-        if (match)
-            return match;
+        if (i_property.first.compare(SBOL_IDENTITY) == 0 || i_property.first.compare(SBOL_PERSISTENT_IDENTITY) == 0)
+            continue;
+        for (auto &i_val : i_property.second)
+        {
+            if (i_val.isURI() && !i_val.empty())
+                visit(i_property.first, i_val.text());
+        }
     }
-    return NULL;
+};
+
+void Document::index(SBOLObject& sbol_obj)
+{
+    ++revision;
+    SBOLObject*& entry = identity_index[sbol_obj.identity.get()];
+    if (entry != &sbol_obj)
+    {
+        // An object that is indexed already keeps its entries, so indexing is safe to repeat
+        if (entry)
+            visit_references(*entry, [&](const sbol_type& property_uri, const string& uri) { unindexReference(*entry, property_uri, uri); });
+        entry = &sbol_obj;
+        visit_references(sbol_obj, [&](const sbol_type& property_uri, const string& uri) { indexReference(sbol_obj, property_uri, uri); });
+        indexVersion(sbol_obj);
+        packSequenceElements(sbol_obj);
+    }
+    for (auto &i_store : sbol_obj.owned_objects)
+    {
+        for (auto &i_obj : i_store.second)
+            index(*i_obj);
+    }
+};
+
+void Document::unindex(SBOLObject& sbol_obj)
+{
+    ++revision;
+    auto i_entry = identity_index.find(sbol_obj.identity.get());
+    if (i_entry != identity_index.end() && i_entry->second == &sbol_obj)
+    {
+        identity_index.erase(i_entry);
+        visit_references(sbol_obj, [&](const sbol_type& property_uri, const string& uri) { unindexReference(sbol_obj, property_uri, uri); });
+        auto i_persistent_identity = sbol_obj.properties.find(SBOL_PERSISTENT_IDENTITY);
+        if (i_persistent_identity != sbol_obj.properties.end())
+            unindexVersion(sbol_obj, i_persistent_identity->second.front().str());
+    }
+    for (auto &i_store : sbol_obj.owned_objects)
+    {
+        for (auto &i_obj : i_store.second)
+            unindex(*i_obj);
+    }
+};
+
+void Document::indexReference(SBOLObject& referrer, const sbol_type& property_uri, const string& uri)
+{
+    // Properties are held as interned ids, so the index keeps no pointers into the referrer's property store, which may be reassigned or rehashed
+    auto i_referral = reference_index[uri].insert(make_pair(&referrer, Referral()));
+    if (i_referral.second)
+        i_referral.first->second.order = referral_count++;
+    i_referral.first->second.properties.push_back(symbols.intern(property_uri));
+};
+
+void Document::unindexReference(SBOLObject& referrer, const sbol_type& property_uri, const string& uri)
+{
+    auto i_referrers = reference_index.find(uri);
+    if (i_referrers == reference_index.end())
+        return;
+    auto i_referrer = i_referrers->second.find(&referrer);
+    if (i_referrer == i_referrers->second.end())
+        return;
+    vector<symbol_id>& referring_properties = i_referrer->second.properties;
+    symbol_id property = symbols.intern(property_uri);
+    for (auto i_property = referring_properties.begin(); i_property != referring_properties.end(); ++i_property)
+    {
+        // Only one occurrence is removed, since a list property may hold the same reference more than once
+        if (*i_property == property)
+        {
+            referring_properties.erase(i_property);
+            break;
+        }
+    }
+    if (referring_properties.empty())
+        i_referrers->second.erase(i_referrer);
+    if (i_referrers->second.empty())
+        reference_index.erase(i_referrers);
+};
+
+// @return The first value of a property, or an empty string if the object does not have the property
+static string get_first_value(SBOLObject& sbol_obj, const sbol_type& property_uri)
+{
+    auto i_property = sbol_obj.properties.find(property_uri);
+    if (i_property == sbol_obj.properties.end() || i_property->second.empty())
+        return "";
+    return i_property->second.front().str();
+};
+
+void Document::indexVersion(SBOLObject& sbol_obj)
+{
+    // Only TopLevels can be retrieved by persistentIdentity
+    if (!dynamic_cast<TopLevel*>(&sbol_obj))
+        return;
+    string persistent_identity = get_first_value(sbol_obj, SBOL_PERSISTENT_IDENTITY);
+    if (persistent_identity.empty())
+        return;
+    string version = get_first_value(sbol_obj, SBOL_VERSION);
+    vector<SBOLObject*>& versions = version_index[persistent_identity];
+
+    // Objects are kept in version order, so the latest version is always at the back. Equal versions keep the order they were added in
+    auto i_insert = upper_bound(versions.begin(), versions.end(), version, [](const string& new_version, SBOLObject* other)
+    {
+        return VersionProperty::compare(new_version, get_first_value(*other, SBOL_VERSION)) < 0;
+    });
+    versions.insert(i_insert, &sbol_obj);
+};
+
+void Document::unindexVersion(SBOLObject& sbol_obj, const string& persistent_identity)
+{
+    auto i_versions = version_index.find(persistent_identity);
+    if (i_versions == version_index.end())
+        return;
+    vector<SBOLObject*>& versions = i_versions->second;
+    versions.erase(remove(versions.begin(), versions.end(), &sbol_obj), versions.end());
+    if (versions.empty())
+        version_index.erase(i_versions);
+};
+
+// @return The referrers in the order they were first indexed, which does not depend on where the objects happen to be allocated
+static vector<SBOLObject*> in_referral_order(vector<pair<unsigned long, SBOLObject*>>& referrals)
+{
+    sort(referrals.begin(), referrals.end());
+    vector<SBOLObject*> referrers;
+    referrers.reserve(referrals.size());
+    for (auto &i_referral : referrals)
+        referrers.push_back(i_referral.second);
+    return referrers;
+};
+
+vector<SBOLObject*> Document::getReferrers(string uri)
+{
+    vector<pair<unsigned long, SBOLObject*>> referrals;
+    auto i_referrers = reference_index.find(uri);
+    if (i_referrers != reference_index.end())
+    {
+        for (auto &i_referrer : i_referrers->second)
+            referrals.push_back(make_pair(i_referrer.second.order, i_referrer.first));
+    }
+    return in_referral_order(referrals);
+};
+
+vector<SBOLObject*> Document::getReferrers(string uri, string property_uri)
+{
+    vector<pair<unsigned long, SBOLObject*>> referrals;
+    auto i_referrers = reference_index.find(uri);
+    if (i_referrers != reference_index.end())
+    {
+        symbol_id property = symbols.intern(property_uri);
+        for (auto &i_referrer : i_referrers->second)
+        {
+            const vector<symbol_id>& referring_properties = i_referrer.second.properties;
+            if (std::find(referring_properties.begin(), referring_properties.end(), property) != referring_properties.end())
+                referrals.push_back(make_pair(i_referrer.second.order, i_referrer.first));
+        }
+    }
+    return in_referral_order(referrals);
 };
 
 SBOLObject* Document::find_property(std::string uri)
@@ -759,15 +1470,7 @@ SBOLObject* Document::find_property(std::string uri)
 
 vector<SBOLObject*> Document::find_reference(string uri)
 {
-    vector<SBOLObject*> matches = {};
-    for (auto i_obj = SBOLObjects.begin(); i_obj != SBOLObjects.end(); ++i_obj)
-    {
-        SBOLObject& obj = *i_obj->second;
-        // @TODO: Need to append matches vector
-        vector<SBOLObject*> submatches = obj.find_reference(uri);
-        matches.insert(matches.end(), submatches.begin(), submatches.end());
-    }
-    return matches;
+    return getReferrers(uri);
 };
 
 void Document::namespaceHandler(void *user_data, raptor_namespace *nspace)
@@ -793,11 +1496,18 @@ void Document::read(std::string filename)
         obj.close();
     }
     SBOLObjects.clear();
+    if (arena)
+        arena->release();
+    identity_index.clear();
+    reference_index.clear();
+    version_index.clear();
+    assembled_sequences.clear();
     properties.clear();  // This may cause problems later because the Document object will lose all properties of an SBOLObject
-    properties[SBOL_IDENTITY].push_back("<>");  // Re-initialize the identity property. The SBOLObject::compare method needs to get the Document's identity
+    properties[SBOL_IDENTITY].push_back(PropertyValue(PropertyValue::URI));  // Re-initialize the identity property. The SBOLObject::compare method needs to get the Document's identity
     list_properties.clear();
     owned_objects.clear();
     namespaces.clear();
+    symbols.clear();
     
     // Create new RDF graph
     this->rdf_graph = raptor_new_world();
@@ -806,9 +1516,6 @@ void Document::read(std::string filename)
 
 void Document::append(std::string filename)
 {
-
-    raptor_world_set_log_handler(this->rdf_graph, NULL, raptor_error_handler); // Intercept raptor errors
-    
     if (filename != "" && filename[0] == '~') {
         if (filename[1] != '/'){
             throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Malformed input path. Potentially missing slash.");
@@ -821,81 +1528,84 @@ void Document::append(std::string filename)
     FILE* fh = fopen(filename.c_str(), "rb");
     if (!fh)
         throw SBOLError(SBOL_ERROR_FILE_NOT_FOUND, "File " + filename + " not found");
-	//raptor_parser* rdf_parser = raptor_new_parser(this->rdf_graph, "rdfxml");
-    raptor_parser* rdf_parser = raptor_new_parser(this->rdf_graph, getFileFormat().c_str());
 
-    raptor_parser_set_namespace_handler(rdf_parser, this, this->namespaceHandler);
+    // The input is read exactly once, so the file handle is never rewound
 	raptor_iostream* ios = raptor_new_iostream_from_file_handle(this->rdf_graph, fh);
-	unsigned char *uri_string;
-	raptor_uri *uri, *base_uri;
-    base_uri = raptor_new_uri(this->rdf_graph, (const unsigned char *)SBOL_URI "#");
-    void *user_data = this;
-
-    // Read the triple store. On the first pass through the triple store, new SBOLObjects are constructed by the parse_objects handler
-	raptor_parser_set_statement_handler(rdf_parser, user_data, this->parse_objects);
-	//base_uri = raptor_new_uri(this->rdf_graph, (const unsigned char *)(getHomespace() + "#").c_str());  //This can be used to import URIs into a namespace
-    raptor_parser_parse_iostream(rdf_parser, ios, base_uri);
-    raptor_free_iostream(ios);
-
-    // Read the triple store again. On the second pass through the triple store, property values are assigned to each SBOLObject's member properties by the parse_properties handler
-	rewind(fh);
-	ios = raptor_new_iostream_from_file_handle(this->rdf_graph, fh);
-	raptor_parser_set_statement_handler(rdf_parser, user_data, this->parse_properties);
-	raptor_parser_parse_iostream(rdf_parser, ios, base_uri);
+    try
+    {
+        parse(ios);
+    }
+    catch (SBOLError &e)
+    {
+        raptor_free_iostream(ios);
+        fclose(fh);
+        throw;
+    }
     raptor_free_iostream(ios);
-    
-    raptor_free_uri(base_uri);
-	raptor_free_parser(rdf_parser);
+    fclose(fh);
+}
 
-    // On the final pass, nested annotations not in the SBOL namespace are identified
-    parse_annotation_objects();
+// Raptor iostream callbacks for reading from a C++ input stream
+static int read_istream_bytes(void *context, void *ptr, size_t size, size_t nmemb)
+{
+    std::istream* input = (std::istream*)context;
+    input->read((char*)ptr, size * nmemb);
+    return (int)(input->gcount() / size);
+};
 
-    // A dummy parser which can be extended by SWIG to attach Python extension code
-    parse_extension_objects();
-//@TODO fix validation on read
-//    this->validate();
+static int read_istream_eof(void *context)
+{
+    std::istream* input = (std::istream*)context;
+    return input->eof() || input->fail();
+};
 
-    fclose(fh);
+void Document::append(std::istream& sbol)
+{
+    static const raptor_iostream_handler istream_handler = { 2, NULL, NULL, NULL, NULL, NULL, read_istream_bytes, read_istream_eof };
+    raptor_iostream* ios = raptor_new_iostream_from_handler(this->rdf_graph, (void*)&sbol, &istream_handler);
+    try
+    {
+        parse(ios);
+    }
+    catch (SBOLError &e)
+    {
+        raptor_free_iostream(ios);
+        throw;
+    }
+    raptor_free_iostream(ios);
 }
 
 void Document::readString(std::string& sbol)
 {
-    raptor_world_set_log_handler(this->rdf_graph, NULL, raptor_error_handler); // Intercept raptor errors
-    
-    raptor_parser* rdf_parser = raptor_new_parser(this->rdf_graph, getFileFormat().c_str());
-    
-    raptor_parser_set_namespace_handler(rdf_parser, this, this->namespaceHandler);
-
     raptor_iostream* ios = raptor_new_iostream_from_string(this->rdf_graph, (void *)sbol.c_str(), sbol.size());
-    unsigned char *uri_string;
-    raptor_uri *uri, *base_uri;
-    base_uri = raptor_new_uri(this->rdf_graph, (const unsigned char *)SBOL_URI "#");
-    void *user_data = this;
-    
-    // Read the triple store. On the first pass through the triple store, new SBOLObjects are constructed by the parse_objects handler
-    raptor_parser_set_statement_handler(rdf_parser, user_data, this->parse_objects);
-    //base_uri = raptor_new_uri(this->rdf_graph, (const unsigned char *)(getHomespace() + "#").c_str());  //This can be used to import URIs into a namespace
-
-    raptor_parser_parse_iostream(rdf_parser, ios, base_uri);
-    raptor_free_iostream(ios);
-    
-    // Read the triple store again. On the second pass through the triple store, property values are assigned to each SBOLObject's member properties by the parse_properties handler
-    ios = raptor_new_iostream_from_string(this->rdf_graph, (void *)sbol.c_str(), sbol.size());
-    raptor_parser_set_statement_handler(rdf_parser, user_data, this->parse_properties);
-    raptor_parser_parse_iostream(rdf_parser, ios, base_uri);
+    try
+    {
+        parse(ios);
+    }
+    catch (SBOLError &e)
+    {
+        raptor_free_iostream(ios);
+        throw;
+    }
     raptor_free_iostream(ios);
-    
-    raptor_free_uri(base_uri);
-    raptor_free_parser(rdf_parser);
-    
-    // On the final pass, nested annotations not in the SBOL namespace are identified
-    parse_annotation_objects();
-    
-    // A dummy parser which can be extended by SWIG to attach Python extension code
-    parse_extension_objects();
-    //@TODO fix validation on read
-    //    this->validate();
-    
+}
+
+std::vector<SBOLObject*> Document::merge(std::string& sbol)
+{
+    // Objects read during the merge are not indexed until the parse is done, so the index only finds the objects that were already here
+    vector<SBOLObject*> objects;
+    merged_objects = &objects;
+    try
+    {
+        readString(sbol);
+    }
+    catch (...)
+    {
+        merged_objects = NULL;
+        throw;
+    }
+    merged_objects = NULL;
+    return objects;
 }
 
 
@@ -942,27 +1652,28 @@ void SBOLObject::serialize(raptor_serializer* sbol_serializer, raptor_world *sbo
 			std::string new_predicate = it->first;  // The triple's predicate identifies an SBOL property
             
 			// Serialize each of the values in a List property as an RDF triple
-			vector<std::string> property_values = it->second;
+			vector<PropertyValue>& property_values = it->second;
 			for (auto i_val = property_values.begin(); i_val != property_values.end(); ++i_val)
 			{
-				std::string new_object = *i_val;
+				const std::string& new_object = i_val->str();
 				triple2->subject = raptor_new_term_from_uri_string(sbol_world, (const unsigned char *)subject.c_str());
 				triple2->predicate = raptor_new_term_from_uri_string(sbol_world, (const unsigned char *)new_predicate.c_str());
 				
-				// TODO:  the condition below, new_object.length() > 2, should be replaced with a function is_empty()
-				if (new_object.length() > 2 && new_object.front() == '<' && new_object.back() == '>') // Angle brackets indicate a uri
+				if (!i_val->empty() && i_val->isURI())
 				{
-					new_object = new_object.substr(1, new_object.length() - 2);  // Strip angle brackets
 					triple2->object = raptor_new_term_from_uri_string(sbol_world, (const unsigned char *)new_object.c_str());
 
 					// Write the triples, but don't write the identity property (it results in a redundant XML element)
 					// TODO: squelching the identity property like this is kludgey.  There's probably a more efficient way to squelch properties
 					if (new_predicate.compare(SBOL_IDENTITY) != 0) raptor_serializer_serialize_statement(sbol_serializer, triple2);
 				}
-				else if (new_object.length() > 2 && new_object.front() == '"' && new_object.back() == '"')  // Quotes indicate a literal
+				else if (!i_val->empty())
 				{
-					new_object = new_object.substr(1, new_object.length() - 2);  // Strip quotes
-					triple2->object = raptor_new_term_from_literal(sbol_world, (const unsigned char *)new_object.c_str(), NULL, NULL);
+					raptor_uri* datatype = i_val->datatype().size() ? raptor_new_uri(sbol_world, (const unsigned char *)i_val->datatype().c_str()) : NULL;
+					const unsigned char* language = i_val->language().size() ? (const unsigned char *)i_val->language().c_str() : NULL;
+					triple2->object = raptor_new_term_from_literal(sbol_world, (const unsigned char *)new_object.c_str(), datatype, language);
+					if (datatype)
+						raptor_free_uri(datatype);  // The term holds its own reference
 
 					// Write the triples
 					raptor_serializer_serialize_statement(sbol_serializer, triple2);
@@ -1046,6 +1757,7 @@ void SBOLObject::serialize(raptor_serializer* sbol_serializer, raptor_world *sbo
 
 void TopLevel::addToDocument(Document& doc)
 {
+    doc.checkArena(*this);
     doc.SBOLObjects[this->identity.get()] = this;
     this->doc = &doc;
 };
@@ -1078,6 +1790,44 @@ void Document::addNamespace(std::string ns, std::string prefix, raptor_serialize
     raptor_serializer_set_namespace(sbol_serializer, ns_uri, ns_prefix);
 };
 
+std::vector<SBOLObject*> Document::rdfxml_objects()
+{
+    // Add missing namespaces from objects and their children to the Document
+    vector<SBOLObject*> object_stack;
+    vector<pair<string, SBOLObject*>> top_levels;
+    for (auto &i_obj : SBOLObjects)
+    {
+        top_levels.push_back(make_pair(i_obj.second->identity.get(), i_obj.second));
+        object_stack.push_back(i_obj.second);
+    }
+    while (object_stack.size())
+    {
+        SBOLObject* obj = object_stack.back();
+        object_stack.pop_back();
+        for (auto &i_ns : obj->namespaces)
+            namespaces[i_ns.first] = i_ns.second;
+        for (auto &i_store : obj->owned_objects)
+            object_stack.insert(object_stack.end(), i_store.second.begin(), i_store.second.end());
+    }
+
+    // TopLevel objects are written in order of their URIs
+    sort(top_levels.begin(), top_levels.end(), [](const pair<string, SBOLObject*>& a, const pair<string, SBOLObject*>& b)
+    {
+        return a.first < b.first;
+    });
+    vector<SBOLObject*> sorted_objects;
+    for (auto &i_obj : top_levels)
+        sorted_objects.push_back(i_obj.second);
+    return sorted_objects;
+};
+
+void Document::serialize_rdfxml(std::ostream& sbol)
+{
+    vector<SBOLObject*> sorted_objects = rdfxml_objects();
+    RDFXMLWriter writer(sbol, namespaces);
+    writer.write(sorted_objects);
+};
+
 std::string Document::write(std::string filename)
 {
 	// Initialize raptor serializer
@@ -1091,14 +1841,19 @@ std::string Document::write(std::string filename)
         }
     }
 
+    // RDF/XML is streamed directly to the file
+    if (getFileFormat().compare("rdfxml") == 0)
+    {
+        ofstream fh(filename.c_str(), ios::out | ios::binary);
+        if (!fh.is_open())
+            throw SBOLError(SBOL_ERROR_SERIALIZATION, "Could not open " + filename + " for writing");
+        return write(fh);
+    }
+
 	FILE* fh = fopen(filename.c_str(), "wb");
 
 	raptor_world* world = getWorld();
-	raptor_serializer* sbol_serializer;
-	if (getFileFormat().compare("rdfxml") == 0)
-		sbol_serializer = raptor_new_serializer(world, "rdfxml-abbrev");
-	else
-		sbol_serializer = raptor_new_serializer(world, getFileFormat().c_str());
+	raptor_serializer* sbol_serializer = raptor_new_serializer(world, getFileFormat().c_str());
 
 	char *sbol_buffer;
 	size_t sbol_buffer_len;
@@ -1141,14 +1896,30 @@ std::string Document::write(std::string filename)
     return response;
 };
 
-std::string Document::writeString()
+std::string Document::write(std::ostream& sbol)
 {
-    raptor_world* world = getWorld();
-    raptor_serializer* sbol_serializer;
     if (getFileFormat().compare("rdfxml") == 0)
-        sbol_serializer = raptor_new_serializer(world, "rdfxml-abbrev");
+        serialize_rdfxml(sbol);
     else
-        sbol_serializer = raptor_new_serializer(world, getFileFormat().c_str());
+        sbol << writeString();
+    if (!sbol)
+        throw SBOLError(SBOL_ERROR_SERIALIZATION, "Serialization failed");
+
+    // Validate SBOL
+    return validate();
+};
+
+std::string Document::writeString()
+{
+    if (getFileFormat().compare("rdfxml") == 0)
+    {
+        ostringstream sbol;
+        serialize_rdfxml(sbol);
+        return sbol.str();
+    }
+
+    raptor_world* world = getWorld();
+    raptor_serializer* sbol_serializer = raptor_new_serializer(world, getFileFormat().c_str());
     
     char *sbol_buffer;
     size_t sbol_buffer_len;
@@ -1257,6 +2028,7 @@ void Document::close(std::string uri)
         else
         {
             SBOLObject* obj = SBOLObjects[uri];
+            unindex(*obj);
             obj->close();
             SBOLObjects.erase(uri);
         }
@@ -1272,7 +2044,7 @@ std::string ReferencedObject::create(std::string uri)
         throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, parseClassName(this->sbol_owner->type) + "::" + parseClassName(this->type) + "::create method of " + this->sbol_owner->identity.get() + " requires that this object belongs to a Document");
     Document& doc = *sbol_owner->doc;
     Identified& parent_obj = (Identified&)*sbol_owner;
-    if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+    if (Config::snapshot().compliant_uris)
     {
     
         Identified& new_obj = (Identified&)SBOL_DATA_MODEL_REGISTER[ reference_type_uri ]();  // Call constructor for the referenced object
@@ -1319,8 +2091,7 @@ Identified& Identified::copy(Document* target_doc, string ns, string version)
     for (auto i_store = properties.begin(); i_store != properties.end(); ++i_store)
     {
         string store_uri = i_store->first;
-        vector < string > property_store = i_store->second;
-        vector < string > property_store_copy = property_store;   // Copy properties
+        vector < PropertyValue > property_store_copy = i_store->second;   // Copy properties
         
         // If caller specified a namespace argument, then replace namespace in URIs
         // Don't overwrite namespaces for the wasDerivedFrom field, which points back to the original object
@@ -1329,15 +2100,15 @@ Identified& Identified::copy(Document* target_doc, string ns, string version)
             string old_ns = getHomespace();
             for (int i_property_val = 0; i_property_val < property_store_copy.size(); ++i_property_val)
             {
-                string property_val = property_store_copy[i_property_val];
+                string property_val = property_store_copy[i_property_val].str();
                 size_t pos = 0;
                 pos = property_val.find(old_ns, pos);
                 if (pos != std::string::npos)
                 {
                     property_val.erase(pos, old_ns.size());
                     property_val.insert(pos, ns);
+                    property_store_copy[i_property_val].set(property_val);
                 }
-                property_store_copy[i_property_val] = property_val;
             }
         }
         new_obj.properties[store_uri] = property_store_copy;
@@ -1360,6 +2131,7 @@ Identified& Identified::copy(Document* target_doc, string ns, string version)
             
             // Recurse into child objects and copy.  This should be after all other object properties are set, to ensure proper generation of new URIs with updated namespace and version
             Identified& child_obj_copy = child_obj.copy(target_doc, ns, version);
+            child_obj_copy.parent = &new_obj;
             new_obj.owned_objects[store_uri].push_back((SBOLObject*)&child_obj_copy);  // Copy child object
         }
     }
@@ -1375,18 +2147,11 @@ Identified& Identified::simpleCopy(string uri)
     for (auto i_store = properties.begin(); i_store != properties.end(); ++i_store)
     {
         string store_uri = i_store->first;
-        vector < string > property_store = i_store->second;
-        vector < string > property_store_copy = property_store;
-        for (int i_property_val = 0; i_property_val < property_store_copy.size(); ++i_property_val)
-        {
-            string property_val = property_store_copy[i_property_val];
-            property_store_copy[i_property_val] = property_val;
-        }
-        new_obj.properties[store_uri] = property_store_copy;
+        new_obj.properties[store_uri] = i_store->second;
     }
     
     // Initialize the object's URI, this code is same as Identified's constructor
-    if(Config::getOption("sbol_compliant_uris").compare("True") == 0)
+    if(Config::snapshot().compliant_uris)
     {
         if (compliantTypesEnabled())
         {
@@ -1420,6 +2185,13 @@ Identified& Identified::simpleCopy(string uri)
 
 
 
+// Handles for requests to the online validator and to SynBioHub, shared by every Document.  The pool initializes libcurl once for the process, and keeps connections open between requests
+static ConnectionPool& web_service_connections()
+{
+    static ConnectionPool connections;
+    return connections;
+};
+
 std::string Document::request_validation(std::string& sbol)
 {
     /* Form validation options in JSON */
@@ -1446,19 +2218,15 @@ std::string Document::request_validation(std::string& sbol)
     
     /* Perform HTTP request */
     string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     headers = curl_slist_append(headers, "Accept: application/json");
     headers = curl_slist_append(headers, "Content-Type: application/json");
     headers = curl_slist_append(headers, "charsets: utf-8");
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* borrow a curl handle, which goes back to the pool when the request is done */
+    PooledHandle curl(web_service_connections());
     if(curl) {
         /* First set the URL that is about to receive our POST. This URL can
          just as well be a https:// URL if that is what should receive the
@@ -1477,13 +2245,12 @@ std::string Document::request_validation(std::string& sbol)
         res = curl_easy_perform(curl);
         /* Check for errors */
         if(res != CURLE_OK)
+        {
+            curl_slist_free_all(headers);
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to validate online failed with " + string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
+        }
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
 
     Json::Value json_response;
     Json::Reader reader;
@@ -1534,19 +2301,15 @@ std::string Document::query_repository(std::string command)
     
     /* Perform HTTP request */
     string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
 //    headers = curl_slist_append(headers, "Accept: application/json");
 //    headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
 //    headers = curl_slist_append(headers, "charsets: utf-8");
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* borrow a curl handle, which goes back to the pool when the request is done */
+    PooledHandle curl(web_service_connections());
     if(curl) {
         /* First set the URL that is about to receive our POST. This URL can
          just as well be a https:// URL if that is what should receive the
@@ -1566,13 +2329,12 @@ std::string Document::query_repository(std::string command)
         res = curl_easy_perform(curl);
         /* Check for errors */
         if(res != CURLE_OK)
+        {
+            curl_slist_free_all(headers);
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to validate online failed with " + string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
+        }
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
 
     cout << response << endl;
 //    Json::Value json_response;
@@ -1627,19 +2389,15 @@ std::string Document::search_metadata(std::string role, std::string type, std::s
     
     /* Perform HTTP request */
     string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     //    headers = curl_slist_append(headers, "Accept: application/json");
     headers = curl_slist_append(headers, "Content-Type: application/json");
     //    headers = curl_slist_append(headers, "charsets: utf-8");
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* borrow a curl handle, which goes back to the pool when the request is done */
+    PooledHandle curl(web_service_connections());
     if(curl)
     {
         /* First set the URL that is about to receive our POST. This URL can
@@ -1660,13 +2418,12 @@ std::string Document::search_metadata(std::string role, std::string type, std::s
         res = curl_easy_perform(curl);
         /* Check for errors */
         if(res != CURLE_OK)
+        {
+            curl_slist_free_all(headers);
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to validate online failed with " + string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
+        }
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
     
     cout << response << endl;
     Json::Value json_response;
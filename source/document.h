@@ -35,10 +35,15 @@
 #include "module.h"
 #include "model.h"
 #include "collection.h"
+#include "combinatorialderivation.h"
+#include "symboltable.h"
+#include "arena.h"
 
 #include <raptor2.h>
 #include <unordered_map>
 #include <istream>
+#include <ostream>
+#include <tuple>
 #include <algorithm>
 
 namespace sbol {
@@ -50,17 +55,36 @@ namespace sbol {
     extern std::unordered_map<std::string, sbol::SBOLObject&(*)()> SBOL_DATA_MODEL_REGISTER;
     /// @endcond
 
+    /// An occurrence of a feature's sequence in a Sequence, as found by Document::search
+    struct SBOL_DECLSPEC SequenceMatch
+    {
+        Sequence* sequence;            ///< The Sequence the feature was found in
+        ComponentDefinition* feature;  ///< The feature that was found
+        int start;                     ///< The position of the first base of the match, starting from 1 as in a Range
+        int end;                       ///< The position of the last base of the match, which is included
+        std::string orientation;       ///< SBOL_ORIENTATION_INLINE, or SBOL_ORIENTATION_REVERSE_COMPLEMENT if the feature was found on the other strand
+    };
     
     /// Read and write SBOL using a Document class.  The Document is a container for Components, Modules, and all other SBOLObjects
     class SBOL_DECLSPEC Document : public Identified
     {
         friend class SBOLObject;
+        friend class PartShop;  // Streams the Document one TopLevel at a time when submitting it
         
 	private:
         std::string home; ///< The authoritative namespace for the Document. Setting the home namespace is like signing a piece of paper.
         int SBOLCompliant; ///< Flag indicating whether to autoconstruct URI's consistent with SBOL's versioning scheme
         ValidationRules validationRules;  ///< A list of validation functions to run on the Document prior to serialization
         raptor_world *rdf_graph;  ///< RDF triple store that holds SBOL objects and properties
+        SymbolTable symbols;  ///< Interned subject, predicate and type URIs encountered by the parser
+        symbol_id rdf_type_symbol;
+        std::unordered_map<symbol_id, std::vector<std::pair<symbol_id, PropertyValue>>> pending_statements;  ///< Statements buffered by the parser until their subject is typed
+        std::vector<std::tuple<SBOLObject*, symbol_id, symbol_id>> pending_owned_objects;  ///< Parent-child links resolved by the parser once the whole input has been read
+        void parse(raptor_iostream* ios);  ///< Parse RDF from an input stream in a single pass
+        void parse_property(SBOLObject* sbol_obj, symbol_id property, PropertyValue& property_value);
+        void serialize_rdfxml(std::ostream& sbol);  ///< Write nested RDF/XML directly from the object tree
+        std::vector<SBOLObject*> rdfxml_objects();  ///< Collect the namespaces of all objects into the Document, and return the TopLevels in the order they are written
+        std::vector<sbol::SBOLObject*>* merged_objects = NULL;  ///< While merging, collects the objects read. Objects already in the Document are passed over
         
 	public:
         /// Construct a Document.  The Document is a container for Components, Modules, and all other SBOLObjects
@@ -76,6 +100,7 @@ namespace sbol {
             sequences(SBOL_SEQUENCE, this, ""),
             sequenceAnnotations(SBOL_SEQUENCE_ANNOTATION, this, ""),
             collections(SBOL_COLLECTION, this, ""),
+            combinatorialDerivations(SBOL_COMBINATORIAL_DERIVATION, this, ""),
             citations(PURL_URI "bibliographicCitation", this),
             keywords(PURL_URI "elements/1.1/subject", this)
         
@@ -92,10 +117,44 @@ namespace sbol {
         }
         
         ~Document() override;
+
+        /// Allocate the objects this Document reads from files in an arena owned by the Document, rather than one by one from the heap. The arena is released in one step when the Document is destroyed or reads another file, which makes loading and discarding many Documents considerably cheaper. Objects in the arena are not freed by close(), so enable this for Documents that are read and discarded as a whole
+        /// @param is_toggled True to allocate from an arena, false to allocate later objects from the heap again
+        void toggleArenaAllocation(bool is_toggled = true);
         
         /// @cond
+        ObjectArena* arena = NULL;  ///< Holds the objects read while arena allocation was enabled
+        bool arena_enabled = false;
+        /// Objects cannot move out of the arena they were read into, since the arena destroys them with its Document
+        /// @throw SBOL_ERROR_INVALID_ARGUMENT if the object belongs to the arena of another Document
+        void checkArena(SBOLObject& sbol_obj);
         /// The Document's register of objects
 		std::unordered_map<std::string, sbol::SBOLObject*> SBOLObjects;
+        /// Every object in the Document by identity, including child objects nested inside TopLevels
+        std::unordered_map<std::string, sbol::SBOLObject*> identity_index;
+        /// An object's references to one URI: the interned properties that hold them, and the order in which the object was first indexed as a referrer
+        struct Referral
+        {
+            unsigned long order;
+            std::vector<symbol_id> properties;
+        };
+        /// The objects that refer to each URI through one of their properties, along with the properties that hold the reference
+        std::unordered_map<std::string, std::unordered_map<sbol::SBOLObject*, Referral>> reference_index;
+        unsigned long referral_count = 0;  ///< Numbers referrals as they are indexed, so referrers can be listed in a stable order
+        void index(SBOLObject& sbol_obj);    ///< Add an object and its children to the identity and reference indices
+        void unindex(SBOLObject& sbol_obj);  ///< Remove an object and its children from the identity and reference indices
+        void indexReference(SBOLObject& referrer, const sbol_type& property_uri, const std::string& uri);
+        void unindexReference(SBOLObject& referrer, const sbol_type& property_uri, const std::string& uri);
+        /// Counts changes to the Document's structure: objects being added or removed, and uri-valued or integer properties, such as Location coordinates, being changed. Derived data, such as the sequence graph of a ComponentDefinition, is rebuilt when the revision moves on
+        unsigned long revision = 0;
+        /// The TopLevel objects that share each persistentIdentity, ordered from the earliest version to the latest
+        std::unordered_map<std::string, std::vector<sbol::SBOLObject*>> version_index;
+        void indexVersion(SBOLObject& sbol_obj);
+        void unindexVersion(SBOLObject& sbol_obj, const std::string& persistent_identity);
+        /// The sequences of composite ComponentDefinitions assembled from their Components, so a part reused across a hierarchy is assembled once. They are dropped when the revision moves on, or when a Sequence they were assembled from is edited
+        std::unordered_map<const sbol::SBOLObject*, sbol::PropertyValue> assembled_sequences;
+        unsigned long assembly_revision = 0;          ///< The revision the assembled sequences were built at
+        void invalidateAssembly(SBOLObject& sequence);  ///< Drops the assembled sequences of every ComponentDefinition that contains a part described by this Sequence
         TopLevel& getTopLevel(std::string);
         raptor_world* getWorld();
         /// @endcond
@@ -106,6 +165,7 @@ namespace sbol {
         List<OwnedObject<Sequence>> sequences;
         List<OwnedObject<SequenceAnnotation>> sequenceAnnotations;
         List<OwnedObject<Collection>> collections;
+        List<OwnedObject<CombinatorialDerivation>> combinatorialDerivations;
 
         URIProperty citations;
         URIProperty keywords;
@@ -135,6 +195,11 @@ namespace sbol {
         /// @return A string with the validation results, or empty string if validation is disabled
         std::string write(std::string filename);
 
+        /// Serialize all objects in this Document to an output stream
+        /// @param sbol The output stream
+        /// @return A string with the validation results, or empty string if validation is disabled
+        std::string write(std::ostream& sbol);
+
         /// Read an RDF/XML file and attach the SBOL objects to this Document. Existing contents of the Document will be wiped.
         /// @param filename The full name of the file you want to read (including file extension)
         void read(std::string filename);
@@ -142,6 +207,12 @@ namespace sbol {
         /// Convert text in SBOL into data objects
         /// @param sbol A string formatted in SBOL
         void readString(std::string& sbol);
+
+        /// @cond
+        /// Reads SBOL into this Document, as readString does, but passes over the objects, including child objects, that the Document already contains, so overlapping inputs can be merged
+        /// @return The objects that were read, including child objects
+        std::vector<SBOLObject*> merge(std::string& sbol);
+        /// @endcond
         
         /// Convert data objects in this Document into textual SBOL
         std::string writeString();
@@ -149,6 +220,10 @@ namespace sbol {
         /// Read an RDF/XML file and attach the SBOL objects to this Document. New objects will be added to the existing contents of the Document
         /// @param filename The full name of the file you want to read (including file extension)
         void append(std::string filename);
+
+        /// Read SBOL from an input stream and attach the SBOL objects to this Document. New objects will be added to the existing contents of the Document. The stream is consumed in a single pass, so non-seekable sources such as pipes and sockets are supported.
+        /// @param sbol An input stream formatted in SBOL
+        void append(std::istream& sbol);
         
         /// Submit this Document to the online validator.
         /// @return The validation results
@@ -177,15 +252,47 @@ namespace sbol {
             return this->size();
         }
         
-        /// Search recursively for an SBOLObject in this Document that matches the uri
+        /// Search for an SBOLObject in this Document, including child objects, that matches the uri
         /// @param uri The identity of the object to search for
         /// @return A pointer to the SBOLObject, or NULL if an object with this identity doesn't exist
         SBOLObject* find(std::string uri);
+
+        /// Find the objects in this Document that refer to a URI through one of their properties, for example the ComponentDefinitions that use a Sequence or the SequenceAnnotations with a given role
+        /// @param uri The URI of the referenced object or term
+        /// @return Pointers to the referring objects, each listed once, in the order they began to refer to the URI
+        std::vector<SBOLObject*> getReferrers(std::string uri);
+
+        /// Find the objects in this Document that refer to a URI through the given property
+        /// @param uri The URI of the referenced object or term
+        /// @param property_uri The RDF type of the referring property, eg, http://sbols.org/v2#sequence
+        /// @return Pointers to the referring objects, each listed once, in the order they began to refer to the URI
+        std::vector<SBOLObject*> getReferrers(std::string uri, std::string property_uri);
+
+        /// Assembles a library of constructs at once, as ComponentDefinition::assemble does for one. The constructs are built in parallel on a pool of worker threads, then added to this Document together. Parts that do not yet belong to a Document are added to this one. Requires SBOL-compliant URIs
+        /// @param uris The displayIds of the new ComponentDefinitions
+        /// @param list_of_designs For each new ComponentDefinition, the list of parts it is assembled from
+        /// @param n_threads The number of worker threads, or 0 to use one per hardware thread
+        /// @return The new ComponentDefinitions, in the order of the uris
+        std::vector<ComponentDefinition*> assemble(std::vector<std::string> uris, std::vector<std::vector<ComponentDefinition*>> list_of_designs, unsigned int n_threads = 0);
+
+        /// Searches every IUPAC DNA and RNA Sequence in this Document for a library of features, such as promoters, terminators and restriction sites, on both strands. All the features are found in a single pass over each Sequence, and the Sequences are searched in parallel on a pool of worker threads. Matching ignores case, and a u matches a t. Ambiguity codes in a Sequence match nothing, and features whose Sequences contain them are not searched for
+        /// @param features The ComponentDefinitions to search for, each by the IUPAC Sequences it refers to
+        /// @param n_threads The number of worker threads, or 0 to use one per hardware thread
+        /// @return The matches, ordered by Sequence as in this Document, then by position
+        std::vector<SequenceMatch> search(std::vector<ComponentDefinition*> features, unsigned int n_threads = 0);
+
+        /// Searches this Document for a library of features, as search does, and annotates the matches. Each ComponentDefinition that refers to a matching Sequence, other than the feature itself, gets a SequenceAnnotation with a Range over the match and the roles of the feature. Matches that are already annotated with the same Range and roles are skipped, so annotating twice adds nothing. Requires SBOL-compliant URIs
+        /// @param features The ComponentDefinitions to search for, each by the IUPAC Sequences it refers to
+        /// @param n_threads The number of worker threads, or 0 to use one per hardware thread
+        /// @return The new SequenceAnnotations
+        std::vector<SequenceAnnotation*> annotate(std::vector<ComponentDefinition*> features, unsigned int n_threads = 0);
         
         /// @cond
         // Handler-functions for the Raptor library's RDF parsers
         static void parse_objects(void* user_data, raptor_statement* triple);
 		static void parse_properties(void* user_data, raptor_statement* triple);
+        static void parse_statement(void* user_data, raptor_statement* triple);
+        static SBOLObject* construct_object(Document* doc, const std::string& uri, const std::string& type_uri);
         static void namespaceHandler(void *user_data, raptor_namespace *nspace);
         void addNamespace(std::string ns, std::string prefix, raptor_serializer* sbol_serializer);
         void parse_annotation_objects();
@@ -271,6 +378,7 @@ namespace sbol {
             throw SBOLError(DUPLICATE_URI_ERROR, "Cannot create " + sbol_obj.identity.get() + ". An object with this identity is already contained in the Document");
         else
         {
+            checkArena(sbol_obj);
             // If TopLevel add the Document
             TopLevel* check_top_level = dynamic_cast<TopLevel*>(&sbol_obj);
             if (check_top_level)
@@ -280,6 +388,7 @@ namespace sbol {
                 this->owned_objects[sbol_obj.type].push_back((SBOLClass*)&sbol_obj);  // Add the object to the Document's property store, eg, componentDefinitions, moduleDefinitions, etc.
             }
             sbol_obj.doc = this;
+            index(sbol_obj);
             
             // Recurse into child objects and set their back-pointer to this Document
             for (auto i_store = sbol_obj.owned_objects.begin(); i_store != sbol_obj.owned_objects.end(); ++i_store)
@@ -308,34 +417,12 @@ namespace sbol {
         if (SBOLObjects.find(uri) != SBOLObjects.end())
             return (SBOLClass &)*(SBOLObjects[uri]);
         
-        // In SBOLCompliant mode, the user may retrieve an object by persistentIdentity as well
-        if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+        // In SBOLCompliant mode, the user may retrieve the latest version of an object by its persistentIdentity as well
+        if (Config::snapshot().compliant_uris)
         {
-            std::vector < std::string > ids;  // Contains all URIs contaning the persistentIdentity
-            
-            // Search the Document's object map for  property's object store for all URIs prefixed with the persistentIdentity
-            for (auto i_obj = SBOLObjects.begin(); i_obj != SBOLObjects.end(); ++i_obj)
-            {
-                std::string obj_id = i_obj->first;
-                SBOLObject* obj = i_obj->second;
-                std::string persistent_id = "";
-
-                if (obj->properties.find(SBOL_PERSISTENT_IDENTITY) != obj->properties.end())
-                {
-                    persistent_id = obj->properties[SBOL_PERSISTENT_IDENTITY][0];
-                    persistent_id = persistent_id.substr(1, persistent_id.size() - 2);  // Removes flanking " from the version field
-                }
-                if (uri.compare(persistent_id) == 0)
-                    ids.push_back(obj_id);
-            }
-            
-            // Get the latest version
-            std::sort(ids.begin(), ids.end());
-            if (ids.size() > 0)
-            {
-                uri = ids.back();
-                return (SBOLClass &)*(SBOLObjects[uri]);
-            }
+            auto i_versions = version_index.find(uri);
+            if (i_versions != version_index.end())
+                return (SBOLClass &)*i_versions->second.back();
         }
         throw SBOLError(NOT_FOUND_ERROR, "Object " + uri + " not found");
 	};
@@ -345,9 +432,12 @@ namespace sbol {
     template < class SBOLClass >
     sbol::SBOLObject& create()
     {
-        // Construct an SBOLObject with emplacement
-        void* mem = malloc(sizeof(SBOLClass));
+        // Construct an SBOLObject with emplacement, in the current thread's arena if a Document has made one current
+        ObjectArena* arena = ObjectArena::current();
+        void* mem = arena ? arena->allocate(sizeof(SBOLClass), alignof(SBOLClass)) : malloc(sizeof(SBOLClass));
         SBOLClass* a = new (mem) SBOLClass;
+        if (arena)
+            arena->adopt(a);
         return (sbol::SBOLObject&)*a;
     };
     
@@ -385,6 +475,35 @@ namespace sbol {
 	std::string get_local_part(std::string qname);
 	std::string get_prefix(std::string qname);
 	std::vector<std::string> parse_element(std::istringstream& xml_buffer);
+
+    /// Streams SBOLObjects as nested RDF/XML in a single walk over their owned objects. The layout is the same as raptor's rdfxml-abbrev serializer after SBOLObject::nest, ie, subjects and statements sorted by URI and child objects nested inside the property element that refers to them
+    class SBOL_DECLSPEC RDFXMLWriter
+    {
+    private:
+        std::ostream& out;
+        std::vector<std::pair<std::string, std::string>> root_namespaces;  ///< Namespace URIs and their prefixes, declared on the rdf:RDF element
+        std::unordered_map<std::string, std::string> qnames;  ///< Cached qnames of URIs in the root namespaces
+        std::vector<std::tuple<std::string, std::string, int>> scoped_namespaces;  ///< Generated namespaces, prefixes and the depth of the element that declares them
+        int namespace_count;
+
+        std::string qname(const std::string& uri, int depth, std::string& declaration);
+        void endScope(int depth);
+        void writeIndent(int depth);
+        void writeEscaped(const std::string& text, std::size_t pos, std::size_t len, bool is_attribute);
+        void writeLiteral(const std::string& text, int depth);
+        void writeObject(SBOLObject& sbol_obj, int depth);
+
+    public:
+        RDFXMLWriter(std::ostream& out, const std::unordered_map<std::string, std::string>& namespaces);
+
+        /// Write an RDF/XML document containing these objects and all their children
+        void write(std::vector<SBOLObject*>& sbol_objects);
+
+        /// Write the document one object at a time, so objects can be discarded once they are written
+        void begin();                      ///< Write the XML declaration and the opening rdf:RDF element
+        void write(SBOLObject& sbol_obj);  ///< Write an object and all its children
+        void end();                        ///< Write the closing rdf:RDF element
+    };
     /// @endcond
 
     /* <!--- Accessor functions for SBOL properties ---> */
@@ -415,7 +534,7 @@ namespace sbol {
         }
         SBOLObject* parent_obj = this->sbol_owner;
 
-        if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+        if (Config::snapshot().compliant_uris)
         {
             SBOLClass* child_obj = new SBOLClass();
 
@@ -424,20 +543,18 @@ namespace sbol {
             std::string version;
             if (!CHECK_TOP_LEVEL && parent_obj->properties.find(SBOL_PERSISTENT_IDENTITY) != parent_obj->properties.end())
             {
-                persistent_id = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front();
-                persistent_id = persistent_id.substr(1, persistent_id.length() - 2);  // Removes flanking < and > from the uri
+                persistent_id = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front().str();
             }
             else
             {
                 // If object is TopLevel, intialize the URI
                 persistent_id = getHomespace();
-                if (Config::getOption("sbol_typed_uris").compare("True") == 0)
+                if (Config::snapshot().typed_uris)
                     persistent_id += "/" + parseClassName(child_obj->getTypeURI());
             }
             if (parent_obj->properties.find(SBOL_VERSION) != parent_obj->properties.end())
             {
-                version = parent_obj->properties[SBOL_VERSION].front();
-                version = version.substr(1, version.length() - 2);  // Removes flanking " from the uri
+                version = parent_obj->properties[SBOL_VERSION].front().str();
             }
             else
             {
@@ -466,9 +583,12 @@ namespace sbol {
             std::vector< sbol::SBOLObject* >& object_store = this->sbol_owner->owned_objects[this->type];
             object_store.push_back((SBOLObject*)child_obj);
 
-            // The following effectively adds the child object to the Document by setting its back-pointer.  However, the Document itself only maintains a register of TopLevel objects, otherwise the returned object will not be registered
+            // The following effectively adds the child object to the Document by setting its back-pointer.  The Document's register only holds TopLevel objects, while its identity index holds every object
             if (parent_doc)
+            {
                 child_obj->doc = parent_doc;
+                parent_doc->index(*child_obj);
+            }
             if (CHECK_TOP_LEVEL)
                 parent_doc->SBOLObjects[child_id] = (SBOLObject*)child_obj;
             return *child_obj;
@@ -509,15 +629,14 @@ namespace sbol {
         }
         SBOLObject* parent_obj = this->sbol_owner;
         
-        if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+        if (Config::snapshot().compliant_uris)
         {
             // Form compliant URI for child object
             std::string persistent_id;
             std::string version;
             if (parent_obj->properties.find(SBOL_PERSISTENT_IDENTITY) != parent_obj->properties.end())
             {
-                persistent_id = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front();
-                persistent_id = persistent_id.substr(1, persistent_id.length() - 2);  // Removes flanking < and > from the uri
+                persistent_id = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front().str();
             }
             else
             {
@@ -525,8 +644,7 @@ namespace sbol {
             }
             if (parent_obj->properties.find(SBOL_VERSION) != parent_obj->properties.end())
             {
-                version = parent_obj->properties[SBOL_VERSION].front();
-                version = version.substr(1, version.length() - 2);  // Removes flanking " from the uri
+                version = parent_obj->properties[SBOL_VERSION].front().str();
             }
             else
             {
@@ -553,9 +671,12 @@ namespace sbol {
             std::vector< sbol::SBOLObject* >& object_store = this->sbol_owner->owned_objects[this->type];
             object_store.push_back(child_obj);
             
-            // The following effectively adds the child object to the Document by setting its back-pointer.  However, the Document itself only maintains a register of TopLevel objects, otherwise the returned object will not be registered
+            // The following effectively adds the child object to the Document by setting its back-pointer.  The Document's register only holds TopLevel objects, while its identity index holds every object
             if (parent_doc)
+            {
                 child_obj->doc = parent_doc;
+                parent_doc->index(*child_obj);
+            }
             if (CHECK_TOP_LEVEL)
                 parent_doc->SBOLObjects[child_id] = (SBOLObject*)child_obj;
             return *child_obj;
@@ -582,7 +703,7 @@ namespace sbol {
     template <class SBOLClass>
     void OwnedObject<SBOLClass>::add(SBOLClass& sbol_obj)
     {
-        if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+        if (Config::snapshot().compliant_uris)
             throw SBOLError(SBOL_ERROR_COMPLIANCE, "Cannot add " + sbol_obj.identity.get() + " to " + this->sbol_owner->identity.get() + ". The " + parseClassName(this->sbol_owner->type) + "::" + parseClassName(this->type) + "::add method is prohibited while operating in SBOL-compliant mode and is only available when operating in open-world mode. Use the " + parseClassName(this->sbol_owner->type) + "::" + parseClassName(this->type) + "::create method instead or use toggleSBOLCompliance to enter open-world mode");
         if (this->sbol_owner)
         {
@@ -598,11 +719,14 @@ namespace sbol {
                     throw SBOLError(DUPLICATE_URI_ERROR, "The object " + sbol_obj.identity.get() + " is already contained by the property");
                 else
                 {
+                    if (this->sbol_owner->doc)
+                        this->sbol_owner->doc->checkArena(sbol_obj);
                     sbol_obj.parent = this->sbol_owner;  // Set back-pointer to parent object
                     object_store.push_back((SBOLObject *)&sbol_obj);
                     if (this->sbol_owner->doc)
                     {
                         sbol_obj.doc = this->sbol_owner->doc;
+                        sbol_obj.doc->index(sbol_obj);
                     }
                 }
             }
@@ -670,7 +794,7 @@ namespace sbol {
         }
         
         // In SBOLCompliant mode, the user may retrieve an object by displayId as well
-        if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+        if (Config::snapshot().compliant_uris)
         {
             // Form compliant URI for child object
             SBOLObject* parent_obj = this->sbol_owner;
@@ -684,8 +808,7 @@ namespace sbol {
                 // Check to see if the parent object has a persistent identity
                 if (parent_obj->properties.find(SBOL_PERSISTENT_IDENTITY) != parent_obj->properties.end())
                 {
-                    persistentIdentity = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front();
-                    persistentIdentity = persistentIdentity.substr(1, persistentIdentity.length() - 2);  // Removes flanking < and > from the uri
+                    persistentIdentity = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front().str();
                 }
             }
             // If the parent object doesn't have a persistent identity then it is TopLevel
@@ -701,8 +824,7 @@ namespace sbol {
             }
             if (parent_obj->properties.find(SBOL_VERSION) != parent_obj->properties.end())
             {
-                version = parent_obj->properties[SBOL_VERSION].front();
-                version = version.substr(1, version.length() - 2);  // Removes flanking " from the uri
+                version = parent_obj->properties[SBOL_VERSION].front().str();
             }
             else
             {
@@ -755,7 +877,10 @@ namespace sbol {
                     if (uri.compare(obj.identity.get()) == 0)
                     {
                         this->sbol_owner->owned_objects[this->type].erase( this->sbol_owner->owned_objects[this->type].begin() + i_obj);
+                        obj.parent = NULL;
                         //this->remove(i_obj);
+                        if (obj.doc)
+                            obj.doc->unindex(obj);
                         TopLevel* check_top_level = dynamic_cast<TopLevel*>(&obj);
                         if (check_top_level)
                             obj.doc->SBOLObjects.erase(uri);
@@ -777,6 +902,8 @@ namespace sbol {
                 for (auto i_obj = object_store.begin(); i_obj != object_store.end(); ++i_obj)
                 {
                     SBOLObject* obj = *i_obj;
+                    if (obj->doc)
+                        obj->doc->unindex(*obj);
                     obj->close();
                 }
                 object_store.clear();
@@ -86,7 +86,7 @@ namespace sbol
             name(SBOL_NAME, this),
             description(SBOL_DESCRIPTION, this)
         {
-            if(Config::getOption("sbol_compliant_uris").compare("True") == 0)
+            if(Config::snapshot().compliant_uris)
             {
                 if (compliantTypesEnabled())
                 {
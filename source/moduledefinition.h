@@ -73,6 +73,11 @@ namespace sbol
         /// @param input A ComponentDefinition that defines the input
         /// @return A FunctionalComponent that is derived from the argument ComponentDefinition and configured as this ModuleDefinition's input (it's direction property is set to SBOL_DIRECTION_IN)
         FunctionalComponent& setInput(ComponentDefinition& input);
+
+        /// Connects many module inputs and outputs at once, as FunctionalComponent::connect does for one pair. The connections are made through this ModuleDefinition, which must contain exactly one Module for the ModuleDefinitions of both components in every pair, or an SBOLError is thrown
+        /// @param components The FunctionalComponents to connect
+        /// @param interface_components The input or output component that corresponds with the FunctionalComponent at the same position in components
+        void connect(std::vector<FunctionalComponent*> components, std::vector<FunctionalComponent*> interface_components);
         
         virtual ~ModuleDefinition() {};
 
@@ -0,0 +1,814 @@
+/**
+ * @file    nucleotides.cpp
+ * @brief   Packing and kernels for IUPAC DNA and RNA sequences
+ * @author  Bryan Bartley
+ * @email   bartleyba@sbolstandard.org
+ *
+ * <!--------------------------------------------------------------------------
+ * This file is part of libSBOL.  Please visit http://sbolstandard.org for more
+ * information about SBOL, and the latest version of libSBOL.
+ *
+ *  Copyright 2016 University of Washington, WA, USA
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ------------------------------------------------------------------------->*/
+
+#include "nucleotides.h"
+#include "assembly.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+using namespace std;
+using namespace sbol;
+
+// How a character is packed: codes 0 to 3 are bases, U_CODE is a u, which is code 3 in an RNA sequence, and the rest are not bases
+static const unsigned char U_CODE = 4;
+static const unsigned char AMBIGUOUS = 5;
+static const unsigned char INVALID = 6;
+
+static const uint64_t LOW_BITS = 0x5555555555555555ULL;  // The low bit of each base
+
+struct NucleotideTables
+{
+    unsigned char code[256];
+    char complement[256];     // Complements of lower case symbols, including ambiguity codes
+    char bytes[4][256][4];    // The four bases packed into a byte, for each combination of case and RNA
+
+    NucleotideTables()
+    {
+        memset(code, INVALID, sizeof(code));
+        memset(complement, 0, sizeof(complement));
+        const char* symbols = "acgtu" "rykmswbdhvn" "-.";
+        const char* complements = "tgcaa" "yrmkswvhdbn" "-.";
+        for (int i_symbol = 0; symbols[i_symbol]; ++i_symbol)
+        {
+            unsigned char symbol = symbols[i_symbol];
+            code[symbol] = i_symbol < 4 ? i_symbol : (i_symbol == 4 ? U_CODE : AMBIGUOUS);
+            if (isalpha(symbol))
+                code[toupper(symbol)] = code[symbol];
+            complement[symbol] = complements[i_symbol];
+        }
+        for (int upper_case = 0; upper_case < 2; ++upper_case)
+        {
+            for (int rna = 0; rna < 2; ++rna)
+            {
+                const char* letters = upper_case ? (rna ? "ACGU" : "ACGT") : (rna ? "acgu" : "acgt");
+                for (int byte = 0; byte < 256; ++byte)
+                {
+                    for (int i_base = 0; i_base < 4; ++i_base)
+                        bytes[upper_case * 2 + rna][byte][i_base] = letters[(byte >> (2 * i_base)) & 3];
+                }
+            }
+        }
+    };
+};
+
+static const NucleotideTables& tables()
+{
+    static const NucleotideTables nucleotide_tables;
+    return nucleotide_tables;
+};
+
+static inline unsigned int popcount(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(word);
+#else
+    word = word - ((word >> 1) & LOW_BITS);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (unsigned int)((word * 0x0101010101010101ULL) >> 56);
+#endif
+};
+
+// Reverses the order of the 32 bases in a word
+static inline uint64_t reverse_bases(uint64_t word)
+{
+    word = ((word >> 2) & 0x3333333333333333ULL) | ((word & 0x3333333333333333ULL) << 2);
+    word = ((word >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((word & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    word = ((word >> 8) & 0x00FF00FF00FF00FFULL) | ((word & 0x00FF00FF00FF00FFULL) << 8);
+    word = ((word >> 16) & 0x0000FFFF0000FFFFULL) | ((word & 0x0000FFFF0000FFFFULL) << 16);
+    return (word >> 32) | (word << 32);
+};
+
+// Extends the last run if it ends where the new one starts, so runs are always as long as they can be
+static inline void append_run(vector<PackedNucleotides::Run>& runs, size_t start, size_t length, char symbol)
+{
+    if (runs.size() && runs.back().start + runs.back().length == start && runs.back().symbol == symbol)
+        runs.back().length += length;
+    else
+        runs.push_back({ start, length, symbol });
+};
+
+// @return The first run that ends after a position
+static vector<PackedNucleotides::Run>::const_iterator first_run_after(const vector<PackedNucleotides::Run>& runs, size_t position)
+{
+    return partition_point(runs.begin(), runs.end(), [position](const PackedNucleotides::Run& run) { return run.start + run.length <= position; });
+};
+
+PackedNucleotides::PackedNucleotides() :
+    n_bases(0),
+    upper_case(false),
+    rna(false)
+{
+};
+
+PackedNucleotides::PackedNucleotides(const std::string& elements) :
+    PackedNucleotides()
+{
+    if (!encode(elements, (std::size_t)-1))
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Sequence elements are not IUPAC nucleotide codes");
+};
+
+PackedNucleotides* PackedNucleotides::pack(const std::string& elements)
+{
+    if (elements.size() < min_length)
+        return NULL;
+    // Packing is only worthwhile while the runs take less room than the words
+    PackedNucleotides* packed = new PackedNucleotides();
+    if (!packed->encode(elements, elements.size() / (4 * sizeof(Run))))
+    {
+        delete packed;
+        return NULL;
+    }
+    return packed;
+};
+
+bool PackedNucleotides::encode(const std::string& elements, std::size_t max_runs)
+{
+    const NucleotideTables& nucleotides = tables();
+    n_bases = elements.size();
+    words.assign((n_bases + 31) / 32, 0);
+    ambiguities.clear();
+    case_runs.clear();
+
+    // The case of the first letter, and whether a u comes before any t, decide which form of the bases is packed
+    upper_case = false;
+    rna = false;
+    auto i_letter = find_if(elements.begin(), elements.end(), [](char c) { return isalpha((unsigned char)c) != 0; });
+    if (i_letter != elements.end())
+        upper_case = isupper((unsigned char)*i_letter) != 0;
+    auto i_t = find_if(elements.begin(), elements.end(), [](char c) { return c == 't' || c == 'T' || c == 'u' || c == 'U'; });
+    if (i_t != elements.end())
+        rna = (*i_t == 'u' || *i_t == 'U');
+
+    const unsigned char* symbols = (const unsigned char*)elements.data();
+    for (size_t i_word = 0; i_word < words.size(); ++i_word)
+    {
+        uint64_t word = 0;
+        size_t word_start = i_word * 32;
+        size_t word_end = min(word_start + 32, n_bases);
+        for (size_t i_base = word_start; i_base < word_end; ++i_base)
+        {
+            unsigned char symbol = symbols[i_base];
+            unsigned char base_code = nucleotides.code[symbol];
+            if (base_code == U_CODE)
+                base_code = rna ? 3 : AMBIGUOUS;
+            else if (base_code == 3 && rna)
+                base_code = AMBIGUOUS;
+            if (base_code == INVALID)
+                return false;
+            if (base_code == AMBIGUOUS)
+                append_run(ambiguities, i_base, 1, (char)tolower(symbol));
+            else
+                word |= (uint64_t)base_code << (2 * (i_base - word_start));
+            if (isalpha(symbol) && (isupper(symbol) != 0) != upper_case)
+                append_run(case_runs, i_base, 1, 0);
+        }
+        words[i_word] = word;
+        if (ambiguities.size() + case_runs.size() > max_runs)
+            return false;
+    }
+    return true;
+};
+
+void PackedNucleotides::decode(std::size_t start, std::size_t length, char* out) const
+{
+    const char (*bytes)[4] = tables().bytes[upper_case * 2 + rna];
+    size_t end = start + length;
+    size_t position = start;
+    char* i_out = out;
+
+    // Bases are decoded four at a time, from whole bytes of the packed words
+    while (position < end && (position % 4 || end - position < 4))
+    {
+        *i_out++ = bytes[(words[position / 32] >> (2 * (position % 32))) & 3][0];
+        ++position;
+    }
+    while (end - position >= 4)
+    {
+        memcpy(i_out, bytes[(words[position / 32] >> (2 * (position % 32))) & 0xFF], 4);
+        i_out += 4;
+        position += 4;
+    }
+    while (position < end)
+    {
+        *i_out++ = bytes[(words[position / 32] >> (2 * (position % 32))) & 3][0];
+        ++position;
+    }
+
+    // Patch in the ambiguity codes, then the letters in the other case
+    for (auto i_run = first_run_after(ambiguities, start); i_run != ambiguities.end() && i_run->start < end; ++i_run)
+    {
+        size_t run_start = max(i_run->start, start);
+        size_t run_end = min(i_run->start + i_run->length, end);
+        char symbol = upper_case ? (char)toupper(i_run->symbol) : i_run->symbol;
+        memset(out + (run_start - start), symbol, run_end - run_start);
+    }
+    for (auto i_run = first_run_after(case_runs, start); i_run != case_runs.end() && i_run->start < end; ++i_run)
+    {
+        size_t run_start = max(i_run->start, start);
+        size_t run_end = min(i_run->start + i_run->length, end);
+        for (size_t i_base = run_start; i_base < run_end; ++i_base)
+            out[i_base - start] ^= 0x20;  // Letters differ from their other case only in this bit
+    }
+};
+
+void PackedNucleotides::fill(std::size_t start, std::size_t length, uint64_t code)
+{
+    uint64_t pattern = code * LOW_BITS;
+    while (length)
+    {
+        size_t offset = start % 32;
+        size_t count = min<size_t>(32 - offset, length);
+        uint64_t mask = (count == 32 ? ~0ULL : ((1ULL << (2 * count)) - 1)) << (2 * offset);
+        uint64_t& word = words[start / 32];
+        word = (word & ~mask) | (pattern & mask);
+        start += count;
+        length -= count;
+    }
+};
+
+char PackedNucleotides::at(std::size_t position) const
+{
+    if (position >= n_bases)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Position " + to_string(position) + " is out of range");
+    char base;
+    decode(position, 1, &base);
+    return base;
+};
+
+std::string PackedNucleotides::str() const
+{
+    string elements(n_bases, '\0');
+    if (n_bases)
+        decode(0, n_bases, &elements[0]);
+    return elements;
+};
+
+void PackedNucleotides::write(std::ostream& out) const
+{
+    const size_t block_size = 1 << 16;
+    char block[block_size];
+    for (size_t position = 0; position < n_bases; position += block_size)
+    {
+        size_t length = min(block_size, n_bases - position);
+        decode(position, length, block);
+        out.write(block, length);
+    }
+};
+
+void PackedNucleotides::append(std::string& out) const
+{
+    size_t position = out.size();
+    out.resize(position + n_bases);
+    if (n_bases)
+        decode(0, n_bases, &out[position]);
+};
+
+PackedNucleotides PackedNucleotides::subsequence(std::size_t start, std::size_t length) const
+{
+    if (start > n_bases || length > n_bases - start)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Subsequence is out of range");
+    PackedNucleotides sub;
+    sub.n_bases = length;
+    sub.upper_case = upper_case;
+    sub.rna = rna;
+    sub.words.resize((length + 31) / 32);
+    if (length == 0)
+        return sub;
+
+    // Each word of the subsequence is spliced from at most two words of this sequence
+    size_t first_word = start / 32;
+    size_t shift = 2 * (start % 32);
+    for (size_t i_word = 0; i_word < sub.words.size(); ++i_word)
+    {
+        uint64_t word = words[first_word + i_word] >> shift;
+        if (shift && first_word + i_word + 1 < words.size())
+            word |= words[first_word + i_word + 1] << (64 - shift);
+        sub.words[i_word] = word;
+    }
+    if (length % 32)
+        sub.words.back() &= (1ULL << (2 * (length % 32))) - 1;
+
+    size_t end = start + length;
+    for (auto i_run = first_run_after(ambiguities, start); i_run != ambiguities.end() && i_run->start < end; ++i_run)
+    {
+        size_t run_start = max(i_run->start, start);
+        sub.ambiguities.push_back({ run_start - start, min(i_run->start + i_run->length, end) - run_start, i_run->symbol });
+    }
+    for (auto i_run = first_run_after(case_runs, start); i_run != case_runs.end() && i_run->start < end; ++i_run)
+    {
+        size_t run_start = max(i_run->start, start);
+        sub.case_runs.push_back({ run_start - start, min(i_run->start + i_run->length, end) - run_start, 0 });
+    }
+    return sub;
+};
+
+PackedNucleotides PackedNucleotides::reverseComplement() const
+{
+    const NucleotideTables& nucleotides = tables();
+    PackedNucleotides rc;
+    rc.n_bases = n_bases;
+    rc.upper_case = upper_case;
+    rc.rna = rna;
+    rc.words.resize(words.size());
+
+    // The codes are chosen so that a base's complement is its code with both bits flipped.  Flipping and reversing whole words leaves the padding at the start, so the bases are then shifted down into place
+    size_t n_words = words.size();
+    for (size_t i_word = 0; i_word < n_words; ++i_word)
+        rc.words[n_words - 1 - i_word] = reverse_bases(~words[i_word]);
+    size_t shift = 2 * (n_words * 32 - n_bases);
+    if (shift)
+    {
+        for (size_t i_word = 0; i_word < n_words; ++i_word)
+        {
+            rc.words[i_word] >>= shift;
+            if (i_word + 1 < n_words)
+                rc.words[i_word] |= rc.words[i_word + 1] << (64 - shift);
+        }
+    }
+
+    // Ambiguity codes were packed as a, so their flipped code is reset.  A t in RNA, or a u in DNA, complements to an ordinary a
+    for (auto i_run = ambiguities.rbegin(); i_run != ambiguities.rend(); ++i_run)
+    {
+        size_t start = n_bases - i_run->start - i_run->length;
+        rc.fill(start, i_run->length, 0);
+        char symbol = nucleotides.complement[(unsigned char)i_run->symbol];
+        if (symbol != 'a')
+            append_run(rc.ambiguities, start, i_run->length, symbol);
+    }
+    for (auto i_run = case_runs.rbegin(); i_run != case_runs.rend(); ++i_run)
+        rc.case_runs.push_back({ n_bases - i_run->start - i_run->length, i_run->length, 0 });
+    return rc;
+};
+
+std::size_t PackedNucleotides::countGC() const
+{
+    // With a, c, g and t coded 00, 01, 10 and 11, a base is g or c when its two bits differ
+    size_t n_gc = 0;
+    for (auto word : words)
+        n_gc += popcount((word ^ (word >> 1)) & LOW_BITS);
+    // Ambiguity codes are packed as a, which is not counted
+    for (auto &i_run : ambiguities)
+    {
+        if (i_run.symbol == 's')
+            n_gc += i_run.length;
+    }
+    return n_gc;
+};
+
+bool PackedNucleotides::operator==(const PackedNucleotides& other) const
+{
+    if (n_bases != other.n_bases)
+        return false;
+    if (upper_case == other.upper_case && rna == other.rna)
+        return words == other.words && ambiguities == other.ambiguities && case_runs == other.case_runs;
+
+    // Sequences packed in different forms are compared as text, a block at a time
+    const size_t block_size = 1 << 12;
+    char block[block_size];
+    char other_block[block_size];
+    for (size_t position = 0; position < n_bases; position += block_size)
+    {
+        size_t length = min(block_size, n_bases - position);
+        decode(position, length, block);
+        other.decode(position, length, other_block);
+        if (memcmp(block, other_block, length) != 0)
+            return false;
+    }
+    return true;
+};
+
+NucleotideSearch::NucleotideSearch(const std::vector<std::string>& patterns) :
+    transitions(4, -1)
+{
+    // Build a trie of the patterns and their reverse complements.  A palindrome is only added once, as found inline
+    const NucleotideTables& table = tables();
+    vector<vector<size_t>> state_outputs(1);
+    vector<int32_t> codes;
+    for (size_t i_pattern = 0; i_pattern < patterns.size(); ++i_pattern)
+    {
+        lengths.push_back(patterns[i_pattern].size());
+        codes.clear();
+        for (auto & symbol : patterns[i_pattern])
+        {
+            unsigned char code = table.code[(unsigned char)symbol];
+            if (code == U_CODE)
+                code = 3;
+            if (code > 3)
+                break;
+            codes.push_back(code);
+        }
+        if (codes.empty() || codes.size() != patterns[i_pattern].size())
+            continue;
+        vector<int32_t> complement_codes(codes.rbegin(), codes.rend());
+        for (auto & code : complement_codes)
+            code = 3 - code;
+        for (int reverse = 0; reverse < 2; ++reverse)
+        {
+            if (reverse && complement_codes == codes)
+                break;
+            int32_t state = 0;
+            for (auto & code : reverse ? complement_codes : codes)
+            {
+                if (transitions[4 * state + code] == -1)
+                {
+                    transitions[4 * state + code] = (int32_t)state_outputs.size();
+                    transitions.resize(transitions.size() + 4, -1);
+                    state_outputs.emplace_back();
+                }
+                state = transitions[4 * state + code];
+            }
+            state_outputs[state].push_back(2 * i_pattern + reverse);
+        }
+    }
+
+    // Complete the transitions breadth first, so each missing one follows the failure link of its state, which is already complete
+    size_t n_states = state_outputs.size();
+    vector<int32_t> failure_links(n_states, 0);
+    dictionary_links.assign(n_states, -1);
+    deque<int32_t> queue;
+    for (int32_t code = 0; code < 4; ++code)
+    {
+        if (transitions[code] == -1)
+            transitions[code] = 0;
+        else
+            queue.push_back(transitions[code]);
+    }
+    while (queue.size())
+    {
+        int32_t state = queue.front();
+        queue.pop_front();
+        for (int32_t code = 0; code < 4; ++code)
+        {
+            int32_t fallback = transitions[4 * failure_links[state] + code];
+            int32_t& next = transitions[4 * state + code];
+            if (next == -1)
+            {
+                next = fallback;
+                continue;
+            }
+            failure_links[next] = fallback;
+            dictionary_links[next] = state_outputs[fallback].empty() ? dictionary_links[fallback] : fallback;
+            queue.push_back(next);
+        }
+    }
+
+    output_offsets.push_back(0);
+    for (auto & state_output : state_outputs)
+    {
+        outputs.insert(outputs.end(), state_output.begin(), state_output.end());
+        output_offsets.push_back((int32_t)outputs.size());
+    }
+};
+
+void NucleotideSearch::report(int32_t state, std::size_t end, std::vector<Match>& matches) const
+{
+    for (; state != -1; state = dictionary_links[state])
+    {
+        for (int32_t i_output = output_offsets[state]; i_output < output_offsets[state + 1]; ++i_output)
+        {
+            size_t pattern = outputs[i_output] / 2;
+            matches.push_back({ pattern, end - lengths[pattern], (outputs[i_output] & 1) != 0 });
+        }
+    }
+};
+
+// Matches are reported as they end, so shorter patterns ending at the same base come out of order
+static void sort_matches(vector<NucleotideSearch::Match>& matches)
+{
+    sort(matches.begin(), matches.end(), [](const NucleotideSearch::Match& a, const NucleotideSearch::Match& b)
+    {
+        if (a.start != b.start)
+            return a.start < b.start;
+        if (a.pattern != b.pattern)
+            return a.pattern < b.pattern;
+        return a.reverse < b.reverse;
+    });
+};
+
+std::vector<NucleotideSearch::Match> NucleotideSearch::find(const std::string& elements) const
+{
+    const NucleotideTables& table = tables();
+    vector<Match> matches;
+    int32_t state = 0;
+    for (size_t position = 0; position < elements.size(); ++position)
+    {
+        unsigned char code = table.code[(unsigned char)elements[position]];
+        if (code == U_CODE)
+            code = 3;
+        if (code > 3)
+        {
+            state = 0;
+            continue;
+        }
+        state = transitions[4 * state + code];
+        if (output_offsets[state] != output_offsets[state + 1] || dictionary_links[state] != -1)
+            report(state, position + 1, matches);
+    }
+    sort_matches(matches);
+    return matches;
+};
+
+std::vector<NucleotideSearch::Match> NucleotideSearch::find(const PackedNucleotides& elements) const
+{
+    vector<Match> matches;
+    int32_t state = 0;
+    size_t position = 0;
+    auto i_run = elements.ambiguities.begin();
+    while (position < elements.n_bases)
+    {
+        // Bases between the ambiguity runs are read straight from the words
+        size_t segment_end = i_run == elements.ambiguities.end() ? elements.n_bases : i_run->start;
+        for (; position < segment_end; ++position)
+        {
+            int32_t code = (elements.words[position >> 5] >> (2 * (position & 31))) & 3;
+            state = transitions[4 * state + code];
+            if (output_offsets[state] != output_offsets[state + 1] || dictionary_links[state] != -1)
+                report(state, position + 1, matches);
+        }
+        if (i_run == elements.ambiguities.end())
+            break;
+
+        // A t in an RNA sequence, or a u in a DNA one, is kept as a run but still matches
+        bool base = i_run->symbol == 't' || i_run->symbol == 'u';
+        for (size_t run_end = i_run->start + i_run->length; position < run_end; ++position)
+        {
+            if (!base)
+            {
+                state = 0;
+                continue;
+            }
+            state = transitions[4 * state + 3];
+            if (output_offsets[state] != output_offsets[state + 1] || dictionary_links[state] != -1)
+                report(state, position + 1, matches);
+        }
+        ++i_run;
+    }
+    sort_matches(matches);
+    return matches;
+};
+
+// @return The elements of a Sequence with an IUPAC encoding, or NULL for any other object
+static PropertyValue* iupac_elements(SBOLObject& sbol_obj)
+{
+    if (sbol_obj.type.compare(SBOL_SEQUENCE) != 0)
+        return NULL;
+    auto i_encoding = sbol_obj.properties.find(SBOL_ENCODING);
+    if (i_encoding == sbol_obj.properties.end() || i_encoding->second.size() != 1 || i_encoding->second.front().text().compare(SBOL_ENCODING_IUPAC) != 0)
+        return NULL;
+    auto i_elements = sbol_obj.properties.find(SBOL_ELEMENTS);
+    if (i_elements == sbol_obj.properties.end() || i_elements->second.size() != 1)
+        return NULL;
+    return &i_elements->second.front();
+};
+
+void sbol::packSequenceElements(SBOLObject& sbol_obj)
+{
+    PropertyValue* elements = iupac_elements(sbol_obj);
+    if (elements)
+        elements->pack();
+};
+
+// Elements held as text are packed into a temporary copy, so the kernels do not need to be written twice
+static PackedNucleotides pack_elements(Sequence& seq, std::string method)
+{
+    if (seq.encoding.get().compare(SBOL_ENCODING_IUPAC) != 0)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Sequence::" + method + " requires IUPAC DNA or RNA encoding");
+    const PackedNucleotides* packed = seq.properties[SBOL_ELEMENTS].front().packed();
+    if (packed)
+        return *packed;
+    return PackedNucleotides(seq.elements.get());
+};
+
+int Sequence::length()
+{
+    const PackedNucleotides* packed = properties[SBOL_ELEMENTS].front().packed();
+    if (packed)
+        return (int)packed->size();
+    return (int)elements.get().size();
+};
+
+std::string Sequence::reverseComplement()
+{
+    const PackedNucleotides* packed = properties[SBOL_ELEMENTS].front().packed();
+    if (packed && encoding.get().compare(SBOL_ENCODING_IUPAC) == 0)
+        return packed->reverseComplement().str();
+    return pack_elements(*this, "reverseComplement").reverseComplement().str();
+};
+
+double Sequence::gcContent()
+{
+    const PackedNucleotides* packed = properties[SBOL_ELEMENTS].front().packed();
+    if (packed && encoding.get().compare(SBOL_ENCODING_IUPAC) == 0)
+        return packed->size() ? (double)packed->countGC() / packed->size() : 0.0;
+    PackedNucleotides elements_copy = pack_elements(*this, "gcContent");
+    return elements_copy.size() ? (double)elements_copy.countGC() / elements_copy.size() : 0.0;
+};
+
+std::string Sequence::subsequence(int start, int end)
+{
+    if (start < 1 || end < start - 1 || end > length())
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Subsequence " + to_string(start) + ".." + to_string(end) + " is out of range for Sequence " + identity.get());
+    const PackedNucleotides* packed = properties[SBOL_ELEMENTS].front().packed();
+    if (packed)
+        return packed->subsequence(start - 1, end - start + 1).str();
+    return elements.get().substr(start - 1, end - start + 1);
+};
+
+std::vector<SequenceMatch> Document::search(std::vector<ComponentDefinition*> features, unsigned int n_threads)
+{
+    // Each feature is searched for by every IUPAC Sequence it refers to. Packed elements are copied out rather than unpacked
+    vector<string> patterns;
+    vector<ComponentDefinition*> pattern_features;
+    for (auto & feature : features)
+    {
+        if (feature->doc == NULL)
+            throw SBOLError(SBOL_ERROR_MISSING_DOCUMENT, "ComponentDefinition " + feature->identity.get() + " cannot be searched for because it does not belong to a Document");
+        for (auto & seq_uri : feature->sequences.getAll())
+        {
+            SBOLObject* feature_seq = seq_uri.size() ? feature->doc->find(seq_uri) : NULL;
+            PropertyValue* feature_elements = feature_seq ? iupac_elements(*feature_seq) : NULL;
+            if (feature_elements == NULL)
+                continue;
+            patterns.push_back(feature_elements->str());
+            pattern_features.push_back(feature);
+        }
+    }
+    NucleotideSearch matcher(patterns);
+
+    // Find the elements before any threads start. The workers only read them
+    vector<Sequence*> targets;
+    vector<const PropertyValue*> target_elements;
+    for (auto & seq : sequences)
+    {
+        PropertyValue* elements = iupac_elements(seq);
+        if (elements == NULL)
+            continue;
+        targets.push_back(&seq);
+        target_elements.push_back(elements);
+    }
+    vector<vector<NucleotideSearch::Match>> target_matches(targets.size());
+    if (patterns.empty() || targets.empty())
+        return vector<SequenceMatch>();
+
+    if (n_threads == 0)
+        n_threads = max(1u, thread::hardware_concurrency());
+    n_threads = (unsigned int)min((size_t)n_threads, targets.size());
+
+    // Workers claim Sequences one at a time. The calling thread works alongside them
+    atomic<size_t> next_target(0);
+    exception_ptr error;
+    mutex error_mutex;
+    auto work = [&]()
+    {
+        for (size_t i_target = next_target++; i_target < targets.size(); i_target = next_target++)
+        {
+            try
+            {
+                const PackedNucleotides* packed = target_elements[i_target]->packed();
+                if (packed)
+                    target_matches[i_target] = matcher.find(*packed);
+                else
+                    target_matches[i_target] = matcher.find(target_elements[i_target]->text());
+            }
+            catch (...)
+            {
+                lock_guard<mutex> guard(error_mutex);
+                if (!error)
+                    error = current_exception();
+            }
+        }
+    };
+    vector<thread> workers;
+    for (unsigned int i_thread = 1; i_thread < n_threads; ++i_thread)
+        workers.push_back(thread(work));
+    work();
+    for (auto & worker : workers)
+        worker.join();
+    if (error)
+        rethrow_exception(error);
+
+    vector<SequenceMatch> matches;
+    for (size_t i_target = 0; i_target < targets.size(); ++i_target)
+    {
+        for (auto & match : target_matches[i_target])
+        {
+            int start = (int)match.start + 1;
+            int end = (int)(match.start + patterns[match.pattern].size());
+            matches.push_back({ targets[i_target], pattern_features[match.pattern], start, end, match.reverse ? SBOL_ORIENTATION_REVERSE_COMPLEMENT : SBOL_ORIENTATION_INLINE });
+        }
+    }
+    return matches;
+};
+
+// @return The roles of an object, sorted, so annotations can be compared by them
+static vector<string> sorted_roles(URIProperty& roles)
+{
+    vector<string> role_uris;
+    for (int i_role = 0; i_role < roles.size(); ++i_role)
+        role_uris.push_back(roles[i_role]);
+    sort(role_uris.begin(), role_uris.end());
+    return role_uris;
+};
+
+static string annotation_key(int start, int end, const string& orientation, const vector<string>& roles)
+{
+    string key = to_string(start) + " " + to_string(end) + " " + orientation;
+    for (auto & role : roles)
+        key += " " + role;
+    return key;
+};
+
+std::vector<SequenceAnnotation*> Document::annotate(std::vector<ComponentDefinition*> features, unsigned int n_threads)
+{
+    if (!Config::snapshot().compliant_uris)
+        throw SBOLError(SBOL_ERROR_COMPLIANCE, "Annotate methods require SBOL-compliance enabled");
+    vector<SequenceMatch> matches = search(features, n_threads);
+
+    unordered_map<Sequence*, vector<ComponentDefinition*>> users;  // The ComponentDefinitions that refer to each matching Sequence
+    unordered_map<ComponentDefinition*, unordered_set<string>> annotated;  // The single Ranges each ComponentDefinition is annotated with already
+    unordered_map<ComponentDefinition*, vector<string>> feature_roles;
+    unordered_map<string, int> instance_counts;  // The next number to try for each ComponentDefinition and feature
+    vector<SequenceAnnotation*> annotations;
+    for (auto & match : matches)
+    {
+        auto i_users = users.find(match.sequence);
+        if (i_users == users.end())
+        {
+            i_users = users.emplace(match.sequence, vector<ComponentDefinition*>()).first;
+            for (auto & referrer : getReferrers(match.sequence->identity.get(), SBOL_SEQUENCE_PROPERTY))
+            {
+                if (referrer->type.compare(SBOL_COMPONENT_DEFINITION) == 0)
+                    i_users->second.push_back((ComponentDefinition*)referrer);
+            }
+        }
+        auto i_roles = feature_roles.find(match.feature);
+        if (i_roles == feature_roles.end())
+            i_roles = feature_roles.emplace(match.feature, sorted_roles(match.feature->roles)).first;
+        string key = annotation_key(match.start, match.end, match.orientation, i_roles->second);
+
+        for (auto & cd : i_users->second)
+        {
+            if (cd == match.feature)
+                continue;
+            auto i_annotated = annotated.find(cd);
+            if (i_annotated == annotated.end())
+            {
+                i_annotated = annotated.emplace(cd, unordered_set<string>()).first;
+                for (auto & annotation : cd->sequenceAnnotations)
+                {
+                    if (annotation.owned_objects[SBOL_LOCATIONS].size() != 1 || annotation.owned_objects[SBOL_LOCATIONS].front()->type != SBOL_RANGE)
+                        continue;
+                    Range& r = *(Range*)annotation.owned_objects[SBOL_LOCATIONS].front();
+                    i_annotated->second.insert(annotation_key(r.start.get(), r.end.get(), r.orientation.get(), sorted_roles(annotation.roles)));
+                }
+            }
+            if (!i_annotated->second.insert(key).second)
+                continue;
+
+            // Number the annotations of each feature after the numbers the ComponentDefinition already uses
+            string stem = match.feature->displayId.get() + "_";
+            int& count = instance_counts[cd->identity.get() + " " + stem];
+            if (count == 0)
+                count = next_number(cd->sequenceAnnotations, stem, 1);
+            SequenceAnnotation& annotation = create_numbered(cd->sequenceAnnotations, stem, count);
+            Range& r = annotation.locations.create<Range>("range");
+            r.start.set(match.start);
+            r.end.set(match.end);
+            r.orientation.set(match.orientation);
+            for (auto & role : i_roles->second)
+                annotation.roles.add(role);
+            annotations.push_back(&annotation);
+        }
+    }
+    return annotations;
+};
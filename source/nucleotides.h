@@ -0,0 +1,144 @@
+/**
+ * @file    nucleotides.h
+ * @brief   PackedNucleotides class, a 2-bit representation of IUPAC DNA and RNA sequences
+ * @author  Bryan Bartley
+ * @email   bartleyba@sbolstandard.org
+ *
+ * <!--------------------------------------------------------------------------
+ * This file is part of libSBOL.  Please visit http://sbolstandard.org for more
+ * information about SBOL, and the latest version of libSBOL.
+ *
+ *  Copyright 2016 University of Washington, WA, USA
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ------------------------------------------------------------------------->*/
+
+#ifndef NUCLEOTIDES_INCLUDED
+#define NUCLEOTIDES_INCLUDED
+
+#include "config.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace sbol
+{
+    /// @cond
+    /// The elements of an IUPAC DNA or RNA Sequence, packed two bits per base.  The bases a, c, g and t (or u) are coded 0 to 3, thirty-two to a 64-bit word, so a genome takes a quarter of the memory it does as text.  Everything else is kept in two short lists of runs: ambiguity codes and gaps, whose packed code is 0, and bases written in the other case from the rest of the sequence.  The kernels work on whole words at a time, and only visit the runs to patch up the result.
+    /// Given its case and whether it is RNA, a sequence has exactly one packed form, so two such sequences are compared by their words and runs.
+    class SBOL_DECLSPEC PackedNucleotides
+    {
+    public:
+        /// Elements shorter than this are left as text, since packing saves little on them
+        static const std::size_t min_length = 1024;
+
+        /// Packs a sequence, regardless of its length
+        /// @param elements IUPAC nucleotide codes or gaps, in either case
+        /// @throw SBOL_ERROR_INVALID_ARGUMENT if the elements contain any other character
+        PackedNucleotides(const std::string& elements);
+
+        /// @return A packed copy of the elements, or NULL if they are too short, are not all nucleotide codes, or have so many ambiguity codes that packing would not save memory.  The caller owns the copy
+        static PackedNucleotides* pack(const std::string& elements);
+
+        std::size_t size() const { return n_bases; };
+        char at(std::size_t position) const;
+
+        /// @return The elements as text
+        std::string str() const;
+
+        /// Writes the elements as text, a block at a time
+        void write(std::ostream& out) const;
+
+        /// Appends the elements as text to the end of a string
+        void append(std::string& out) const;
+
+        /// @param start The 0-based position of the first base
+        /// @param length The number of bases
+        PackedNucleotides subsequence(std::size_t start, std::size_t length) const;
+
+        /// Complements each base, including ambiguity codes, and reverses their order
+        PackedNucleotides reverseComplement() const;
+
+        /// @return The number of bases that are g, c or s (strong), in either case
+        std::size_t countGC() const;
+
+        bool operator==(const PackedNucleotides& other) const;
+        bool operator!=(const PackedNucleotides& other) const { return !(*this == other); };
+
+        /// A stretch of bases that are packed as something other than what they are
+        struct Run
+        {
+            std::size_t start;
+            std::size_t length;
+            char symbol;  // Lower case symbol of an ambiguity run.  Case runs leave it 0
+
+            bool operator==(const Run& other) const
+            {
+                return start == other.start && length == other.length && symbol == other.symbol;
+            };
+        };
+
+    private:
+        friend class NucleotideSearch;
+
+        std::vector<uint64_t> words;  // Base i is at bits 2 * (i % 32) of word i / 32.  Bits past the last base are 0
+        std::size_t n_bases;
+        bool upper_case;  // The case of every letter outside the case runs.  Packing takes the case of the first letter
+        bool rna;         // Code 3 is u rather than t.  Packing sets it if a u comes before any t
+        std::vector<Run> ambiguities;
+        std::vector<Run> case_runs;
+
+        PackedNucleotides();
+        bool encode(const std::string& elements, std::size_t max_runs);
+        void decode(std::size_t start, std::size_t length, char* out) const;
+        void fill(std::size_t start, std::size_t length, uint64_t code);
+    };
+
+    /// Finds every occurrence of a set of patterns in a nucleotide sequence, on both strands, in a single pass.  The patterns and their reverse complements are compiled into an Aho-Corasick automaton over the four bases, so the time taken depends on the length of the sequence and the number of matches, but not on the number of patterns.
+    /// Matching ignores case, and a u matches a t.  Ambiguity codes and gaps in the sequence match nothing, and patterns that contain them are never found
+    class SBOL_DECLSPEC NucleotideSearch
+    {
+    public:
+        struct Match
+        {
+            std::size_t pattern;  // The index of the pattern
+            std::size_t start;    // The 0-based position of the first base of the match, on the forward strand
+            bool reverse;         // The reverse complement of the pattern was found
+        };
+
+        NucleotideSearch(const std::vector<std::string>& patterns);
+
+        /// @return The matches, ordered by position, then by pattern
+        std::vector<Match> find(const std::string& elements) const;
+        std::vector<Match> find(const PackedNucleotides& elements) const;
+
+    private:
+        std::vector<int32_t> transitions;       // Four per state, one for each base
+        std::vector<int32_t> dictionary_links;  // The longest proper suffix of each state that ends a pattern, or -1
+        std::vector<int32_t> output_offsets;    // The patterns ending at state i are outputs[output_offsets[i]] up to outputs[output_offsets[i + 1]]
+        std::vector<std::size_t> outputs;       // Twice the pattern index, plus 1 for a reverse complement
+        std::vector<std::size_t> lengths;
+
+        void report(int32_t state, std::size_t end, std::vector<Match>& matches) const;
+    };
+
+    class SBOLObject;
+
+    /// Packs the elements of a Sequence with an IUPAC encoding, if they are long enough to be worth it.  Documents call this as Sequences are added and edited
+    void packSequenceElements(SBOLObject& sbol_obj);
+    /// @endcond
+}
+
+#endif /* NUCLEOTIDES_INCLUDED */
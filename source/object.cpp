@@ -24,6 +24,8 @@
  * ------------------------------------------------------------------------->*/
 
 #include "object.h"
+#include "document.h"
+#include "nucleotides.h"
 #include <raptor2.h>
 #include <string>
 #include <vector>
@@ -67,7 +69,8 @@ bool sbol::operator !=(const SBOLObject &a, const SBOLObject &b)
 
 void SBOLObject::close()
 {
-    delete this;
+    if (!owning_arena)
+        delete this;
 };
 
 sbol_type SBOLObject::getTypeURI() 
@@ -116,11 +119,12 @@ int SBOLObject::compare(SBOLObject* comparand)
     
     std::string l_id;
     std::string r_id;
-    std::map < std::string, std::vector<std::string> >::iterator i_lp;  // iterator for left-hand side
-    std::map < std::string, std::vector<std::string> >::iterator i_rp;  // iterator for right-hand side
-    std::map < std::string, std::vector<std::string> >::iterator i_end;  // stop iteration
+    PropertyStore < std::vector<PropertyValue> >::iterator i_lp;  // iterator for left-hand side
+    PropertyStore < std::vector<PropertyValue> >::iterator i_rp;  // iterator for right-hand side
+    PropertyStore < std::vector<PropertyValue> >::iterator i_end;  // stop iteration
+    PropertyStore < std::vector<PropertyValue> >::iterator i_rend;
 
-    // The longer property store is assigned to left-hand side for side-by-side comparison. Property keys are assumed alphabetically sorted since they are based on std::map
+    // The longer property store is assigned to left-hand side for side-by-side comparison. Objects of the same type share a slot layout, so their property keys are visited in the same order
     if (properties.size() >= comparand->properties.size())
     {
         l_id = identity.get();
@@ -128,6 +132,7 @@ int SBOLObject::compare(SBOLObject* comparand)
         i_lp = properties.begin();
         i_rp = comparand->properties.begin();
         i_end = properties.end();
+        i_rend = comparand->properties.end();
     }
     else
     {
@@ -136,16 +141,16 @@ int SBOLObject::compare(SBOLObject* comparand)
         i_lp = comparand->properties.begin();
         i_rp = properties.begin();
         i_end = comparand->properties.end();
+        i_rend = properties.end();
 
     }
     while (i_lp != i_end )
     {
-        std::string l_key = i_lp->first;
-        std::string r_key = i_rp->first;
+        const std::string& l_key = i_lp->first;
         // In case one object has a property (ie, extension annotation) that another object does not
-        if(l_key.compare(r_key) != 0)
+        if (i_rp == i_rend || l_key.compare(i_rp->first) != 0)
         {
-            cout << r_id << "::" << parsePropertyName(r_key) << " not found in " << l_id << endl;
+            cout << l_id << "::" << parsePropertyName(l_key) << " not found in " << r_id << endl;
             ++i_lp;
             IS_EQUAL = 0;
         }
@@ -153,13 +158,13 @@ int SBOLObject::compare(SBOLObject* comparand)
         else
         {
             // Copy and sort the property store, so we can compare them side by side
-            std::vector < std::string > l_store(i_lp->second);
-            std::vector < std::string > r_store(i_rp->second);
+            std::vector < PropertyValue > l_store(i_lp->second);
+            std::vector < PropertyValue > r_store(i_rp->second);
             std::sort(l_store.begin(), l_store.end());
             std::sort(r_store.begin(), r_store.end());
             if (!std::equal(l_store.begin(), l_store.end(), r_store.begin()))
             {
-                cout << "Values " << " in " << l_id << "::" << parsePropertyName(l_key) << " not equal to values in " << r_id << "::" << parsePropertyName(r_key) << endl;
+                cout << "Values " << " in " << l_id << "::" << parsePropertyName(l_key) << " not equal to values in " << r_id << "::" << parsePropertyName(l_key) << endl;
                 IS_EQUAL = 0;
             }
             ++i_lp;
@@ -255,14 +260,59 @@ SBOLObject* SBOLObject::find(string uri)
         vector<SBOLObject*>& store = i_store->second;
         for (auto i_obj = store.begin(); i_obj != store.end(); ++i_obj)
         {
-            SBOLObject& obj = **i_obj;
-            if (obj.find(uri))
-                return obj.find(uri);
+            SBOLObject* match = (*i_obj)->find(uri);
+            if (match)
+                return match;
         }
     }
     return NULL;
 };
 
+void SBOLObject::reindex(const sbol_type& property_uri, const std::string& old_value, const std::string& new_value)
+{
+    if (!doc)
+        return;
+    if (property_uri.compare(SBOL_ELEMENTS) == 0)
+    {
+        // Editing a Sequence leaves the Document's structure as it is, but not the sequences assembled from it
+        doc->invalidateAssembly(*this);
+        packSequenceElements(*this);
+        return;
+    }
+    ++doc->revision;
+    if (property_uri.compare(SBOL_IDENTITY) == 0)
+    {
+        // Only objects that are already indexed are moved, so a copy that still carries its original's identity does not displace the original
+        auto i_entry = doc->identity_index.find(old_value);
+        if (i_entry == doc->identity_index.end() || i_entry->second != this)
+            return;
+        doc->identity_index.erase(i_entry);
+        doc->identity_index[new_value] = this;
+        return;
+    }
+    // Likewise, versions and references are only tracked for objects the Document has indexed. Others are picked up when they are added
+    auto i_entry = doc->identity_index.find(identity.get());
+    if (i_entry == doc->identity_index.end() || i_entry->second != this)
+        return;
+    if (property_uri.compare(SBOL_PERSISTENT_IDENTITY) == 0)
+    {
+        doc->unindexVersion(*this, old_value);
+        doc->indexVersion(*this);
+        return;
+    }
+    if (property_uri.compare(SBOL_VERSION) == 0)
+    {
+        doc->unindexVersion(*this, properties[SBOL_PERSISTENT_IDENTITY].front().str());
+        doc->indexVersion(*this);
+        return;
+    }
+    // Integer properties, such as the coordinates of a Location, pass no values and only move the revision on
+    if (old_value.size())
+        doc->unindexReference(*this, property_uri, old_value);
+    if (new_value.size())
+        doc->indexReference(*this, property_uri, new_value);
+};
+
 SBOLObject* SBOLObject::find_property(string uri)
 {
     if (owned_objects.find(uri) != owned_objects.end())
@@ -289,16 +339,21 @@ vector<SBOLObject*> SBOLObject::find_reference(string uri)
         for (auto i_obj = store.begin(); i_obj != store.end(); ++i_obj)
         {
             SBOLObject& obj = **i_obj;
-            matches = obj.find_reference(uri);
+            vector<SBOLObject*> submatches = obj.find_reference(uri);
+            matches.insert(matches.end(), submatches.begin(), submatches.end());
         }
     }
     for (auto &i_p : properties)
     {
-        string val = i_p.second.front();
-        if (val.compare("<" + uri + ">") == 0)
+        if (i_p.first.compare(SBOL_IDENTITY) == 0 || i_p.first.compare(SBOL_PERSISTENT_IDENTITY) == 0)
+            continue;  // An object's own identity is not a reference
+        for (auto &i_val : i_p.second)
         {
-            matches.push_back(this);
-            break;
+            if (i_val.isURI() && i_val.text().compare(uri) == 0)
+            {
+                matches.push_back(this);
+                return matches;
+            }
         }
     }
     return matches;
@@ -321,9 +376,7 @@ std::string SBOLObject::getPropertyValue(std::string property_uri)
 {
     if (properties.find(property_uri) != properties.end())
     {
-        std::string property_value = properties[property_uri][0];
-        property_value = property_value.substr(1, property_value.length() - 2);
-        return property_value;
+        return properties[property_uri][0].str();
     }
     else throw SBOLError(SBOL_ERROR_NOT_FOUND, property_uri + " not contained in this object.");
 };
@@ -334,12 +387,14 @@ void SBOLObject::setPropertyValue(std::string property_uri, std::string val)
         if (val[0] == '<' && val[val.length() - 1] == '>')
         {
             // Check if new value is a URI...
-            properties[property_uri].push_back(val);
+            properties[property_uri].push_back(PropertyValue(PropertyValue::URI, val.substr(1, val.length() - 2)));
+            if (doc)
+                reindex(property_uri, "", val.substr(1, val.length() - 2));
         }
         else
         {
             // ...else treat the value as a literal
-            properties[property_uri].push_back("\"" + val + "\"");
+            properties[property_uri].push_back(PropertyValue(PropertyValue::LITERAL, val));
         }
 };
 
@@ -347,12 +402,9 @@ std::vector < std::string > SBOLObject::getPropertyValues(std::string property_u
 {
     if (properties.find(property_uri) != properties.end())
     {
-        std::vector < std::string > property_values = properties[property_uri];
-        for (auto i_val = 0; i_val < property_values.size(); ++i_val)
-        {
-            std::string val = property_values[i_val];
-            property_values[i_val] = val.substr(1, val.length() - 2);
-        }
+        std::vector < std::string > property_values;
+        for (auto &i_val : properties[property_uri])
+            property_values.push_back(i_val.str());
         return property_values;
     }
     else throw SBOLError(SBOL_ERROR_NOT_FOUND, property_uri + " not contained in this object.");
@@ -367,6 +419,7 @@ std::vector < std::string > SBOLObject::getProperties()
         string uri = i_p->first;
         property_uris.push_back(uri);
     }
+    sort(property_uris.begin(), property_uris.end());
     return property_uris;
 };
 
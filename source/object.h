@@ -28,6 +28,7 @@
 
 #include "validation.h"
 #include "properties.h"
+#include "propertystore.h"
 
 #include <raptor2.h>
 #include <string>
@@ -46,6 +47,7 @@ namespace sbol
     
     /* All SBOLObjects have a pointer back to their Document.  This requires forward declaration of SBOL Document class here */
     class Document;
+    class ObjectArena;
     
     /// An SBOLObject converts a C++ class data structure into an RDF triple store and contains methods for serializing and parsing RDF triples
     class SBOL_DECLSPEC SBOLObject
@@ -54,6 +56,7 @@ namespace sbol
         
         template < class LiteralType >
         friend class Property;
+        friend class VariantGenerator;  // Streams variants with the namespaces of their derivation's Document
 
     protected:
         std::unordered_map<std::string, std::string> namespaces;
@@ -77,13 +80,14 @@ namespace sbol
         /// @cond
         Document *doc = NULL;
         sbol_type type;
-        SBOLObject* parent;
+        SBOLObject* parent = NULL;
         void * proxy;
         
-        std::map<sbol::sbol_type, std::vector< std::string > > properties;
+        PropertyStore< std::vector< sbol::PropertyValue > > properties;
         std::map<sbol::sbol_type, std::vector< std::string > > list_properties;
-        std::map<sbol::sbol_type, std::vector< sbol::SBOLObject* > > owned_objects;
+        PropertyStore< std::vector< sbol::SBOLObject* > > owned_objects;
         std::map<sbol::sbol_type, std::vector< void* > > extension_objects;
+        ObjectArena* owning_arena = NULL;  ///< Set for objects allocated from a Document's ObjectArena, which are destroyed with the arena rather than by close()
         /// @endcond
         
         /// The identity property is REQUIRED by all Identified objects and has a data type of URI. A given Identified object’s identity URI MUST be globally unique among all other identity URIs. The identity of a compliant SBOL object MUST begin with a URI prefix that maps to a domain over which the user has control. Namely, the user can guarantee uniqueness of identities within this domain.  For other best practices regarding URIs see Section 11.2 of the [SBOL specification doucment](http://sbolstandard.org/wp-content/uploads/2015/08/SBOLv2.0.1.pdf).
@@ -113,7 +117,15 @@ namespace sbol
         /// @return A pointer to the object that contains a member property with the specified RDF type, NULL otherwise
         SBOLObject* find_property(std::string uri);
         
+        /// Search this object recursively for objects that refer to the given URI through one of their properties. Document::getReferrers answers the same query from an index
+        /// @param uri The URI to search for
+        /// @return Pointers to the referring objects
         std::vector<SBOLObject*> find_reference(std::string uri);
+
+        /// @cond
+        /// Keeps the parent Document's identity and reference indices current after a uri-valued property changes, its assembled sequences current after a Sequence's elements change, and its revision current after an integer property changes. An empty value stands for no value
+        void reindex(const sbol_type& property_uri, const std::string& old_value, const std::string& new_value);
+        /// @endcond
         
         /// Compare two SBOL objects or Documents. The behavior is currently undefined for objects with custom annotations or extension classes.
         /// @param comparand A pointer to the object being compared to this one.
@@ -148,7 +160,7 @@ namespace sbol
         std::string getAnnotation(std::string property_uri);
         
         
-        /// Use this method to destroy an SBOL object that is not contained by a parent Document.  If the object does have a parent Document, instead use doc.close() with the object's URI identity as an argument.
+        /// Use this method to destroy an SBOL object that is not contained by a parent Document.  If the object does have a parent Document, instead use doc.close() with the object's URI identity as an argument. Objects that a Document read into its arena are not destroyed until the arena is released, see Document::toggleArenaAllocation.
         /// @TODO Recurse through child objects and delete them.
         void close();
         
@@ -160,6 +172,8 @@ namespace sbol
         // Open-world constructor
         SBOLObject(sbol_type type, std::string uri) :
             type(type),
+            properties(type),
+            owned_objects(type),
             namespaces({}),
             identity(SBOL_IDENTITY, this, uri, { sbol_rule_10202 })
         {
@@ -170,6 +184,8 @@ namespace sbol
         // Conforms to SBOL compliant URIs
         SBOLObject(sbol_type type, std::string uri_prefix, std::string display_id, std::string version) :
             type(type),
+            properties(type),
+            owned_objects(type),
             namespaces({}),
             identity(SBOL_IDENTITY, this, uri_prefix + "/" + getClassName(type) + "/" + display_id + "/" + version)
         {
@@ -205,23 +221,23 @@ namespace sbol
 
         
         /// Provides iterator functionality for SBOL properties that contain multiple references
-        class iterator : public std::vector<std::string>::iterator
+        class iterator : public std::vector<PropertyValue>::iterator
         {
         public:
-            iterator( std::vector<std::string>::iterator i_str = std::vector<std::string>::iterator()) : std::vector<std::string>::iterator(i_str)
+            iterator( std::vector<PropertyValue>::iterator i_val = std::vector<PropertyValue>::iterator()) : std::vector<PropertyValue>::iterator(i_val)
             {
             }
         };
         
         iterator begin()
         {
-            std::vector<std::string> *object_store = &this->sbol_owner->properties[this->type];
+            std::vector<PropertyValue> *object_store = &this->sbol_owner->properties.access(this->slot, this->type);
             return iterator(object_store->begin());
         };
         
         iterator end()
         {
-            std::vector<std::string> *object_store = &this->sbol_owner->properties[this->type];
+            std::vector<PropertyValue> *object_store = &this->sbol_owner->properties.access(this->slot, this->type);
             return iterator(object_store->end());
         };
         
@@ -231,7 +247,7 @@ namespace sbol
             return (int)size;
         };
         
-        std::vector<std::string>::iterator python_iter;
+        std::vector<PropertyValue>::iterator python_iter;
         
 #if defined(SBOL_BUILD_PYTHON2) || defined(SBOL_BUILD_PYTHON3)
         std::string __getitem__(const int nIndex)
@@ -251,7 +267,7 @@ namespace sbol
                 throw SBOLError(END_OF_LIST, "");
             if (this->python_iter != this->end())
             {
-                std::string ref = *this->python_iter;
+                std::string ref = this->python_iter->str();
                 this->python_iter++;
                 if (this->python_iter == this->end())
                 {
@@ -269,7 +285,7 @@ namespace sbol
                 throw SBOLError(END_OF_LIST, "");
             if (this->python_iter != this->end())
             {
-                std::string ref = *this->python_iter;
+                std::string ref = this->python_iter->str();
                 this->python_iter++;
                 if (this->python_iter == this->end())
                 {
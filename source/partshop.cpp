@@ -1,5 +1,16 @@
 #include "partshop.h"
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+#include <zlib.h>
 
 using namespace std;
 using namespace sbol;
@@ -40,6 +51,402 @@ void encode_http(string& text)
     replace(text, "/", UTF8_SLASH);
 };
 
+ConnectionPool::ConnectionPool()
+{
+    /* In windows, this will init the winsock stuff. libcurl is left initialized until the process exits */
+    static CURLcode initialized = curl_global_init(CURL_GLOBAL_ALL);
+    if (initialized != CURLE_OK)
+        throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Failed to initialize libcurl: " + string(curl_easy_strerror(initialized)));
+
+    share = curl_share_init();
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, ConnectionPool::lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, ConnectionPool::unlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+};
+
+ConnectionPool::~ConnectionPool()
+{
+    // Handles must let go of the share before it is freed
+    for (auto & curl : idle)
+        curl_easy_cleanup(curl);
+    curl_share_cleanup(share);
+};
+
+void ConnectionPool::configure(CURL* curl)
+{
+    curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+#if LIBCURL_VERSION_NUM >= 0x072f00
+    // HTTP/2 over TLS where the server offers it, so requests in flight together can share one connection
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072b00
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+#endif
+};
+
+CURL* ConnectionPool::acquire()
+{
+    {
+        lock_guard<mutex> guard(pool_mutex);
+        if (idle.size())
+        {
+            CURL* curl = idle.back();
+            idle.pop_back();
+            return curl;
+        }
+    }
+    CURL* curl = curl_easy_init();
+    if (curl)
+        configure(curl);
+    return curl;
+};
+
+void ConnectionPool::release(CURL* curl)
+{
+    if (curl == NULL)
+        return;
+
+    // Resetting clears the options of the last request, but not its connection or caches
+    curl_easy_reset(curl);
+    configure(curl);
+    lock_guard<mutex> guard(pool_mutex);
+    if (idle.size() < max_idle)
+        idle.push_back(curl);
+    else
+        curl_easy_cleanup(curl);
+};
+
+void ConnectionPool::lock(CURL*, curl_lock_data data, curl_lock_access, void* user_data)
+{
+    ConnectionPool* pool = (ConnectionPool*)user_data;
+    pool->share_mutexes[data].lock();
+};
+
+void ConnectionPool::unlock(CURL*, curl_lock_data data, void* user_data)
+{
+    ConnectionPool* pool = (ConnectionPool*)user_data;
+    pool->share_mutexes[data].unlock();
+};
+
+static const string CACHE_BUNDLE_HEADER = "libSBOL response bundle 1";
+
+static long long seconds_now()
+{
+    return chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+};
+
+// An entry is its URL, validators and time on separate lines, then the length of the body and the body itself, so bodies may hold any bytes
+static void write_entry(ostream& out, const ResponseCache::Entry& entry)
+{
+    out << entry.url << "\n" << entry.etag << "\n" << entry.last_modified << "\n" << entry.fetched << "\n" << entry.body.size() << "\n";
+    out.write(entry.body.data(), entry.body.size());
+};
+
+static bool read_entry(istream& in, ResponseCache::Entry& entry)
+{
+    string fetched;
+    string length;
+    if (!getline(in, entry.url) || !getline(in, entry.etag) || !getline(in, entry.last_modified) || !getline(in, fetched) || !getline(in, length))
+        return false;
+    try
+    {
+        entry.fetched = stoll(fetched);
+        entry.body.resize(stoull(length));
+    }
+    catch (...)
+    {
+        return false;
+    }
+    in.read(&entry.body[0], entry.body.size());
+    return (size_t)in.gcount() == entry.body.size();
+};
+
+ResponseCache::ResponseCache(std::string directory, long long ttl) :
+    directory(directory),
+    ttl(ttl),
+    offline(false)
+{
+    // The index lists the URLs in the cache, for writing bundles
+    ofstream index(directory + "/index", ios::app);
+    if (!index)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Cannot write to the cache directory " + directory);
+};
+
+std::string ResponseCache::path(const std::string& url) const
+{
+    // Entries are named by a 64-bit FNV-1a hash of the URL. The URL is kept in the entry too, in case two of them collide
+    uint64_t hash = 14695981039346656037ULL;
+    for (auto & c : url)
+        hash = (hash ^ (unsigned char)c) * 1099511628211ULL;
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+    return directory + "/" + name + ".response";
+};
+
+bool ResponseCache::find(const std::string& url, Entry& entry)
+{
+    ifstream in(path(url), ios::binary);
+    bool on_disk = in && read_entry(in, entry) && entry.url == url;
+    if (on_disk && isFresh(entry))
+        return true;
+    {
+        lock_guard<mutex> guard(bundle_mutex);
+        auto i_bundled = bundled.find(url);
+        if (i_bundled != bundled.end())
+        {
+            entry = i_bundled->second;
+            return true;
+        }
+    }
+    return on_disk;
+};
+
+bool ResponseCache::isFresh(const Entry& entry) const
+{
+    // Times are in whole seconds, so a ttl of 0 revalidates even a response fetched this second
+    return seconds_now() - entry.fetched < ttl;
+};
+
+void ResponseCache::store(Entry& entry)
+{
+    // Write to a file of its own first, then rename it over the entry, so readers in other processes see the old entry or the new one
+    string entry_path = path(entry.url);
+    string temporary_path = entry_path + "." + to_string(hash<thread::id>()(this_thread::get_id())) + "." + to_string(chrono::steady_clock::now().time_since_epoch().count());
+    bool is_new = !ifstream(entry_path);
+    {
+        ofstream out(temporary_path, ios::binary);
+        write_entry(out, entry);
+        if (!out)
+        {
+            out.close();
+            remove(temporary_path.c_str());
+            return;  // The cache is only an optimization, so a full disk does not fail the request
+        }
+    }
+    if (rename(temporary_path.c_str(), entry_path.c_str()) != 0)
+    {
+        remove(entry_path.c_str());
+        if (rename(temporary_path.c_str(), entry_path.c_str()) != 0)
+        {
+            remove(temporary_path.c_str());
+            return;
+        }
+    }
+    if (is_new)
+        ofstream(directory + "/index", ios::app) << entry.url << "\n";
+};
+
+void ResponseCache::addBundle(std::string filename)
+{
+    ifstream in(filename, ios::binary);
+    string header;
+    if (!in || !getline(in, header) || header != CACHE_BUNDLE_HEADER)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, filename + " is not a bundle of cached responses");
+    lock_guard<mutex> guard(bundle_mutex);
+    Entry entry;
+    while (read_entry(in, entry))
+    {
+        entry.fetched = numeric_limits<long long>::max();
+        bundled[entry.url] = entry;
+    }
+};
+
+void ResponseCache::writeBundle(std::string filename)
+{
+    ofstream out(filename, ios::binary);
+    if (!out)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Cannot write the bundle " + filename);
+    out << CACHE_BUNDLE_HEADER << "\n";
+    unordered_set<string> written;
+    ifstream index(directory + "/index");
+    string url;
+    while (getline(index, url))
+    {
+        Entry entry;
+        ifstream in(path(url), ios::binary);
+        if (written.count(url) || !in || !read_entry(in, entry) || entry.url != url)
+            continue;
+        write_entry(out, entry);
+        written.insert(url);
+    }
+    lock_guard<mutex> guard(bundle_mutex);
+    for (auto & i_bundled : bundled)
+    {
+        if (!written.count(i_bundled.first))
+            write_entry(out, i_bundled.second);
+    }
+    if (!out)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Cannot write the bundle " + filename);
+};
+
+// Keeps the validators from the headers of a response, so it can be revalidated once it goes stale
+static size_t read_validators(char* buffer, size_t size, size_t n_items, void* user_data)
+{
+    ResponseCache::Entry& entry = *(ResponseCache::Entry*)user_data;
+    string header(buffer, size * n_items);
+    size_t colon = header.find(':');
+    if (header.compare(0, 5, "HTTP/") == 0)
+    {
+        // A new response begins, for example after a redirect
+        entry.etag.clear();
+        entry.last_modified.clear();
+    }
+    else if (colon != string::npos)
+    {
+        string name = header.substr(0, colon);
+        transform(name.begin(), name.end(), name.begin(), ::tolower);
+        size_t value_start = header.find_first_not_of(" \t", colon + 1);
+        size_t value_end = header.find_last_not_of(" \t\r\n");
+        string value = value_start == string::npos || value_end < value_start ? "" : header.substr(value_start, value_end - value_start + 1);
+        if (name == "etag")
+            entry.etag = value;
+        else if (name == "last-modified")
+            entry.last_modified = value;
+    }
+    return size * n_items;
+};
+
+// @return The request headers plus the conditions that let the server answer 304 Not Modified if a cached response is still current. The caller frees the list
+static struct curl_slist* conditional_headers(struct curl_slist* headers, const ResponseCache::Entry* cached)
+{
+    struct curl_slist* request_headers = NULL;
+    for (struct curl_slist* header = headers; header; header = header->next)
+        request_headers = curl_slist_append(request_headers, header->data);
+    if (cached && cached->etag.size())
+        request_headers = curl_slist_append(request_headers, ("If-None-Match: " + cached->etag).c_str());
+    if (cached && cached->last_modified.size())
+        request_headers = curl_slist_append(request_headers, ("If-Modified-Since: " + cached->last_modified).c_str());
+    return request_headers;
+};
+
+// Caches a completed response, or refreshes the cached one if the server found it current
+// @return The body of the response
+static string& complete_response(ResponseCache& cache, CURL* curl, ResponseCache::Entry& received, ResponseCache::Entry* cached)
+{
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    if (status == 304 && cached)
+    {
+        cached->fetched = seconds_now();
+        cache.store(*cached);
+        return cached->body;
+    }
+    if (status == 200)
+    {
+        received.fetched = seconds_now();
+        cache.store(received);
+    }
+    return received.body;
+};
+
+CURLcode PartShop::perform(CURL* curl, const std::string& url, struct curl_slist* headers, std::string& response)
+{
+    if (!cache)
+    {
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+        return curl_easy_perform(curl);
+    }
+
+    ResponseCache::Entry cached;
+    bool is_cached = cache->find(url, cached);
+    if (is_cached && (cache->offline || cache->isFresh(cached)))
+    {
+        response = cached.body;
+        return CURLE_OK;
+    }
+    if (cache->offline)
+        throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Cannot retrieve " + url + " because it is not cached and the PartShop is offline");
+
+    ResponseCache::Entry received = { url, "", "", 0, "" };
+    struct curl_slist* request_headers = conditional_headers(headers, is_cached ? &cached : NULL);
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request_headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &received.body);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, read_validators);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &received);
+    CURLcode res = curl_easy_perform(curl);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+    curl_slist_free_all(request_headers);
+    if (res == CURLE_OK)
+        response = complete_response(*cache, curl, received, is_cached ? &cached : NULL);
+    return res;
+};
+
+void PartShop::setCache(std::string directory, int ttl)
+{
+    bool offline = cache && cache->offline;
+    cache = make_shared<ResponseCache>(directory, ttl);
+    cache->offline = offline;
+};
+
+void PartShop::setOffline(bool offline)
+{
+    if (!cache)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Set a cache with setCache before working offline");
+    cache->offline = offline;
+};
+
+void PartShop::addCacheBundle(std::string filename)
+{
+    if (!cache)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Set a cache with setCache before adding a bundle");
+    cache->addBundle(filename);
+};
+
+void PartShop::writeCacheBundle(std::string filename)
+{
+    if (!cache)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Set a cache with setCache before writing a bundle");
+    cache->writeBundle(filename);
+};
+
+// The search criteria of an advanced search, ready to be followed by the offset and limit of a page
+static string advanced_search_criteria(SearchQuery& q)
+{
+    string parameters;
+    // Specify the type of SBOL object to search for
+    if (q["objectType"].size() == 1)
+        parameters = "objectType=" + parseClassName(q["objectType"].get()) + "&";
+    else
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "SearchQuery is invalid because it does not have an objectType specified");
+    
+    // Get the search criteria, while ignoring special search parameters like objectType, offset, and limit
+    vector<string> search_criteria = q.getProperties();
+    auto i_ignore = std::find(std::begin(search_criteria), std::end(search_criteria), SBOL_IDENTITY);
+    search_criteria.erase(i_ignore);
+    i_ignore = std::find(std::begin(search_criteria), std::end(search_criteria), SBOL_URI "#objectType");
+    search_criteria.erase(i_ignore);
+    i_ignore = std::find(std::begin(search_criteria), std::end(search_criteria), SBOL_URI "#offset");
+    search_criteria.erase(i_ignore);
+    i_ignore = std::find(std::begin(search_criteria), std::end(search_criteria), SBOL_URI "#limit");
+    search_criteria.erase(i_ignore);
+    
+    // Form GET request from the search criteria
+    for (auto & property_uri : search_criteria)
+        for (auto & property_val : q.getPropertyValues(property_uri))
+        {
+            if (property_val.length() > 0)
+            {
+                parameters += "<" + property_uri + ">=";
+                if (property_val.find("http") == 0)
+                    parameters += "<" + property_val + ">&"; // encode property value as a URI
+                else
+                    parameters += "'" + property_val + "'&"; // encode property value as a literal
+            }
+        }
+    return parameters;
+};
+
 // Advanced search
 SearchResponse& sbol::PartShop::search(SearchQuery& q)
 {
@@ -47,54 +454,20 @@ SearchResponse& sbol::PartShop::search(SearchQuery& q)
     
     /* Perform HTTP request */
     string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     //    headers = curl_slist_append(headers, "Accept: application/json");
     headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
     //    headers = curl_slist_append(headers, "charsets: utf-8");
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* get a curl handle, which goes back to the pool at the end of the request */
+    PooledHandle curl(*connections);
     
     /* Specify the GET parameters */
     if(curl)
     {
-        string parameters;
-        // Specify the type of SBOL object to search for
-        if (q["objectType"].size() == 1)
-            parameters = "objectType=" + parseClassName(q["objectType"].get()) + "&";
-        else
-            throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "SearchQuery is invalid because it does not have an objectType specified");
-        
-        // Get the search criteria, while ignoring special search parameters like objectType, offset, and limit
-        vector<string> search_criteria = q.getProperties();
-        auto i_ignore = std::find(std::begin(search_criteria), std::end(search_criteria), SBOL_IDENTITY);
-        search_criteria.erase(i_ignore);
-        i_ignore = std::find(std::begin(search_criteria), std::end(search_criteria), SBOL_URI "#objectType");
-        search_criteria.erase(i_ignore);
-        i_ignore = std::find(std::begin(search_criteria), std::end(search_criteria), SBOL_URI "#offset");
-        search_criteria.erase(i_ignore);
-        i_ignore = std::find(std::begin(search_criteria), std::end(search_criteria), SBOL_URI "#limit");
-        search_criteria.erase(i_ignore);
-        
-        // Form GET request from the search criteria
-        for (auto & property_uri : search_criteria)
-            for (auto & property_val : q.getPropertyValues(property_uri))
-            {
-                if (property_val.length() > 0)
-                {
-                    parameters += "<" + property_uri + ">=";
-                    if (property_val.find("http") == 0)
-                        parameters += "<" + property_val + ">&"; // encode property value as a URI
-                    else
-                        parameters += "'" + property_val + "'&"; // encode property value as a literal
-                }
-            }
+        string parameters = advanced_search_criteria(q);
         
         // Specify index of the first record to retrieve
         if (q["offset"].size() == 1)
@@ -111,26 +484,13 @@ SearchResponse& sbol::PartShop::search(SearchQuery& q)
         encode_http(parameters);
         parameters = url + "/remoteSearch/" + parameters;
         
-        /* First set the URL that is about to receive our GET. */
-        //curl_easy_setopt(curl, CURLOPT_URL, Config::getOption("validator_url").c_str());
-        curl_easy_setopt(curl, CURLOPT_URL, parameters.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        
-        /* Now specify the callback to read the response into string */
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        
-        /* Perform the request, res will get the return code */
-        res = curl_easy_perform(curl);
+        /* Perform the request, res will get the return code. A cached response is used instead if it is still fresh */
+        res = perform(curl, parameters, headers, response);
         /* Check for errors */
         if(res != CURLE_OK)
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to validate online failed with " + string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
     
     SearchResponse& search_response = * new SearchResponse();
     Json::Value json_response;
@@ -162,19 +522,15 @@ SearchResponse& sbol::PartShop::search(std::string search_text, sbol_type object
     
     /* Perform HTTP request */
     string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     //    headers = curl_slist_append(headers, "Accept: application/json");
     headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
     //    headers = curl_slist_append(headers, "charsets: utf-8");
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* get a curl handle, which goes back to the pool at the end of the request */
+    PooledHandle curl(*connections);
     if(curl) {
         /* Specify the GET data */
         // Specify the type of SBOL object to search for
@@ -198,26 +554,13 @@ SearchResponse& sbol::PartShop::search(std::string search_text, sbol_type object
         
         parameters = url + "/remoteSearch/" + parameters;
         
-        /* First set the URL that is about to receive our GET. */
-        //curl_easy_setopt(curl, CURLOPT_URL, Config::getOption("validator_url").c_str());
-        curl_easy_setopt(curl, CURLOPT_URL, parameters.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        
-        /* Now specify the callback to read the response into string */
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        
-        /* Perform the request, res will get the return code */
-        res = curl_easy_perform(curl);
+        /* Perform the request, res will get the return code. A cached response is used instead if it is still fresh */
+        res = perform(curl, parameters, headers, response);
         /* Check for errors */
         if(res != CURLE_OK)
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to validate online failed with " + string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
     
     SearchResponse& search_response = * new SearchResponse();
     Json::Value json_response;
@@ -249,19 +592,15 @@ SearchResponse& sbol::PartShop::search(std::string search_text, sbol_type object
     
     /* Perform HTTP request */
     string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     //    headers = curl_slist_append(headers, "Accept: application/json");
     headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
     //    headers = curl_slist_append(headers, "charsets: utf-8");
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* get a curl handle, which goes back to the pool at the end of the request */
+    PooledHandle curl(*connections);
     if(curl) {
         /* Specify the GET data */
         // Specify the type of SBOL object to search for
@@ -277,26 +616,13 @@ SearchResponse& sbol::PartShop::search(std::string search_text, sbol_type object
         
         parameters = url + "/remoteSearch/" + parameters;
         
-        /* First set the URL that is about to receive our GET. */
-        //curl_easy_setopt(curl, CURLOPT_URL, Config::getOption("validator_url").c_str());
-        curl_easy_setopt(curl, CURLOPT_URL, parameters.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        
-        /* Now specify the callback to read the response into string */
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        
-        /* Perform the request, res will get the return code */
-        res = curl_easy_perform(curl);
+        /* Perform the request, res will get the return code. A cached response is used instead if it is still fresh */
+        res = perform(curl, parameters, headers, response);
         /* Check for errors */
         if(res != CURLE_OK)
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to validate online failed with " + string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
     
     SearchResponse& search_response = * new SearchResponse();
     Json::Value json_response;
@@ -322,25 +648,141 @@ SearchResponse& sbol::PartShop::search(std::string search_text, sbol_type object
 };
 
 
+SearchIterator sbol::PartShop::searchAll(std::string search_text, sbol_type object_type, std::string property_uri, int page_size)
+{
+    // The criteria are formed as they are for an exact search
+    string parameters = "objectType=" + parseClassName(object_type) + "&";
+    parameters += "<" + property_uri + ">=";
+    if (search_text.find("http") == 0)
+        parameters += "<" + search_text + ">&";
+    else
+        parameters += "'" + search_text + "'&";
+    encode_http(parameters);
+    string url = resource + "/remoteSearch/" + parameters;
+    return SearchIterator(*this, [url](int offset, int limit)
+    {
+        return url + "/?offset=" + to_string(offset) + "&limit=" + to_string(limit);
+    }, page_size);
+};
+
+SearchIterator sbol::PartShop::searchAll(std::string search_text, sbol_type object_type, int page_size)
+{
+    // The criteria are formed as they are for a general search
+    string url = resource + "/remoteSearch/objectType=" + parseClassName(object_type) + "&" + search_text;
+    return SearchIterator(*this, [url](int offset, int limit)
+    {
+        return url + "/?offset=" + to_string(offset) + "&limit=" + to_string(limit);
+    }, page_size);
+};
+
+SearchIterator sbol::PartShop::searchAll(SearchQuery& q, int page_size)
+{
+    string criteria = advanced_search_criteria(q);
+    string url = resource;
+    return SearchIterator(*this, [url, criteria](int offset, int limit)
+    {
+        string parameters = criteria + "/?offset=" + to_string(offset) + "&limit=" + to_string(limit);
+        encode_http(parameters);
+        return url + "/remoteSearch/" + parameters;
+    }, page_size);
+};
+
+SearchIterator::SearchIterator(PartShop& shop, std::function<std::string(int offset, int limit)> page_url, int page_size) :
+    shop(shop),
+    page_url(page_url),
+    page_size(page_size),
+    next_offset(0),
+    n_visited(0),
+    last_page(false),
+    i_record(0)
+{
+    if (page_size < 1)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "The page size of a search must be at least 1");
+    prefetch();
+};
+
+// Starts fetching the next page on another thread, through the PartShop's pool and cache
+void SearchIterator::prefetch()
+{
+    string url = page_url(next_offset, page_size);
+    next_offset += page_size;
+    PartShop fetching_shop = shop;
+    fetched = std::async(std::launch::async, [fetching_shop, url]() mutable
+    {
+        string response;
+        struct curl_slist *headers = NULL;
+        headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
+        CURLcode res;
+        {
+            PooledHandle curl(*fetching_shop.connections);
+            res = fetching_shop.perform(curl, url, headers, response);
+        }
+        curl_slist_free_all(headers);
+        if (res != CURLE_OK)
+            throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Search failed with " + string(curl_easy_strerror(res)));
+        return response;
+    }).share();
+};
+
+bool SearchIterator::next()
+{
+    if (i_record + 1 < page.size())
+    {
+        ++i_record;
+        ++n_visited;
+        return true;
+    }
+    while (!last_page)
+    {
+        // Parse the page that was fetched in the background, and start on the one after it.  The response is released once it has parsed, so a page that fails to parse fails again if next is called again
+        Json::Value json_response;
+        {
+            string response = fetched.get();
+            Json::Reader reader;
+            if (!reader.parse(response, json_response) || !json_response.isArray())
+                throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Search failed with error message" + response);
+            fetched = std::shared_future<std::string>();
+        }
+        page.clear();
+        page.reserve(json_response.size());
+        for (Json::ValueIterator i_entry = json_response.begin(); i_entry != json_response.end(); i_entry++)
+        {
+            SearchRecord record;
+            record.uri = (*i_entry).get("uri", "").asString();
+            record.displayId = (*i_entry).get("displayId", "").asString();
+            record.name = (*i_entry).get("name", "").asString();
+            record.description = (*i_entry).get("description", "").asString();
+            record.version = (*i_entry).get("version", "").asString();
+            page.push_back(record);
+        }
+        last_page = page.size() < (std::size_t)page_size;
+        if (!last_page)
+            prefetch();
+        i_record = 0;
+        if (page.size())
+        {
+            ++n_visited;
+            return true;
+        }
+    }
+    return false;
+};
+
 int sbol::PartShop::searchCount(SearchQuery& q)
 {
     string url = resource;
     
     /* Perform HTTP request */
     string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     //    headers = curl_slist_append(headers, "Accept: application/json");
     headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
     //    headers = curl_slist_append(headers, "charsets: utf-8");
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* get a curl handle, which goes back to the pool at the end of the request */
+    PooledHandle curl(*connections);
     
     /* Specify the GET parameters */
     if(curl)
@@ -380,26 +822,13 @@ int sbol::PartShop::searchCount(SearchQuery& q)
         encode_http(parameters);
         parameters = url + "/searchCount/" + parameters;
         
-        /* First set the URL that is about to receive our GET. */
-        //curl_easy_setopt(curl, CURLOPT_URL, Config::getOption("validator_url").c_str());
-        curl_easy_setopt(curl, CURLOPT_URL, parameters.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        
-        /* Now specify the callback to read the response into string */
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        
-        /* Perform the request, res will get the return code */
-        res = curl_easy_perform(curl);
+        /* Perform the request, res will get the return code. A cached response is used instead if it is still fresh */
+        res = perform(curl, parameters, headers, response);
         /* Check for errors */
         if(res != CURLE_OK)
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to validate online failed with " + string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
     
     int count;
     try
@@ -419,19 +848,15 @@ int sbol::PartShop::searchCount(std::string search_text, sbol_type object_type,
     
     /* Perform HTTP request */
     string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     //    headers = curl_slist_append(headers, "Accept: application/json");
     headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
     //    headers = curl_slist_append(headers, "charsets: utf-8");
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* get a curl handle, which goes back to the pool at the end of the request */
+    PooledHandle curl(*connections);
     if(curl) {
         /* Specify the GET data */
         // Specify the type of SBOL object to search for
@@ -452,26 +877,13 @@ int sbol::PartShop::searchCount(std::string search_text, sbol_type object_type,
         
         parameters = url + "/remoteSearch/" + parameters;
         
-        /* First set the URL that is about to receive our GET. */
-        //curl_easy_setopt(curl, CURLOPT_URL, Config::getOption("validator_url").c_str());
-        curl_easy_setopt(curl, CURLOPT_URL, parameters.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        
-        /* Now specify the callback to read the response into string */
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        
-        /* Perform the request, res will get the return code */
-        res = curl_easy_perform(curl);
+        /* Perform the request, res will get the return code. A cached response is used instead if it is still fresh */
+        res = perform(curl, parameters, headers, response);
         /* Check for errors */
         if(res != CURLE_OK)
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to validate online failed with " + string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
 
     int count;
     try
@@ -491,19 +903,15 @@ int sbol::PartShop::searchCount(std::string search_text, sbol_type object_type)
     
     /* Perform HTTP request */
     string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     //    headers = curl_slist_append(headers, "Accept: application/json");
     headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
     //    headers = curl_slist_append(headers, "charsets: utf-8");
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* get a curl handle, which goes back to the pool at the end of the request */
+    PooledHandle curl(*connections);
     if(curl) {
         /* Specify the GET data */
         // Specify the type of SBOL object to search for
@@ -516,26 +924,13 @@ int sbol::PartShop::searchCount(std::string search_text, sbol_type object_type)
         
         parameters = url + "/searchCount/" + parameters;
         
-        /* First set the URL that is about to receive our GET. */
-        //curl_easy_setopt(curl, CURLOPT_URL, Config::getOption("validator_url").c_str());
-        curl_easy_setopt(curl, CURLOPT_URL, parameters.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        
-        /* Now specify the callback to read the response into string */
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        
-        /* Perform the request, res will get the return code */
-        res = curl_easy_perform(curl);
+        /* Perform the request, res will get the return code. A cached response is used instead if it is still fresh */
+        res = perform(curl, parameters, headers, response);
         /* Check for errors */
         if(res != CURLE_OK)
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to validate online failed with " + string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
     
     int count;
     try
@@ -555,19 +950,15 @@ void sbol::PartShop::login(std::string email, std::string password)
     
     /* Perform HTTP request */
     string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     //    headers = curl_slist_append(headers, "Accept: application/json");
     headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
     //    headers = curl_slist_append(headers, "charsets: utf-8");
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* get a curl handle, which goes back to the pool at the end of the request */
+    PooledHandle curl(*connections);
     if(curl) {
         /* First set the URL that is about to receive our POST. This URL can
          just as well be a https:// URL if that is what should receive the
@@ -589,76 +980,277 @@ void sbol::PartShop::login(std::string email, std::string password)
         /* Check for errors */
         if(res != CURLE_OK)
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to validate online failed with " + string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
     
     key = response;
 };
 
-std::string sbol::PartShop::submit(Document& doc, int overwrite)
+// The body of a submission, a multipart form. It is produced as libcurl reads it: the form fields first, then the Document a TopLevel at a time, then the closing boundary. Only what has been produced but not yet sent is held in memory
+struct SubmitBody
+{
+    SubmitBody(Document& doc, string fields, string boundary, bool compress, std::function<void(const UploadProgress&)>& progress);
+    ~SubmitBody();
+
+    Document& doc;
+    string fields;
+    string boundary;
+    bool compress;
+    z_stream stream;                     // The gzip encoder, when the body is compressed
+    ostringstream serialized;            // Each piece of the Document, as it is written
+    unique_ptr<RDFXMLWriter> writer;     // Set by PartShop::submit if the Document is written as RDF/XML. Otherwise it is serialized in one piece
+    vector<SBOLObject*> objects;         // The TopLevels, in the order they are written
+    size_t i_object;
+    bool started;
+    bool finished;                       // The last piece has been produced
+    string pending;                      // Produced, but not yet read by libcurl
+    size_t pending_start;
+    long long n_serialized;
+    long long n_sent;
+    std::function<void(const UploadProgress&)>& progress;
+    chrono::steady_clock::time_point start;
+    chrono::steady_clock::time_point last_report;
+    exception_ptr error;                 // Thrown while producing the body or reporting progress, and rethrown once libcurl returns
+
+    bool produce();
+    void encode(const string& raw, bool last);
+    UploadProgress report(bool done) const;
+};
+
+SubmitBody::SubmitBody(Document& doc, string fields, string boundary, bool compress, std::function<void(const UploadProgress&)>& progress) :
+    doc(doc),
+    fields(fields),
+    boundary(boundary),
+    compress(compress),
+    i_object(0),
+    started(false),
+    finished(false),
+    pending_start(0),
+    n_serialized(0),
+    n_sent(0),
+    progress(progress),
+    start(chrono::steady_clock::now()),
+    last_report(start)
+{
+    if (compress)
+    {
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        // A window of 15 bits, plus 16 for a gzip header and trailer rather than a zlib one
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw SBOLError(SBOL_ERROR_SERIALIZATION, "Could not start compressing the submission");
+    }
+};
+
+SubmitBody::~SubmitBody()
+{
+    if (compress)
+        deflateEnd(&stream);
+};
+
+// Produces the next piece of the body into pending
+// @return false once the whole body has been produced
+bool SubmitBody::produce()
+{
+    if (finished)
+        return false;
+    string raw;
+    if (!started)
+    {
+        raw = fields;
+        started = true;
+        if (writer)
+            writer->begin();
+        else
+            serialized << doc.writeString();  // Other formats are serialized in one piece
+    }
+    else if (writer && i_object < objects.size())
+        writer->write(*objects[i_object++]);
+    else
+    {
+        if (writer)
+            writer->end();
+        finished = true;
+    }
+    string piece = serialized.str();
+    serialized.str("");
+    n_serialized += piece.size();
+    raw += piece;
+    if (finished)
+        raw += "\r\n--" + boundary + "--\r\n";
+    encode(raw, finished);
+    return true;
+};
+
+void SubmitBody::encode(const string& raw, bool last)
+{
+    if (!compress)
+    {
+        pending += raw;
+        return;
+    }
+    char out[16384];
+    stream.next_in = (Bytef*)raw.data();
+    stream.avail_in = (uInt)raw.size();
+    do
+    {
+        stream.next_out = (Bytef*)out;
+        stream.avail_out = sizeof(out);
+        deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+        pending.append(out, sizeof(out) - stream.avail_out);
+    } while (stream.avail_out == 0);
+};
+
+UploadProgress SubmitBody::report(bool done) const
+{
+    UploadProgress report;
+    report.serialized = n_serialized;
+    report.sent = n_sent;
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    report.bytes_per_second = report.seconds > 0 ? n_sent / report.seconds : 0;
+    report.done = done;
+    return report;
+};
+
+// The CURLOPT_READFUNCTION of a submission
+static size_t read_submit_body(char* buffer, size_t size, size_t n_items, void* user_data)
+{
+    SubmitBody& body = *(SubmitBody*)user_data;
+    try
+    {
+        // A compressed piece may be empty, so pieces are produced until there is something to send
+        while (body.pending_start == body.pending.size())
+        {
+            body.pending.clear();
+            body.pending_start = 0;
+            if (!body.produce())
+                return 0;
+        }
+    }
+    catch (...)
+    {
+        body.error = current_exception();
+        return CURL_READFUNC_ABORT;
+    }
+    size_t n_read = std::min(size * n_items, body.pending.size() - body.pending_start);
+    memcpy(buffer, body.pending.data() + body.pending_start, n_read);
+    body.pending_start += n_read;
+    body.n_sent += n_read;
+    return n_read;
+};
+
+// The CURLOPT_XFERINFOFUNCTION of a submission, which libcurl calls many times a second. Progress is reported once a second
+static int report_submit_progress(void* user_data, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+{
+    SubmitBody& body = *(SubmitBody*)user_data;
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (now - body.last_report < chrono::seconds(1))
+        return 0;
+    body.last_report = now;
+    try
+    {
+        body.progress(body.report(false));
+    }
+    catch (...)
+    {
+        body.error = current_exception();
+        return 1;  // Abort the transfer
+    }
+    return 0;
+};
+
+// The headers of a submission, which are freed however the submission ends
+struct SubmitHeaders
+{
+    struct curl_slist* headers = NULL;
+
+    ~SubmitHeaders()
+    {
+        curl_slist_free_all(headers);
+    };
+
+    void append(const string& header)
+    {
+        headers = curl_slist_append(headers, header.c_str());
+    };
+};
+
+void PartShop::setUploadProgress(std::function<void(const UploadProgress&)> callback)
+{
+    upload_progress = callback;
+};
+
+std::string sbol::PartShop::submit(Document& doc, int overwrite, bool compress)
 {
     
     /* Perform HTTP request */
     string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
-    struct curl_slist *headers = NULL;
-//        headers = curl_slist_append(headers, "Accept: application/json");
-//    headers = curl_slist_append(headers, "Content-Type:  multipart/form-data");
-    //    headers = curl_slist_append(headers, "charsets: utf-8");
+    // A boundary that separates the parts of the form, which is unlikely to appear in the Document
+    std::random_device random_bits;
+    char random_digits[17];
+    snprintf(random_digits, sizeof(random_digits), "%08x%08x", random_bits(), random_bits());
+    string boundary = string("------------------------") + random_digits;
+
+    SubmitHeaders headers;
+    headers.append("Content-Type: multipart/form-data; boundary=" + boundary);
+    headers.append("Transfer-Encoding: chunked");  // The length of the body is not known until it has been sent
+    headers.append("Expect:");  // Send the body without waiting for a 100 Continue
+    if (compress)
+        headers.append("Content-Encoding: gzip");  // Of the whole body, form fields included
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* get a curl handle, which goes back to the pool at the end of the request */
+    PooledHandle curl(*connections);
     if(curl) {
         /* First set the URL that is about to receive our POST. This URL can
          just as well be a https:// URL if that is what should receive the
          data. */
         //curl_easy_setopt(curl, CURLOPT_URL, Config::getOption("validator_url").c_str());
         curl_easy_setopt(curl, CURLOPT_URL, "http://synbiohub.org/remoteSubmit");
-//        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers.headers);
         
-        /* Now specify the POST data */
-        struct curl_httppost* post = NULL;
-        struct curl_httppost* last = NULL;
-        
-        curl_formadd(&post, &last, CURLFORM_COPYNAME, "id",
-                     CURLFORM_COPYCONTENTS, doc.displayId.get().c_str(), CURLFORM_END);
-        curl_formadd(&post, &last, CURLFORM_COPYNAME, "version",
-                     CURLFORM_COPYCONTENTS, doc.version.get().c_str(), CURLFORM_END);
-        curl_formadd(&post, &last, CURLFORM_COPYNAME, "name",
-                     CURLFORM_COPYCONTENTS, doc.name.get().c_str(), CURLFORM_END);
-        curl_formadd(&post, &last, CURLFORM_COPYNAME, "description",
-                     CURLFORM_COPYCONTENTS, doc.description.get().c_str(), CURLFORM_END);
+        /* Now specify the POST data. The form fields go before the Document, which is the last part */
+        string fields;
+        auto add_field = [&fields, &boundary](string name, string value)
+        {
+            fields += "--" + boundary + "\r\nContent-Disposition: form-data; name=\"" + name + "\"\r\n\r\n" + value + "\r\n";
+        };
+        add_field("id", doc.displayId.get());
+        add_field("version", doc.version.get());
+        add_field("name", doc.name.get());
+        add_field("description", doc.description.get());
         string citations;
         for (auto citation : doc.citations.getAll())
             citations += citation + ",";
         citations = citations.substr(0, citations.length() - 1);
-        curl_formadd(&post, &last, CURLFORM_COPYNAME, "citations",
-                     CURLFORM_COPYCONTENTS, citations.c_str(), CURLFORM_END);  // Comma separated list
+        add_field("citations", citations);  // Comma separated list
         string keywords;
         for (auto kw : doc.keywords.getAll())
             keywords += kw + ",";
         keywords = keywords.substr(0, keywords.length() - 1);
-        curl_formadd(&post, &last, CURLFORM_COPYNAME, "keywords",
-                     CURLFORM_COPYCONTENTS, doc.keywords.get().c_str(), CURLFORM_END);
-
-        curl_formadd(&post, &last, CURLFORM_COPYNAME, "overwrite_merge",
-                     CURLFORM_COPYCONTENTS, std::to_string(overwrite).c_str(), CURLFORM_END);
-        curl_formadd(&post, &last, CURLFORM_COPYNAME, "user",
-                     CURLFORM_COPYCONTENTS, key.c_str(), CURLFORM_END);
-        curl_formadd(&post, &last, CURLFORM_COPYNAME, "file",
-                     CURLFORM_COPYCONTENTS, doc.writeString().c_str(), CURLFORM_CONTENTTYPE, "text/xml", CURLFORM_END);
-        
-        /* Set the form info */
-        curl_easy_setopt(curl, CURLOPT_HTTPPOST, post);
+        add_field("keywords", keywords);
+        add_field("overwrite_merge", std::to_string(overwrite));
+        add_field("user", key);
+        fields += "--" + boundary + "\r\nContent-Disposition: form-data; name=\"file\"\r\nContent-Type: text/xml\r\n\r\n";
+        
+        /* The body is read from a callback, as it is produced */
+        SubmitBody body(doc, fields, boundary, compress, upload_progress);
+        if (getFileFormat().compare("rdfxml") == 0)
+        {
+            body.objects = doc.rdfxml_objects();
+            body.writer.reset(new RDFXMLWriter(body.serialized, doc.namespaces));
+        }
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_submit_body);
+        curl_easy_setopt(curl, CURLOPT_READDATA, &body);
+        if (upload_progress)
+        {
+            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, report_submit_progress);
+            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &body);
+            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        }
         
         /* Now specify the callback to read the response into string */
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
@@ -666,15 +1258,15 @@ std::string sbol::PartShop::submit(Document& doc, int overwrite)
         
         /* Perform the request, res will get the return code */
         res = curl_easy_perform(curl);
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+        if (body.error)
+            rethrow_exception(body.error);
         /* Check for errors */
         if(res != CURLE_OK)
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to submit Document failed with " + string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
+        if (upload_progress)
+            upload_progress(body.report(true));
     }
-    curl_slist_free_all(headers);
-    curl_global_cleanup();
     
     //    Json::Value json_response;
     //    Json::Reader reader;
@@ -758,39 +1350,20 @@ std::string PartShop::searchRootCollections()
     
     /* Perform HTTP request */
     std::string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* get a curl handle, which goes back to the pool at the end of the request */
+    PooledHandle curl(*connections);
     if(curl) {
-        /* First set the URL that is about to receive our POST. This URL can
-         just as well be a https:// URL if that is what should receive the
-         data. */
-        //curl_easy_setopt(curl, CURLOPT_URL, Config::getOption("validator_url").c_str());
-        curl_easy_setopt(curl, CURLOPT_URL, get_request.c_str());
-        //        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        
-        /* Now specify the callback to read the response into string */
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        
-        /* Perform the request, res will get the return code */
-        res = curl_easy_perform(curl);
+        /* Perform the request, res will get the return code. A cached response is used instead if it is still fresh */
+        res = perform(curl, get_request, headers, response);
         /* Check for errors */
         if(res != CURLE_OK)
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to retrieve root collections failed with: " + std::string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
     
     return response;
 };
@@ -803,39 +1376,20 @@ std::string PartShop::searchSubCollections(std::string uri)
     
     /* Perform HTTP request */
     std::string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* get a curl handle, which goes back to the pool at the end of the request */
+    PooledHandle curl(*connections);
     if(curl) {
-        /* First set the URL that is about to receive our POST. This URL can
-         just as well be a https:// URL if that is what should receive the
-         data. */
-        //curl_easy_setopt(curl, CURLOPT_URL, Config::getOption("validator_url").c_str());
-        curl_easy_setopt(curl, CURLOPT_URL, get_request.c_str());
-        //        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        
-        /* Now specify the callback to read the response into string */
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        
-        /* Perform the request, res will get the return code */
-        res = curl_easy_perform(curl);
+        /* Perform the request, res will get the return code. A cached response is used instead if it is still fresh */
+        res = perform(curl, get_request, headers, response);
         /* Check for errors */
         if(res != CURLE_OK)
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to count objects failed with " + std::string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
     return response;
 };
 
@@ -846,49 +1400,189 @@ void PartShop::pull(std::string uri, Document& doc)
     
     /* Perform HTTP request */
     std::string response;
-    CURL *curl;
     CURLcode res;
     
-    /* In windows, this will init the winsock stuff */
-    curl_global_init(CURL_GLOBAL_ALL);
-    
     struct curl_slist *headers = NULL;
     //    headers = curl_slist_append(headers, "Accept: application/json");
     //    headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
     //    headers = curl_slist_append(headers, "charsets: utf-8");
     
-    /* get a curl handle */
-    curl = curl_easy_init();
+    /* get a curl handle, which goes back to the pool at the end of the request */
+    PooledHandle curl(*connections);
     if(curl) {
-        /* First set the URL that is about to receive our POST. This URL can
-         just as well be a https:// URL if that is what should receive the
-         data. */
-        //curl_easy_setopt(curl, CURLOPT_URL, Config::getOption("validator_url").c_str());
-        curl_easy_setopt(curl, CURLOPT_URL, get_request.c_str());
-        //        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        
-        /* Now specify the POST data */
-        //        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json.c_str());
-        
-        /* Now specify the callback to read the response into string */
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        
-        /* Perform the request, res will get the return code */
-        res = curl_easy_perform(curl);
+        /* Perform the request, res will get the return code. A cached response is used instead if it is still fresh */
+        res = perform(curl, get_request, headers, response);
         /* Check for errors */
         if(res != CURLE_OK)
             throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to validate online failed with " + std::string(curl_easy_strerror(res)));
-        
-        /* always cleanup */
-        curl_easy_cleanup(curl);
     }
     curl_slist_free_all(headers);
-    curl_global_cleanup();
     
     doc.readString(response);
 };
 
+// A request made by PartShop::pull for a list of URIs
+struct PullTransfer
+{
+    string uri;
+    int depth;  // The number of references followed to reach this object
+    CURL* curl;
+    ResponseCache::Entry received;
+    ResponseCache::Entry cached;  // A stale response, which the request revalidates
+    bool is_cached;
+    struct curl_slist* headers;
+};
+
+void PartShop::pull(std::vector<std::string> uris, Document& doc, int depth, int max_connections)
+{
+    if (max_connections < 1)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "At least one connection is needed to pull objects");
+
+    // Each URI is requested at most once
+    deque<pair<string, int>> queue;
+    unordered_set<string> requested;
+    for (auto & uri : uris)
+    {
+        if (!doc.find(uri) && requested.insert(uri).second)
+            queue.push_back(make_pair(uri, 0));
+    }
+    const vector<string> followed_properties = { SBOL_DEFINITION, SBOL_SEQUENCE_PROPERTY, SBOL_MEMBERS, SBOL_VARIANTS };
+
+    // Reads a response into the Document, and queues the objects it refers to
+    auto read_response = [&](int response_depth, string& response)
+    {
+        vector<SBOLObject*> objects = doc.merge(response);
+        if (response_depth >= depth)
+            return;
+        for (auto & obj : objects)
+        {
+            for (auto & property_uri : followed_properties)
+            {
+                auto i_property = obj->properties.find(property_uri);
+                if (i_property == obj->properties.end())
+                    continue;
+                for (auto & value : i_property->second)
+                {
+                    if (value.isURI() && !value.empty() && !doc.find(value.text()) && requested.insert(value.text()).second)
+                        queue.push_back(make_pair(value.text(), response_depth + 1));
+                }
+            }
+        }
+    };
+
+    CURLM* multi = curl_multi_init();
+#if LIBCURL_VERSION_NUM >= 0x072b00
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x071e00
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)max_connections);
+#endif
+    vector<PullTransfer*> transfers;
+    auto finish = [&](PullTransfer* transfer)
+    {
+        curl_multi_remove_handle(multi, transfer->curl);
+        connections->release(transfer->curl);
+        curl_slist_free_all(transfer->headers);
+        transfers.erase(std::find(transfers.begin(), transfers.end(), transfer));
+        delete transfer;
+    };
+    try
+    {
+        while (queue.size() || transfers.size())
+        {
+            // Start requests until the limit is reached. Fresh cached responses are read straight away
+            while (queue.size() && (int)transfers.size() < max_connections)
+            {
+                string uri = queue.front().first;
+                int uri_depth = queue.front().second;
+                queue.pop_front();
+                string get_request = uri + "/sbol";
+                ResponseCache::Entry cached;
+                bool is_cached = cache && cache->find(get_request, cached);
+                if (is_cached && (cache->offline || cache->isFresh(cached)))
+                {
+                    read_response(uri_depth, cached.body);
+                    continue;
+                }
+                if (cache && cache->offline)
+                {
+                    if (uri_depth > 0)
+                        continue;
+                    throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Cannot pull " + uri + " because it is not cached and the PartShop is offline");
+                }
+
+                PullTransfer* transfer = new PullTransfer({ uri, uri_depth, connections->acquire(), { get_request, "", "", 0, "" }, cached, is_cached, NULL });
+                if (transfer->curl == NULL)
+                {
+                    delete transfer;
+                    throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to pull objects failed because a connection could not be created");
+                }
+                curl_easy_setopt(transfer->curl, CURLOPT_URL, get_request.c_str());
+                curl_easy_setopt(transfer->curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
+                curl_easy_setopt(transfer->curl, CURLOPT_WRITEDATA, &transfer->received.body);
+                curl_easy_setopt(transfer->curl, CURLOPT_PRIVATE, transfer);
+                if (cache)
+                {
+                    transfer->headers = conditional_headers(NULL, is_cached ? &transfer->cached : NULL);
+                    curl_easy_setopt(transfer->curl, CURLOPT_HTTPHEADER, transfer->headers);
+                    curl_easy_setopt(transfer->curl, CURLOPT_HEADERFUNCTION, read_validators);
+                    curl_easy_setopt(transfer->curl, CURLOPT_HEADERDATA, &transfer->received);
+                }
+                transfers.push_back(transfer);
+                curl_multi_add_handle(multi, transfer->curl);
+            }
+            if (transfers.empty())
+                continue;
+
+            int running = 0;
+            CURLMcode multi_res = curl_multi_perform(multi, &running);
+            if (multi_res != CURLM_OK)
+                throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to pull objects failed with " + string(curl_multi_strerror(multi_res)));
+
+            // Read each response as it arrives
+            CURLMsg* message;
+            int n_messages;
+            while ((message = curl_multi_info_read(multi, &n_messages)))
+            {
+                if (message->msg != CURLMSG_DONE)
+                    continue;
+                PullTransfer* transfer;
+                curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char**)&transfer);
+                CURLcode res = message->data.result;
+                long status = 0;
+                curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &status);
+                if (res != CURLE_OK || status >= 400)
+                {
+                    if (transfer->depth > 0)
+                    {
+                        finish(transfer);
+                        continue;
+                    }
+                    string reason = res != CURLE_OK ? string(curl_easy_strerror(res)) : "HTTP status " + to_string(status);
+                    throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to pull " + transfer->uri + " failed with " + reason);
+                }
+                if (cache)
+                    read_response(transfer->depth, complete_response(*cache, transfer->curl, transfer->received, transfer->is_cached ? &transfer->cached : NULL));
+                else
+                    read_response(transfer->depth, transfer->received.body);
+                finish(transfer);
+            }
+
+            // Sleep until a transfer makes progress, unless there are requests waiting to start
+            if (running && (queue.empty() || (int)transfers.size() >= max_connections))
+                curl_multi_wait(multi, NULL, 0, 1000, NULL);
+        }
+    }
+    catch (...)
+    {
+        while (transfers.size())
+            finish(transfers.back());
+        curl_multi_cleanup(multi);
+        throw;
+    }
+    curl_multi_cleanup(multi);
+};
+
 string PartShop::getURL()
 {
     return resource;
@@ -34,6 +34,11 @@
 #include <iostream>
 #include <algorithm>
 #include <json/json.h>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace sbol
 {
@@ -207,13 +212,125 @@ namespace sbol
 //        }
 //    };  // SearchResponse
     
+    /// @cond
+    // A pool of curl handles owned by a PartShop, with the DNS, TLS session and connection caches they share. A handle keeps its connection alive once a request is done, so the next request to the same server skips the TCP and TLS handshakes. libcurl is initialized once for the process rather than around every request
+    class SBOL_DECLSPEC ConnectionPool
+    {
+    public:
+        ConnectionPool();
+        ~ConnectionPool();
+
+        /// @return An idle handle, or a new one if there is none. Handles are set up to share the pool's caches
+        CURL* acquire();
+
+        /// Clears the options of a handle and returns it to the pool, keeping its connection open
+        void release(CURL* curl);
+
+    private:
+        static const std::size_t max_idle = 8;
+
+        CURLSH* share;
+        std::vector<CURL*> idle;
+        std::mutex pool_mutex;
+        std::mutex share_mutexes[CURL_LOCK_DATA_LAST];
+
+        void configure(CURL* curl);
+        static void lock(CURL* curl, curl_lock_data data, curl_lock_access access, void* user_data);
+        static void unlock(CURL* curl, curl_lock_data data, void* user_data);
+    };
+
+    // Borrows a handle from a ConnectionPool for the length of a request
+    class SBOL_DECLSPEC PooledHandle
+    {
+    public:
+        PooledHandle(ConnectionPool& pool) :
+            pool(pool),
+            curl(pool.acquire())
+        {
+        };
+
+        ~PooledHandle()
+        {
+            pool.release(curl);
+        };
+
+        operator CURL*() { return curl; };
+
+    private:
+        ConnectionPool& pool;
+        CURL* curl;
+
+        PooledHandle(const PooledHandle&);
+        PooledHandle& operator=(const PooledHandle&);
+    };
+
+    // Responses to GET requests, kept on local disk and keyed by URL, with the ETag and Last-Modified validators the server sent. A fresh response is used without a request. A stale one is revalidated with a conditional request, so an unchanged response is not downloaded again. Bundles hold entries that are never revalidated
+    class SBOL_DECLSPEC ResponseCache
+    {
+    public:
+        struct Entry
+        {
+            std::string url;
+            std::string etag;
+            std::string last_modified;
+            long long fetched;  // When the response was received or last revalidated, in seconds since the epoch. Bundled entries are always fresh
+            std::string body;
+        };
+
+        /// @param directory An existing directory, which several processes may share
+        /// @param ttl How many seconds a response stays fresh
+        ResponseCache(std::string directory, long long ttl);
+
+        std::string directory;
+        long long ttl;
+        bool offline;
+
+        /// @return Whether the response to a request is cached, on disk or in a bundle
+        bool find(const std::string& url, Entry& entry);
+        bool isFresh(const Entry& entry) const;
+
+        /// Saves a response to disk. Other processes never see a partly written entry
+        void store(Entry& entry);
+
+        void addBundle(std::string filename);
+        void writeBundle(std::string filename);
+
+    private:
+        std::unordered_map<std::string, Entry> bundled;
+        std::mutex bundle_mutex;
+
+        std::string path(const std::string& url) const;
+    };
+    /// @endcond
+
+    class SearchIterator;
+
+    /// How far an upload has got, as reported to the callback set by PartShop::setUploadProgress
+    struct SBOL_DECLSPEC UploadProgress
+    {
+        long long serialized;     ///< Bytes of SBOL written so far, before compression
+        long long sent;           ///< Bytes of the request body sent so far, after compression
+        double seconds;           ///< Time since the upload began
+        double bytes_per_second;  ///< The average rate at which the request body was sent
+        bool done;                ///< The whole request body has been sent
+    };
+
     /// A class which provides an API front-end for online bioparts repositories
     class SBOL_DECLSPEC PartShop
     {
     private:
         std::string resource;
         std::string key;
+        std::shared_ptr<ConnectionPool> connections;  ///< Reused across requests, and shared by copies of this PartShop
+        std::shared_ptr<ResponseCache> cache;  ///< Set by setCache
+        std::function<void(const UploadProgress&)> upload_progress;  ///< Set by setUploadProgress
         
+        /// @cond
+        // Performs a GET request, unless the cache holds a fresh response to it
+        CURLcode perform(CURL* curl, const std::string& url, struct curl_slist* headers, std::string& response);
+        friend class SearchIterator;
+        /// @endcond
+
     public:
         /// Return the count of objects contained in a PartShop
         /// @tparam SBOLClass The type of SBOL object, usually a ComponentDefinition
@@ -224,6 +341,13 @@ namespace sbol
         /// @param doc A document to add the data to
         void pull(std::string uri, Document& doc);
 
+        /// Retrieve many objects from an online resource at once, with several requests in flight, and optionally the objects they refer to. Each response is read into the Document as soon as it arrives. Objects already in the Document are neither requested nor read again
+        /// @param uris The identities of the SBOL objects you want to retrieve
+        /// @param doc A document to add the data to
+        /// @param depth How many steps of definition, sequences, members and variants references to follow from the requested objects. By default only the requested objects are retrieved. Referenced objects that cannot be retrieved, for example because they are held by another resource, are skipped
+        /// @param max_connections The largest number of requests in flight at once
+        void pull(std::vector<std::string> uris, Document& doc, int depth = 0, int max_connections = 8);
+
         /// Returns all Collections that are not members of any other Collections
         /// @param doc A Document to add the Collections to
         std::string searchRootCollections();
@@ -254,6 +378,24 @@ namespace sbol
         /// @param search_query A map of string key-value pairs. Keys are objectType, sbolTag, collection, dcterms:tag, namespace/tag, offset, limit.
         /// @return Search metadata A vector of maps with key-value pairs.
         SearchResponse& search(SearchQuery& q);
+
+        /// Iterate over every record of an EXACT search, however many there are. Records are fetched a page at a time as the iteration reaches them, and the next page is fetched in the background while this one is visited, so only two pages are held in memory at once
+        /// @param search_text This may be a literal text value or it may be a URI.
+        /// @param object_type The RDF type of an SBOL object. See @ref constants.h. For example, SBOL_COMPONENT_DEFINITION
+        /// @param property_uri The RDF type of an SBOL property. Specifies which field of an SBOL object to search. For example, SBOL_ROLES. Refer to @ref constants.h
+        /// @param page_size The number of records requested at a time
+        SearchIterator searchAll(std::string search_text, std::string object_type, std::string property_uri, int page_size = 100);
+
+        /// Iterate over every record of a GENERAL search, a page at a time. See the EXACT searchAll
+        /// @param search_text A snippet of text to search for in a property's value.
+        /// @param object_type The RDF type of an SBOL object. See @ref constants.h. For example, SBOL_COMPONENT_DEFINITION by default.
+        /// @param page_size The number of records requested at a time
+        SearchIterator searchAll(std::string search_text, std::string object_type = SBOL_COMPONENT_DEFINITION, int page_size = 100);
+
+        /// Iterate over every record of an ADVANCED search, a page at a time. The offset and limit of the SearchQuery are ignored. See the EXACT searchAll
+        /// @param search_query A map of string key-value pairs. See SearchQuery for required and optional criteria.
+        /// @param page_size The number of records requested at a time
+        SearchIterator searchAll(SearchQuery& q, int page_size = 100);
         
 //#endif
         
@@ -270,16 +412,38 @@ namespace sbol
         /// @return An integer count.
         int searchCount(SearchQuery& q);
         
-        /// Submit a Document to SynBioHub
+        /// Submit a Document to SynBioHub. The Document is serialized a TopLevel at a time as the request is sent, with chunked transfer encoding, so it is never held in memory as a whole
         /// @param doc The Document to submit
         /// @param overwrite An integer code: 0(default) - do not overwrite, 1 - overwrite, 2 - merge
-        std::string submit(Document& doc, int overwrite = 0);
+        /// @param compress Whether to send the request with gzip content encoding. The whole multipart request is compressed, form fields included, so the SynBioHub server itself, or a proxy in front of it, must decode gzip-encoded request bodies. Leave this off for servers that do not
+        std::string submit(Document& doc, int overwrite = 0, bool compress = false);
+
+        /// Report the progress of submissions. The callback is called about once a second while a Document is uploaded, and once more when it is done
+        /// @param callback Called with the bytes serialized and sent so far, and the upload rate
+        void setUploadProgress(std::function<void(const UploadProgress&)> callback);
         
         /// In order to submit to a PartShop, you must login first. Register on [SynBioHub](http://synbiohub.org) to obtain account credentials.
         /// @param email The email associated with the user's SynBioHub account
         /// @param password The user's password
         void login(std::string email, std::string password);
         
+        /// Keep the responses to searches, counts and pulls in a directory on local disk, so repeated requests do not go to the network. A response is used as it is until it is older than the time to live, then revalidated with the server, which sends it again only if it has changed. The directory may be shared by several processes
+        /// @param directory An existing directory to keep the responses in
+        /// @param ttl How many seconds a response is used before it is revalidated
+        void setCache(std::string directory, int ttl = 3600);
+
+        /// In offline mode, every request is answered from the cache, however old the response is, and a request that is not cached throws
+        /// @param offline Whether to work offline
+        void setOffline(bool offline = true);
+
+        /// Answer requests from a bundle of cached responses, written by writeCacheBundle on another machine. Bundled responses are never revalidated, so a bundle can be shipped to nodes without network access. setCache must be called first
+        /// @param filename The bundle file
+        void addCacheBundle(std::string filename);
+
+        /// Write every response in the cache, including those from bundles, to a single file
+        /// @param filename The bundle file to write
+        void writeCacheBundle(std::string filename);
+        
         /// Returns the network address of the PartShop
         /// @return The URL of the online repository
         std::string getURL();
@@ -287,10 +451,60 @@ namespace sbol
         /// Construct an interface to an instance of SynBioHub or other parts repository
         /// @param The URL of the online repository
         PartShop(std::string url) :
-        resource(url)
+        resource(url),
+        connections(std::make_shared<ConnectionPool>())
         {
         };
     };
+
+    /// The metadata of one search record, as plain strings
+    struct SBOL_DECLSPEC SearchRecord
+    {
+        std::string uri;
+        std::string displayId;
+        std::string name;
+        std::string description;
+        std::string version;
+    };
+
+    /// Visits the records of a search in order, fetching them from the PartShop a page at a time. Returned by PartShop::searchAll.
+    /// @code
+    /// SearchIterator records = part_shop.searchAll("GFP");
+    /// while (records.next())
+    ///     cout << records->uri << endl;
+    /// @endcode
+    class SBOL_DECLSPEC SearchIterator
+    {
+    public:
+        /// @param shop The PartShop to fetch from. Its connections and cache are shared
+        /// @param page_url Gives the URL of the page of records that starts at an offset
+        /// @param page_size The number of records in a full page. A page with fewer records is the last one
+        SearchIterator(PartShop& shop, std::function<std::string(int offset, int limit)> page_url, int page_size);
+
+        /// Moves to the next record, waiting for its page if it has not arrived yet
+        /// @return false once every record has been visited
+        /// @throw SBOL_ERROR_BAD_HTTP_REQUEST if a page cannot be fetched
+        bool next();
+
+        const SearchRecord& operator*() const { return page[i_record]; };
+        const SearchRecord* operator->() const { return &page[i_record]; };
+
+        /// @return The number of records visited so far
+        int count() const { return n_visited; };
+
+    private:
+        PartShop shop;
+        std::function<std::string(int offset, int limit)> page_url;
+        int page_size;
+        int next_offset;  // The offset of the page after the one being fetched
+        int n_visited;
+        bool last_page;   // The page being visited is the last one
+        std::vector<SearchRecord> page;
+        std::size_t i_record;
+        std::shared_future<std::string> fetched;  // The response for the next page
+
+        void prefetch();
+    };
     
 //    /// Returns a Document including all objects referenced from this object
 //    template <> sbol::Document& sbol::PartShop::pull<sbol::Document>(std::string uri);
@@ -305,42 +519,23 @@ namespace sbol
         
         /* Perform HTTP request */
         std::string response;
-        CURL *curl;
         CURLcode res;
         
-        /* In windows, this will init the winsock stuff */
-        curl_global_init(CURL_GLOBAL_ALL);
-        
         struct curl_slist *headers = NULL;
         //    headers = curl_slist_append(headers, "Accept: application/json");
         //    headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
         //    headers = curl_slist_append(headers, "charsets: utf-8");
         
-        /* get a curl handle */
-        curl = curl_easy_init();
+        /* get a curl handle, which goes back to the pool at the end of the request */
+        PooledHandle curl(*connections);
         if(curl) {
-            /* First set the URL that is about to receive our POST. This URL can
-             just as well be a https:// URL if that is what should receive the
-             data. */
-            //curl_easy_setopt(curl, CURLOPT_URL, Config::getOption("validator_url").c_str());
-            curl_easy_setopt(curl, CURLOPT_URL, get_request.c_str());
-            //        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-            
-            /* Now specify the callback to read the response into string */
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite_CallbackFunc_StdString);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-            
-            /* Perform the request, res will get the return code */
-            res = curl_easy_perform(curl);
+            /* Perform the request, res will get the return code. A cached response is used instead if it is still fresh */
+            res = perform(curl, get_request, headers, response);
             /* Check for errors */
             if(res != CURLE_OK)
                 throw SBOLError(SBOL_ERROR_BAD_HTTP_REQUEST, "Attempt to count objects failed with " + std::string(curl_easy_strerror(res)));
-            
-            /* always cleanup */
-            curl_easy_cleanup(curl);
         }
         curl_slist_free_all(headers);
-        curl_global_cleanup();
         
         return stoi(response);
     };
@@ -24,39 +24,201 @@
  * ------------------------------------------------------------------------->*/
 
 #include "object.h"
+#include "nucleotides.h"
 
 #include <stdexcept>      // std::invalid_argument
 
 #include <vector>
 #include <utility>
 #include <regex>
+#include <cstdlib>
 #include <time.h>
 
 using namespace sbol;
 using namespace std;
 
-/// @return A string literal
+PropertyValue::PropertyValue(const PropertyValue& other) :
+    value_text(other.value_text),
+    int_value(other.int_value),
+    value_kind(other.value_kind),
+    is_empty(other.is_empty),
+    packed_elements(other.packed_elements ? new PackedNucleotides(*other.packed_elements) : NULL),
+    literal_tag(other.literal_tag ? new LiteralTag(*other.literal_tag) : NULL)
+{
+};
+
+PropertyValue::PropertyValue(PropertyValue&& other) noexcept :
+    value_text(std::move(other.value_text)),
+    int_value(other.int_value),
+    value_kind(other.value_kind),
+    is_empty(other.is_empty),
+    packed_elements(other.packed_elements),
+    literal_tag(other.literal_tag)
+{
+    other.packed_elements = NULL;
+    other.literal_tag = NULL;
+};
+
+PropertyValue& PropertyValue::operator=(const PropertyValue& other)
+{
+    if (this != &other)
+        *this = PropertyValue(other);
+    return *this;
+};
+
+PropertyValue& PropertyValue::operator=(PropertyValue&& other) noexcept
+{
+    if (this != &other)
+    {
+        value_text = std::move(other.value_text);
+        int_value = other.int_value;
+        value_kind = other.value_kind;
+        is_empty = other.is_empty;
+        delete packed_elements;
+        packed_elements = other.packed_elements;
+        other.packed_elements = NULL;
+        delete literal_tag;
+        literal_tag = other.literal_tag;
+        other.literal_tag = NULL;
+    }
+    return *this;
+};
+
+PropertyValue::~PropertyValue()
+{
+    delete packed_elements;
+    delete literal_tag;
+};
+
+void PropertyValue::pack()
+{
+    if (value_kind != LITERAL || packed_elements || value_text.size() < PackedNucleotides::min_length)
+        return;
+    packed_elements = PackedNucleotides::pack(value_text);
+    if (packed_elements)
+        std::string().swap(value_text);  // Release the text's memory, not just its contents
+};
+
+std::string PropertyValue::packedStr() const
+{
+    return packed_elements->str();
+};
+
+const std::string& PropertyValue::datatype() const
+{
+    static const std::string untagged;
+    return literal_tag ? literal_tag->datatype : untagged;
+};
+
+const std::string& PropertyValue::language() const
+{
+    static const std::string untagged;
+    return literal_tag ? literal_tag->language : untagged;
+};
+
+void PropertyValue::setTag(std::string datatype, std::string language)
+{
+    delete literal_tag;
+    literal_tag = NULL;
+    if (datatype.size() || language.size())
+        literal_tag = new LiteralTag{ std::move(datatype), std::move(language) };
+};
+
+void PropertyValue::set(std::string value)
+{
+    delete packed_elements;
+    packed_elements = NULL;
+    delete literal_tag;
+    literal_tag = NULL;
+    value_text = std::move(value);
+    is_empty = value_text.empty();
+    if (value_kind == INTEGER)
+        int_value = parseInt(value_text);
+};
+
+void PropertyValue::set(int value)
+{
+    delete packed_elements;
+    packed_elements = NULL;
+    delete literal_tag;
+    literal_tag = NULL;
+    value_text = to_string(value);
+    int_value = value;
+    is_empty = false;
+    if (value_kind != URI)
+        value_kind = INTEGER;
+};
+
+void PropertyValue::clear()
+{
+    delete packed_elements;
+    packed_elements = NULL;
+    delete literal_tag;
+    literal_tag = NULL;
+    value_text.clear();
+    int_value = 0;
+    is_empty = true;
+};
+
+bool PropertyValue::operator==(const PropertyValue& other) const
+{
+    if (isURI() != other.isURI() || is_empty != other.is_empty)
+        return false;
+    if (datatype() != other.datatype() || language() != other.language())
+        return false;
+    // Packed values are compared without unpacking them
+    const PackedNucleotides* other_packed = other.packed_elements;
+    if (packed_elements && other_packed)
+        return *packed_elements == *other_packed;
+    if (packed_elements)
+        return packed_elements->size() == other.value_text.size() && packed_elements->str() == other.value_text;
+    if (other_packed)
+        return other_packed->size() == value_text.size() && other_packed->str() == value_text;
+    return value_text == other.value_text;
+};
+
+bool PropertyValue::operator<(const PropertyValue& other) const
+{
+    if (isURI() != other.isURI())
+        return isURI();
+    if (literal_tag || other.literal_tag)
+    {
+        int cmp = str().compare(other.str());
+        if (cmp != 0)
+            return cmp < 0;
+        if (datatype() != other.datatype())
+            return datatype() < other.datatype();
+        return language() < other.language();
+    }
+    if (packed_elements || other.packed_elements)
+        return str() < other.str();
+    return value_text < other.value_text;
+};
+
+int PropertyValue::parseInt(const std::string& value)
+{
+    return (int)strtol(value.c_str(), NULL, 10);
+};
+
+/// @return A string literal.  A packed Sequence's elements are decoded into the copy
 std::string TextProperty::get()
 {
     if (this->sbol_owner)
     {
         // check if property a valid member of this object (mismatching of properties can result from improper template calls)
-        if (this->sbol_owner->properties.find(type) == this->sbol_owner->properties.end())
+        std::vector<PropertyValue>* value_store = this->sbol_owner->properties.get(slot, type);
+        if (!value_store)
         {
             throw SBOLError(SBOL_ERROR_TYPE_MISMATCH, "This object does not have a property of type " + type);
         }
         else
         {
             // property value not set
-            if (this->sbol_owner->properties[type].size() == 0)
+            if (value_store->size() == 0)
                 throw SBOLError(SBOL_ERROR_NOT_FOUND, "Property has not been set");
             // property value is found
             else
-            {
-                std::string value = this->sbol_owner->properties[type].front();
-                value = value.substr(1, value.length() - 2);  // Strips angle brackets from URIs and quotes from literals
-                return value;
-            }
+                return value_store->front().str();
         }
     }	else
     {
@@ -65,27 +227,24 @@ std::string TextProperty::get()
 };
 
 /// @return A string of characters used to identify a resource
-std::string URIProperty::get()
+const std::string& URIProperty::get()
 {
     if (this->sbol_owner)
     {
         // check if property a valid member of this object (mismatching of properties can result from improper template calls)
-        if (this->sbol_owner->properties.find(type) == this->sbol_owner->properties.end())
+        std::vector<PropertyValue>* value_store = this->sbol_owner->properties.get(slot, type);
+        if (!value_store)
         {
             throw SBOLError(SBOL_ERROR_TYPE_MISMATCH, "This object does not have a property of type " + type);
         }
         else
         {
             // property value not set
-            if (this->sbol_owner->properties[type].size() == 0)
+            if (value_store->size() == 0)
                 throw SBOLError(SBOL_ERROR_NOT_FOUND, "Property has not been set");
             // property value is found
             else
-            {
-                std::string value = this->sbol_owner->properties[type].front();
-                value = value.substr(1, value.length() - 2);  // Strips angle brackets from URIs and quotes from literals
-                return value;
-            }
+                return value_store->front().text();
         }
     }	else
     {
@@ -99,22 +258,19 @@ int IntProperty::get()
     if (this->sbol_owner)
     {
         // check if property a valid member of this object (mismatching of properties can result from improper template calls)
-        if (this->sbol_owner->properties.find(type) == this->sbol_owner->properties.end())
+        std::vector<PropertyValue>* value_store = this->sbol_owner->properties.get(slot, type);
+        if (!value_store)
         {
             throw SBOLError(SBOL_ERROR_TYPE_MISMATCH, "This object does not have a property of type " + type);
         }
         else
         {
             // property value not set
-            if (this->sbol_owner->properties[type].size() == 0)
+            if (value_store->size() == 0)
                 throw SBOLError(SBOL_ERROR_NOT_FOUND, "Property has not been set");
-            // property value is found
+            // property value is found.  Integer values are parsed once, when they are set
             else
-            {
-                std::string value = this->sbol_owner->properties[type].front();
-                value = value.substr(1, value.length() - 2);  // Strips angle brackets from URIs and quotes from literals
-                return stoi(value);
-            }
+                return value_store->front().toInt();
         }
     }	else
     {
@@ -149,14 +305,13 @@ void VersionProperty::incrementMinor()
     this->set(new_version);
     
     /// Update the identity if SBOLCompliant
-    if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+    if (Config::snapshot().compliant_uris)
     {
         SBOLObject* parent_obj = this->sbol_owner;
         std::string persistentIdentity;
         if (parent_obj->properties.find(SBOL_PERSISTENT_IDENTITY) != parent_obj->properties.end())
         {
-            persistentIdentity = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front();
-            persistentIdentity = persistentIdentity.substr(1, persistentIdentity.length() - 2);  // Removes flanking < and > from the uri
+            persistentIdentity = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front().str();
         }
         parent_obj->identity.set(persistentIdentity + "/" + new_version);
     }
@@ -196,14 +351,13 @@ void VersionProperty::incrementMajor()
     this->set(new_version);
     
     /// Update the identity if SBOLCompliant
-    if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+    if (Config::snapshot().compliant_uris)
     {
         SBOLObject* parent_obj = this->sbol_owner;
         std::string persistentIdentity;
         if (parent_obj->properties.find(SBOL_PERSISTENT_IDENTITY) != parent_obj->properties.end())
         {
-            persistentIdentity = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front();
-            persistentIdentity = persistentIdentity.substr(1, persistentIdentity.length() - 2);  // Removes flanking < and > from the uri
+            persistentIdentity = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front().str();
         }
         parent_obj->identity.set(persistentIdentity + "/" + new_version);
     }
@@ -236,14 +390,13 @@ void VersionProperty::incrementPatch()
     this->set(new_version);
     
     /// Update the identity if SBOLCompliant
-    if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+    if (Config::snapshot().compliant_uris)
     {
         SBOLObject* parent_obj = this->sbol_owner;
         std::string persistentIdentity;
         if (parent_obj->properties.find(SBOL_PERSISTENT_IDENTITY) != parent_obj->properties.end())
         {
-            persistentIdentity = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front();
-            persistentIdentity = persistentIdentity.substr(1, persistentIdentity.length() - 2);  // Removes flanking < and > from the uri
+            persistentIdentity = parent_obj->properties[SBOL_PERSISTENT_IDENTITY].front().str();
         }
         parent_obj->identity.set(persistentIdentity + "/" + new_version);
     }
@@ -261,6 +414,13 @@ void VersionProperty::decrementPatch()
 {
 };
 
+void VersionProperty::set(std::string maven_version)
+{
+    TextProperty::set(maven_version);
+    if (this->sbol_owner && this->sbol_owner->doc)
+        this->sbol_owner->reindex(type, "", maven_version);
+};
+
 /// @return The major version as an integer
 /// Splits the version string by a delimiter and returns the major version number
 int VersionProperty::major()
@@ -350,28 +510,64 @@ vector<string> VersionProperty::split(const char c)
 
 pair < vector<string>, vector<string> > VersionProperty::split()
 {
-    // Adapted from C++ cookbook
-    const string& s = this->get();
+    return split(this->get());
+}
+
+pair < vector<string>, vector<string> > VersionProperty::split(const string& version)
+{
+    // Tokens are separated by any of the characters - | . _ or a backslash
     vector<string> tokens;
     vector<string> delimiters;
     
-    std::regex rgx("[-|.|\\\\|_]");
-    std::sregex_token_iterator i_token(s.begin(), s.end(), rgx, -1);
-    std::sregex_token_iterator end;
-    while (i_token != end)
+    string::size_type i_token = 0;
+    for (string::size_type i_char = 0; i_char < version.size(); ++i_char)
     {
-        tokens.push_back(*i_token);
-        ++i_token;
+        char c = version[i_char];
+        if (c == '-' || c == '|' || c == '.' || c == '\\' || c == '_')
+        {
+            tokens.push_back(version.substr(i_token, i_char - i_token));
+            delimiters.push_back(string(1, c));
+            i_token = i_char + 1;
+        }
     }
+    if (i_token < version.size())
+        tokens.push_back(version.substr(i_token));
     
-    std::sregex_token_iterator i_delimiter(s.begin(), s.end(), rgx);
-    while (i_delimiter != end)
+    return make_pair(tokens, delimiters);
+}
+
+// Numeric tokens are compared by value, without converting them, so versions with very long numbers still compare correctly
+static int compare_version_token(const string& a, const string& b)
+{
+    bool a_numeric = !a.empty() && a.find_first_not_of("0123456789") == string::npos;
+    bool b_numeric = !b.empty() && b.find_first_not_of("0123456789") == string::npos;
+    if (a_numeric && b_numeric)
     {
-        delimiters.push_back(*i_delimiter);
-        ++i_delimiter;
+        string::size_type a_start = min(a.find_first_not_of('0'), a.size());
+        string::size_type b_start = min(b.find_first_not_of('0'), b.size());
+        if (a.size() - a_start != b.size() - b_start)
+            return a.size() - a_start < b.size() - b_start ? -1 : 1;
+        return a.compare(a_start, string::npos, b, b_start, string::npos);
     }
-    
-    return make_pair(tokens, delimiters);
+    if (a_numeric != b_numeric)
+        return a_numeric ? 1 : -1;  // A release number ranks above a qualifier such as alpha or SNAPSHOT
+    return a.compare(b);
+}
+
+int VersionProperty::compare(const string& a, const string& b)
+{
+    vector<string> a_tokens = split(a).first;
+    vector<string> b_tokens = split(b).first;
+    for (size_t i_token = 0; i_token < a_tokens.size() || i_token < b_tokens.size(); ++i_token)
+    {
+        // A missing part counts as zero, so 1.0 equals 1.0.0, precedes 1.0.1 and follows 1.0-SNAPSHOT
+        const string& a_token = i_token < a_tokens.size() ? a_tokens[i_token] : "0";
+        const string& b_token = i_token < b_tokens.size() ? b_tokens[i_token] : "0";
+        int result = compare_version_token(a_token, b_token);
+        if (result != 0)
+            return result < 0 ? -1 : 1;
+    }
+    return 0;
 }
 
 string DateTimeProperty::stampTime()
@@ -441,7 +637,7 @@ ReferencedObject::ReferencedObject(sbol_type type_uri, sbol_type reference_type_
     // Register Property in owner Object
     if (this->sbol_owner != NULL)
     {
-        std::vector<std::string> property_store;
+        std::vector<PropertyValue> property_store;
         this->sbol_owner->properties.insert({ type_uri, property_store });
     }
 };
@@ -451,12 +647,15 @@ void ReferencedObject::set(std::string uri)
     if (this->sbol_owner)
     {
         //sbol_owner->properties[type].push_back( new_value );
-        std::string current_value = this->sbol_owner->properties[this->type][0];
-        if (current_value[0] == '<')  //  this property is a uri
+        PropertyValue& current_value = this->sbol_owner->properties.access(slot, type)[0];
+        if (current_value.isURI())  //  this property is a uri
         {
-            this->sbol_owner->properties[this->type][0] = "<" + uri + ">";
+            std::string old_uri = current_value.str();
+            current_value.set(uri);
+            if (this->sbol_owner->doc)
+                this->sbol_owner->reindex(type, old_uri, uri);
         }
-        else if (current_value[0] == '"') // this property is a literal
+        else // this property is a literal
         {
             throw;
         }
@@ -469,7 +668,7 @@ void ReferencedObject::set(std::string uri)
 // For compliant URIs
 void ReferencedObject::setReference(const std::string uri)
 {
-    if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+    if (Config::snapshot().compliant_uris)
     {
         // if not TopLevel throw an error
         // @TODO search Document by persistentIdentity and retrieve the latest version
@@ -510,13 +709,19 @@ void ReferencedObject::setReference(const std::string uri)
 
 std::string ReferencedObject::operator[] (const int nIndex)
 {
-    std::vector<std::string> *reference_store = &this->sbol_owner->properties[this->type];
-    return reference_store->at(nIndex);
+    std::vector<PropertyValue> *reference_store = &this->sbol_owner->properties.access(slot, type);
+    return reference_store->at(nIndex).str();
 };
 
 
 void ReferencedObject::addReference(const std::string uri)
 {
-    this->sbol_owner->properties[this->type].push_back("<" + uri + ">");
+    std::vector<PropertyValue>& reference_store = this->sbol_owner->properties.access(slot, type);
+    if (reference_store.size() == 1 && reference_store[0].empty())
+        reference_store[0].set(uri);  // The first reference replaces the empty placeholder
+    else
+        reference_store.push_back(PropertyValue(PropertyValue::URI, uri));
+    if (this->sbol_owner->doc)
+        this->sbol_owner->reindex(type, "", uri);
 };
 
@@ -52,10 +52,10 @@ namespace sbol
     class SBOL_DECLSPEC URIProperty : public Property<std::string>
 	{
 	public:
-        virtual std::string get();                  ///< Basic getter for all SBOL literal properties.
+        virtual const std::string& get();           ///< Basic getter for all SBOL literal properties.
 
         URIProperty(sbol_type type_uri = UNDEFINED, void *property_owner = NULL, std::string initial_value = "", ValidationRules validation_rules = {}) :
-			Property(type_uri, property_owner, "<" + initial_value + ">", validation_rules)
+			Property(type_uri, property_owner, PropertyValue(PropertyValue::URI, initial_value), validation_rules)
 		{
 		}
         
@@ -79,8 +79,7 @@ namespace sbol
                 throw SBOLError(END_OF_LIST, "");
             if (this->python_iter != this->end())
             {
-                std::string ref = *this->python_iter;
-                ref = ref.substr(1, ref.size() - 2);  // Removes flanking angle brackets from the field
+                std::string ref = this->python_iter->str();
                 this->python_iter++;
                 if (this->python_iter == this->end())
                 {
@@ -99,8 +98,7 @@ namespace sbol
                 throw SBOLError(END_OF_LIST, "");
             if (this->python_iter != this->end())
             {
-                std::string ref = *this->python_iter;
-                ref = ref.substr(1, ref.size() - 2);  // Removes flanking angle brackets from the field
+                std::string ref = this->python_iter->str();
                 this->python_iter++;
                 if (this->python_iter == this->end())
                 {
@@ -125,7 +123,7 @@ namespace sbol
 	class SBOL_DECLSPEC TextProperty : public Property<std::string>
 	{
 	public:
-        virtual std::string get();                  ///< Basic getter for all SBOL literal properties.
+        virtual std::string get();           ///< Basic getter for all SBOL literal properties.
 
         #if defined(SBOL_BUILD_PYTHON2) || defined(SBOL_BUILD_PYTHON3)
         std::string __getitem__(const int nIndex)
@@ -146,8 +144,7 @@ namespace sbol
                 throw SBOLError(END_OF_LIST, "");
             if (this->python_iter != this->end())
             {
-                std::string ref = *this->python_iter;
-                ref = ref.substr(1, ref.size() - 2);  // Removes flanking quotations from the field
+                std::string ref = this->python_iter->str();
                 this->python_iter++;
                 if (this->python_iter == this->end())
                 {
@@ -166,8 +163,7 @@ namespace sbol
                 throw SBOLError(END_OF_LIST, "");
             if (this->python_iter != this->end())
             {
-                std::string ref = *this->python_iter;
-                ref = ref.substr(1, ref.size() - 2);  // Removes flanking quotations from the field
+                std::string ref = this->python_iter->str();
                 this->python_iter++;
                 if (this->python_iter == this->end())
                 {
@@ -186,7 +182,7 @@ namespace sbol
         #endif
 
         TextProperty(sbol_type type_uri, void *property_owner, std::string initial_value = "", ValidationRules validation_rules = {}) :
-			Property(type_uri, property_owner, "\"" + initial_value + "\"", validation_rules)
+			Property(type_uri, property_owner, PropertyValue(PropertyValue::LITERAL, initial_value), validation_rules)
         
 		{
 		}
@@ -218,7 +214,7 @@ namespace sbol
                 throw SBOLError(END_OF_LIST, "");
             if (this->python_iter != this->end())
             {
-                std::string ref = *this->python_iter;
+                std::string ref = this->python_iter->str();
                 this->python_iter++;
                 if (this->python_iter == this->end())
                 {
@@ -237,7 +233,7 @@ namespace sbol
                 throw SBOLError(END_OF_LIST, "");
             if (this->python_iter != this->end())
             {
-                std::string ref = *this->python_iter;
+                std::string ref = this->python_iter->str();
                 this->python_iter++;
                 if (this->python_iter == this->end())
                 {
@@ -274,7 +270,12 @@ namespace sbol
     public:
         /// @cond
         std::pair< std::vector<std::string>, std::vector<std::string> > split();
+        static std::pair< std::vector<std::string>, std::vector<std::string> > split(const std::string& version);
         /// @endcond
+
+        /// Compares two version strings in the manner of Maven. Numeric parts are compared by value, so 10.0.0 follows 9.0.0, and a qualifier such as 1.0.0-SNAPSHOT precedes its release
+        /// @return A negative number if a precedes b, zero if they are equivalent, or a positive number if a follows b
+        static int compare(const std::string& a, const std::string& b);
         
         void incrementMajor(); ///< Increment major version
         void incrementMinor(); ///< Increment minor version
@@ -285,6 +286,7 @@ namespace sbol
         int major(); ///< Get major version
         int minor(); ///< Get minor version
         int patch(); ///< Get patch version
+        void set(std::string maven_version) override;  ///< Set the version, keeping the parent Document's version index in order
         VersionProperty(sbol_type type_uri, void *property_owner, std::string initial_value = "") :
             TextProperty(type_uri, property_owner, initial_value)
             {
@@ -292,9 +294,9 @@ namespace sbol
                 // @TODO move this error checking to validation rules to be run on VersionProperty::set() and VersionProperty()::VersionProperty()
                 // sbol-10207 The version property of an Identified object is OPTIONAL and MAY contain a String that MUST be composed of only alphanumeric characters, underscores, hyphens, or periods and MUST begin with a digit. 20 Reference: Section 7.4 on page 16 21
                 // sbol-10208 The version property of an Identified object SHOULD follow the conventions of semantic 22 versioning as implemented by Maven.
-                if (Config::getOption("sbol_compliant_uris").compare("True") == 0)
+                if (Config::snapshot().compliant_uris)
                 {
-                    std::regex v_rgx("[0-9]+[a-zA-Z0-9_\\\\.-]*");
+                    static const std::regex v_rgx("[0-9]+[a-zA-Z0-9_\\\\.-]*");  // Compiled once, since every Identified object constructs a VersionProperty
                     if (!std::regex_match(v.begin(), v.end(), v_rgx))
                         throw SBOLError(SBOL_ERROR_NONCOMPLIANT_VERSION, "SBOL-compliant versions require a major, minor, and patch number in accordance with Maven versioning schemes. Use toggleSBOLCompliance() to relax these versioning requirements.");
                 }
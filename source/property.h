@@ -49,6 +49,106 @@ namespace sbol
 
 	// All SBOLProperties have a pointer back to the object which the property belongs to.  This requires forward declaration of the SBOLObject class
 	class SBOLObject;
+    class PackedNucleotides;
+
+    /// @cond
+    /// A single value in an SBOLObject's property store.  Values are stored unquoted and tagged with their kind, so getters can return a reference to the value without stripping the angle brackets and quotes used in the serialized form.  An empty value keeps its kind, so an unset property is still known to hold URIs or literals.
+    /// A long nucleotide sequence may be packed two bits per base instead of being held as text.  The writer and the Sequence kernels read a packed value directly, while str() decodes a copy of it.
+    /// A literal read with an rdf:datatype or xml:lang keeps them, so it is written back the same way.  Most literals have neither, so the tag is only allocated when one is set.
+    class SBOL_DECLSPEC PropertyValue
+    {
+    public:
+        enum Kind : unsigned char { URI, LITERAL, INTEGER };
+
+        explicit PropertyValue(Kind kind = LITERAL) :
+            int_value(0),
+            value_kind(kind),
+            is_empty(true),
+            packed_elements(NULL),
+            literal_tag(NULL)
+        {
+        };
+
+        PropertyValue(Kind kind, std::string value) :
+            value_text(std::move(value)),
+            int_value(kind == INTEGER ? parseInt(value_text) : 0),
+            value_kind(kind),
+            is_empty(value_text.empty()),
+            packed_elements(NULL),
+            literal_tag(NULL)
+        {
+        };
+
+        explicit PropertyValue(int value) :
+            value_text(std::to_string(value)),
+            int_value(value),
+            value_kind(INTEGER),
+            is_empty(false),
+            packed_elements(NULL),
+            literal_tag(NULL)
+        {
+        };
+
+        PropertyValue(const PropertyValue& other);
+        PropertyValue(PropertyValue&& other) noexcept;
+        PropertyValue& operator=(const PropertyValue& other);
+        PropertyValue& operator=(PropertyValue&& other) noexcept;
+        ~PropertyValue();
+
+        Kind kind() const { return value_kind; };
+        bool isURI() const { return value_kind == URI; };
+        bool empty() const { return is_empty; };
+        int toInt() const { return value_kind == INTEGER ? int_value : parseInt(str()); };
+
+        /// The unquoted value, or an empty string if the value is not set.  A packed value is decoded into the copy and stays packed
+        std::string str() const { return packed_elements ? packedStr() : value_text; };
+
+        /// The unquoted value without a copy, for values that are never packed, such as URIs and integers.  A packed value has no text, so this is empty
+        const std::string& text() const { return value_text; };
+
+        /// @return The packed form of the value, or NULL if it is held as text
+        const PackedNucleotides* packed() const { return packed_elements; };
+
+        /// Packs a literal made up of enough IUPAC nucleotide codes.  Other values are left as they are
+        void pack();
+
+        /// @return The datatype URI of a typed literal, or an empty string
+        const std::string& datatype() const;
+
+        /// @return The language of a language-tagged literal, or an empty string
+        const std::string& language() const;
+
+        /// Tag a literal with a datatype URI or a language.  Empty strings remove the tag
+        void setTag(std::string datatype, std::string language);
+
+        void set(std::string value);   ///< Replace the value, keeping its kind but not its tag
+        void set(int value);
+        void clear();                  ///< Mark the value as empty, keeping its kind
+
+        /// Values order URIs before literals, then lexically, then by tag.  Integers compare as literals, since a parsed annotation and an IntProperty may hold the same value
+        bool operator==(const PropertyValue& other) const;
+        bool operator!=(const PropertyValue& other) const { return !(*this == other); };
+        bool operator<(const PropertyValue& other) const;
+
+    private:
+        static int parseInt(const std::string& value);
+
+        std::string packedStr() const;
+
+        struct LiteralTag
+        {
+            std::string datatype;
+            std::string language;
+        };
+
+        std::string value_text;
+        int int_value;
+        Kind value_kind;
+        bool is_empty;
+        PackedNucleotides* packed_elements;  // Set while the value is packed, in which case value_text is empty
+        LiteralTag* literal_tag;  // Set only for typed and language-tagged literals
+    };
+    /// @endcond
 
     /// Member properties of all SBOL objects are defined using a Property object.  The Property class provides a generic interface for accessing SBOL objects.  At a low level, the Property class converts SBOL data structures into RDF triples.
     /// @tparam The SBOL specification currently supports string, URI, and integer literal values.
@@ -62,16 +162,18 @@ namespace sbol
 		sbol_type type;
 		SBOLObject *sbol_owner;  // back pointer to the SBOLObject to which this Property belongs
 		ValidationRules validationRules;
+        std::size_t slot;  // index of this property in the owner's PropertyStore, assigned when the property registers its initial value
         void initializeNamespace(std::string ns);  // Adds extension namespaces to the owner SBOLObject
 	public:
-        Property(sbol_type type_uri, void *property_owner, std::string initial_value, ValidationRules validation_rules = {});
+        Property(sbol_type type_uri, void *property_owner, PropertyValue initial_value, ValidationRules validation_rules = {});
 
 		Property(sbol_type type_uri, void *property_owner, int initial_value, ValidationRules validation_rules = {});
 
 		Property(sbol_type type_uri = UNDEFINED, void *property_owner = NULL, ValidationRules validation_rules = {}) :
 			type(type_uri),
 			sbol_owner((SBOLObject *)property_owner),
-            validationRules(validation_rules)
+            validationRules(validation_rules),
+            slot((std::size_t)-1)
 		{
 		}
 		~Property();
@@ -90,40 +192,36 @@ namespace sbol
 
 
         /// Provides iterator functionality for SBOL properties that contain multiple values
-        class iterator : public std::vector<std::string>::iterator
+        class iterator : public std::vector<PropertyValue>::iterator
         {
         public:
             
-            iterator(typename std::vector<std::string>::iterator i_str = std::vector<std::string>::iterator()) : std::vector<std::string>::iterator(i_str)
+            iterator(typename std::vector<PropertyValue>::iterator i_val = std::vector<PropertyValue>::iterator()) : std::vector<PropertyValue>::iterator(i_val)
             {
             }
         };
         
         iterator begin()
         {
-            std::vector<std::string> *object_store = &this->sbol_owner->properties[this->type];
+            std::vector<PropertyValue> *object_store = &this->sbol_owner->properties.access(this->slot, this->type);
             return iterator(object_store->begin());
         };
         
         iterator end()
         {
-            std::vector<std::string> *object_store = &this->sbol_owner->properties[this->type];
+            std::vector<PropertyValue> *object_store = &this->sbol_owner->properties.access(this->slot, this->type);
             return iterator(object_store->end());
         };
         
         int size()
         {
-            std::size_t size = this->sbol_owner->properties[this->type].size();
-            std::string current_value = this->sbol_owner->properties[this->type][0];
-            if (size == 1)
-            {
-                if (current_value.compare("<>") == 0 || current_value.compare("\"\"") == 0)  // Empty fields retain <> or "" to distinguish between URIs and literals
-                    return 0;
-            }
-            return (int)size;
+            std::vector<PropertyValue>& value_store = this->sbol_owner->properties.access(this->slot, this->type);
+            if (value_store.size() == 1 && value_store[0].empty())  // Empty fields retain a single empty value to distinguish between URIs and literals
+                return 0;
+            return (int)value_store.size();
         };
         
-        std::vector<std::string>::iterator python_iter;
+        std::vector<PropertyValue>::iterator python_iter;
         
 
     };
@@ -134,17 +232,17 @@ namespace sbol
     /// @param initial_value The initial value of the Property
     /// @param validation_rules A vector of externally defined ValidationRules. The vector contains pointers to functions which correspond to the validation rules listed in the appendix of the formal SBOL specification document.  ValidationRules are automatically checked every time a setter or adder method is called and when Documents are read and written.
     template <class LiteralType>
-	Property<LiteralType>::Property(sbol_type type_uri, void *property_owner, std::string initial_value, ValidationRules validation_rules) : Property(type_uri, property_owner, validation_rules)
+	Property<LiteralType>::Property(sbol_type type_uri, void *property_owner, PropertyValue initial_value, ValidationRules validation_rules) : Property(type_uri, property_owner, validation_rules)
 	{
-        std::string trim_value = initial_value.substr(1, initial_value.length() - 2);
+        std::string trim_value = initial_value.str();
         validate(&trim_value);
 		// Register Property in owner Object
 		if (this->sbol_owner != NULL)
 		{
-			std::vector<std::string> property_store;
-			property_store.push_back(initial_value);
+			std::vector<PropertyValue> property_store;
+			property_store.push_back(std::move(initial_value));
 //			this->sbol_owner->properties.insert({ type_uri, property_store });
-            this->sbol_owner->properties.insert({ type, property_store });
+            slot = this->sbol_owner->properties.declare(type, property_store);
         }
 	}
 
@@ -155,9 +253,9 @@ namespace sbol
 		// Register Property in owner Object
 		if (this->sbol_owner != NULL)
 		{
-			std::vector<std::string> property_store;
-			property_store.push_back("\"" + std::to_string(initial_value) + "\"");
-			this->sbol_owner->properties.insert({ type_uri, property_store });
+			std::vector<PropertyValue> property_store;
+			property_store.push_back(PropertyValue(initial_value));
+			slot = this->sbol_owner->properties.declare(type, property_store);
 		}
 	}
 
@@ -219,7 +317,8 @@ namespace sbol
     {
         if (this->sbol_owner)
         {
-            if (this->sbol_owner->properties.find(type) == this->sbol_owner->properties.end())
+            std::vector<PropertyValue>* found_store = this->sbol_owner->properties.get(slot, type);
+            if (!found_store)
             {
                 // not found
                 throw;
@@ -227,18 +326,14 @@ namespace sbol
             else
             {
                 // found
-                if (this->sbol_owner->properties[type].size() == 0)
+                if (found_store->size() == 0)
                     throw SBOLError(NOT_FOUND_ERROR, "Property has not been set");
                 else
                 {
                     std::vector<std::string> values;
-                    std::vector<std::string>& value_store = this->sbol_owner->properties[type];
+                    std::vector<PropertyValue>& value_store = *found_store;
                     for (auto i_val = value_store.begin(); i_val != value_store.end(); ++i_val)
-                    {
-                        std::string value = *i_val;
-                        value = value.substr(1, value.length() - 2);  // Strips angle brackets from URIs and quotes from literals
-                        values.push_back(value);
-                    }
+                        values.push_back(i_val->str());
                     return values;
                 }
             }
@@ -279,16 +374,21 @@ namespace sbol
         if (sbol_owner)
         {
             //sbol_owner->properties[type].push_back( new_value );
-            std::string current_value = this->sbol_owner->properties[this->type][0];
-            if (current_value[0] == '<')  //  this property is a uri
+            PropertyValue& current_value = this->sbol_owner->properties.access(this->slot, this->type)[0];
+            if (this->sbol_owner->doc && current_value.isURI())
             {
-                this->sbol_owner->properties[this->type][0] = "<" + new_value + ">";
+                // Objects in a Document are indexed by identity and by the URIs they refer to
+                std::string old_value = current_value.str();
+                current_value.set(new_value);
+                this->sbol_owner->reindex(this->type, old_value, new_value);
             }
-            else if (current_value[0] == '"') // this property is a literal
+            else
             {
-                this->sbol_owner->properties[this->type][0] = "\"" + new_value + "\"";
+                current_value.set(new_value);  // The stored value keeps its kind, either a uri or a literal
+                // Sequences assembled from these elements, or annotations indexed at these coordinates, are now stale
+                if (this->sbol_owner->doc && (current_value.kind() == PropertyValue::INTEGER || this->type.compare(SBOL_ELEMENTS) == 0))
+                    this->sbol_owner->reindex(this->type, "", "");
             }
-            
         }
         validate((void *)&new_value);
     };
@@ -299,8 +399,9 @@ namespace sbol
     {
         if (new_value)
         {
-            // TODO:  need to convert new_value to string
-            this->sbol_owner->properties[type][0] = "\"" + std::to_string(new_value) + "\"";
+            this->sbol_owner->properties.access(slot, type)[0].set(new_value);
+            if (this->sbol_owner->doc)
+                this->sbol_owner->reindex(this->type, "", "");
         }
         validate((void *)&new_value);  //  Call validation rules associated with this Property
     };
@@ -309,24 +410,22 @@ namespace sbol
     template <class LiteralType>
     std::string Property<LiteralType>::operator[] (const int nIndex)
     {
-        std::vector<std::string> *value_store = &this->sbol_owner->properties[this->type];
-        return value_store->at(nIndex);
+        std::vector<PropertyValue> *value_store = &this->sbol_owner->properties.access(this->slot, this->type);
+        return value_store->at(nIndex).str();
     };
     
     template <class LiteralType>
     void Property<LiteralType>::clear()
     {
-        std::string current_value = this->sbol_owner->properties[this->type][0];
-        std::cout << current_value << std::endl;
-        this->sbol_owner->properties[type].clear();
-        if (current_value[0] == '<')  //  this property is a uri
-        {
-            this->sbol_owner->properties[this->type].push_back("<>");
-        }
-        else if (current_value[0] == '"') // this property is a literal
+        std::vector<PropertyValue>& value_store = this->sbol_owner->properties.access(this->slot, this->type);
+        PropertyValue::Kind kind = value_store[0].kind();
+        if (this->sbol_owner->doc && kind == PropertyValue::URI)
         {
-            this->sbol_owner->properties[this->type].push_back("\"\"");
+            for (auto &i_val : value_store)
+                this->sbol_owner->reindex(this->type, i_val.str(), "");
         }
+        value_store.clear();
+        value_store.push_back(PropertyValue(kind));  // An empty value of the same kind marks the property as unset
     }
     
     template <class LiteralType>
@@ -334,7 +433,7 @@ namespace sbol
     {
         std::string subject = (*this->sbol_owner).identity.get();
         sbol_type predicate = type;
-        std::string object = this->sbol_owner->properties[type].front();
+        std::string object = this->sbol_owner->properties.access(slot, type).front().str();
         
         std::cout << "Subject:  " << subject << std::endl;
         std::cout << "Predicate: " << predicate << std::endl;
@@ -363,15 +462,13 @@ namespace sbol
     {
         if (sbol_owner)
         {
-            std::string current_value = this->sbol_owner->properties[this->type][0];
-            if (current_value[0] == '<')  //  this property is a uri
-            {
-                this->sbol_owner->properties[this->type].push_back("<" + new_value + ">");
-            }
-            else if (current_value[0] == '"') // this property is a literal
-            {
-                this->sbol_owner->properties[this->type].push_back("\"" + new_value + "\"");
-            }
+            std::vector<PropertyValue>& value_store = this->sbol_owner->properties.access(this->slot, this->type);
+            if (value_store.size() == 1 && value_store[0].empty())
+                value_store[0].set(new_value);  // The first value replaces the empty placeholder
+            else
+                value_store.push_back(PropertyValue(value_store[0].kind(), new_value));  // New values take the kind of the values already in the list
+            if (this->sbol_owner->doc && value_store[0].isURI())
+                this->sbol_owner->reindex(this->type, "", new_value);
             validate((void *)&new_value);  //  Call validation rules associated with this Property
         }
     };
@@ -381,14 +478,19 @@ namespace sbol
     {
         if (this->sbol_owner)
         {
-            if (this->sbol_owner->properties.find(this->type) != this->sbol_owner->properties.end())
+            std::vector<PropertyValue>* value_store = this->sbol_owner->properties.get(this->slot, this->type);
+            if (value_store)
             {
-                if (index >= this->sbol_owner->properties[this->type].size())
+                if (index >= value_store->size())
                     throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Index out of range");
-                if (this->sbol_owner->properties[this->type].size() == 1)
+                if (value_store->size() == 1)
                     this->clear();  // If this is the only value in the property, then clearing it will properly re-initialize the property
                 else
-                    this->sbol_owner->properties[this->type].erase( this->sbol_owner->properties[this->type].begin() + index);
+                {
+                    if (this->sbol_owner->doc && (*value_store)[index].isURI())
+                        this->sbol_owner->reindex(this->type, (*value_store)[index].str(), "");
+                    value_store->erase(value_store->begin() + index);
+                }
             }
         }
     };
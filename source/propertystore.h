@@ -0,0 +1,381 @@
+/**
+ * @file    propertystore.h
+ * @brief   PropertyStore class, the slot-indexed storage behind an SBOLObject's properties
+ * @author  Bryan Bartley
+ * @email   bartleyba@sbolstandard.org
+ *
+ * <!--------------------------------------------------------------------------
+ * This file is part of libSBOL.  Please visit http://sbolstandard.org for more
+ * information about SBOL, and the latest version of libSBOL.
+ *
+ *  Copyright 2016 University of Washington, WA, USA
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ------------------------------------------------------------------------->*/
+
+#ifndef PROPERTYSTORE_INCLUDED
+#define PROPERTYSTORE_INCLUDED
+
+#include "property.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+namespace sbol
+{
+    /// @cond
+    /// The layout shared by all objects of one SBOL class.  Each property URI is assigned a fixed slot the first time a Property member registers it, so later objects of the class find their properties by index rather than by comparing URIs.
+    /// Slots are looked up far more often than they are declared, and a class's first object may be constructed on any thread while other threads look up slots.  So the layout is frozen once it is built: declaring a new slot publishes a new frozen layout, and lookups read the current one without taking a lock
+    class SBOL_DECLSPEC PropertySchema
+    {
+    public:
+        static const std::size_t npos = (std::size_t)-1;
+
+        PropertySchema() :
+            current(new Layout())
+        {
+            layouts.emplace_back(current.load());
+        };
+
+        /// @return The slot for a property, or npos if the class has no such property
+        std::size_t slot(const sbol_type& property_uri) const
+        {
+            const Layout& layout = *current.load(std::memory_order_acquire);
+            auto i_slot = layout.slots.find(property_uri);
+            if (i_slot == layout.slots.end())
+                return npos;
+            return i_slot->second;
+        };
+
+        /// Assigns a slot to a property, or returns the slot it already has
+        std::size_t declare(const sbol_type& property_uri)
+        {
+            std::size_t i_slot = slot(property_uri);
+            if (i_slot != npos)
+                return i_slot;
+
+            // Another thread may have declared the property since it was looked up, so check again under the lock
+            std::lock_guard<std::mutex> guard(declare_mutex);
+            const Layout& layout = *current.load(std::memory_order_acquire);
+            auto i_declared = layout.slots.find(property_uri);
+            if (i_declared != layout.slots.end())
+                return i_declared->second;
+            keys.push_back(property_uri);
+            Layout* next_layout = new Layout(layout);
+            next_layout->slots[keys.back()] = next_layout->keys.size();
+            next_layout->keys.push_back(&keys.back());
+            layouts.emplace_back(next_layout);
+            current.store(next_layout, std::memory_order_release);
+            return next_layout->keys.size() - 1;
+        };
+
+        /// @return The property URI of a slot. A deque never moves its elements, so the reference stays valid as slots are declared
+        const sbol_type& key(std::size_t slot) const
+        {
+            return *current.load(std::memory_order_acquire)->keys[slot];
+        };
+
+        /// @return The number of slots assigned so far
+        std::size_t size() const
+        {
+            return current.load(std::memory_order_acquire)->keys.size();
+        };
+
+    private:
+        /// A frozen layout, which is never modified once it is published
+        struct Layout
+        {
+            std::vector<const sbol_type*> keys;
+            std::unordered_map<sbol_type, std::size_t> slots;
+        };
+
+        std::atomic<const Layout*> current;
+        std::deque<sbol_type> keys;  // A deque never moves its elements, so slots can refer to their keys
+        std::vector<std::unique_ptr<const Layout>> layouts;  // Superseded layouts are kept, since a lookup may still be reading one
+        std::mutex declare_mutex;
+    };
+
+    /// Stores the values of an SBOLObject's properties, keyed by property URI.  Properties declared by the object's class are held in a contiguous array of slots laid out by the class's PropertySchema, while extension annotations go into a side map.  The interface follows std::map, so entries are visited with first and second
+    template <class Store>
+    class PropertyStore
+    {
+    public:
+        struct Entry
+        {
+            const sbol_type& first;
+            Store second;
+            bool present;
+        };
+
+        class iterator
+        {
+            friend class PropertyStore;
+            PropertyStore* store;
+            std::size_t i_slot;
+            typename std::map<sbol_type, std::unique_ptr<Entry>>::iterator i_extension;
+
+            iterator(PropertyStore* store, std::size_t i_slot, typename std::map<sbol_type, std::unique_ptr<Entry>>::iterator i_extension) :
+                store(store),
+                i_slot(i_slot),
+                i_extension(i_extension)
+            {
+                skip();
+            };
+
+            // Absent slots are passed over, as if the key were not in a map
+            void skip()
+            {
+                while (i_slot < store->slots.size() && !store->slots[i_slot].present)
+                    ++i_slot;
+            };
+
+        public:
+            iterator() :
+                store(NULL),
+                i_slot(0)
+            {
+            };
+
+            Entry& operator*() const
+            {
+                if (i_slot < store->slots.size())
+                    return store->slots[i_slot];
+                return *i_extension->second;
+            };
+
+            Entry* operator->() const
+            {
+                return &**this;
+            };
+
+            iterator& operator++()
+            {
+                if (i_slot < store->slots.size())
+                {
+                    ++i_slot;
+                    skip();
+                }
+                else
+                    ++i_extension;
+                return *this;
+            };
+
+            iterator operator++(int)
+            {
+                iterator previous = *this;
+                ++*this;
+                return previous;
+            };
+
+            bool operator==(const iterator& other) const
+            {
+                return i_slot == other.i_slot && i_extension == other.i_extension;
+            };
+
+            bool operator!=(const iterator& other) const
+            {
+                return !(*this == other);
+            };
+        };
+
+        PropertyStore(const sbol_type& class_type = UNDEFINED) :
+            schema(&lookupSchema(class_type))
+        {
+        };
+
+        PropertyStore(const PropertyStore& other) :
+            schema(other.schema),
+            slots(other.slots)
+        {
+            for (auto &i_extension : other.extensions)
+                (*this)[i_extension.first] = i_extension.second->second;
+        };
+
+        PropertyStore& operator=(const PropertyStore& other)
+        {
+            if (this == &other)
+                return *this;
+            clear();
+            for (auto &i_slot : other.slots)
+            {
+                if (i_slot.present)
+                    (*this)[i_slot.first] = i_slot.second;
+            }
+            for (auto &i_extension : other.extensions)
+                (*this)[i_extension.first] = i_extension.second->second;
+            return *this;
+        };
+
+        iterator begin()
+        {
+            return iterator(this, 0, extensions.begin());
+        };
+
+        iterator end()
+        {
+            return iterator(this, slots.size(), extensions.end());
+        };
+
+        iterator find(const sbol_type& property_uri)
+        {
+            std::size_t i_slot = schema->slot(property_uri);
+            if (i_slot != PropertySchema::npos)
+            {
+                if (i_slot < slots.size() && slots[i_slot].present)
+                    return iterator(this, i_slot, extensions.begin());
+                return end();
+            }
+            auto i_extension = extensions.find(property_uri);
+            if (i_extension == extensions.end())
+                return end();
+            return iterator(this, slots.size(), i_extension);
+        };
+
+        std::size_t count(const sbol_type& property_uri)
+        {
+            return find(property_uri) == end() ? 0 : 1;
+        };
+
+        /// Number of properties present, including extension annotations
+        std::size_t size() const
+        {
+            std::size_t n_present = extensions.size();
+            for (auto &i_slot : slots)
+            {
+                if (i_slot.present)
+                    ++n_present;
+            }
+            return n_present;
+        };
+
+        Store& operator[](const sbol_type& property_uri)
+        {
+            std::size_t i_slot = schema->slot(property_uri);
+            if (i_slot != PropertySchema::npos)
+                return access(i_slot, property_uri);
+            auto i_extension = extensions.find(property_uri);
+            if (i_extension == extensions.end())
+            {
+                i_extension = extensions.insert(std::make_pair(property_uri, std::unique_ptr<Entry>())).first;
+                i_extension->second.reset(new Entry{ i_extension->first, Store(), true });
+            }
+            return i_extension->second->second;
+        };
+
+        /// Registers a property declared by the object's class and gives it an initial value, unless it already has one
+        /// @return The slot assigned to the property, which a Property member keeps for constant-time access
+        std::size_t declare(const sbol_type& property_uri, const Store& initial_value)
+        {
+            std::size_t i_slot = schema->declare(property_uri);
+            reserve(i_slot);
+            if (!slots[i_slot].present)
+            {
+                slots[i_slot].second = initial_value;
+                slots[i_slot].present = true;
+            }
+            return i_slot;
+        };
+
+        /// Registers a property with an initial value, unless it already has one
+        void insert(const std::pair<sbol_type, Store>& property)
+        {
+            declare(property.first, property.second);
+        };
+
+        /// @return The values of a property, looked up by its slot if it has one, or NULL if the property is not present
+        Store* get(std::size_t i_slot, const sbol_type& property_uri)
+        {
+            if (i_slot != PropertySchema::npos)
+            {
+                if (i_slot < slots.size() && slots[i_slot].present)
+                    return &slots[i_slot].second;
+                return NULL;
+            }
+            auto i_property = find(property_uri);
+            if (i_property == end())
+                return NULL;
+            return &i_property->second;
+        };
+
+        /// @return The values of a property, looked up by its slot if it has one. The property is added if it is not present
+        Store& access(std::size_t i_slot, const sbol_type& property_uri)
+        {
+            if (i_slot == PropertySchema::npos)
+                return (*this)[property_uri];
+            reserve(i_slot);
+            slots[i_slot].present = true;
+            return slots[i_slot].second;
+        };
+
+        void erase(const sbol_type& property_uri)
+        {
+            std::size_t i_slot = schema->slot(property_uri);
+            if (i_slot != PropertySchema::npos)
+            {
+                if (i_slot < slots.size())
+                {
+                    slots[i_slot].second.clear();
+                    slots[i_slot].present = false;
+                }
+            }
+            else
+                extensions.erase(property_uri);
+        };
+
+        void clear()
+        {
+            for (auto &i_slot : slots)
+            {
+                i_slot.second.clear();
+                i_slot.present = false;
+            }
+            extensions.clear();
+        };
+
+    private:
+        PropertySchema* schema;
+        std::vector<Entry> slots;
+        std::map<sbol_type, std::unique_ptr<Entry>> extensions;  // Extension annotations, which are not part of the class layout
+
+        void reserve(std::size_t i_slot)
+        {
+            if (slots.size() > i_slot)
+                return;
+            slots.reserve(std::max(i_slot + 1, schema->size()));  // Room for every property of the class, so the slots are allocated once
+            while (slots.size() <= i_slot)
+                slots.push_back(Entry{ schema->key(slots.size()), Store(), false });
+        };
+
+        // Each class type has one schema per kind of store. Schemas live for the whole program, since every object of the class refers to them
+        static PropertySchema& lookupSchema(const sbol_type& class_type)
+        {
+            static std::unordered_map<sbol_type, PropertySchema*> schemas;
+            static std::mutex schemas_mutex;
+            std::lock_guard<std::mutex> guard(schemas_mutex);
+            PropertySchema*& schema = schemas[class_type];
+            if (!schema)
+                schema = new PropertySchema();
+            return *schema;
+        };
+    };
+    /// @endcond
+}
+
+#endif /* PROPERTYSTORE_INCLUDED */
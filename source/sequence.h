@@ -49,7 +49,7 @@ namespace sbol
         URIProperty encoding;
 
         /// Calculates the complete sequence of a high-level Component from the sequence of its subcomponents. Pior to assembling the the complete sequence, you must assemble a template design by calling ComponentDefinition::assemble for the ComponentDefinition that references this Sequence.
-        /// @param composite_sequence Typically no value for the composite sequence should be specified by the user. This parameter is used to hold the composite sequence as it is passed to function calls at a higher-level of the recursion stack.
+        /// @param composite_sequence Typically no value for the composite sequence should be specified by the user. If one is given, it is prepended to the assembled sequence.
         std::string assemble(std::string composite_sequence = "");
 
         /// Synonomous with Sequence::assemble. Calculates the complete sequence of a high-level Component from the sequence of its subcomponents. Prior to assembling the the complete sequence, you must assemble a template design by calling ComponentDefinition::assemble for the ComponentDefinition that references this Sequence.
@@ -57,6 +57,22 @@ namespace sbol
         
         /// @param clone_id A URI for the build, or displayId if working in SBOLCompliant mode.
         ComponentDefinition& synthesize(std::string clone_id);
+
+        /// Long IUPAC DNA and RNA sequences are kept packed, two bits per base, while they belong to a Document.  This method and the ones below read the packed elements without unpacking them, whereas getting the elements as a string unpacks them.
+        /// @return The number of elements
+        int length();
+
+        /// Complements each base of an IUPAC DNA or RNA sequence, including ambiguity codes, and reverses their order.  Letters keep their case.
+        /// @return The reverse complement
+        std::string reverseComplement();
+
+        /// @return The fraction of the elements of an IUPAC DNA or RNA sequence that are G, C or S (strong). Other ambiguity codes are not counted
+        double gcContent();
+
+        /// @param start The position of the first element, starting from 1 as in a Range
+        /// @param end The position of the last element, which is included
+        /// @return The elements from start to end
+        std::string subsequence(int start, int end);
         
         /// Construct a ComponentDefinition
         /// @param uri A full URI including a scheme, namespace, and identifier.  If SBOLCompliance configuration is enabled, then this argument is simply the displayId for the new object and a full URI will automatically be constructed.
@@ -0,0 +1,75 @@
+/**
+ * @file    symboltable.cpp
+ * @brief   SymbolTable class, an interned string table used by the RDF parser
+ * @author  Bryan Bartley
+ * @email   bartleyba@sbolstandard.org
+ *
+ * <!--------------------------------------------------------------------------
+ * This file is part of libSBOL.  Please visit http://sbolstandard.org for more
+ * information about SBOL, and the latest version of libSBOL.
+ *
+ *  Copyright 2016 University of Washington, WA, USA
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ------------------------------------------------------------------------->*/
+
+#include "symboltable.h"
+
+#include <string>
+
+using namespace sbol;
+using namespace std;
+
+symbol_id SymbolTable::intern(const char* str, std::size_t len)
+{
+    key_buffer.assign(str, len);
+    auto i_sym = index.find(key_buffer);
+    if (i_sym != index.end())
+        return i_sym->second;
+
+    // Keys of an unordered_map are never relocated, so the table can hand out references to them
+    symbol_id id = symbols.size();
+    auto i_new = index.insert(make_pair(key_buffer, id)).first;
+    symbols.push_back(&i_new->first);
+    return id;
+};
+
+symbol_id SymbolTable::intern(raptor_term* term)
+{
+    size_t len = 0;
+    switch (term->type)
+    {
+        case RAPTOR_TERM_TYPE_URI:
+        {
+            const char* uri = (const char*)raptor_uri_as_counted_string(term->value.uri, &len);
+            return intern(uri, len);
+        }
+        case RAPTOR_TERM_TYPE_BLANK:
+        {
+            // Blank nodes are distinguished from URIs with the N-Triples prefix
+            string blank_id = "_:";
+            blank_id.append((const char*)term->value.blank.string, term->value.blank.string_len);
+            return intern(blank_id);
+        }
+        case RAPTOR_TERM_TYPE_LITERAL:
+            return intern((const char*)term->value.literal.string, term->value.literal.string_len);
+        default:
+            throw SBOLError(SBOL_ERROR_PARSE, "Cannot intern an unknown RDF term");
+    }
+};
+
+void SymbolTable::clear()
+{
+    symbols.clear();
+    index.clear();
+};
@@ -0,0 +1,87 @@
+/**
+ * @file    symboltable.h
+ * @brief   SymbolTable class, an interned string table used by the RDF parser
+ * @author  Bryan Bartley
+ * @email   bartleyba@sbolstandard.org
+ *
+ * <!--------------------------------------------------------------------------
+ * This file is part of libSBOL.  Please visit http://sbolstandard.org for more
+ * information about SBOL, and the latest version of libSBOL.
+ *
+ *  Copyright 2016 University of Washington, WA, USA
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ------------------------------------------------------------------------->*/
+
+#ifndef SYMBOLTABLE_INCLUDED
+#define SYMBOLTABLE_INCLUDED
+
+#include "config.h"
+
+#include <raptor2.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace sbol
+{
+    /// @cond
+    typedef std::size_t symbol_id;
+    /// @endcond
+
+    /// An interned table of URIs and other terms. Each distinct string is stored once and identified by a stable integer id, so parser handlers can compare and hash terms without allocating fresh strings for every triple
+    class SBOL_DECLSPEC SymbolTable
+    {
+    private:
+        std::unordered_map<std::string, symbol_id> index;
+        std::vector<const std::string*> symbols;
+        std::string key_buffer;  ///< Reusable buffer for lookups, so finding an existing symbol does not allocate
+
+    public:
+        SymbolTable() {};
+
+        /// Intern a string
+        /// @param str A pointer to the characters of the string
+        /// @param len The number of characters
+        /// @return The id of the interned string
+        symbol_id intern(const char* str, std::size_t len);
+
+        /// Intern a string
+        /// @return The id of the interned string
+        symbol_id intern(const std::string& str)
+        {
+            return intern(str.c_str(), str.size());
+        };
+
+        /// Intern the lexical form of a URI or blank node term directly from the raptor term, without converting it to an N-Triples string. Literal terms are interned by their value.
+        /// @return The id of the interned term
+        symbol_id intern(raptor_term* term);
+
+        /// @return The interned string. The reference remains valid until the table is cleared
+        const std::string& operator[] (const symbol_id id) const
+        {
+            return *symbols[id];
+        };
+
+        /// @return The number of distinct strings in the table
+        std::size_t size() const
+        {
+            return symbols.size();
+        };
+
+        /// Remove all strings from the table. Previously issued ids and references become invalid
+        void clear();
+    };
+}
+
+#endif /* SYMBOLTABLE_INCLUDED */
@@ -0,0 +1,251 @@
+#define RAPTOR_STATIC
+
+#include "sbol.h"
+
+#ifdef _WIN32
+    #include "dirent.h"
+#else
+    #include <dirent.h>
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+using namespace sbol;
+
+// Reference implementation of the original reader, which makes one pass over the input to construct objects and a second pass to assign their properties
+void read_two_pass(Document& doc, string& sbol)
+{
+    raptor_world* world = doc.getWorld();
+    raptor_parser* rdf_parser = raptor_new_parser(world, getFileFormat().c_str());
+    raptor_parser_set_namespace_handler(rdf_parser, &doc, Document::namespaceHandler);
+    raptor_uri *base_uri = raptor_new_uri(world, (const unsigned char *)SBOL_URI "#");
+
+    raptor_iostream* ios = raptor_new_iostream_from_string(world, (void *)sbol.c_str(), sbol.size());
+    raptor_parser_set_statement_handler(rdf_parser, &doc, Document::parse_objects);
+    raptor_parser_parse_iostream(rdf_parser, ios, base_uri);
+    raptor_free_iostream(ios);
+
+    ios = raptor_new_iostream_from_string(world, (void *)sbol.c_str(), sbol.size());
+    raptor_parser_set_statement_handler(rdf_parser, &doc, Document::parse_properties);
+    raptor_parser_parse_iostream(rdf_parser, ios, base_uri);
+    raptor_free_iostream(ios);
+
+    raptor_free_uri(base_uri);
+    raptor_free_parser(rdf_parser);
+    for (auto &i_obj : doc.SBOLObjects)
+        doc.index(*i_obj.second);
+    doc.parse_annotation_objects();
+}
+
+double elapsed_ms(chrono::high_resolution_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// Assembles a combinatorial library one construct at a time, then as one batch, and checks that both Documents agree
+int benchmark_assembly(int n_constructs)
+{
+    setHomespace("http://examples.com");
+    vector<string> uris;
+    vector< vector<ComponentDefinition*> > serial_designs;
+    vector< vector<ComponentDefinition*> > batch_designs;
+    Document serial_doc;
+    Document batch_doc;
+    vector<ComponentDefinition*> serial_parts;
+    vector<ComponentDefinition*> batch_parts;
+    for (int i_part = 0; i_part < 24; ++i_part)
+    {
+        serial_parts.push_back(&serial_doc.componentDefinitions.create("part" + to_string(i_part)));
+        batch_parts.push_back(&batch_doc.componentDefinitions.create("part" + to_string(i_part)));
+    }
+    srand(0);
+    for (int i_construct = 0; i_construct < n_constructs; ++i_construct)
+    {
+        uris.push_back("construct" + to_string(i_construct));
+        serial_designs.push_back({});
+        batch_designs.push_back({});
+        for (int i_slot = 0; i_slot < 6; ++i_slot)
+        {
+            int i_part = rand() % serial_parts.size();
+            serial_designs.back().push_back(serial_parts[i_part]);
+            batch_designs.back().push_back(batch_parts[i_part]);
+        }
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    for (int i_construct = 0; i_construct < n_constructs; ++i_construct)
+    {
+        ComponentDefinition& construct = serial_doc.componentDefinitions.create(uris[i_construct]);
+        construct.assemble(serial_designs[i_construct]);
+    }
+    double serial = elapsed_ms(start);
+
+    start = chrono::high_resolution_clock::now();
+    batch_doc.assemble(uris, batch_designs);
+    double batch = elapsed_ms(start);
+
+    cout << "Assembled " << n_constructs << " constructs" << endl;
+    cout << "Serial assembly: " << serial << " ms" << endl;
+    cout << "Batch assembly: " << batch << " ms" << endl;
+    if (batch > 0)
+        cout << "Speedup: " << serial / batch << "x" << endl;
+    if (!serial_doc.compare(&batch_doc))
+    {
+        cout << "XXX Batch assembly differs from serial assembly XXX" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Searches a Document for a library of its own parts on both strands, one part at a time with string::find, then with Document::search on one thread and on all of them
+int benchmark_search(string filename, int n_features)
+{
+    Document doc;
+    doc.read(filename);
+
+    // The library is made of the parts whose sequences are plain bases, and short enough to be features
+    vector<ComponentDefinition*> features;
+    vector<string> patterns;
+    for (auto & cd : doc.componentDefinitions)
+    {
+        if ((int)features.size() == n_features)
+            break;
+        Sequence* seq = dynamic_cast<Sequence*>(doc.find(cd.sequences.get()));
+        if (seq == NULL || seq->encoding.get().compare(SBOL_ENCODING_IUPAC) != 0 || seq->length() < 12 || seq->length() > 300)
+            continue;
+        string pattern = seq->subsequence(1, seq->length());
+        transform(pattern.begin(), pattern.end(), pattern.begin(), ::tolower);
+        if (pattern.find_first_not_of("acgt") != string::npos)
+            continue;
+        features.push_back(&cd);
+        patterns.push_back(pattern);
+    }
+    vector<string> targets;
+    size_t n_bases = 0;
+    for (auto & seq : doc.sequences)
+    {
+        if (seq.encoding.get().compare(SBOL_ENCODING_IUPAC) != 0)
+            continue;
+        string target = seq.subsequence(1, seq.length());
+        transform(target.begin(), target.end(), target.begin(), ::tolower);
+        replace(target.begin(), target.end(), 'u', 't');
+        n_bases += target.size();
+        targets.push_back(target);
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    size_t n_naive = 0;
+    for (auto & pattern : patterns)
+    {
+        string complement(pattern.rbegin(), pattern.rend());
+        for (auto & base : complement)
+            base = base == 'a' ? 't' : base == 't' ? 'a' : base == 'c' ? 'g' : 'c';
+        for (auto & target : targets)
+        {
+            for (size_t i = target.find(pattern); i != string::npos; i = target.find(pattern, i + 1))
+                ++n_naive;
+            if (complement == pattern)
+                continue;
+            for (size_t i = target.find(complement); i != string::npos; i = target.find(complement, i + 1))
+                ++n_naive;
+        }
+    }
+    double naive = elapsed_ms(start);
+
+    start = chrono::high_resolution_clock::now();
+    size_t n_serial = doc.search(features, 1).size();
+    double serial = elapsed_ms(start);
+
+    start = chrono::high_resolution_clock::now();
+    size_t n_parallel = doc.search(features).size();
+    double parallel = elapsed_ms(start);
+
+    cout << "Searched " << targets.size() << " sequences, " << n_bases << " bases, for " << features.size() << " features" << endl;
+    cout << "One feature at a time: " << naive << " ms" << endl;
+    cout << "All features, one thread: " << serial << " ms" << endl;
+    cout << "All features, all threads: " << parallel << " ms" << endl;
+    if (parallel > 0)
+        cout << "Speedup: " << naive / parallel << "x" << endl;
+    if (n_serial != n_naive || n_parallel != n_naive)
+    {
+        cout << "XXX Found " << n_serial << " and " << n_parallel << " matches, expected " << n_naive << " XXX" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    int repeats = 5;
+    if (argc > 1)
+        repeats = atoi(argv[1]);
+    int n_constructs = 2000;
+    if (argc > 2)
+        n_constructs = atoi(argv[2]);
+
+    string path = "roundtrip";
+    DIR* valid = opendir(path.c_str());
+    if (!valid)
+    {
+        cout << "Could not open " << path << endl;
+        return 1;
+    }
+
+    double two_pass_total = 0;
+    double one_pass_total = 0;
+    int mismatched = 0;
+    struct dirent * file = readdir(valid);
+    while (file)
+    {
+        string filename = string(file->d_name);
+        if (filename[0] != '.' && filename.compare(0, 4, "new_") != 0)
+        {
+            ifstream fh(path + "/" + filename, ios::binary);
+            stringstream buffer;
+            buffer << fh.rdbuf();
+            string sbol = buffer.str();
+
+            double two_pass = 0;
+            double one_pass = 0;
+            for (int i_rep = 0; i_rep < repeats; ++i_rep)
+            {
+                Document& two_pass_doc = *new Document();
+                auto start = chrono::high_resolution_clock::now();
+                read_two_pass(two_pass_doc, sbol);
+                two_pass += elapsed_ms(start);
+
+                Document& one_pass_doc = *new Document();
+                start = chrono::high_resolution_clock::now();
+                one_pass_doc.readString(sbol);
+                one_pass += elapsed_ms(start);
+
+                if (i_rep == 0 && !two_pass_doc.compare(&one_pass_doc))
+                {
+                    cout << "XXX " << filename << " parsed differently XXX" << endl;
+                    ++mismatched;
+                }
+                delete &two_pass_doc;
+                delete &one_pass_doc;
+            }
+            cout << filename << "\ttwo-pass " << two_pass / repeats << " ms\tone-pass " << one_pass / repeats << " ms" << endl;
+            two_pass_total += two_pass / repeats;
+            one_pass_total += one_pass / repeats;
+        }
+        file = readdir(valid);
+    }
+    closedir(valid);
+    cout << "Total two-pass: " << two_pass_total << " ms" << endl;
+    cout << "Total one-pass: " << one_pass_total << " ms" << endl;
+    if (one_pass_total > 0)
+        cout << "Speedup: " << two_pass_total / one_pass_total << "x" << endl;
+    cout << "Mismatched: " << mismatched << endl;
+    int failed = benchmark_assembly(n_constructs);
+    failed = benchmark_search(path + "/labhost_All.rdf", 500) || failed;
+    return mismatched != 0 || failed;
+}
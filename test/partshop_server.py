@@ -0,0 +1,146 @@
+# A local stand-in for a SynBioHub repository, for the PartShop tests in unit.cpp
+#
+#     python3 partshop_server.py 8766 &
+#     ./sbol_unit http://127.0.0.1:8766
+#
+# It serves a ComponentDefinition "top" with 20 Components, whose parts refer to Sequences. Even parts bundle their
+# Sequence in the same response, and part3 also refers to a Sequence that does not exist. Responses carry an ETag and
+# answer a matching If-None-Match with 304. GET /stats returns the number of connections opened, requests served and
+# 304 responses sent. Searches page through 1000 records, except that a search for "broken" answers every page after the
+# first with text that is not JSON. Submissions echo back the file they uploaded. POST /validate answers as the online
+# validator does, finding every file valid.
+
+import email.parser
+import gzip
+import hashlib
+import http.server
+import json
+import socket
+import socketserver
+import sys
+import urllib.parse
+
+PORT = int(sys.argv[1]) if len(sys.argv) > 1 else 8766
+BASE = 'http://127.0.0.1:%d' % PORT
+HEAD = ('<?xml version="1.0" ?><rdf:RDF xmlns:rdf="http://www.w3.org/1999/02/22-rdf-syntax-ns#" '
+        'xmlns:sbol="http://sbols.org/v2#" xmlns:dcterms="http://purl.org/dc/terms/" xmlns:prov="http://www.w3.org/ns/prov#">')
+TAIL = '</rdf:RDF>'
+N_PARTS = 20
+N_RECORDS = 1000
+DNA = 'http://www.biopax.org/release/biopax-level3.owl#DnaRegion'
+IUPAC = 'http://www.chem.qmul.ac.uk/iubmb/misc/naseq.html'
+
+
+def identified(uri, display_id):
+    return ('<sbol:persistentIdentity rdf:resource="%s"/><sbol:displayId>%s</sbol:displayId><sbol:version>1</sbol:version>'
+            % (uri, display_id))
+
+
+def sequence(i):
+    uri = '%s/seq/part%d_seq' % (BASE, i)
+    return ('<sbol:Sequence rdf:about="%s/1">%s<sbol:elements>acgt%s</sbol:elements><sbol:encoding rdf:resource="%s"/></sbol:Sequence>'
+            % (uri, identified(uri, 'part%d_seq' % i), 'a' * i, IUPAC))
+
+
+def part(i):
+    uri = '%s/cd/part%d' % (BASE, i)
+    missing = '<sbol:sequence rdf:resource="%s/seq/missing%d/1"/>' % (BASE, i) if i == 3 else ''
+    return ('<sbol:ComponentDefinition rdf:about="%s/1">%s<sbol:type rdf:resource="%s"/><sbol:sequence rdf:resource="%s/seq/part%d_seq/1"/>%s</sbol:ComponentDefinition>'
+            % (uri, identified(uri, 'part%d' % i), DNA, BASE, i, missing))
+
+
+def top():
+    uri = '%s/cd/top' % BASE
+    components = ''.join('<sbol:component><sbol:Component rdf:about="%s/c%d/1">%s<sbol:definition rdf:resource="%s/cd/part%d/1"/>'
+                         '<sbol:access rdf:resource="http://sbols.org/v2#public"/></sbol:Component></sbol:component>'
+                         % (uri, i, identified('%s/c%d' % (uri, i), 'c%d' % i), BASE, i) for i in range(N_PARTS))
+    return ('<sbol:ComponentDefinition rdf:about="%s/1">%s<sbol:type rdf:resource="%s"/>%s</sbol:ComponentDefinition>'
+            % (uri, identified(uri, 'top'), DNA, components))
+
+
+stats = {'connections': 0, 'requests': 0, 'not_modified': 0}
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def setup(self):
+        super().setup()
+        stats['connections'] += 1
+        self.connection.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    def log_message(self, *args):
+        pass
+
+    def send(self, code, body):
+        body = body.encode() if isinstance(body, str) else body
+        etag = '"' + hashlib.md5(body).hexdigest() + '"'
+        if code == 200 and self.headers.get('If-None-Match') == etag:
+            stats['not_modified'] += 1
+            self.send_response(304)
+            self.send_header('ETag', etag)
+            self.send_header('Content-Length', '0')
+            self.end_headers()
+            return
+        self.send_response(code)
+        self.send_header('ETag', etag)
+        self.send_header('Last-Modified', 'Wed, 21 Oct 2015 07:28:00 GMT')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_GET(self):
+        path = self.path
+        if path == '/stats':
+            return self.send(200, '%(connections)d %(requests)d %(not_modified)d' % stats)
+        stats['requests'] += 1
+        if '/remoteSearch/' in path:
+            query = urllib.parse.unquote(path.split('/remoteSearch/')[1])
+            page = dict(kv.split('=') for kv in query.split('/?')[1].split('&'))
+            offset, limit = int(page['offset']), int(page['limit'])
+            if 'broken' in query and offset > 0:
+                return self.send(200, 'not a page of records')
+            records = [{'uri': '%s/cd/rec%d/1' % (BASE, i), 'displayId': 'rec%d' % i, 'name': 'record %d' % i,
+                        'description': 'x' * 200, 'version': '1'} for i in range(offset, min(offset + limit, N_RECORDS))]
+            return self.send(200, json.dumps(records))
+        if path.endswith('/count'):
+            return self.send(200, '42')
+        if path == '/cd/top/1/sbol':
+            return self.send(200, HEAD + top() + TAIL)
+        if path.startswith('/cd/part'):
+            i = int(path.split('/')[2][4:])
+            return self.send(200, HEAD + part(i) + (sequence(i) if i % 2 == 0 else '') + TAIL)
+        if path.startswith('/seq/part'):
+            i = int(path.split('/')[2][4:].split('_')[0])
+            return self.send(200, HEAD + sequence(i) + TAIL)
+        self.send(404, 'not found')
+
+    def do_POST(self):
+        chunks = []
+        if self.headers.get('Transfer-Encoding') == 'chunked':
+            while True:
+                size = int(self.rfile.readline().strip(), 16)
+                if size == 0:
+                    self.rfile.readline()
+                    break
+                chunks.append(self.rfile.read(size))
+                self.rfile.readline()
+        else:
+            chunks.append(self.rfile.read(int(self.headers['Content-Length'])))
+        body = b''.join(chunks)
+        if self.path == '/validate':
+            stats['requests'] += 1
+            json.loads(body.decode())
+            return self.send(200, json.dumps({'valid': True, 'errors': []}))
+        if self.headers.get('Content-Encoding') == 'gzip':
+            body = gzip.decompress(body)
+        message = email.parser.BytesParser().parsebytes(b'Content-Type: ' + self.headers['Content-Type'].encode() + b'\r\n\r\n' + body)
+        fields = dict((field.get_param('name', header='content-disposition'), field.get_payload(decode=True)) for field in message.get_payload())
+        self.send(200, fields['file'])
+
+
+class Server(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+
+
+Server(('127.0.0.1', PORT), Handler).serve_forever()
@@ -0,0 +1,1239 @@
+#define RAPTOR_STATIC
+
+#include "sbol.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+#endif
+
+using namespace std;
+using namespace sbol;
+
+int passed = 0;
+int failed = 0;
+
+void check(bool is_true, string description)
+{
+    if (is_true)
+    {
+        std::cout << "=== " << description << " passed ===" << std::endl;
+        ++passed;
+    }
+    else
+    {
+        std::cout << "XXX " << description << " failed XXX" << std::endl;
+        ++failed;
+    }
+}
+
+// Wraps RDF/XML elements in an rdf:RDF document with the SBOL, Dublin Core and example namespaces
+string rdf_document(string body)
+{
+    return "<?xml version=\"1.0\" ?>"
+        "<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\" xmlns:sbol=\"http://sbols.org/v2#\" "
+        "xmlns:dcterms=\"http://purl.org/dc/terms/\" xmlns:ex=\"http://examples.com/terms#\">" + body + "</rdf:RDF>";
+}
+
+// Reads objects whose statements come before their type, and objects that are already in the Document, as the two-pass parser read them
+void test_single_pass_read()
+{
+    string cd_type = "<rdf:type rdf:resource=\"http://sbols.org/v2#ComponentDefinition\"/>";
+    string seq_type = "<rdf:type rdf:resource=\"http://sbols.org/v2#Sequence\"/>";
+    string sbol = rdf_document(
+        "<rdf:Description rdf:about=\"http://examples.com/reads/promoter/1\">"
+        "<sbol:displayId>promoter</sbol:displayId><sbol:sequence rdf:resource=\"http://examples.com/reads/promoter_seq/1\"/>"
+        "<sbol:sequenceAnnotation><rdf:Description rdf:about=\"http://examples.com/reads/promoter/anno/1\">"
+        "<sbol:displayId>anno</sbol:displayId><rdf:type rdf:resource=\"http://sbols.org/v2#SequenceAnnotation\"/>"
+        "</rdf:Description></sbol:sequenceAnnotation>" + cd_type + "</rdf:Description>"
+        "<rdf:Description rdf:about=\"http://examples.com/reads/promoter_seq/1\"><sbol:elements>tata</sbol:elements>" + seq_type + "</rdf:Description>"
+        "<rdf:Description rdf:about=\"http://examples.com/reads/untyped/1\"><sbol:displayId>untyped</sbol:displayId></rdf:Description>");
+    Document doc;
+    doc.readString(sbol);
+    ComponentDefinition& promoter = doc.componentDefinitions.get("http://examples.com/reads/promoter/1");
+    check(promoter.displayId.get() == "promoter" && promoter.sequences.get() == "http://examples.com/reads/promoter_seq/1"
+          && doc.sequences.get("http://examples.com/reads/promoter_seq/1").elements.get() == "tata", "Reading statements that come before their object's type");
+    check(promoter.sequenceAnnotations.size() == 1 && promoter.sequenceAnnotations[0].displayId.get() == "anno"
+          && doc.find("http://examples.com/reads/promoter/anno/1") == &promoter.sequenceAnnotations[0], "Nesting child objects read before their parent is typed");
+    check(doc.find("http://examples.com/reads/untyped/1") == NULL, "Discarding statements about untyped subjects");
+
+    // A second read into the same Document adds its statements to the objects that are already there
+    string more_sbol = rdf_document(
+        "<rdf:Description rdf:about=\"http://examples.com/reads/promoter/1\"><ex:note>added</ex:note>" + cd_type + "</rdf:Description>"
+        "<rdf:Description rdf:about=\"http://examples.com/reads/terminator/1\"><sbol:displayId>terminator</sbol:displayId>" + cd_type + "</rdf:Description>");
+    doc.readString(more_sbol);
+    check(&doc.componentDefinitions.get("http://examples.com/reads/promoter/1") == &promoter && doc.componentDefinitions.size() == 2
+          && promoter.getAnnotation("http://examples.com/terms#note") == "added" && promoter.displayId.get() == "promoter", "Reading statements about objects already in the Document");
+    check(doc.componentDefinitions.get("http://examples.com/reads/terminator/1").displayId.get() == "terminator", "Reading new objects into a Document that is not empty");
+}
+
+// Interns each distinct string once, and reads plain literals exactly as they were written
+void test_symbol_table()
+{
+    SymbolTable symbols;
+    symbol_id promoter = symbols.intern("http://examples.com/promoter/1");
+    const string& promoter_str = symbols[promoter];
+    symbol_id type = symbols.intern(string("http://sbols.org/v2#ComponentDefinition"));
+    check(promoter != type && symbols.intern(string("http://examples.com/promoter/1")) == promoter && symbols.size() == 2, "Interning each distinct string once");
+    for (int i_sym = 0; i_sym < 1000; ++i_sym)
+        symbols.intern("http://examples.com/part_" + to_string(i_sym) + "/1");
+    check(symbols.size() == 1002 && &symbols[promoter] == &promoter_str && promoter_str == "http://examples.com/promoter/1"
+          && symbols.intern("http://examples.com/part_999/1") == 1001, "Keeping interned strings in place as the table grows");
+    symbols.clear();
+    check(symbols.size() == 0 && symbols.intern("http://examples.com/promoter/1") == 0, "Clearing a symbol table");
+
+    string sbol = rdf_document(
+        "<sbol:ComponentDefinition rdf:about=\"http://examples.com/literals/1\">"
+        "<dcterms:title>a &quot;quoted&quot; &amp; &lt;bracketed&gt; title</dcterms:title><dcterms:description></dcterms:description>"
+        "</sbol:ComponentDefinition>");
+    Document doc;
+    doc.readString(sbol);
+    ComponentDefinition& cd = doc.componentDefinitions.get("http://examples.com/literals/1");
+    check(cd.name.get() == "a \"quoted\" & <bracketed> title" && cd.description.get() == "", "Reading plain literals without N-Triples escapes");
+}
+
+// Lists the objects that refer to a URI in the order they began to refer to it, and keeps them as their property stores grow
+void test_referrers()
+{
+    Document doc;
+    Sequence& shared_seq = doc.sequences.create("shared_seq");
+    Sequence& other_seq = doc.sequences.create("other_seq");
+    vector<SBOLObject*> users;
+    for (int i_cd = 0; i_cd < 50; ++i_cd)
+    {
+        // Identities are created in descending order, so neither identity order nor allocation order matches the order of the references
+        ComponentDefinition& cd = doc.componentDefinitions.create("user_" + to_string(99 - i_cd));
+        cd.sequences.set(shared_seq.identity.get());
+        users.push_back(&cd);
+    }
+    check(doc.getReferrers(shared_seq.identity.get()) == users && doc.getReferrers(shared_seq.identity.get(), SBOL_SEQUENCE_PROPERTY) == users
+          && doc.getReferrers(shared_seq.identity.get(), SBOL_DEFINITION).empty(), "Listing referrers in the order they began to refer to a URI");
+
+    // Growing the referrer's property store rehashes it
+    ComponentDefinition& first_user = (ComponentDefinition&)*users.front();
+    for (int i_property = 0; i_property < 200; ++i_property)
+        first_user.setAnnotation("http://examples.com/terms#note_" + to_string(i_property), "note");
+    first_user.sequences.set(other_seq.identity.get());
+    users.erase(users.begin());
+    check(doc.getReferrers(shared_seq.identity.get(), SBOL_SEQUENCE_PROPERTY) == users
+          && doc.getReferrers(other_seq.identity.get()) == vector<SBOLObject*>({ &first_user }), "Moving a reference after the referrer's properties are rehashed");
+
+    first_user.sequences.set(shared_seq.identity.get());
+    users.push_back(&first_user);
+    check(doc.getReferrers(shared_seq.identity.get()) == users && doc.getReferrers(other_seq.identity.get()).empty(), "Listing a returning referrer last");
+}
+
+// Declares and looks up the slots of one schema on several threads at once, which must all see the same layout
+void test_property_schema()
+{
+    PropertySchema schema;
+    vector<vector<size_t>> declared(4);
+    vector<thread> threads;
+    for (size_t i_thread = 0; i_thread < declared.size(); ++i_thread)
+    {
+        threads.push_back(thread([&schema, &declared, i_thread]()
+        {
+            // Each thread declares the same properties, starting at a different one
+            for (int i_property = 0; i_property < 100; ++i_property)
+            {
+                string property_uri = "http://examples.com/terms#property_" + to_string((i_property + 25 * i_thread) % 100);
+                size_t i_slot = schema.declare(property_uri);
+                if (schema.slot(property_uri) != i_slot || schema.key(i_slot) != property_uri)
+                    i_slot = PropertySchema::npos;
+                declared[i_thread].push_back(i_slot);
+            }
+        }));
+    }
+    for (auto &i_thread : threads)
+        i_thread.join();
+
+    bool is_consistent = schema.size() == 100 && schema.slot("http://examples.com/terms#undeclared") == PropertySchema::npos;
+    for (size_t i_thread = 0; is_consistent && i_thread < declared.size(); ++i_thread)
+    {
+        for (int i_property = 0; is_consistent && i_property < 100; ++i_property)
+        {
+            string property_uri = "http://examples.com/terms#property_" + to_string((i_property + 25 * i_thread) % 100);
+            is_consistent = declared[i_thread][i_property] == schema.slot(property_uri);
+        }
+    }
+    check(is_consistent, "Declaring schema slots on several threads");
+}
+
+// Finds nested child objects through the Document's identity index as they are created, added, renamed and removed
+void test_identity_index()
+{
+    Document doc;
+    ComponentDefinition& gene = doc.componentDefinitions.create("gene");
+    SequenceAnnotation& promoter_anno = gene.sequenceAnnotations.create("promoter_anno");
+    Range& promoter_range = promoter_anno.locations.create<Range>("promoter_range");
+    check(doc.find(gene.identity.get()) == &gene && doc.find(promoter_anno.identity.get()) == &promoter_anno
+          && doc.find(promoter_range.identity.get()) == &promoter_range, "Finding created child objects");
+
+    // Children created before their parent is added are indexed with it
+    ComponentDefinition& cds = *new ComponentDefinition("cds");
+    SequenceAnnotation& cds_anno = cds.sequenceAnnotations.create("cds_anno");
+    check(doc.find(cds_anno.identity.get()) == NULL, "Leaving children of an object outside the Document out of its index");
+    doc.add<ComponentDefinition>(cds);
+    check(doc.find(cds.identity.get()) == &cds && doc.find(cds_anno.identity.get()) == &cds_anno, "Finding the children of an added object");
+
+    string old_uri = promoter_range.identity.get();
+    promoter_range.identity.set(old_uri + "_renamed");
+    check(doc.find(old_uri) == NULL && doc.find(old_uri + "_renamed") == &promoter_range, "Moving a renamed object in the index");
+
+    string anno_uri = promoter_anno.identity.get();
+    string range_uri = promoter_range.identity.get();
+    gene.sequenceAnnotations.remove(anno_uri);
+    check(doc.find(anno_uri) == NULL && doc.find(range_uri) == NULL && doc.find(gene.identity.get()) == &gene, "Removing a child and its descendants from the index");
+}
+
+// Resolves a persistentIdentity to its latest version, comparing versions by the value of their numeric parts
+void test_version_index()
+{
+    check(VersionProperty::compare("10.0.0", "9.0.0") > 0 && VersionProperty::compare("1.0", "1.0.0") == 0
+          && VersionProperty::compare("1.0.0-SNAPSHOT", "1.0.0") < 0 && VersionProperty::compare("1.2.3", "1.10") < 0, "Comparing versions");
+
+    Document doc;
+    ComponentDefinition& v9 = *new ComponentDefinition("part", BIOPAX_DNA, "9.0.0");
+    ComponentDefinition& v10 = *new ComponentDefinition("part", BIOPAX_DNA, "10.0.0");
+    ComponentDefinition& snapshot = *new ComponentDefinition("part", BIOPAX_DNA, "10.0.0-SNAPSHOT");
+    doc.add<ComponentDefinition>(v9);
+    doc.add<ComponentDefinition>(v10);
+    doc.add<ComponentDefinition>(snapshot);
+    string persistent_identity = v9.persistentIdentity.get();
+    check(&doc.get<ComponentDefinition>(persistent_identity) == &v10 && &doc.get<ComponentDefinition>(v9.identity.get()) == &v9, "Resolving the latest version of a persistentIdentity");
+
+    v10.version.set("8.0.0");
+    check(&doc.get<ComponentDefinition>(persistent_identity) == &snapshot, "Reordering versions when a version changes");
+}
+
+// Keeps the typed option snapshot in step with Config::setOption, and builds URIs from it
+void test_config_snapshot()
+{
+    check(Config::snapshot().compliant_uris && Config::snapshot().typed_uris && !Config::snapshot().validate
+          && Config::snapshot().output_format == Config::FORMAT_RDFXML, "Taking a snapshot of the options");
+
+    Document doc;
+    Config::setOption("sbol_typed_uris", false);
+    Config::setOption("output_format", string("json"));
+    bool is_snapshot_set = !Config::snapshot().typed_uris && Config::snapshot().output_format == Config::FORMAT_JSON;
+    string untyped_uri = doc.componentDefinitions.create("untyped").identity.get();
+    Config::setOption("sbol_typed_uris", true);
+    Config::setOption("output_format", string("rdfxml"));
+    string typed_uri = doc.componentDefinitions.create("typed").identity.get();
+    check(is_snapshot_set && Config::snapshot().typed_uris && Config::snapshot().output_format == Config::FORMAT_RDFXML, "Updating the snapshot when an option is set");
+    check(untyped_uri == "http://examples.com/untyped/1.0.0" && typed_uri == "http://examples.com/ComponentDefinition/typed/1.0.0", "Constructing URIs from the snapshot");
+
+    bool is_refused = false;
+    try
+    {
+        Config::setOption("sbol_compliant_uris", string("Maybe"));
+    }
+    catch (SBOLError &e)
+    {
+        is_refused = e.error_code() == SBOL_ERROR_INVALID_ARGUMENT;
+    }
+    check(is_refused && Config::snapshot().compliant_uris && Config::getOption("sbol_compliant_uris") == "True", "Keeping the snapshot when an option is refused");
+}
+
+// @return The displayIds of a ComponentDefinition's primary structure
+vector<string> primary_structure_ids(ComponentDefinition& cd)
+{
+    vector<string> ids;
+    for (auto &i_cd : cd.getPrimaryStructure())
+        ids.push_back(i_cd->displayId.get());
+    return ids;
+}
+
+// @return True if ordering a ComponentDefinition is refused because its SequenceConstraints do not form a single chain
+bool is_order_refused(ComponentDefinition& cd)
+{
+    try
+    {
+        cd.getInSequentialOrder();
+    }
+    catch (SBOLError &e)
+    {
+        return e.error_code() == SBOL_ERROR_INVALID_ARGUMENT;
+    }
+    return false;
+}
+
+// Orders Components along their precedes constraints, orders them again after an edit, and refuses cycles and branches
+void test_sequential_order()
+{
+    Document doc;
+    ComponentDefinition& gene = doc.componentDefinitions.create("ordered_gene");
+    ComponentDefinition& promoter = doc.componentDefinitions.create("ordered_promoter");
+    ComponentDefinition& cds = doc.componentDefinitions.create("ordered_cds");
+    ComponentDefinition& terminator = doc.componentDefinitions.create("ordered_terminator");
+    gene.assemble({ &promoter, &cds });
+    check(primary_structure_ids(gene) == vector<string>({ "ordered_promoter", "ordered_cds" })
+          && gene.getFirstComponent().definition.get() == promoter.identity.get() && gene.getLastComponent().definition.get() == cds.identity.get(), "Ordering Components");
+
+    // Appending a Component after the order was first computed
+    Component& cds_component = gene.getLastComponent();
+    Component& terminator_component = gene.components.create("ordered_terminator_component");
+    terminator_component.definition.set(terminator.identity.get());
+    SequenceConstraint& cds_terminator = gene.sequenceConstraints.create("ordered_cds_terminator");
+    cds_terminator.subject.set(cds_component.identity.get());
+    cds_terminator.object.set(terminator_component.identity.get());
+    cds_terminator.restriction.set(SBOL_RESTRICTION_PRECEDES);
+    check(primary_structure_ids(gene) == vector<string>({ "ordered_promoter", "ordered_cds", "ordered_terminator" })
+          && &gene.getLastComponent() == &terminator_component && gene.hasDownstreamComponent(cds_component), "Ordering Components again after an edit");
+
+    string promoter_component_uri = gene.getFirstComponent().identity.get();
+    SequenceConstraint& terminator_promoter = gene.sequenceConstraints.create("ordered_terminator_promoter");
+    terminator_promoter.subject.set(terminator_component.identity.get());
+    terminator_promoter.object.set(promoter_component_uri);
+    terminator_promoter.restriction.set(SBOL_RESTRICTION_PRECEDES);
+    check(is_order_refused(gene), "Refusing to order a cycle");
+
+    ComponentDefinition& branched = doc.componentDefinitions.create("branched");
+    branched.assemble({ &promoter, &cds });
+    string branch_point_uri = branched.getFirstComponent().identity.get();
+    Component& branch = branched.components.create("branch");
+    branch.definition.set(terminator.identity.get());
+    SequenceConstraint& promoter_branch = branched.sequenceConstraints.create("promoter_branch");
+    promoter_branch.subject.set(branch_point_uri);
+    promoter_branch.object.set(branch.identity.get());
+    promoter_branch.restriction.set(SBOL_RESTRICTION_PRECEDES);
+    check(is_order_refused(branched), "Refusing to order a branch");
+}
+
+// @return A ComponentDefinition with a Sequence of the given elements
+ComponentDefinition& sequenced_definition(Document& doc, string display_id, string elements)
+{
+    ComponentDefinition& cd = doc.componentDefinitions.create(display_id);
+    Sequence& seq = doc.sequences.create(display_id + "_seq");
+    seq.elements.set(elements);
+    cd.sequences.set(seq.identity.get());
+    return cd;
+}
+
+// Assembles a hierarchy that reuses parts, reassembles it after a leaf is edited, and refuses a hierarchy that contains itself
+void test_hierarchical_assembly()
+{
+    Document doc;
+    ComponentDefinition& leaf_a = sequenced_definition(doc, "leaf_a", "aaaa");
+    ComponentDefinition& leaf_b = sequenced_definition(doc, "leaf_b", "cc");
+    ComponentDefinition& sub = sequenced_definition(doc, "sub", "");
+    ComponentDefinition& top = sequenced_definition(doc, "top", "");
+    sub.assemble({ &leaf_a, &leaf_b });
+    top.assemble({ &leaf_b, &sub, &leaf_a });
+    Sequence& top_seq = doc.sequences.get(top.sequences.get());
+    Sequence& sub_seq = doc.sequences.get(sub.sequences.get());
+    check(top_seq.assemble() == "cc" "aaaacc" "aaaa" && sub_seq.elements.get() == "aaaacc", "Assembling a hierarchy with a composite part that is not first");
+    check(top.updateSequence() == "cc" "aaaacc" "aaaa" && top_seq.elements.get() == "ccaaaaccaaaa", "Assembling a hierarchy again from the cache");
+
+    doc.sequences.get(leaf_b.sequences.get()).elements.set("gg");
+    check(top_seq.assemble() == "gg" "aaaagg" "aaaa" && sub_seq.elements.get() == "aaaagg", "Reassembling a hierarchy after a leaf is edited");
+
+    ComponentDefinition& outer = sequenced_definition(doc, "outer", "");
+    ComponentDefinition& inner = sequenced_definition(doc, "inner", "");
+    outer.assemble({ &leaf_a, &inner });
+    inner.assemble({ &leaf_b, &outer });
+    bool is_refused = false;
+    try
+    {
+        outer.updateSequence();
+    }
+    catch (SBOLError &e)
+    {
+        is_refused = e.error_code() == SBOL_ERROR_INVALID_ARGUMENT;
+    }
+    check(is_refused, "Refusing to assemble a hierarchy that contains itself");
+}
+
+// The ComponentDefinitions visited by a hierarchy callback, in the order their callbacks ran
+struct HierarchyVisits
+{
+    mutex visits_mutex;
+    vector<ComponentDefinition*> visits;
+    string failing_uri;  ///< The callback throws when it visits this ComponentDefinition
+};
+
+void record_visit(ComponentDefinition* cd, void* user_data)
+{
+    HierarchyVisits& visits = *(HierarchyVisits*)user_data;
+    if (cd->identity.get() == visits.failing_uri)
+        throw SBOLError(SBOL_ERROR_INVALID_ARGUMENT, "Failing callback");
+    lock_guard<mutex> lock(visits.visits_mutex);
+    visits.visits.push_back(cd);
+}
+
+// Visits each ComponentDefinition of a hierarchy of reused parts once, with one thread and with several, and refuses a hierarchy that contains itself
+void test_component_hierarchy()
+{
+    // Each rung contains the one below it twice, so a traversal that revisits shared parts would make about a million visits
+    Document doc;
+    vector<ComponentDefinition*> ladder = { &doc.componentDefinitions.create("rung_0") };
+    for (int i_rung = 1; i_rung <= 20; ++i_rung)
+    {
+        ComponentDefinition& rung = doc.componentDefinitions.create("rung_" + to_string(i_rung));
+        rung.assemble({ ladder.back(), ladder.back() });
+        ladder.push_back(&rung);
+    }
+    ComponentDefinition& top = *ladder.back();
+
+    HierarchyVisits serial;
+    vector<ComponentDefinition*> hierarchy = top.applyToComponentHierarchy(record_visit, &serial);
+    check(hierarchy.size() == 21 && hierarchy.front() == &top && hierarchy.back() == ladder.front()
+          && serial.visits == hierarchy, "Visiting each reused ComponentDefinition once, in pre-order");
+
+    HierarchyVisits parallel;
+    vector<ComponentDefinition*> parallel_hierarchy = top.applyToComponentHierarchy(record_visit, &parallel, 4);
+    bool is_bottom_up = parallel.visits.size() == 21;
+    for (size_t i_visit = 0; is_bottom_up && i_visit < parallel.visits.size(); ++i_visit)
+        is_bottom_up = parallel.visits[i_visit] == ladder[i_visit];
+    check(parallel_hierarchy == hierarchy && is_bottom_up, "Visiting a hierarchy on several threads from the leaves up");
+
+    HierarchyVisits failing;
+    failing.failing_uri = ladder[10]->identity.get();
+    bool is_rethrown = false;
+    try
+    {
+        top.applyToComponentHierarchy(record_visit, &failing, 4);
+    }
+    catch (SBOLError &e)
+    {
+        is_rethrown = string(e.what()) == "Failing callback";
+    }
+    check(is_rethrown && failing.visits.size() == 10, "Stopping a parallel traversal when a callback throws");
+
+    // Closing the ladder into a cycle
+    ComponentDefinition& cycle = doc.componentDefinitions.create("cycle");
+    cycle.assemble({ &top });
+    ladder.front()->assemble({ &cycle });
+    HierarchyVisits cyclic;
+    bool is_refused = false;
+    try
+    {
+        top.applyToComponentHierarchy(record_visit, &cyclic);
+    }
+    catch (SBOLError &e)
+    {
+        is_refused = e.error_code() == SBOL_ERROR_INVALID_ARGUMENT;
+    }
+    check(is_refused && cyclic.visits.empty(), "Refusing a hierarchy that contains itself before any callback runs");
+}
+
+// @return A SequenceAnnotation with one Range
+SequenceAnnotation& range_annotation(ComponentDefinition& cd, string display_id, int start, int end)
+{
+    SequenceAnnotation& sa = cd.sequenceAnnotations.create(display_id);
+    Range& r = sa.locations.create<Range>(display_id + "_range");
+    r.start.set(start);
+    r.end.set(end);
+    return sa;
+}
+
+// @return The displayIds of some SequenceAnnotations, sorted
+vector<string> annotation_ids(vector<SequenceAnnotation*> annotations)
+{
+    vector<string> ids;
+    for (auto &i_sa : annotations)
+        ids.push_back(i_sa->displayId.get());
+    sort(ids.begin(), ids.end());
+    return ids;
+}
+
+// Queries the interval index at its edges: empty regions, touching endpoints, nested and identical intervals, and an index rebuilt after an edit
+void test_annotation_queries()
+{
+    Document doc;
+    ComponentDefinition& plain = doc.componentDefinitions.create("unannotated");
+    check(plain.findOverlappingAnnotations(1, 100).empty() && plain.findContainedAnnotations(1, 100).empty() && plain.findAnnotationsAt(1).empty()
+          && plain.findPrecedingAnnotations(100).empty() && plain.findFollowingAnnotations(0).empty(), "Querying a ComponentDefinition without annotations");
+
+    ComponentDefinition& cd = doc.componentDefinitions.create("annotated");
+    SequenceAnnotation& outer = range_annotation(cd, "outer", 1, 10);
+    range_annotation(cd, "twin", 1, 10);
+    range_annotation(cd, "inner", 3, 5);
+    range_annotation(cd, "next", 11, 20);
+    SequenceAnnotation& split = range_annotation(cd, "split", 21, 23);
+    Range& split_tail = split.locations.create<Range>("split_tail");
+    split_tail.start.set(28);
+    split_tail.end.set(30);
+    Cut& cut = cd.sequenceAnnotations.create("cut").locations.create<Cut>("cut_location");
+    cut.at.set(10);  // Between bases 10 and 11
+
+    check(cd.findOverlappingAnnotations(12, 11).empty() && cd.findContainedAnnotations(12, 11).empty(), "Querying an empty region");
+    check(annotation_ids(cd.findOverlappingAnnotations(10, 10)) == vector<string>({ "outer", "twin" })
+          && annotation_ids(cd.findOverlappingAnnotations(10, 11)) == vector<string>({ "cut", "next", "outer", "twin" })
+          && annotation_ids(cd.findAnnotationsAt(11)) == vector<string>({ "next" }), "Querying regions that touch the ends of intervals");
+    check(annotation_ids(cd.findContainedAnnotations(1, 10)) == vector<string>({ "inner", "outer", "twin" })
+          && annotation_ids(cd.findContainedAnnotations(2, 10)) == vector<string>({ "inner" })
+          && annotation_ids(cd.findContainedAnnotations(3, 5)) == vector<string>({ "inner" })
+          && annotation_ids(cd.findContainedAnnotations(1, 11)) == vector<string>({ "cut", "inner", "outer", "twin" }), "Finding nested and identical intervals");
+    check(annotation_ids(cd.findOverlappingAnnotations(24, 27)).empty() && annotation_ids(cd.findContainedAnnotations(21, 29)).empty()
+          && annotation_ids(cd.findContainedAnnotations(21, 30)) == vector<string>({ "split" })
+          && annotation_ids(cd.findOverlappingAnnotations(22, 29)) == vector<string>({ "split" }), "Querying an annotation with several Ranges");
+    check(annotation_ids(cd.findPrecedingAnnotations(11)) == vector<string>({ "cut", "inner", "outer", "twin" })
+          && annotation_ids(cd.findPrecedingAnnotations(10)) == vector<string>({ "inner" })
+          && annotation_ids(cd.findFollowingAnnotations(20)) == vector<string>({ "split" })
+          && annotation_ids(cd.findFollowingAnnotations(10)) == vector<string>({ "cut", "next", "split" }), "Finding preceding and following annotations");
+
+    // Queries after an edit are answered from a rebuilt index
+    ((Range&)outer.locations[0]).end.set(15);
+    range_annotation(cd, "late", 12, 13);
+    check(annotation_ids(cd.findAnnotationsAt(12)) == vector<string>({ "late", "next", "outer" })
+          && annotation_ids(cd.findContainedAnnotations(1, 10)) == vector<string>({ "inner", "twin" }), "Rebuilding the index after an edit");
+    cd.sequenceAnnotations.remove(split.identity.get());
+    check(cd.findOverlappingAnnotations(21, 30).empty(), "Rebuilding the index after an annotation is removed");
+}
+
+// Commits, rolls back and fails EditSessions, and checks that the design and the Document's indices are exactly as the session left them
+void test_edit_session()
+{
+    Document doc;
+    ComponentDefinition& gene = doc.componentDefinitions.create("session_gene");
+    ComponentDefinition& promoter = doc.componentDefinitions.create("session_promoter");
+    ComponentDefinition& cds = doc.componentDefinitions.create("session_cds");
+    ComponentDefinition& terminator = doc.componentDefinitions.create("session_terminator");
+    ComponentDefinition& rbs = doc.componentDefinitions.create("session_rbs");
+    gene.assemble({ &promoter, &cds, &terminator });
+    Component& promoter_component = gene.getFirstComponent();
+    Component& cds_component = gene.getDownstreamComponent(promoter_component);
+    string original = doc.writeString();
+    string rbs_component_uri = gene.persistentIdentity.get() + "/session_rbs/0/" + gene.version.get();
+    string flank_uri = "http://examples.com/ComponentDefinition/flank0/1.0.0";
+
+    {
+        EditSession session(gene);
+        session.insertDownstream(promoter_component, rbs);
+        session.addUpstreamFlank(promoter_component, "ggcc");
+        check(session.size() == 2 && original.find("session_gene") != string::npos && doc.writeString() == original, "Leaving the design as it is until a session is committed");
+        session.rollback();
+        check(session.size() == 0, "Discarding edits on rollback");
+        session.commit();
+        check(doc.writeString() == original, "Committing an empty session");
+
+        // A session that goes out of scope discards its edits
+        session.insertDownstream(promoter_component, rbs);
+    }
+    check(doc.writeString() == original && doc.find(rbs_component_uri) == NULL && doc.getReferrers(rbs.identity.get()).empty(), "Discarding uncommitted edits");
+
+    // An edit that fails after others were applied, one of which spliced an existing SequenceConstraint
+    ComponentDefinition& other = doc.componentDefinitions.create("session_other");
+    other.assemble({ &promoter });
+    original = doc.writeString();
+    EditSession failing(gene);
+    failing.insertDownstream(promoter_component, rbs);
+    failing.addUpstreamFlank(promoter_component, "ggcc");
+    failing.insertDownstream(other.components[0], rbs);
+    bool is_refused = false;
+    try
+    {
+        failing.commit();
+    }
+    catch (SBOLError &e)
+    {
+        is_refused = e.error_code() == NOT_FOUND_ERROR;
+    }
+    check(is_refused && failing.size() == 0 && doc.writeString() == original, "Restoring the design when a commit fails");
+    check(doc.find(rbs_component_uri) == NULL && doc.find(flank_uri) == NULL && doc.getReferrers(rbs.identity.get()).empty()
+          && doc.getReferrers(promoter_component.identity.get(), SBOL_SUBJECT).size() == 1 && gene.getDownstreamComponent(promoter_component).identity.get() == cds_component.identity.get(),
+          "Restoring the Document's indices when a commit fails");
+
+    // The session can be used again after a failed commit, and an edit made through the ComponentDefinition while it has pending edits is applied on its own
+    failing.insertDownstream(promoter_component, rbs);
+    gene.addDownstreamFlank(cds_component, "ttaa");
+    check(failing.size() == 1 && primary_structure_ids(gene) == vector<string>({ "session_promoter", "session_cds", "flank0", "session_terminator" }), "Applying an edit made outside a session with pending edits");
+    failing.commit();
+    check(failing.size() == 0 && primary_structure_ids(gene) == vector<string>({ "session_promoter", "session_rbs", "session_cds", "flank0", "session_terminator" })
+          && doc.find(rbs_component_uri) != NULL && doc.find(flank_uri) != NULL && doc.getReferrers(rbs.identity.get()).size() == 1, "Committing edits after a failed commit");
+}
+
+// Assembles a batch on several threads whose first designs have no parts and one part, so the workers are the first to create Components and SequenceConstraints
+void test_assemble_short_designs()
+{
+    Document doc;
+    ComponentDefinition& promoter = doc.componentDefinitions.create("promoter");
+    ComponentDefinition& cds = doc.componentDefinitions.create("cds");
+    ComponentDefinition& terminator = doc.componentDefinitions.create("terminator");
+    vector<string> uris;
+    vector<vector<ComponentDefinition*>> designs;
+    for (int i_construct = 0; i_construct < 200; ++i_construct)
+    {
+        uris.push_back("construct" + to_string(i_construct));
+        if (i_construct == 0)
+            designs.push_back({});
+        else if (i_construct == 1)
+            designs.push_back({ &promoter });
+        else
+            designs.push_back({ &promoter, &cds, &cds, &terminator });
+    }
+    vector<ComponentDefinition*> constructs = doc.assemble(uris, designs, 8);
+    bool is_complete = constructs.size() == uris.size();
+    for (size_t i_construct = 0; is_complete && i_construct < constructs.size(); ++i_construct)
+    {
+        ComponentDefinition& construct = *constructs[i_construct];
+        size_t n_parts = designs[i_construct].size();
+        is_complete = construct.components.size() == (int)n_parts
+            && construct.sequenceConstraints.size() == (int)(n_parts ? n_parts - 1 : 0)
+            && doc.find(construct.identity.get()) == &construct;
+    }
+    check(is_complete, "Batch assembly of designs with 0 and 1 parts");
+}
+
+// @return The SBOLError code a batch assembly fails with, or 0 if it succeeds
+int batch_error(Document& doc, vector<string> uris, vector<vector<ComponentDefinition*>> designs)
+{
+    try
+    {
+        doc.assemble(uris, designs, 4);
+    }
+    catch (SBOLError &e)
+    {
+        return e.error_code();
+    }
+    return 0;
+}
+
+// Fails batches that bring in parts from outside the Document, and checks the parts leave the Document again
+void test_assemble_failed_batch()
+{
+    Document doc;
+    Document other_doc;
+    ComponentDefinition& promoter = doc.componentDefinitions.create("batch_promoter");
+    ComponentDefinition& foreign = other_doc.componentDefinitions.create("batch_foreign");
+    ComponentDefinition& rbs = *new ComponentDefinition("batch_rbs");
+    ComponentDefinition& cds = *new ComponentDefinition("batch_cds");
+    rbs.sequenceAnnotations.create("batch_rbs_anno");
+    string original = doc.writeString();
+
+    int error_code = batch_error(doc, { "batch_0", "batch_1" }, { { &promoter, &rbs }, { &cds, &foreign } });
+    check(error_code == SBOL_ERROR_MISSING_DOCUMENT && rbs.doc == NULL && rbs.sequenceAnnotations[0].doc == NULL && cds.doc == NULL
+          && doc.find(rbs.identity.get()) == NULL && doc.find(rbs.sequenceAnnotations[0].identity.get()) == NULL
+          && doc.componentDefinitions.size() == 1 && doc.writeString() == original, "Removing added parts when a batch has a part from another Document");
+
+    error_code = batch_error(doc, { "batch_0", "batch_promoter" }, { { &promoter, &rbs }, { &cds } });
+    check(error_code == DUPLICATE_URI_ERROR && rbs.doc == NULL && cds.doc == NULL && doc.find("http://examples.com/ComponentDefinition/batch_0/1.0.0") == NULL
+          && doc.componentDefinitions.size() == 1 && doc.getReferrers(rbs.identity.get()).empty() && doc.writeString() == original, "Removing added parts when a batch has a duplicate identity");
+
+    error_code = batch_error(doc, { "batch_0", "batch_1" }, { { &promoter, &rbs }, { &cds } });
+    check(error_code == 0 && rbs.doc == &doc && &doc.componentDefinitions.get(cds.identity.get()) == &cds
+          && doc.componentDefinitions.size() == 5 && doc.getReferrers(rbs.identity.get()).size() == 1, "Adding parts when a batch succeeds");
+}
+
+// Reads, compares and assembles long Sequences, which are packed while they belong to a Document, and checks they stay packed
+void test_packed_reads()
+{
+    Document doc;
+    string promoter_elements;
+    string cds_elements;
+    for (int i_base = 0; i_base < 3000; ++i_base)
+    {
+        promoter_elements += "acgt"[i_base % 4];
+        cds_elements += "ttgca"[i_base % 5];
+    }
+    Sequence& promoter_seq = doc.sequences.create("promoter_seq");
+    promoter_seq.elements.set(promoter_elements);
+    Sequence& cds_seq = doc.sequences.create("cds_seq");
+    cds_seq.elements.set(cds_elements);
+    ComponentDefinition& promoter = doc.componentDefinitions.create("promoter");
+    promoter.sequences.set(promoter_seq.identity.get());
+    ComponentDefinition& cds = doc.componentDefinitions.create("cds");
+    cds.sequences.set(cds_seq.identity.get());
+    ComponentDefinition& gene = doc.componentDefinitions.create("gene");
+    Sequence& gene_seq = doc.sequences.create("gene_seq");
+    gene.sequences.set(gene_seq.identity.get());
+    gene.assemble({ &promoter, &cds });
+
+    const PropertyValue& promoter_value = promoter_seq.properties[SBOL_ELEMENTS].front();
+    const PropertyValue& cds_value = cds_seq.properties[SBOL_ELEMENTS].front();
+    check(promoter_value.packed() != NULL && cds_value.packed() != NULL, "Packing long Sequences");
+    check(promoter_seq.elements.get() == promoter_elements, "Reading packed elements");
+    check(!(promoter_value == cds_value) && (promoter_value < cds_value) == (promoter_elements < cds_elements), "Comparing packed elements");
+    check(gene_seq.assemble() == promoter_elements + cds_elements && promoter.updateSequence() == promoter_elements, "Assembling packed parts");
+    check(promoter_value.packed() != NULL && cds_value.packed() != NULL && promoter_value.text().empty(), "Packed elements stay packed once read");
+}
+
+// Reads nested objects into an arena, mixes in children from the heap, and checks that arena objects cannot move to another Document
+void test_arena_ownership()
+{
+    Document source;
+    ComponentDefinition& gene = source.componentDefinitions.create("gene");
+    gene.sequenceAnnotations.create("promoter_annotation").locations.create<Range>("promoter_range");
+    gene.sequenceAnnotations.create("cds_annotation").locations.create<Range>("cds_range");
+    string sbol = source.writeString();
+
+    Document* arena_doc = new Document();
+    arena_doc->toggleArenaAllocation();
+    arena_doc->readString(sbol);
+    ComponentDefinition& arena_gene = arena_doc->componentDefinitions.get("gene");
+    // Objects created after the read come from the heap
+    arena_gene.sequenceAnnotations.create("terminator_annotation").locations.create<Range>("terminator_range");
+
+    Document other;
+    bool is_refused = false;
+    try
+    {
+        other.add<ComponentDefinition>(arena_gene);
+    }
+    catch (SBOLError &e)
+    {
+        is_refused = e.error_code() == SBOL_ERROR_INVALID_ARGUMENT;
+    }
+    check(is_refused && other.find(arena_gene.identity.get()) == NULL, "Moving an arena object to another Document");
+    check(arena_gene.sequenceAnnotations.size() == 3, "Adding heap children to arena objects");
+
+    // Each parent is destroyed after the children read with it, so it must not call into them
+    delete arena_doc;
+    check(true, "Releasing an arena with heap children");
+}
+
+// Annotates a ComponentDefinition that already has numbered SequenceAnnotations, which the new annotations are numbered after
+void test_annotate_numbering()
+{
+    Document doc;
+    string genome;
+    for (int i_base = 0; i_base < 2000; ++i_base)
+        genome += "acgt"[(i_base * 7 + i_base / 5) % 4];
+    ComponentDefinition& plasmid = doc.componentDefinitions.create("plasmid");
+    Sequence& plasmid_seq = doc.sequences.create("plasmid_seq");
+    plasmid_seq.elements.set(genome);
+    plasmid.sequences.set(plasmid_seq.identity.get());
+    ComponentDefinition& promoter = doc.componentDefinitions.create("promoter");
+    Sequence& promoter_seq = doc.sequences.create("promoter_seq");
+    promoter_seq.elements.set(genome.substr(500, 40));
+    promoter.sequences.set(promoter_seq.identity.get());
+    plasmid.sequenceAnnotations.create("promoter_2");
+    plasmid.sequenceAnnotations.create("promoter_old");
+
+    vector<SequenceAnnotation*> annotations = doc.annotate({ &promoter });
+    check(annotations.size() >= 1 && annotations.front()->displayId.get() == "promoter_3", "Numbering annotations after the existing ones");
+}
+
+// Reads typed and language-tagged literals, and checks they keep their datatype and language when written again
+void test_tagged_literals()
+{
+    string sbol = "<?xml version=\"1.0\" ?>"
+        "<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\" xmlns:sbol=\"http://sbols.org/v2#\" "
+        "xmlns:dcterms=\"http://purl.org/dc/terms/\" xmlns:ex=\"http://examples.com/terms#\">"
+        "<sbol:ComponentDefinition rdf:about=\"http://examples.com/tagged/1\">"
+        "<sbol:persistentIdentity rdf:resource=\"http://examples.com/tagged\"/><sbol:displayId>tagged</sbol:displayId>"
+        "<sbol:version>1</sbol:version><sbol:type rdf:resource=\"http://www.biopax.org/release/biopax-level3.owl#DnaRegion\"/>"
+        "<dcterms:description xml:lang=\"en\">A tagged part</dcterms:description>"
+        "<ex:weight rdf:datatype=\"http://www.w3.org/2001/XMLSchema#double\">1.5</ex:weight>"
+        "<ex:note xml:lang=\"de\">Gr\xC3\xBC\xC3\x9F\x65</ex:note>"
+        "</sbol:ComponentDefinition></rdf:RDF>";
+    Document doc;
+    doc.readString(sbol);
+    ComponentDefinition& tagged = doc.componentDefinitions.get("http://examples.com/tagged/1");
+    const PropertyValue& description = tagged.properties[SBOL_DESCRIPTION].front();
+    const PropertyValue& weight = tagged.properties["http://examples.com/terms#weight"].front();
+    const PropertyValue& note = tagged.properties["http://examples.com/terms#note"].front();
+    check(tagged.description.get() == "A tagged part" && description.language() == "en" && description.datatype().empty(), "Reading a language-tagged literal");
+    check(weight.str() == "1.5" && weight.datatype() == "http://www.w3.org/2001/XMLSchema#double", "Reading a typed literal");
+    check(note.language() == "de", "Reading an escaped language-tagged literal");
+
+    string written = doc.writeString();
+    Document reread;
+    reread.readString(written);
+    ComponentDefinition& reread_tagged = reread.componentDefinitions.get("http://examples.com/tagged/1");
+    check(reread_tagged.properties[SBOL_DESCRIPTION].front() == description
+          && reread_tagged.properties["http://examples.com/terms#weight"].front() == weight
+          && reread_tagged.properties["http://examples.com/terms#note"].front() == note, "Writing tagged literals");
+
+    tagged.description.set("An untagged part");
+    check(tagged.properties[SBOL_DESCRIPTION].front().language().empty(), "Setting a value drops its tag");
+}
+
+// Writes multi-line literals in nested objects, and compares the output with what the baseline serializer wrote after SBOLObject::nest, which indented the lines after the first at each level of nesting
+void test_write_multiline_literals()
+{
+    Document doc;
+    ComponentDefinition& gene = doc.componentDefinitions.create("gene");
+    gene.description.set("top first\ntop second");
+    SequenceAnnotation& anno = gene.sequenceAnnotations.create("anno");
+    anno.description.set("anno first\nanno second\n  anno third\n");
+    Range& r = anno.locations.create<Range>("r");
+    r.description.set("range first\n\nrange third");
+    r.name.set("plain");
+    Component& c = gene.components.create("c");
+    c.description.set("\nstarts with a newline");
+
+    string baseline_sbol =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+        "<rdf:RDF xmlns:dcterms=\"http://purl.org/dc/terms/\"\n"
+        "   xmlns:prov=\"http://www.w3.org/ns/prov#\"\n"
+        "   xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\"\n"
+        "   xmlns:sbol=\"http://sbols.org/v2#\">\n"
+        "  <sbol:ComponentDefinition rdf:about=\"http://examples.com/ComponentDefinition/gene/1.0.0\">\n"
+        "    <dcterms:description>top first\n"
+        "top second</dcterms:description>\n"
+        "    <sbol:component>\n"
+        "      <sbol:Component rdf:about=\"http://examples.com/ComponentDefinition/gene/c/1.0.0\">\n"
+        "        <dcterms:description>\n"
+        "    starts with a newline</dcterms:description>\n"
+        "        <sbol:access rdf:resource=\"http://sbols.org/v2#public\"/>\n"
+        "        <sbol:displayId>c</sbol:displayId>\n"
+        "        <sbol:persistentIdentity rdf:resource=\"http://examples.com/ComponentDefinition/gene/c\"/>\n"
+        "        <sbol:version>1.0.0</sbol:version>\n"
+        "      </sbol:Component>\n"
+        "    </sbol:component>\n"
+        "    <sbol:displayId>gene</sbol:displayId>\n"
+        "    <sbol:persistentIdentity rdf:resource=\"http://examples.com/ComponentDefinition/gene\"/>\n"
+        "    <sbol:sequenceAnnotation>\n"
+        "      <sbol:SequenceAnnotation rdf:about=\"http://examples.com/ComponentDefinition/gene/anno/1.0.0\">\n"
+        "        <dcterms:description>anno first\n"
+        "    anno second\n"
+        "      anno third\n"
+        "    </dcterms:description>\n"
+        "        <sbol:displayId>anno</sbol:displayId>\n"
+        "        <sbol:location>\n"
+        "          <sbol:Range rdf:about=\"http://examples.com/ComponentDefinition/gene/anno/r/1.0.0\">\n"
+        "            <dcterms:description>range first\n"
+        "        \n"
+        "        range third</dcterms:description>\n"
+        "            <dcterms:title>plain</dcterms:title>\n"
+        "            <sbol:displayId>r</sbol:displayId>\n"
+        "            <sbol:end>2</sbol:end>\n"
+        "            <sbol:orientation rdf:resource=\"http://sbols.org/v2#inline\"/>\n"
+        "            <sbol:persistentIdentity rdf:resource=\"http://examples.com/ComponentDefinition/gene/anno/r\"/>\n"
+        "            <sbol:start>1</sbol:start>\n"
+        "            <sbol:version>1.0.0</sbol:version>\n"
+        "          </sbol:Range>\n"
+        "        </sbol:location>\n"
+        "        <sbol:persistentIdentity rdf:resource=\"http://examples.com/ComponentDefinition/gene/anno\"/>\n"
+        "        <sbol:roleIntegration rdf:resource=\"http://sbols.org/v2#mergeRoles\"/>\n"
+        "        <sbol:version>1.0.0</sbol:version>\n"
+        "      </sbol:SequenceAnnotation>\n"
+        "    </sbol:sequenceAnnotation>\n"
+        "    <sbol:type rdf:resource=\"http://www.biopax.org/release/biopax-level3.owl#DnaRegion\"/>\n"
+        "    <sbol:version>1.0.0</sbol:version>\n"
+        "  </sbol:ComponentDefinition>\n"
+        "</rdf:RDF>\n";
+    check(doc.writeString() == baseline_sbol, "Writing nested multi-line literals as the baseline serializer did");
+
+    // Reading the baseline's output back keeps its indentation, and the line breaks N-Triples escaped, as the baseline reader did
+    Document reread;
+    reread.readString(baseline_sbol);
+    Range& reread_range = (Range&)reread.componentDefinitions.get("http://examples.com/ComponentDefinition/gene/1.0.0").sequenceAnnotations[0].locations[0];
+    check(reread_range.description.get() == "range first\\n        \\n        range third", "Reading nested multi-line literals as the baseline reader did");
+}
+
+// Connects the components of two submodules, then checks that a connection is refused once a second Module shares a definition
+void test_connect_submodules()
+{
+    Document doc;
+    ComponentDefinition& signal = doc.componentDefinitions.create("signal");
+    ModuleDefinition& sender = doc.moduleDefinitions.create("sender");
+    ModuleDefinition& receiver = doc.moduleDefinitions.create("receiver");
+    FunctionalComponent& output = sender.setOutput(signal);
+    FunctionalComponent& input = receiver.setInput(signal);
+    ModuleDefinition& system = doc.moduleDefinitions.create("system");
+    system.modules.create("sender_module").definition.set(sender.identity.get());
+    system.modules.create("receiver_module").definition.set(receiver.identity.get());
+    system.connect({ &output }, { &input });
+    check(system.functionalComponents.size() == 1, "Connecting submodules");
+
+    system.modules.create("second_sender_module").definition.set(sender.identity.get());
+    bool is_refused = false;
+    try
+    {
+        system.connect({ &output }, { &input });
+    }
+    catch (SBOLError &e)
+    {
+        is_refused = e.error_code() == SBOL_ERROR_INVALID_ARGUMENT;
+    }
+    check(is_refused, "Connecting through Modules that share a definition");
+}
+
+// Builds a CombinatorialDerivation whose template has one Component for each entry of n_variants, which that many variants may replace. A Component with no variants is not variable
+CombinatorialDerivation& create_library(Document& doc, string display_id, vector<int> n_variants, string strategy, string repeat)
+{
+    ComponentDefinition& library_template = doc.componentDefinitions.create(display_id + "_template");
+    CombinatorialDerivation& library = doc.combinatorialDerivations.create(display_id);
+    library.masterTemplate.set(library_template.identity.get());
+    library.strategy.set(strategy);
+    for (size_t i_com = 0; i_com < n_variants.size(); ++i_com)
+    {
+        string component_id = "c" + to_string(i_com);
+        Component& c = library_template.components.create(component_id);
+        c.definition.set("http://examples.com/" + component_id + "_template");
+        if (n_variants[i_com] == 0)
+            continue;
+        VariableComponent& vc = library.variableComponents.create(component_id + "_variable");
+        vc.variable.set(c.identity.get());
+        vc.repeat.set(repeat);
+        for (int i_variant = 0; i_variant < n_variants[i_com]; ++i_variant)
+            vc.variants.add("http://examples.com/" + component_id + "_variant" + to_string(i_variant));
+    }
+    return library;
+}
+
+// @return The definition of a variant's Component, or an empty string if the Component was left out
+string variant_definition(ComponentDefinition& variant, string component_id)
+{
+    for (auto &c : variant.components)
+    {
+        if (c.displayId.get() == component_id)
+            return c.definition.get();
+    }
+    return "";
+}
+
+// @return The ordinal of a derived variant, which ends its displayId
+unsigned long long variant_ordinal(ComponentDefinition& variant, string display_id)
+{
+    return stoull(variant.displayId.get().substr(display_id.size() + 1));
+}
+
+// Enumerates a library in which a Component may be left out, and checks each variant is decoded from its ordinal with the last VariableComponent varying fastest
+void test_enumerate_variants()
+{
+    Document doc;
+    CombinatorialDerivation& library = create_library(doc, "library", { 2, 0, 3 }, SBOL_ENUMERATE, SBOL_REPEAT_ZERO_OR_ONE);
+    ComponentDefinition& library_template = doc.componentDefinitions.get("library_template");
+    SequenceConstraint& sc = library_template.sequenceConstraints.create("c0_before_c2");
+    sc.subject.set(library_template.components.get("c0").identity.get());
+    sc.object.set(library_template.components.get("c2").identity.get());
+    sc.restriction.set(SBOL_RESTRICTION_PRECEDES);
+
+    VariantGenerator generator(library);
+    check(generator.size() == 12 && generator.remaining() == 12, "Counting the variants in a design space");
+
+    bool is_decoded = true;
+    unsigned long long n_enumerated = 0;
+    while (ComponentDefinition* variant = generator.next())
+    {
+        // Each Component that may be left out has one more option than it has variants, which is to leave it out
+        unsigned long long ordinal = n_enumerated++;
+        string c0 = ordinal / 4 < 2 ? "http://examples.com/c0_variant" + to_string(ordinal / 4) : "";
+        string c2 = ordinal % 4 < 3 ? "http://examples.com/c2_variant" + to_string(ordinal % 4) : "";
+        is_decoded = is_decoded && variant_ordinal(*variant, "library") == ordinal
+            && variant_definition(*variant, "c0") == c0
+            && variant_definition(*variant, "c1") == "http://examples.com/c1_template"
+            && variant_definition(*variant, "c2") == c2
+            && variant->sequenceConstraints.size() == (c0.empty() || c2.empty() ? 0 : 1);
+        variant->close();
+    }
+    check(is_decoded && n_enumerated == 12 && generator.remaining() == 0, "Enumerating variants in order of their ordinals");
+
+    ComponentDefinition* variant = generator.derive(5);
+    check(variant_definition(*variant, "c0") == "http://examples.com/c0_variant1" && variant_definition(*variant, "c2") == "http://examples.com/c2_variant1", "Deriving a variant from its ordinal");
+    variant->close();
+    bool is_refused = false;
+    try
+    {
+        generator.derive(12);
+    }
+    catch (SBOLError &e)
+    {
+        is_refused = e.error_code() == SBOL_ERROR_INVALID_ARGUMENT;
+    }
+    check(is_refused, "Deriving a variant outside the design space");
+}
+
+// Samples a design space that does not fill a power of two, and checks every seed draws each variant exactly once, in an order the seed repeats
+void test_sample_variants()
+{
+    Document doc;
+    CombinatorialDerivation& library = create_library(doc, "sampled", { 3, 5, 7 }, SBOL_SAMPLE, "http://sbols.org/v2#one");
+    bool is_bijective = true;
+    bool is_shuffled = true;
+    bool is_repeated = true;
+    for (unsigned long long seed = 0; seed < 8; ++seed)
+    {
+        VariantGenerator generator(library, 0, seed);
+        vector<unsigned long long> ordinals;
+        while (ComponentDefinition* variant = generator.next())
+        {
+            ordinals.push_back(variant_ordinal(*variant, "sampled"));
+            variant->close();
+        }
+        vector<unsigned long long> drawn = ordinals;
+        sort(drawn.begin(), drawn.end());
+        for (unsigned long long i_ordinal = 0; i_ordinal < 105; ++i_ordinal)
+            is_bijective = is_bijective && drawn.size() == 105 && drawn[i_ordinal] == i_ordinal;
+        is_shuffled = is_shuffled && drawn != ordinals;
+
+        generator.reset();
+        for (auto &i_ordinal : ordinals)
+        {
+            ComponentDefinition* variant = generator.next();
+            is_repeated = is_repeated && variant_ordinal(*variant, "sampled") == i_ordinal;
+            variant->close();
+        }
+    }
+    check(is_bijective, "Sampling each variant exactly once");
+    check(is_shuffled, "Sampling variants out of order");
+    check(is_repeated, "Sampling the same variants again after a reset");
+
+    VariantGenerator subset(library, 10, 1);
+    vector<unsigned long long> ordinals;
+    while (ComponentDefinition* variant = subset.next())
+    {
+        ordinals.push_back(variant_ordinal(*variant, "sampled"));
+        variant->close();
+    }
+    sort(ordinals.begin(), ordinals.end());
+    check(ordinals.size() == 10 && unique(ordinals.begin(), ordinals.end()) == ordinals.end() && ordinals.back() < 105, "Sampling a subset of the variants");
+}
+
+// The PartShop tests run against the stand-in repository in partshop_server.py, whose URL is given on the command line
+
+static size_t append_response(char* data, size_t size, size_t n_items, void* response)
+{
+    ((string*)response)->append(data, size * n_items);
+    return size * n_items;
+}
+
+// @return The number of connections the stand-in has opened, requests it has served and 304 responses it has sent
+vector<int> server_stats(string url)
+{
+    string response;
+    CURL* curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, (url + "/stats").c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, append_response);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    vector<int> stats(3, -1);
+    istringstream(response) >> stats[0] >> stats[1] >> stats[2];
+    return stats;
+}
+
+// Makes many requests through one PartShop and its copies, which share a pool of connections
+void test_partshop_pool(string url)
+{
+    vector<int> before = server_stats(url);
+    PartShop shop(url);
+    int total = 0;
+    for (int i_request = 0; i_request < 50; ++i_request)
+        total += shop.count<ComponentDefinition>();
+    PartShop copy = shop;
+    total += copy.count<ComponentDefinition>();
+    vector<int> after = server_stats(url);
+    check(total == 51 * 42 && after[1] - before[1] == 51 && after[0] - before[0] <= 3, "Reusing pooled connections");
+
+    bool is_refused = false;
+    try
+    {
+        PartShop unreachable("http://127.0.0.1:1");
+        unreachable.count<ComponentDefinition>();
+    }
+    catch (SBOLError &e)
+    {
+        is_refused = true;
+    }
+    check(is_refused, "Requesting from an unreachable repository");
+}
+
+// Validates several times through the pooled connections, which are kept open between requests. The request for
+// statistics opens a connection of its own
+void test_validator_connections(string url)
+{
+    Document doc;
+    doc.componentDefinitions.create("validated");
+    Config::setOption("validator_url", url + "/validate");
+    Config::setOption("validate", true);
+    vector<int> before = server_stats(url);
+    bool is_valid = true;
+    for (int i_request = 0; i_request < 10; ++i_request)
+        is_valid = is_valid && doc.validate() == "Valid.";
+    vector<int> after = server_stats(url);
+    Config::setOption("validate", false);
+    check(is_valid && after[1] - before[1] == 10 && after[0] - before[0] <= 2, "Validating through pooled connections");
+}
+
+// Pulls a design along with the parts and Sequences it refers to
+void test_partshop_pull(string url)
+{
+    PartShop shop(url);
+    Document doc;
+    shop.pull(vector<string>{ url + "/cd/top/1" }, doc, 2);
+    check(doc.componentDefinitions.size() == 21 && doc.sequences.size() == 20, "Pulling references to a depth");
+    check(doc.get<ComponentDefinition>(url + "/cd/top/1").components.size() == 20, "Pulling an object with children");
+
+    vector<int> before = server_stats(url);
+    shop.pull(vector<string>{ url + "/cd/top/1", url + "/cd/part1/1" }, doc, 2);
+    vector<int> after = server_stats(url);
+    check(after[1] == before[1] && doc.componentDefinitions.size() == 21, "Pulling objects the Document already has");
+
+    Document bundled;
+    shop.pull(vector<string>{ url + "/cd/top/1" }, bundled, 1, 1);
+    check(bundled.componentDefinitions.size() == 21 && bundled.sequences.size() == 10, "Pulling one level over one connection");
+
+    bool is_missing = false;
+    try
+    {
+        Document missing;
+        shop.pull(vector<string>{ url + "/nothing/1" }, missing);
+    }
+    catch (SBOLError &e)
+    {
+        is_missing = true;
+    }
+    check(is_missing, "Pulling an object the repository does not have");
+}
+
+// Answers a second pull from a cache on disk, then revalidates the cached responses once they are stale
+void test_partshop_cache(string url)
+{
+    string directory = "partshop_cache";
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+    {
+        PartShop shop(url);
+        shop.setCache(directory, 3600);
+        Document doc;
+        shop.pull(vector<string>{ url + "/cd/top/1" }, doc, 2);
+    }
+    vector<int> before = server_stats(url);
+    {
+        PartShop shop(url);
+        shop.setCache(directory, 3600);
+        Document doc;
+        shop.pull(vector<string>{ url + "/cd/top/1" }, doc, 2);
+        // Only the Sequence that the repository does not have is requested again, since failed requests are not cached
+        check(doc.componentDefinitions.size() == 21 && doc.sequences.size() == 20 && server_stats(url)[1] == before[1] + 1, "Pulling from a fresh cache");
+    }
+    {
+        PartShop shop(url);
+        shop.setCache(directory, 0);
+        Document doc;
+        shop.pull(vector<string>{ url + "/cd/top/1" }, doc, 2);
+        check(doc.componentDefinitions.size() == 21 && server_stats(url)[2] > before[2], "Revalidating a stale cache");
+    }
+
+    bool is_refused = false;
+    try
+    {
+        PartShop shop(url);
+        shop.setCache(directory + "/missing/directory");
+    }
+    catch (SBOLError &e)
+    {
+        is_refused = true;
+    }
+    check(is_refused, "Caching in a directory that does not exist");
+}
+
+// Iterates over every record of a search that takes many pages
+void test_partshop_search_all(string url)
+{
+    PartShop shop(url);
+    SearchIterator records = shop.searchAll("GFP", SBOL_COMPONENT_DEFINITION, 64);
+    bool is_ordered = true;
+    while (records.next())
+        is_ordered = is_ordered && records->displayId == "rec" + to_string(records.count() - 1);
+    check(is_ordered && records.count() == 1000, "Iterating over every search record");
+
+    // The second page of this search is not JSON.  Asking for it again must fail the same way
+    SearchIterator broken = shop.searchAll("broken", SBOL_COMPONENT_DEFINITION, 64);
+    int n_failures = 0;
+    for (int i_attempt = 0; i_attempt < 66; ++i_attempt)
+    {
+        try
+        {
+            broken.next();
+        }
+        catch (SBOLError &e)
+        {
+            ++n_failures;
+        }
+    }
+    check(broken.count() == 64 && n_failures == 2, "Iterating past a page that does not parse");
+}
+
+// Submits a Document, with and without compression. The stand-in answers with the file it received
+void test_partshop_submit(string url)
+{
+    Document doc;
+    doc.displayId.set("library");
+    doc.name.set("Library");
+    doc.description.set("Parts for the submission test");
+    doc.version.set("1");
+    for (int i_part = 0; i_part < 3; ++i_part)
+    {
+        ComponentDefinition& cd = doc.componentDefinitions.create("part" + to_string(i_part));
+        Sequence& seq = doc.sequences.create("part" + to_string(i_part) + "_seq");
+        seq.elements.set("acgtacgt");
+        cd.sequences.set(seq.identity.get());
+    }
+    // Submissions are posted to synbiohub.org, so they are sent through the stand-in as a proxy
+#ifdef _WIN32
+    _putenv_s("http_proxy", url.c_str());
+#else
+    setenv("http_proxy", url.c_str(), 1);
+#endif
+    PartShop shop(url);
+    bool is_done = false;
+    shop.setUploadProgress([&](const UploadProgress& progress) { is_done = progress.done; });
+    for (int compress = 0; compress < 2; ++compress)
+    {
+        string response = shop.submit(doc, 0, compress != 0);
+        Document received;
+        received.readString(response);
+        check(received.componentDefinitions.size() == 3 && received.sequences.size() == 3 && is_done, compress ? "Submitting compressed" : "Submitting");
+    }
+#ifdef _WIN32
+    _putenv_s("http_proxy", "");
+#else
+    unsetenv("http_proxy");
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    setHomespace("http://examples.com");
+    Config::setOption("validate", false);
+
+    // Runs first, so no other test has laid out the classes involved
+    test_assemble_short_designs();
+    test_assemble_failed_batch();
+    test_single_pass_read();
+    test_symbol_table();
+    test_referrers();
+    test_property_schema();
+    test_identity_index();
+    test_version_index();
+    test_config_snapshot();
+    test_sequential_order();
+    test_hierarchical_assembly();
+    test_annotation_queries();
+    test_edit_session();
+    test_component_hierarchy();
+    test_packed_reads();
+    test_arena_ownership();
+    test_annotate_numbering();
+    test_tagged_literals();
+    test_write_multiline_literals();
+    test_connect_submodules();
+    test_enumerate_variants();
+    test_sample_variants();
+
+    if (argc > 1)
+    {
+        string url = argv[1];
+        test_partshop_pool(url);
+        test_validator_connections(url);
+        test_partshop_pull(url);
+        test_partshop_cache(url);
+        test_partshop_search_all(url);
+        test_partshop_submit(url);
+    }
+    else
+        cout << "Skipping the PartShop tests. Give the URL of partshop_server.py to run them" << endl;
+
+    cout << "Passed: " << passed << endl;
+    cout << "FAILED: " << failed << endl;
+    return failed != 0;
+}
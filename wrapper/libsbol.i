@@ -99,6 +99,14 @@
 %ignore sbol::SBOLObject::close;
 %ignore sbol::SBOLObject::properties;
 %ignore sbol::SBOLObject::list_properties;
+%ignore sbol::PropertyValue;
+%ignore sbol::Config::Snapshot;
+%ignore sbol::Config::snapshot;
+%ignore sbol::ConnectionPool;
+%ignore sbol::PooledHandle;
+%ignore sbol::ResponseCache;
+%ignore sbol::SearchIterator::SearchIterator;
+%ignore sbol::PartShop::setUploadProgress;
 %ignore sbol::SBOLObject::owned_objects;
 %ignore sbol::SBOLObject::begin;
 // %ignore sbol::SBOLObject::end;
@@ -115,6 +123,7 @@
 %ignore sbol::Document::flatten();
 %ignore sbol::Document::parse_objects;
 %ignore sbol::Document::close;
+%ignore sbol::Document::checkArena;
 
 
 // Instantiate STL templates
@@ -191,6 +200,7 @@
 %include "module.h"
 %include "model.h"
 %include "collection.h"
+%include "combinatorialderivation.h"
 %include "moduledefinition.h"
 
 // Converts json-formatted text into Python data structures, eg, lists, dictionaries
@@ -352,18 +362,23 @@ TEMPLATE_MACRO_1(Module);
 TEMPLATE_MACRO_1(Interaction);
 TEMPLATE_MACRO_1(FunctionalComponent);
 
+// CombinatorialDerivation templates
+TEMPLATE_MACRO_1(VariableComponent);
+
 // Templates classes used by Document class
 TEMPLATE_MACRO_1(ComponentDefinition);
 TEMPLATE_MACRO_1(ModuleDefinition);
 TEMPLATE_MACRO_1(Sequence);
 TEMPLATE_MACRO_1(Model);
 TEMPLATE_MACRO_1(Collection);
+TEMPLATE_MACRO_1(CombinatorialDerivation);
 
 TEMPLATE_MACRO_2(ComponentDefinition)
 TEMPLATE_MACRO_2(ModuleDefinition)
 TEMPLATE_MACRO_2(Sequence)
 TEMPLATE_MACRO_2(Model)
 TEMPLATE_MACRO_2(Collection)
+TEMPLATE_MACRO_2(CombinatorialDerivation)
 
 
 %template(copyComponentDefinition) sbol::TopLevel::copy < ComponentDefinition >;
@@ -398,7 +413,7 @@ TEMPLATE_MACRO_2(Collection)
             throw SBOLError(END_OF_LIST, "");
         if ($self->python_iter != $self->end())
         {
-            std::string ref = *$self->python_iter;
+            std::string ref = $self->python_iter->str();
             $self->python_iter++;
             if ($self->python_iter == $self->end())
             {
@@ -417,7 +432,7 @@ TEMPLATE_MACRO_2(Collection)
             throw SBOLError(END_OF_LIST, "");
         if ($self->python_iter != $self->end())
         {
-            std::string ref = *$self->python_iter;
+            std::string ref = $self->python_iter->str();
             $self->python_iter++;
             if ($self->python_iter == $self->end())
             {